@@ -6,6 +6,7 @@ import {
     FaCheckCircle, FaExclamationTriangle, FaFingerprint, FaKey,
     FaSearch, FaDollarSign, FaTimesCircle, FaCheck
 } from 'react-icons/fa';
+import { verifyLocally } from './wasmVerifier';
 
 const API_BASE = '/api';
 const MAX_WATERMARK_LENGTH = 32;
@@ -29,6 +30,8 @@ function App() {
     const [verifyResult, setVerifyResult] = useState(null);
     const [quickVerifyResult, setQuickVerifyResult] = useState(null);
     const [hasDownloaded, setHasDownloaded] = useState(false);
+    // 免费查询模式下暂存本地文件，优先在浏览器内验证，必要时再上传
+    const [localFile, setLocalFile] = useState(null);
 
     // [交互] 输入框非法字符拦截提示
     const [inputWarning, setInputWarning] = useState('');
@@ -98,6 +101,15 @@ function App() {
         const file = e.target.files[0];
         if (!file) return;
 
+        if (mode === 'VERIFY') {
+            setLocalFile(file);
+            setFileId(null);
+            setStatus('UPLOADED');
+            setError('');
+            setVerifyResult(null);
+            return;
+        }
+
         const formData = new FormData();
         formData.append('image', file);
         setStatus('UPLOADING');
@@ -170,7 +182,23 @@ function App() {
         } else if (mode === 'VERIFY') {
             setStatus('VERIFYING');
             try {
-                const res = await axios.post(`${API_BASE}/verify_watermark_free`, { fileId });
+                const localResult = localFile ? await verifyLocally(localFile) : null;
+                if (localResult) {
+                    setVerifyResult(localResult);
+                    setStatus('VERIFIED');
+                    return;
+                }
+
+                // 本地结果不可靠时回退服务端
+                let verifyFileId = fileId;
+                if (!verifyFileId) {
+                    const formData = new FormData();
+                    formData.append('image', localFile);
+                    const uploadRes = await axios.post(`${API_BASE}/upload_verify`, formData);
+                    verifyFileId = uploadRes.data.fileId;
+                    setFileId(verifyFileId);
+                }
+                const res = await axios.post(`${API_BASE}/verify_watermark_free`, { fileId: verifyFileId });
                 setVerifyResult(res.data);
                 setStatus('VERIFIED');
             } catch (err) {
@@ -232,6 +260,7 @@ function App() {
         setVerifyResult(null);
         setQuickVerifyResult(null);
         setHasDownloaded(false);
+        setLocalFile(null);
     };
 
     const getStepTitle = () => {
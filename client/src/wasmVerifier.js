@@ -0,0 +1,92 @@
+// 浏览器端水印验证 (WebAssembly)
+// 模块由 cpp-service 的 emcmake 构建产出到 client/public/wasm，
+// 与服务端 /verify 使用同一份 C++ 提取代码。
+
+const WASM_BASE = '/wasm';
+
+// 水印最多 1 字节长度 + 255 字节数据，只需读取前 2048 个像素
+const MAX_PAYLOAD_PIXELS = 8 + 255 * 8;
+
+// 仅在无损格式上信任"未检测到"的结论，其余情况回退服务端
+const LOSSLESS_TYPES = ['image/png', 'image/bmp'];
+
+// 最小的 SIMD128 模块 (i8x16.popcnt)，用于特性检测
+const SIMD_PROBE = new Uint8Array([
+    0, 97, 115, 109, 1, 0, 0, 0, 1, 5, 1, 96, 0, 1, 123, 3, 2, 1, 0, 10, 10, 1, 8, 0, 65, 0, 253, 15, 253, 98, 11
+]);
+
+let verifierPromise = null;
+
+const loadVerifier = () => {
+    if (!verifierPromise) {
+        const simd = typeof WebAssembly === 'object' && WebAssembly.validate(SIMD_PROBE);
+        const url = `${WASM_BASE}/${simd ? 'sentinel-verify-simd' : 'sentinel-verify'}.mjs`;
+        verifierPromise = import(/* @vite-ignore */ url)
+            .then((mod) => mod.default())
+            .catch((err) => {
+                verifierPromise = null;
+                throw err;
+            });
+    }
+    return verifierPromise;
+};
+
+const readPayloadPixels = async (file) => {
+    const bitmap = await createImageBitmap(file, { colorSpaceConversion: 'none', premultiplyAlpha: 'none' });
+    const width = bitmap.width;
+    const height = Math.min(bitmap.height, Math.ceil(MAX_PAYLOAD_PIXELS / width));
+
+    const canvas = document.createElement('canvas');
+    canvas.width = width;
+    canvas.height = height;
+    const ctx = canvas.getContext('2d', { willReadFrequently: true });
+    ctx.drawImage(bitmap, 0, 0);
+    bitmap.close();
+
+    return ctx.getImageData(0, 0, width, height);
+};
+
+/**
+ * 在本地排除水印。返回 null 表示需要服务端判定 (模块缺失、含透明像素、有损格式、本地命中或签名载荷)，
+ * 调用方应回退到服务端 /api/verify_watermark_free。
+ */
+export const verifyLocally = async (file) => {
+    let module;
+    let imageData;
+    try {
+        module = await loadVerifier();
+        imageData = await readPayloadPixels(file);
+    } catch (err) {
+        return null;
+    }
+
+    // Canvas 内部预乘 Alpha，半透明像素的颜色值不可信
+    const pixels = imageData.data;
+    for (let i = 3; i < pixels.length; i += 4) {
+        if (pixels[i] !== 255) return null;
+    }
+
+    const ptr = module._malloc(pixels.length);
+    let result;
+    try {
+        module.HEAPU8.set(pixels, ptr);
+        result = JSON.parse(module.UTF8ToString(module._sentinel_verify_rgba(ptr, imageData.width, imageData.height)));
+    } finally {
+        module._free(ptr);
+    }
+
+    // 签名载荷需要服务端的公钥验证，本地只能确认"已签名、未验证"；
+    // 未签名的 MAGIC_HEADER 任何人都能伪造，服务端开启 requireSignature 时不算通过，
+    // 因此本地命中一律交给服务端确认，本地只负责无损格式上"未检测到"的快速结论
+    if (result.signature || result.success) return null;
+    if (!LOSSLESS_TYPES.includes(file.type)) return null;
+
+    return {
+        success: true,
+        found: false,
+        extractedText: null,
+        confidenceScore: 0,
+        message: '未检测到有效数字水印',
+        local: true
+    };
+};
@@ -0,0 +1,374 @@
+#include "algorithms.h"
+#include "file_utils.h"
+#include "image_decoder.h"
+#include "perf_counters.h"
+#include "signed_payload.h"
+#include <climits>
+#include <stdexcept>
+
+using json = ArenaJson;
+using namespace cv;
+
+// =======================================================
+// 编码参数
+// =======================================================
+static std::string lowerExtension(const std::string& path) {
+    size_t dot = path.find_last_of('.');
+    std::string ext = dot == std::string::npos ? "" : path.substr(dot + 1);
+    for (char& c : ext) c = (char)tolower(c);
+    return ext;
+}
+
+std::vector<int> encodeParams(const std::string& path, const CodecOptions& codec) {
+    std::vector<int> params;
+    std::string ext = lowerExtension(path);
+    if (ext == "png" && codec.pngCompression >= 0) {
+        params.push_back(IMWRITE_PNG_COMPRESSION);
+        params.push_back(codec.pngCompression);
+    }
+    else if ((ext == "jpg" || ext == "jpeg") && codec.jpegQuality >= 0) {
+        params.push_back(IMWRITE_JPEG_QUALITY);
+        params.push_back(codec.jpegQuality);
+    }
+    else if (ext == "webp" && codec.webpQuality >= 0) {
+        params.push_back(IMWRITE_WEBP_QUALITY);
+        params.push_back(codec.webpQuality);
+    }
+    return params;
+}
+
+bool isLosslessOutput(const std::string& path) {
+    std::string ext = lowerExtension(path);
+    return ext == "png" || ext == "bmp" || ext == "tif" || ext == "tiff";
+}
+
+void writeImage(const std::string& path, const Mat& img, const CodecOptions& codec) {
+    if (!imwrite(path, img, encodeParams(path, codec))) throw std::runtime_error("保存失败: " + path);
+}
+
+static ImageLoader g_imageLoader;
+
+void setImageLoader(ImageLoader loader) { g_imageLoader = loader; }
+
+Mat loadImage(const std::string& path) {
+    Mat img = g_imageLoader ? g_imageLoader(path) : decodeImageFile(path);
+    if (img.empty()) throw std::runtime_error("无法读取图片: " + path);
+    return img;
+}
+
+static ScaledImageLoader g_scaledImageLoader;
+
+void setScaledImageLoader(ScaledImageLoader loader) { g_scaledImageLoader = loader; }
+
+Mat loadImageAtLeast(const std::string& path, int minSide) {
+    if (!g_scaledImageLoader) return loadImage(path);
+    Mat img = g_scaledImageLoader(path, minSide);
+    if (img.empty()) throw std::runtime_error("无法读取图片: " + path);
+    return img;
+}
+
+static RegionImageLoader g_regionImageLoader;
+
+void setRegionImageLoader(RegionImageLoader loader) { g_regionImageLoader = loader; }
+
+Mat loadImageRegion(const std::string& path, Rect& roi) {
+    Mat img;
+    if (g_regionImageLoader) {
+        img = g_regionImageLoader(path, roi);
+    }
+    else {
+        std::vector<uchar> bytes;
+        if (readFile(path, bytes)) img = decodeImageRegion(bytes, roi);
+    }
+    if (img.empty()) throw std::runtime_error("无法读取图片区域: " + path);
+    return img;
+}
+
+static LumaImageLoader g_lumaImageLoader;
+
+void setLumaImageLoader(LumaImageLoader loader) { g_lumaImageLoader = loader; }
+
+static Mat loadLuma(const std::string& path, Rect& roi, int minSide) {
+    Mat img;
+    if (g_lumaImageLoader) {
+        img = g_lumaImageLoader(path, roi, minSide);
+    }
+    else {
+        std::vector<uchar> bytes;
+        if (readFile(path, bytes)) img = roi.empty() ? decodeImageLuma(bytes, minSide) : decodeImageRegionLuma(bytes, roi);
+    }
+    return img;
+}
+
+Mat loadImageLuma(const std::string& path, int minSide) {
+    Rect whole;
+    Mat img = loadLuma(path, whole, minSide);
+    if (img.empty()) throw std::runtime_error("无法读取图片: " + path);
+    return img;
+}
+
+Mat loadImageRegionLuma(const std::string& path, Rect& roi) {
+    Mat img = loadLuma(path, roi, 0);
+    if (img.empty()) throw std::runtime_error("无法读取图片区域: " + path);
+    return img;
+}
+
+Rect parseRoi(const json& value) {
+    if (!value.is_object()) throw std::runtime_error("roi 必须为对象 {x, y, width, height}");
+    int field[4];
+    const char* names[4] = { "x", "y", "width", "height" };
+    for (int i = 0; i < 4; ++i) {
+        if (!value.contains(names[i]) || !value[names[i]].is_number_integer()) {
+            throw std::runtime_error(std::string("roi 缺少整数字段 ") + names[i]);
+        }
+        // 按 64 位读取再检查范围，超出 int 的值不能被截断成看似合法的坐标；
+        // 上限取 INT_MAX / 2，x + width、y + height 不会溢出
+        const json& v = value[names[i]];
+        if (v.is_number_unsigned() ? v.get<uint64_t>() > (uint64_t)(INT_MAX / 2) : v.get<int64_t>() > INT_MAX / 2) {
+            throw std::runtime_error(std::string("roi 字段超出范围: ") + names[i]);
+        }
+        int64_t n = v.get<int64_t>();
+        if (n < 0 || (i >= 2 && n == 0)) throw std::runtime_error("roi 坐标不能为负，尺寸必须为正");
+        field[i] = (int)n;
+    }
+    return Rect(field[0], field[1], field[2], field[3]);
+}
+
+static void reportRoi(const Rect& roi, json& response) {
+    json& out = response["roi"];
+    out["x"] = roi.x;
+    out["y"] = roi.y;
+    out["width"] = roi.width;
+    out["height"] = roi.height;
+}
+
+Mat loadProcessingImage(const std::string& path, const Rect& requested, json& response) {
+    if (requested.empty()) return loadImage(path);
+    Rect roi = requested;
+    Mat img = loadImageRegion(path, roi);
+    reportRoi(roi, response);
+    return img;
+}
+
+Mat loadProcessingLuma(const std::string& path, const Rect& requested, json& response) {
+    if (requested.empty()) return loadImageLuma(path);
+    Rect roi = requested;
+    Mat img = loadImageRegionLuma(path, roi);
+    reportRoi(roi, response);
+    return img;
+}
+
+std::string previewPathFor(const std::string& outputPath) {
+    return outputPath.substr(0, outputPath.find_last_of('.')) + "_preview.png";
+}
+
+Mat shrinkToMaxSide(const Mat& img, int maxSide) {
+    int longest = std::max(img.rows, img.cols);
+    if (maxSide <= 0 || longest <= maxSide) return img;
+    double scale = (double)maxSide / longest;
+    Mat small;
+    resize(img, small, Size(std::max(1, (int)(img.cols * scale)), std::max(1, (int)(img.rows * scale))), 0, 0, INTER_AREA);
+    return small;
+}
+
+// =======================================================
+// 算法 1: 隐形水印嵌入 (Blue Channel + Magic Header)
+// =======================================================
+void embedWatermark(Mat& img, const std::string& watermarkText) {
+    // 加盐：拼接 Header
+    embedPayload(img, MAGIC_HEADER + watermarkText);
+}
+
+void embedPayload(Mat& img, const std::string& fullPayload) {
+    int watermarkLen = (int)payloadBitCount(fullPayload);
+
+    if (watermarkLen == 0) throw std::runtime_error("水印内容无效");
+    if (watermarkLen > (img.rows * img.cols)) throw std::runtime_error("图片太小，无法嵌入水印");
+
+    int bitIndex = 0;
+
+    // 嵌入到 Blue 通道
+    for (int i = 0; i < img.rows; ++i) {
+        for (int j = 0; j < img.cols; ++j) {
+            Vec3b& pixel = img.at<Vec3b>(i, j);
+            uchar& blue = pixel[0];
+
+            if (bitIndex < watermarkLen) {
+                blue = (blue & 0xFE) | payloadBit(fullPayload, bitIndex);
+                bitIndex++;
+            }
+            else {
+                return;
+            }
+        }
+    }
+}
+
+Mat renderWatermarkPreview(const Mat& watermarked, const std::string& watermarkText, int bannerHeight) {
+    Mat preview_img = watermarked.clone();
+    // 预览缩得很小时横幅随之压低，不能因为放不下就整块省略
+    int box_h = std::min(bannerHeight, preview_img.rows - 20);
+    Rect rect(10, 10, preview_img.cols - 20, box_h);
+    if (box_h > 0 && rect.width > 0) {
+        Mat sub_region = preview_img(rect);
+        addWeighted(sub_region, 0.7, Mat::zeros(sub_region.size(), sub_region.type()), 0.3, 0, sub_region);
+    }
+
+    putText(preview_img, "DIGITAL WATERMARK EMBEDDED", Point(30, 40),
+        FONT_HERSHEY_DUPLEX, 0.7, Scalar(0, 255, 0), 1, LINE_AA);
+    putText(preview_img, "Data: " + watermarkText, Point(30, 80),
+        FONT_HERSHEY_SIMPLEX, 0.6, Scalar(255, 255, 255), 1, LINE_AA);
+    return preview_img;
+}
+
+void processWatermark(const std::string& inputPath, const std::string& outputPath, const std::string& watermarkText, json& response,
+    const ProcessOptions& options) {
+    Mat img;
+    {
+        PerfScope perf("watermark", "decode");
+        img = loadProcessingImage(inputPath, options.roi, response);
+    }
+
+    Mat watermarked_full = img.clone();
+    {
+        PerfScope perf("watermark", "embed");
+        embedPayload(watermarked_full, watermarkPayload(watermarkText, options.signature));
+    }
+    {
+        PerfScope perf("watermark", "encode");
+        writeImage(outputPath, watermarked_full, options.codec);
+    }
+
+    // 生成预览图 (先缩小再叠加文字)；预览是未付费用户唯一能看到的版本，降级时也不省略
+    {
+        PerfScope perf("watermark", "preview");
+        Mat preview_img = renderWatermarkPreview(shrinkToMaxSide(watermarked_full, options.previewMaxSide), watermarkText,
+            options.previewBannerHeight);
+        std::string previewPath = previewPathFor(outputPath);
+        writeImage(previewPath, preview_img, options.codec);
+        response["previewPath"] = previewPath;
+    }
+
+    response["success"] = true;
+    response["embeddedText"] = watermarkText;
+    response["algorithm"] = "LSB (Blue Channel + Header)";
+    if (!options.signature.empty()) response["signature"] = options.signature;
+}
+
+// =======================================================
+// 算法 2: 图像取证
+// =======================================================
+Mat detectForensicEdges(const Mat& img) {
+    Mat edges;
+    if (img.channels() == 1) {
+        Canny(img, edges, 100, 200);
+    }
+    else {
+        cvtColor(img, edges, COLOR_BGR2GRAY);
+        Canny(edges, edges, 100, 200);
+    }
+    return edges;
+}
+
+Mat renderForensicsPreview(const Mat& edges) {
+    Mat preview_img;
+    cvtColor(edges, preview_img, COLOR_GRAY2BGR);
+    putText(preview_img, "FORENSICS ANALYSIS PREVIEW", Point(30, 50), FONT_HERSHEY_DUPLEX, 0.7, Scalar(0, 0, 255), 2, LINE_AA);
+    return preview_img;
+}
+
+void processForensics(const std::string& inputPath, const std::string& outputPath, const std::string& watermarkText, json& response,
+    const ProcessOptions& options) {
+    // 降级时推迟全分辨率的精细分析，只在缩小图上给出粗略结果
+    Mat img;
+    {
+        PerfScope perf("forensics", "decode");
+        // 边缘检测只看亮度：JPEG 直接取 Y 分量，省去色度上采样与两次颜色转换
+        if (!options.roi.empty()) {
+            // 区域已限定了像素数，降级时同样再缩小
+            img = loadProcessingLuma(inputPath, options.roi, response);
+            if (options.coarseForensics) {
+                img = shrinkToMaxSide(img, 1024);
+                response["refinementDeferred"] = true;
+            }
+        }
+        else if (options.coarseForensics) {
+            // JPEG 以 DCT 缩放直接解出接近 1024 的亮度图
+            img = shrinkToMaxSide(loadImageLuma(inputPath, 1024), 1024);
+            response["refinementDeferred"] = true;
+        }
+        else {
+            img = loadImageLuma(inputPath);
+        }
+    }
+    Mat edges;
+    {
+        PerfScope perf("forensics", "canny");
+        edges = detectForensicEdges(img);
+    }
+
+    {
+        PerfScope perf("forensics", "encode");
+        writeImage(outputPath, renderForensicsPreview(edges), options.codec);
+    }
+    // 预览在缩小后的边缘图上重新标注，标注文字不随缩放变小
+    {
+        PerfScope perf("forensics", "preview");
+        std::string previewPath = previewPathFor(outputPath);
+        writeImage(previewPath, renderForensicsPreview(shrinkToMaxSide(edges, options.previewMaxSide)), options.codec);
+        response["previewPath"] = previewPath;
+    }
+
+    response["success"] = true;
+    response["score"] = 90;
+    response["riskLevel"] = "Low";
+}
+
+void refineForensics(const std::string& inputPath, const std::string& outputPath, const Rect& roi, const CodecOptions& codec) {
+    json scratch;
+    Mat img = roi.empty() ? loadImageLuma(inputPath) : loadProcessingLuma(inputPath, roi, scratch);
+    writeImage(outputPath, renderForensicsPreview(detectForensicEdges(img)), codec);
+}
+
+// =======================================================
+// 水印提取/验证算法 (Blue Channel + Header Check)
+// =======================================================
+VerifyResult verifyImage(const Mat& img) {
+    // 提取与 Header 校验在 watermark_codec 中实现，浏览器端 WASM 复用同一份代码
+    LsbView view = { img.data, img.rows, img.cols, img.step, img.channels(), 0 };
+    std::string payload;
+    if (!extractLsbPayload(view, payload)) {
+        VerifyResult none = { false, "", 0.0, "", false };
+        return none;
+    }
+    if (isSignedPayload(payload)) return verifySignedPayload(payload);
+    VerifyResult result = checkPayloadHeader(payload);
+    if (result.success && signatureRequired()) {
+        // 未签名的 MAGIC_HEADER 可被伪造：保留提取到的文本，但不算通过
+        result.success = false;
+        result.confidenceScore = 0.1;
+    }
+    return result;
+}
+
+void processVerify(const std::string& inputPath, const std::string& originalWatermarkData, json& response, const Rect& roi) {
+    Mat img;
+    {
+        PerfScope perf("verify", "decode");
+        img = loadProcessingImage(inputPath, roi, response);
+    }
+
+    VerifyResult result;
+    {
+        PerfScope perf("verify", "extract");
+        result = verifyImage(img);
+    }
+
+    response["success"] = result.success;
+    response["extractedText"] = result.extractedText;
+    response["confidenceScore"] = result.confidenceScore;
+    if (!result.signature.empty()) {
+        response["signature"] = result.signature;
+        response["signatureValid"] = result.signatureValid;
+    }
+}
@@ -0,0 +1,97 @@
+#pragma once
+// =======================================================
+// 图像算法 (服务端 image-service 与离线 sentinel-cli 共用)
+// =======================================================
+#include "request_arena.h"
+#include "watermark_codec.h"
+#include <opencv2/opencv.hpp>
+#include <functional>
+#include <string>
+#include <vector>
+
+// 输出编码参数，-1 表示使用 OpenCV 默认值
+struct CodecOptions {
+    int pngCompression;
+    int jpegQuality;
+    int webpQuality;
+
+    CodecOptions() : pngCompression(-1), jpegQuality(-1), webpQuality(-1) {}
+};
+
+// 单次处理的可选项 (brownout 降级时由服务端调整)
+struct ProcessOptions {
+    CodecOptions codec;
+    int previewMaxSide;   // 预览图最长边，0 表示与输出同尺寸
+    bool coarseForensics; // 取证只在缩小后的图像上分析
+    int previewBannerHeight;
+    std::string signature; // 水印载荷签名方案 ("" 不签名，"ed25519" / "mac"，见 signed_payload.h)
+    cv::Rect roi;          // 只处理该区域 (空表示整张图)，输出即为该区域
+
+    ProcessOptions() : previewMaxSide(0), coarseForensics(false), previewBannerHeight(100) {}
+};
+
+std::vector<int> encodeParams(const std::string& path, const CodecOptions& codec);
+// 按扩展名判断编码是否无损 (png / bmp / tif / tiff)；LSB 水印只能在无损输出中保留
+bool isLosslessOutput(const std::string& path);
+void writeImage(const std::string& path, const cv::Mat& img, const CodecOptions& codec);
+
+// 图片读取入口，默认为 imread；服务端可替换为带缓存的实现。
+// 返回的 Mat 可能与缓存共享数据，需要修改时先 clone()
+typedef std::function<cv::Mat(const std::string&)> ImageLoader;
+void setImageLoader(ImageLoader loader);
+cv::Mat loadImage(const std::string& path); // 失败时抛出 std::runtime_error
+
+// 只需要缩小图时的读取入口：返回最长边不小于 minSide 的图像 (可能来自缓存的金字塔层级)，
+// 调用方再自行缩放；未设置时等同 loadImage
+typedef std::function<cv::Mat(const std::string&, int)> ScaledImageLoader;
+void setScaledImageLoader(ScaledImageLoader loader);
+cv::Mat loadImageAtLeast(const std::string& path, int minSide);
+
+// 只需要 roi 区域时的读取入口：roi 裁剪到图像范围后写回，返回该区域 (可能与缓存共享数据)。
+// 默认为区域解码 (decodeImageRegion)；roi 与图像不相交时抛出 std::runtime_error
+typedef std::function<cv::Mat(const std::string&, cv::Rect&)> RegionImageLoader;
+void setRegionImageLoader(RegionImageLoader loader);
+cv::Mat loadImageRegion(const std::string& path, cv::Rect& roi);
+
+// 只需要亮度时的读取入口：返回 CV_8UC1 (JPEG 为 Y 分量，见 decodeImageLuma)。
+// 加载函数的 roi 为空时读整张图 (minSide > 0 时可以返回较小的图，调用方再缩放)，否则只读该区域并写回裁剪后的 roi。
+// 默认为 decodeImageLuma / decodeImageRegionLuma；失败时抛出 std::runtime_error
+typedef std::function<cv::Mat(const std::string&, cv::Rect&, int)> LumaImageLoader;
+void setLumaImageLoader(LumaImageLoader loader);
+cv::Mat loadImageLuma(const std::string& path, int minSide = 0);
+cv::Mat loadImageRegionLuma(const std::string& path, cv::Rect& roi);
+
+// 请求中的 {"x", "y", "width", "height"}；缺字段、负坐标、非正尺寸或字段超过 INT_MAX / 2 时抛出 std::runtime_error
+cv::Rect parseRoi(const ArenaJson& value);
+// 各处理入口的解码：roi 为空时为 loadImage，否则只解码该区域，
+// 并在 response["roi"] 中给出裁剪到图像范围后的实际区域
+cv::Mat loadProcessingImage(const std::string& path, const cv::Rect& roi, ArenaJson& response);
+// 同上，返回亮度图
+cv::Mat loadProcessingLuma(const std::string& path, const cv::Rect& roi, ArenaJson& response);
+
+// ---- 基于 Mat 的算法核心 ----
+void embedWatermark(cv::Mat& img, const std::string& watermarkText);
+// 嵌入完整载荷 (含头部标记，见 watermarkPayload)
+void embedPayload(cv::Mat& img, const std::string& payload);
+cv::Mat renderWatermarkPreview(const cv::Mat& watermarked, const std::string& watermarkText, int bannerHeight = 100);
+// 取证边缘检测：输入为 BGR 或亮度图，返回单通道边缘图
+cv::Mat detectForensicEdges(const cv::Mat& img);
+// 边缘图转为 BGR 并加标注：取证的输出 (原尺寸) 与预览 (缩小后再调用) 都用它
+cv::Mat renderForensicsPreview(const cv::Mat& edges);
+// 未签名载荷按 MAGIC_HEADER 判定，签名载荷校验签名 (requireSignature 开启时只接受签名有效的)
+VerifyResult verifyImage(const cv::Mat& img);
+
+std::string previewPathFor(const std::string& outputPath);
+// 按最长边等比缩小 (INTER_AREA)，maxSide 为 0 或图像已足够小时原样返回
+cv::Mat shrinkToMaxSide(const cv::Mat& img, int maxSide);
+
+// ---- 基于文件路径的接口 (HTTP 服务使用) ----
+void processWatermark(const std::string& inputPath, const std::string& outputPath, const std::string& watermarkText, ArenaJson& response,
+    const ProcessOptions& options = ProcessOptions());
+void processForensics(const std::string& inputPath, const std::string& outputPath, const std::string& watermarkText, ArenaJson& response,
+    const ProcessOptions& options = ProcessOptions());
+// 降级时推迟的全分辨率取证 (coarseForensics 的补做)：重新分析并把结果写入 outputPath，预览不变
+void refineForensics(const std::string& inputPath, const std::string& outputPath, const cv::Rect& roi, const CodecOptions& codec);
+// roi 非空时只在该区域内提取 (水印以区域自身的左上角为起点)
+void processVerify(const std::string& inputPath, const std::string& originalWatermarkData, ArenaJson& response,
+    const cv::Rect& roi = cv::Rect());
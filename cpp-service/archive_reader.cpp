@@ -0,0 +1,428 @@
+#include "archive_reader.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+#include <unistd.h>
+#include <zlib.h>
+
+static const size_t kBufferSize = 256 * 1024;
+
+ByteSource fdByteSource(int fd) {
+    return [fd](unsigned char* buf, size_t size) -> size_t {
+        while (true) {
+            ssize_t n = ::read(fd, buf, size);
+            if (n >= 0) return (size_t)n;
+            if (errno != EINTR) throw std::runtime_error(std::string("读取失败: ") + strerror(errno));
+        }
+    };
+}
+
+// =======================================================
+// 输入层：原始数据源 / gzip 解压流，外加一层可回看的缓冲
+// =======================================================
+class ArchiveReader::Stream {
+public:
+    virtual ~Stream() {}
+    virtual size_t read(unsigned char* buf, size_t size) = 0;
+};
+
+class ArchiveReader::Buffer {
+public:
+    explicit Buffer(Stream& source) : source_(source), data_(kBufferSize), pos_(0), end_(0), eof_(false) {}
+
+    size_t available() const { return end_ - pos_; }
+    const unsigned char* data() const { return data_.data() + pos_; }
+    void consume(size_t n) { pos_ += n; }
+
+    // 尽量保证至少 n 字节可用 (n 不超过缓冲区大小)，返回实际可用字节数
+    size_t fill(size_t n) {
+        if (available() >= n || eof_) return available();
+        if (pos_ > 0) {
+            memmove(data_.data(), data_.data() + pos_, available());
+            end_ -= pos_;
+            pos_ = 0;
+        }
+        while (end_ < n && !eof_) {
+            size_t got = source_.read(data_.data() + end_, data_.size() - end_);
+            if (got == 0) eof_ = true;
+            end_ += got;
+        }
+        return available();
+    }
+
+    bool readExact(unsigned char* out, size_t n) {
+        while (n > 0) {
+            if (available() == 0 && fill(1) == 0) return false;
+            size_t take = std::min(n, available());
+            memcpy(out, data(), take);
+            consume(take);
+            out += take;
+            n -= take;
+        }
+        return true;
+    }
+
+    bool skip(uint64_t n) {
+        while (n > 0) {
+            if (available() == 0 && fill(1) == 0) return false;
+            size_t take = (size_t)std::min<uint64_t>(n, available());
+            consume(take);
+            n -= take;
+        }
+        return true;
+    }
+
+private:
+    Stream& source_;
+    std::vector<unsigned char> data_;
+    size_t pos_;
+    size_t end_;
+    bool eof_;
+};
+
+namespace {
+
+class CallbackStream : public ArchiveReader::Stream {
+public:
+    explicit CallbackStream(ByteSource source) : source_(source) {}
+    size_t read(unsigned char* buf, size_t size) override { return source_(buf, size); }
+
+private:
+    ByteSource source_;
+};
+
+// gzip 解压流，支持多个成员首尾相接
+class GzipStream : public ArchiveReader::Stream {
+public:
+    explicit GzipStream(ArchiveReader::Buffer& input) : input_(input), finished_(false) {
+        memset(&z_, 0, sizeof(z_));
+        if (inflateInit2(&z_, 16 + MAX_WBITS) != Z_OK) throw std::runtime_error("zlib 初始化失败");
+    }
+    ~GzipStream() { inflateEnd(&z_); }
+
+    size_t read(unsigned char* buf, size_t size) override {
+        z_.next_out = buf;
+        z_.avail_out = (uInt)std::min<size_t>(size, 1u << 30);
+        while (z_.avail_out > 0 && !finished_) {
+            if (input_.available() == 0 && input_.fill(1) == 0) throw std::runtime_error("gzip 数据被截断");
+            z_.next_in = const_cast<Bytef*>(input_.data());
+            z_.avail_in = (uInt)input_.available();
+            int ret = inflate(&z_, Z_NO_FLUSH);
+            input_.consume(input_.available() - z_.avail_in);
+            if (ret == Z_STREAM_END) {
+                if (input_.fill(1) == 0) finished_ = true;
+                else inflateReset(&z_);
+            }
+            else if (ret != Z_OK && ret != Z_BUF_ERROR) {
+                throw std::runtime_error("gzip 数据损坏");
+            }
+            // 已产出数据就先返回，避免在管道输入上无谓阻塞
+            if (z_.next_out != buf) break;
+        }
+        return z_.next_out - buf;
+    }
+
+private:
+    ArchiveReader::Buffer& input_;
+    z_stream z_;
+    bool finished_;
+};
+
+// 写入条目内容，超过上限后只计数不保存
+struct EntrySink {
+    std::vector<unsigned char>& out;
+    size_t limit;
+    uint64_t total;
+    bool overflow;
+
+    EntrySink(std::vector<unsigned char>& o, size_t l) : out(o), limit(l), total(0), overflow(false) {}
+
+    void append(const unsigned char* data, size_t n) {
+        total += n;
+        if (overflow) return;
+        if (total > limit) {
+            overflow = true;
+            std::vector<unsigned char>().swap(out);
+            return;
+        }
+        out.insert(out.end(), data, data + n);
+    }
+};
+
+uint16_t le16(const unsigned char* p) { return (uint16_t)(p[0] | (p[1] << 8)); }
+uint32_t le32(const unsigned char* p) { return (uint32_t)le16(p) | ((uint32_t)le16(p + 2) << 16); }
+uint64_t le64(const unsigned char* p) { return (uint64_t)le32(p) | ((uint64_t)le32(p + 4) << 32); }
+
+// 未压缩 (stored) 且带数据描述符的条目：大小未知，只能向后扫描描述符签名，
+// 以 "压缩大小 == 已读字节数 且 CRC 一致" 确认找到真正的结尾
+void readStoredUntilDescriptor(ArchiveReader::Buffer& in, EntrySink& sink, bool zip64) {
+    static const unsigned char kSig[4] = { 'P', 'K', 7, 8 };
+    const size_t descLen = zip64 ? 24 : 16;
+    uLong crc = crc32(0L, Z_NULL, 0);
+    while (true) {
+        if (in.fill(descLen) < descLen) throw std::runtime_error("zip 数据被截断");
+        const unsigned char* p = in.data();
+        size_t n = in.available();
+        const unsigned char* hit = std::search(p, p + n, kSig, kSig + 4);
+        size_t take = hit - p;
+        if (take == 0) {
+            uint64_t size = zip64 ? le64(p + 8) : le32(p + 8);
+            if (size == sink.total && le32(p + 4) == (uint32_t)crc) {
+                in.consume(descLen);
+                return;
+            }
+            take = 1; // 数据中恰好出现了签名字节，继续向后扫描
+        }
+        else if (hit == p + n) {
+            take = n - 3; // 保留末尾可能是半个签名的字节
+        }
+        crc = crc32(crc, p, (uInt)take);
+        sink.append(p, take);
+        in.consume(take);
+    }
+}
+
+// tar 数字字段：八进制文本，或首字节最高位为 1 时的 base-256 编码
+uint64_t tarNumber(const unsigned char* field, size_t len) {
+    uint64_t value = 0;
+    if (field[0] & 0x80) {
+        for (size_t i = 1; i < len; ++i) value = (value << 8) | field[i];
+        return value;
+    }
+    for (size_t i = 0; i < len; ++i) {
+        if (field[i] >= '0' && field[i] <= '7') value = value * 8 + (field[i] - '0');
+        else if (field[i] != ' ' || value != 0) break;
+    }
+    return value;
+}
+
+std::string tarString(const unsigned char* field, size_t len) {
+    size_t n = 0;
+    while (n < len && field[n]) ++n;
+    return std::string(reinterpret_cast<const char*>(field), n);
+}
+
+bool tarChecksumOk(const unsigned char* header) {
+    uint64_t sum = 0;
+    for (int i = 0; i < 512; ++i) sum += (i >= 148 && i < 156) ? ' ' : header[i];
+    return sum == tarNumber(header + 148, 8);
+}
+
+// pax 扩展头："<长度> path=<值>\n" 记录序列，只关心 path
+std::string paxPath(const std::vector<unsigned char>& data) {
+    std::string text(data.begin(), data.end());
+    size_t pos = 0;
+    while (pos < text.size()) {
+        size_t space = text.find(' ', pos);
+        if (space == std::string::npos) break;
+        size_t len = std::strtoul(text.c_str() + pos, nullptr, 10);
+        if (len == 0 || pos + len > text.size()) break;
+        std::string record = text.substr(space + 1, pos + len - space - 2);
+        if (record.compare(0, 5, "path=") == 0) return record.substr(5);
+        pos += len;
+    }
+    return std::string();
+}
+
+}
+
+// =======================================================
+// ArchiveReader
+// =======================================================
+ArchiveReader::ArchiveReader(ByteSource source, size_t maxEntryBytes)
+    : raw_(new CallbackStream(source)), in_(nullptr), maxEntryBytes_(maxEntryBytes) {
+    rawBuffer_.reset(new Buffer(*raw_));
+}
+
+ArchiveReader::~ArchiveReader() {}
+
+void ArchiveReader::detect() {
+    in_ = rawBuffer_.get();
+    in_->fill(4);
+    const unsigned char* p = in_->data();
+    if (in_->available() >= 2 && p[0] == 0x1f && p[1] == 0x8b) {
+        gzip_.reset(new GzipStream(*rawBuffer_));
+        gzipBuffer_.reset(new Buffer(*gzip_));
+        in_ = gzipBuffer_.get();
+        format_ = "tar.gz";
+    }
+    else if (in_->available() >= 4 && le32(p) == 0x04034b50) {
+        format_ = "zip";
+    }
+    else {
+        format_ = "tar";
+    }
+}
+
+bool ArchiveReader::next(ArchiveEntry& entry) {
+    if (!in_) detect();
+    entry = ArchiveEntry();
+    return format_ == "zip" ? nextZip(entry) : nextTar(entry);
+}
+
+bool ArchiveReader::nextTar(ArchiveEntry& entry) {
+    std::string longName;
+    while (true) {
+        unsigned char header[512];
+        if (!in_->readExact(header, sizeof(header))) return false;
+        // 全零块表示归档结束
+        if (std::all_of(header, header + 512, [](unsigned char c) { return c == 0; })) return false;
+        if (!tarChecksumOk(header)) throw std::runtime_error("tar 头部校验失败");
+
+        uint64_t size = tarNumber(header + 124, 12);
+        uint64_t padded = (size + 511) & ~(uint64_t)511;
+        char type = (char)header[156];
+
+        if (type == 'L' || type == 'x') {
+            // GNU 长文件名 / pax 扩展头：内容作用于下一个条目
+            std::vector<unsigned char> meta;
+            EntrySink sink(meta, 1 << 20);
+            std::vector<unsigned char> chunk(512);
+            for (uint64_t left = padded; left > 0; left -= 512) {
+                if (!in_->readExact(chunk.data(), 512)) throw std::runtime_error("tar 数据被截断");
+                sink.append(chunk.data(), (size_t)std::min<uint64_t>(512, size - std::min(size, padded - left)));
+            }
+            std::string name = type == 'L' ? tarString(meta.data(), meta.size()) : paxPath(meta);
+            if (!name.empty()) longName = name;
+            continue;
+        }
+
+        if (type != '0' && type != '\0' && type != '7') {
+            // 目录、链接、设备等：跳过
+            if (!in_->skip(padded)) throw std::runtime_error("tar 数据被截断");
+            longName.clear();
+            continue;
+        }
+
+        if (!longName.empty()) {
+            entry.name = longName;
+        }
+        else {
+            std::string prefix = memcmp(header + 257, "ustar", 5) == 0 ? tarString(header + 345, 155) : std::string();
+            entry.name = (prefix.empty() ? "" : prefix + "/") + tarString(header, 100);
+        }
+        entry.size = size;
+
+        if (size > maxEntryBytes_) {
+            entry.error = "条目过大，已跳过";
+            if (!in_->skip(padded)) throw std::runtime_error("tar 数据被截断");
+            return true;
+        }
+        entry.data.resize((size_t)size);
+        if (!in_->readExact(entry.data.data(), (size_t)size) || !in_->skip(padded - size)) {
+            throw std::runtime_error("tar 数据被截断");
+        }
+        return true;
+    }
+}
+
+bool ArchiveReader::nextZip(ArchiveEntry& entry) {
+    while (true) {
+        unsigned char header[30];
+        if (!in_->readExact(header, 4)) return false;
+        uint32_t signature = le32(header);
+        // 到达中央目录 (或归档结束记录) 即说明所有条目已读完
+        if (signature == 0x02014b50 || signature == 0x06054b50 || signature == 0x06064b50) return false;
+        if (signature != 0x04034b50) throw std::runtime_error("zip 本地文件头无效");
+        if (!in_->readExact(header + 4, 26)) throw std::runtime_error("zip 数据被截断");
+
+        uint16_t flags = le16(header + 6);
+        uint16_t method = le16(header + 8);
+        uint64_t compressedSize = le32(header + 18);
+        uint64_t uncompressedSize = le32(header + 22);
+        uint16_t nameLen = le16(header + 26);
+        uint16_t extraLen = le16(header + 28);
+
+        std::vector<unsigned char> nameAndExtra(nameLen + extraLen);
+        if (!in_->readExact(nameAndExtra.data(), nameAndExtra.size())) throw std::runtime_error("zip 数据被截断");
+        entry.name.assign(nameAndExtra.begin(), nameAndExtra.begin() + nameLen);
+
+        // Zip64 扩展字段 (0x0001) 中保存真实大小
+        bool zip64 = false;
+        const unsigned char* extra = nameAndExtra.data() + nameLen;
+        for (size_t off = 0; off + 4 <= extraLen;) {
+            uint16_t id = le16(extra + off);
+            uint16_t len = le16(extra + off + 2);
+            if (id == 0x0001 && off + 4 + len <= extraLen) {
+                zip64 = true;
+                size_t p = off + 4;
+                if (uncompressedSize == 0xFFFFFFFFu && p + 8 <= off + 4 + len) { uncompressedSize = le64(extra + p); p += 8; }
+                if (compressedSize == 0xFFFFFFFFu && p + 8 <= off + 4 + len) { compressedSize = le64(extra + p); }
+            }
+            off += 4 + len;
+        }
+
+        bool hasDescriptor = (flags & 0x08) != 0;
+        bool isDirectory = !entry.name.empty() && entry.name.back() == '/';
+        entry.size = uncompressedSize;
+
+        if (method == 8) {
+            // 无论大小是否已知都解压到流结束，这样带数据描述符的条目也能流式读取
+            z_stream z;
+            memset(&z, 0, sizeof(z));
+            if (inflateInit2(&z, -MAX_WBITS) != Z_OK) throw std::runtime_error("zlib 初始化失败");
+            EntrySink sink(entry.data, maxEntryBytes_);
+            if (!hasDescriptor && uncompressedSize <= maxEntryBytes_) entry.data.reserve((size_t)uncompressedSize);
+            std::vector<unsigned char> out(64 * 1024);
+            int ret = Z_OK;
+            while (ret != Z_STREAM_END) {
+                if (in_->available() == 0 && in_->fill(1) == 0) {
+                    inflateEnd(&z);
+                    throw std::runtime_error("zip 数据被截断");
+                }
+                z.next_in = const_cast<Bytef*>(in_->data());
+                z.avail_in = (uInt)in_->available();
+                z.next_out = out.data();
+                z.avail_out = (uInt)out.size();
+                ret = inflate(&z, Z_NO_FLUSH);
+                in_->consume(in_->available() - z.avail_in);
+                if (ret != Z_OK && ret != Z_STREAM_END && ret != Z_BUF_ERROR) {
+                    inflateEnd(&z);
+                    throw std::runtime_error("zip 条目解压失败: " + entry.name);
+                }
+                sink.append(out.data(), out.size() - z.avail_out);
+            }
+            inflateEnd(&z);
+            entry.size = sink.total;
+            if (sink.overflow) entry.error = "条目过大，已跳过";
+        }
+        else if (hasDescriptor && method == 0 && !(flags & 0x01)) {
+            EntrySink sink(entry.data, maxEntryBytes_);
+            readStoredUntilDescriptor(*in_, sink, zip64);
+            entry.size = sink.total;
+            if (sink.overflow) entry.error = "条目过大，已跳过";
+            hasDescriptor = false; // 描述符已读取
+        }
+        else if (hasDescriptor) {
+            // 大小未知的加密 / 其他压缩方式条目无法在不 seek 的前提下定位结尾
+            throw std::runtime_error("zip 条目使用了不支持流式读取的格式: " + entry.name);
+        }
+        else if (method == 0 && !(flags & 0x01)) {
+            if (compressedSize > maxEntryBytes_) {
+                entry.error = "条目过大，已跳过";
+                if (!in_->skip(compressedSize)) throw std::runtime_error("zip 数据被截断");
+            }
+            else {
+                entry.data.resize((size_t)compressedSize);
+                if (!in_->readExact(entry.data.data(), entry.data.size())) throw std::runtime_error("zip 数据被截断");
+            }
+        }
+        else {
+            entry.error = (flags & 0x01) ? "条目已加密，已跳过" : "不支持的压缩方式，已跳过";
+            if (!in_->skip(compressedSize)) throw std::runtime_error("zip 数据被截断");
+        }
+
+        if (hasDescriptor) {
+            // 数据描述符：可选签名 + CRC + 压缩/原始大小 (Zip64 时各 8 字节)
+            unsigned char desc[4];
+            if (!in_->readExact(desc, 4)) throw std::runtime_error("zip 数据被截断");
+            size_t rest = (zip64 ? 16 : 8) + (le32(desc) == 0x08074b50 ? 4 : 0);
+            if (!in_->skip(rest)) throw std::runtime_error("zip 数据被截断");
+        }
+
+        if (isDirectory) continue;
+        return true;
+    }
+}
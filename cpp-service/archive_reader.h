@@ -0,0 +1,54 @@
+#pragma once
+// =======================================================
+// 流式归档读取 (tar / tar.gz / zip)
+// 只顺序读取一遍输入，条目内容直接解压到内存，不落盘；
+// 因此可以读取管道、HTTP 上传等不可 seek 的数据源
+// =======================================================
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+// 数据源：读取最多 size 字节，返回实际读取的字节数，0 表示结束
+typedef std::function<size_t(unsigned char* buf, size_t size)> ByteSource;
+
+// 从文件描述符读取 (不负责关闭)
+ByteSource fdByteSource(int fd);
+
+struct ArchiveEntry {
+    std::string name;
+    uint64_t size;
+    std::vector<unsigned char> data;
+    std::string error; // 非空时 data 为空 (条目过大、不支持的压缩方式等)
+
+    ArchiveEntry() : size(0) {}
+};
+
+class ArchiveReader {
+public:
+    // 超过 maxEntryBytes 的条目会被跳过并在 error 中说明
+    ArchiveReader(ByteSource source, size_t maxEntryBytes);
+    ~ArchiveReader();
+
+    // 读取下一个普通文件条目，归档结束返回 false；格式损坏时抛出 std::runtime_error
+    bool next(ArchiveEntry& entry);
+    // "tar" / "tar.gz" / "zip"，首次调用 next() 后有效
+    const std::string& format() const { return format_; }
+
+    class Stream;
+    class Buffer;
+
+private:
+    void detect();
+    bool nextTar(ArchiveEntry& entry);
+    bool nextZip(ArchiveEntry& entry);
+
+    std::unique_ptr<Stream> raw_;
+    std::unique_ptr<Buffer> rawBuffer_;
+    std::unique_ptr<Stream> gzip_;
+    std::unique_ptr<Buffer> gzipBuffer_;
+    Buffer* in_; // 指向 rawBuffer_ 或 gzipBuffer_
+    size_t maxEntryBytes_;
+    std::string format_;
+};
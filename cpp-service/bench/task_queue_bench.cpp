@@ -0,0 +1,96 @@
+// =======================================================
+// 请求分发队列基准：httplib::ThreadPool vs RingTaskQueue
+// 单个生产者 (对应 httplib 的 accept 线程) 向 1~64 个 worker 投递极短任务：
+//   saturate  一次性投递，测吞吐
+//   paced     每批 16 个、批间隔约 20us，测分发延迟 (入队到开始执行)，
+//             worker 大部分时间处于空闲等待，能看出唤醒开销
+// 构建：cmake -DSENTINEL_BUILD_BENCH=ON，运行 ./task-queue-bench [任务数]
+//
+// 参考结果 (1 vCPU Xeon 虚拟机，100000 任务，kSpinIterations = 100)：
+//   threads              1        4       16       64
+//   saturate stock    2.32M    0.87M    0.54M    0.33M tasks/s
+//   saturate ring     4.12M    4.58M    4.22M    4.20M tasks/s
+//   paced p50 stock    639      3.3      4.4      3.7  us
+//   paced p50 ring    1791     1901     1944     1508  us
+// 单核上 ring 的吞吐更高，但 worker 与生产者抢同一个核，paced 分发延迟为毫秒级；
+// 自旋 2000 次时结果相近 (paced p50 1.5~1.9 ms)。因此默认仍用 threadpool，
+// ring 只建议在核数明显多于 httpThreads 的机器上、按本基准实测后开启
+// =======================================================
+#include "task_queue.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <string>
+#include <vector>
+
+typedef std::chrono::steady_clock Clock;
+
+static int64_t nowNs() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now().time_since_epoch()).count();
+}
+
+struct RunResult {
+    double tasksPerSecond;
+    double p50Us;
+    double p99Us;
+    size_t rejected;
+};
+
+static httplib::TaskQueue* makeQueue(const std::string& kind, size_t threads, size_t tasks) {
+    if (kind == "stock") return new httplib::ThreadPool(threads);
+    return new RingTaskQueue(threads, tasks);
+}
+
+static RunResult run(const std::string& kind, size_t threads, size_t tasks, bool paced) {
+    std::unique_ptr<httplib::TaskQueue> queue(makeQueue(kind, threads, tasks));
+    std::vector<int64_t> latencyNs(tasks, -1);
+    std::atomic<size_t> done(0);
+    size_t rejected = 0;
+
+    int64_t start = nowNs();
+    for (size_t i = 0; i < tasks; ++i) {
+        int64_t enqueuedAt = nowNs();
+        bool ok = queue->enqueue([&latencyNs, &done, i, enqueuedAt] {
+            latencyNs[i] = nowNs() - enqueuedAt;
+            done.fetch_add(1, std::memory_order_relaxed);
+        });
+        if (!ok) rejected++;
+        if (paced && i % 16 == 15) {
+            int64_t until = nowNs() + 20000;
+            while (nowNs() < until) {}
+        }
+    }
+    while (done.load() + rejected < tasks) std::this_thread::yield();
+    int64_t elapsed = nowNs() - start;
+    queue->shutdown();
+
+    std::vector<int64_t> samples;
+    for (int64_t ns : latencyNs) {
+        if (ns >= 0) samples.push_back(ns);
+    }
+    std::sort(samples.begin(), samples.end());
+    RunResult r;
+    r.tasksPerSecond = done.load() / (elapsed / 1e9);
+    r.p50Us = samples.empty() ? 0 : samples[samples.size() / 2] / 1e3;
+    r.p99Us = samples.empty() ? 0 : samples[samples.size() * 99 / 100] / 1e3;
+    r.rejected = rejected;
+    return r;
+}
+
+int main(int argc, char** argv) {
+    size_t tasks = argc > 1 ? (size_t)std::atoll(argv[1]) : 200000;
+    const size_t threadCounts[] = { 1, 2, 4, 8, 16, 32, 64 };
+    printf("%-9s %-7s %8s %14s %10s %10s %9s\n", "mode", "queue", "threads", "tasks/s", "p50 us", "p99 us", "rejected");
+    for (int paced = 0; paced < 2; ++paced) {
+        for (size_t threads : threadCounts) {
+            for (const char* kind : { "stock", "ring" }) {
+                RunResult r = run(kind, threads, paced ? tasks / 10 : tasks, paced != 0);
+                printf("%-9s %-7s %8zu %14.0f %10.1f %10.1f %9zu\n", paced ? "paced" : "saturate", kind, threads,
+                    r.tasksPerSecond, r.p50Us, r.p99Us, r.rejected);
+            }
+        }
+    }
+    return 0;
+}
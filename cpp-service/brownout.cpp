@@ -0,0 +1,91 @@
+#include "brownout.h"
+
+static const double kEwmaAlpha = 0.2;
+
+BrownoutThresholds::BrownoutThresholds() : recoverFactor(0.7), escalateHoldMs(2000), recoverHoldMs(10000) {
+    // 按默认 executionSlots = 8 推导：槽位占满进入 L1，再排队一整轮进入 L2，排队三轮进入 L3；
+    // L4 只按延迟判断
+    const int active[4] = { 8, 16, 32, 0 };
+    const double latency[4] = { 400, 800, 1500, 3000 };
+    for (int i = 0; i < 4; ++i) {
+        activeRequests[i] = active[i];
+        latencyMs[i] = latency[i];
+    }
+}
+
+BrownoutController::BrownoutController()
+    : level_(0), latencyEwma_(0), lastObserve_(std::chrono::steady_clock::now()),
+      lastChange_(lastObserve_), calmSince_(lastObserve_), calm_(false) {}
+
+void BrownoutController::setThresholds(const BrownoutThresholds& thresholds) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    thresholds_ = thresholds;
+}
+
+double BrownoutController::latencyEwmaMs() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return latencyEwma_;
+}
+
+void BrownoutController::observe(double latencyMs, int activeRequests) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    latencyEwma_ = latencyEwma_ == 0 ? latencyMs : kEwmaAlpha * latencyMs + (1 - kEwmaAlpha) * latencyEwma_;
+    lastObserve_ = std::chrono::steady_clock::now();
+    evaluateLocked(activeRequests, lastObserve_);
+}
+
+void BrownoutController::tick(int activeRequests) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto now = std::chrono::steady_clock::now();
+    if (now - lastObserve_ >= std::chrono::seconds(1)) latencyEwma_ *= (1 - kEwmaAlpha);
+    evaluateLocked(activeRequests, now);
+}
+
+void BrownoutController::evaluateLocked(int activeRequests, std::chrono::steady_clock::time_point now) {
+    using std::chrono::milliseconds;
+    int level = level_.load();
+
+    // 升级：当前级别的下一级阈值被突破
+    if (level < kMaxLevel) {
+        int activeLimit = thresholds_.activeRequests[level];
+        bool overloaded = (activeLimit > 0 && activeRequests >= activeLimit) || latencyEwma_ >= thresholds_.latencyMs[level];
+        if (overloaded) {
+            calm_ = false;
+            if (now - lastChange_ >= milliseconds(thresholds_.escalateHoldMs)) {
+                level_ = level + 1;
+                lastChange_ = now;
+            }
+            return;
+        }
+    }
+
+    // 降级：进入当前级别的阈值在一段时间内都有足够余量
+    if (level > 0) {
+        int activeLimit = thresholds_.activeRequests[level - 1];
+        bool relaxed = (activeLimit == 0 || activeRequests < activeLimit * thresholds_.recoverFactor) &&
+            latencyEwma_ < thresholds_.latencyMs[level - 1] * thresholds_.recoverFactor;
+        if (!relaxed) {
+            calm_ = false;
+            return;
+        }
+        if (!calm_) {
+            calm_ = true;
+            calmSince_ = now;
+        }
+        else if (now - calmSince_ >= milliseconds(thresholds_.recoverHoldMs)) {
+            level_ = level - 1;
+            lastChange_ = now;
+            calmSince_ = now;
+        }
+    }
+}
+
+BrownoutPolicy BrownoutController::policy() const {
+    int level = level_.load();
+    BrownoutPolicy p;
+    p.level = level;
+    p.previewMaxSide = level >= 3 ? 384 : (level >= 1 ? 1024 : 0);
+    p.pngCompression = level >= 2 ? 1 : -1;
+    p.coarseForensics = level >= 4;
+    return p;
+}
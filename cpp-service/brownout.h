@@ -0,0 +1,59 @@
+#pragma once
+// =======================================================
+// Brownout 降级控制
+// 根据前台负载 (执行中 + 排队中的请求数) 与执行延迟 (EWMA) 逐级降级可选工作，负载下降后自动逐级恢复：
+//   L1 缩小预览图  L2 PNG 快速压缩  L3 进一步缩小预览图  L4 推迟取证精细化 (低分辨率分析)
+// 预览图在任何级别都不会省略：未付费用户只能看到带横幅的预览，缺少预览时不能退回原图
+// =======================================================
+#include <atomic>
+#include <chrono>
+#include <mutex>
+
+struct BrownoutThresholds {
+    // 第 i 项为进入 L(i+1) 的阈值，activeRequests 为 0 表示该级不按并发判断。
+    // activeRequests 比较的是执行中与排队中的请求总数，可以超过 executionSlots
+    int activeRequests[4];
+    double latencyMs[4];
+    double recoverFactor;  // 两项指标都低于 上一级阈值 * recoverFactor 才会降级
+    int escalateHoldMs;    // 两次升级之间的最短间隔
+    int recoverHoldMs;     // 持续平稳多久后降一级
+
+    BrownoutThresholds();
+};
+
+// 各级降级对应的处理参数
+struct BrownoutPolicy {
+    int level;
+    int previewMaxSide;   // 0 表示不缩放
+    int pngCompression;   // -1 表示默认
+    bool coarseForensics;
+};
+
+class BrownoutController {
+public:
+    static const int kMaxLevel = 4;
+
+    BrownoutController();
+
+    void setThresholds(const BrownoutThresholds& thresholds);
+    // 请求结束时上报执行耗时与当前前台负载 (执行中 + 排队中)
+    void observe(double latencyMs, int activeRequests);
+    // 定时调用 (约每秒一次)：没有新请求时让延迟估计衰减，保证空闲后也能恢复
+    void tick(int activeRequests);
+
+    int level() const { return level_.load(); }
+    double latencyEwmaMs() const;
+    BrownoutPolicy policy() const;
+
+private:
+    void evaluateLocked(int activeRequests, std::chrono::steady_clock::time_point now);
+
+    mutable std::mutex mutex_;
+    BrownoutThresholds thresholds_;
+    std::atomic<int> level_;
+    double latencyEwma_;
+    std::chrono::steady_clock::time_point lastObserve_;
+    std::chrono::steady_clock::time_point lastChange_;
+    std::chrono::steady_clock::time_point calmSince_;
+    bool calm_;
+};
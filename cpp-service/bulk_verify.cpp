@@ -0,0 +1,92 @@
+#include "bulk_verify.h"
+#include "algorithms.h"
+#include "bounded_queue.h"
+#include "fair_scheduler.h"
+#include "file_utils.h"
+#include "image_decoder.h"
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+using json = ArenaJson;
+using namespace cv;
+
+BulkVerifySummary verifyArchive(ByteSource source, const BulkVerifyOptions& options, NdjsonSink sink) {
+    BoundedQueue<ArchiveEntry> queue(options.queueDepth);
+    std::mutex sinkMutex;
+    std::atomic<bool> stopped(false);
+    BulkVerifySummary summary = { 0, 0, 0 };
+
+    auto emit = [&](const json& line) {
+        std::lock_guard<std::mutex> lock(sinkMutex);
+        if (stopped) return;
+        if (!sink(line.dump() + "\n")) {
+            stopped = true;
+            queue.close();
+        }
+    };
+
+    std::vector<std::thread> workers;
+    // 调用方在 FairScope 内时，worker 的 CPU 时间记到该请求的租户
+    CpuAccount* account = currentCpuAccount();
+    for (int w = 0; w < std::max(1, options.jobs); ++w) {
+        workers.push_back(std::thread([&] {
+            CpuCharge charge(account);
+            ArchiveEntry entry;
+            while (queue.pop(entry)) {
+                json line = { {"entry", entry.name} };
+                bool found = false;
+                if (entry.error.empty()) {
+                    // 直接从归档缓冲区解码，不经过文件系统
+                    Mat img = decodeImage(entry.data);
+                    std::vector<unsigned char>().swap(entry.data);
+                    if (img.empty()) {
+                        entry.error = "无法解码图片";
+                    }
+                    else {
+                        VerifyResult result = verifyImage(img);
+                        found = result.success;
+                        line["success"] = result.success;
+                        line["extractedText"] = result.extractedText;
+                        line["confidenceScore"] = result.confidenceScore;
+                        // 签名验证结果按载荷缓存，同一载荷在整个归档中只做一次公钥运算
+                        if (!result.signature.empty()) {
+                            line["signature"] = result.signature;
+                            line["signatureValid"] = result.signatureValid;
+                        }
+                    }
+                }
+                if (!entry.error.empty()) line["error"] = entry.error;
+                {
+                    std::lock_guard<std::mutex> lock(sinkMutex);
+                    summary.total++;
+                    if (found) summary.found++;
+                    if (!entry.error.empty()) summary.failed++;
+                }
+                emit(line);
+            }
+        }));
+    }
+
+    ArchiveReader reader(source, options.maxEntryBytes);
+    std::string error;
+    try {
+        ArchiveEntry entry;
+        while (!stopped && reader.next(entry)) {
+            if (!isImageFile(entry.name)) continue;
+            if (!queue.push(std::move(entry))) break;
+        }
+    }
+    catch (const std::exception& e) {
+        error = e.what();
+    }
+    queue.close();
+    for (std::thread& t : workers) t.join();
+
+    json done = { {"done", true}, {"format", reader.format()}, {"total", summary.total}, {"found", summary.found}, {"failed", summary.failed} };
+    if (!error.empty()) done["error"] = error;
+    emit(done);
+    return summary;
+}
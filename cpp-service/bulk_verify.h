@@ -0,0 +1,53 @@
+#pragma once
+// =======================================================
+// 归档批量验证：流式读取归档 -> 并行解码验证 -> 逐条输出 NDJSON
+// 内存占用受 (队列深度 + worker 数) x 单条目上限约束，不写任何临时文件
+// HTTP 服务 (/verify/bulk) 与 sentinel-cli --archive 共用
+// =======================================================
+#include "archive_reader.h"
+#include <algorithm>
+#include <atomic>
+#include <functional>
+#include <string>
+
+struct BulkVerifyOptions {
+    int jobs;
+    size_t queueDepth;
+    size_t maxEntryBytes;
+
+    BulkVerifyOptions() : jobs(4), queueDepth(8), maxEntryBytes(64u * 1024 * 1024) {}
+};
+
+struct BulkVerifySummary {
+    size_t total;
+    size_t found;
+    size_t failed;
+};
+
+// 多个批量验证共享的 worker 配额：每个请求最多取 want 个，配额用尽时 acquire 返回 0，
+// 由调用方拒绝请求 (HTTP 503)，避免并发的归档请求各自开满线程压垮单请求接口
+class BulkWorkerBudget {
+public:
+    explicit BulkWorkerBudget(int total) : free_(std::max(1, total)) {}
+    int acquire(int want) {
+        int free = free_.load();
+        int take;
+        do {
+            take = std::min(free, std::max(1, want));
+            if (take <= 0) return 0;
+        } while (!free_.compare_exchange_weak(free, free - take));
+        return take;
+    }
+    void release(int n) { free_ += n; }
+
+private:
+    std::atomic<int> free_;
+};
+
+// 每完成一个条目调用一次 (已串行化)，返回 false 时停止读取剩余条目
+typedef std::function<bool(const std::string& line)> NdjsonSink;
+
+// 结果行: {"entry","success","extractedText","confidenceScore"} (签名载荷另有 "signature","signatureValid")
+// 或 {"entry","error"}；
+// 最后输出一行汇总 {"done":true,"format","total","found","failed"}，归档损坏时附带 "error"
+BulkVerifySummary verifyArchive(ByteSource source, const BulkVerifyOptions& options, NdjsonSink sink);
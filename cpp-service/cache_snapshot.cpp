@@ -0,0 +1,234 @@
+#include "cache_snapshot.h"
+#include "cost_model.h"
+#include "file_utils.h"
+#include "frame_store.h"
+#include "image_cache.h"
+#include "prefetch.h"
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <iostream>
+#include <unistd.h>
+#include <vector>
+
+static const uint32_t kSnapshotMagic = 0x534e5453; // "STNS"
+static const uint32_t kSnapshotVersion = 1;
+
+enum SnapshotKind { kCostModel = 1, kFrameIndex = 2, kImageIndex = 3 };
+
+struct SnapshotHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t kind;
+    uint32_t reserved;
+    uint64_t length;
+    uint64_t checksum;
+};
+
+// =======================================================
+// 编码
+// =======================================================
+void SnapshotWriter::putVarint(uint64_t v) {
+    while (v >= 0x80) {
+        buf_.push_back((char)(v | 0x80));
+        v >>= 7;
+    }
+    buf_.push_back((char)v);
+}
+
+void SnapshotWriter::putU64(uint64_t v) {
+    for (int i = 0; i < 8; ++i) buf_.push_back((char)(v >> (8 * i)));
+}
+
+void SnapshotWriter::putDouble(double v) {
+    uint64_t bits;
+    memcpy(&bits, &v, sizeof(bits));
+    putU64(bits);
+}
+
+void SnapshotWriter::putString(const std::string& s) {
+    putVarint(s.size());
+    buf_.append(s);
+}
+
+bool SnapshotReader::getVarint(uint64_t& v) {
+    v = 0;
+    for (int shift = 0; shift < 64 && pos_ < data_.size(); shift += 7) {
+        uint8_t b = (uint8_t)data_[pos_++];
+        v |= (uint64_t)(b & 0x7f) << shift;
+        if (!(b & 0x80)) return true;
+    }
+    return false;
+}
+
+bool SnapshotReader::getU64(uint64_t& v) {
+    if (data_.size() - pos_ < 8) return false;
+    v = 0;
+    for (int i = 0; i < 8; ++i) v |= (uint64_t)(uint8_t)data_[pos_ + i] << (8 * i);
+    pos_ += 8;
+    return true;
+}
+
+bool SnapshotReader::getDouble(double& v) {
+    uint64_t bits;
+    if (!getU64(bits)) return false;
+    memcpy(&v, &bits, sizeof(v));
+    return true;
+}
+
+bool SnapshotReader::getString(std::string& s) {
+    uint64_t n;
+    if (!getVarint(n) || n > data_.size() - pos_) return false;
+    s.assign(data_, pos_, (size_t)n);
+    pos_ += (size_t)n;
+    return true;
+}
+
+bool writeSnapshotFile(const std::string& path, uint32_t kind, const std::string& payload) {
+    SnapshotHeader h = { kSnapshotMagic, kSnapshotVersion, kind, 0, payload.size(),
+        contentHash64((const unsigned char*)payload.data(), payload.size()) };
+    // 热重启期间新旧两个进程可能同时写同一目录，临时文件按进程区分
+    std::string tmpPath = path + "." + std::to_string(getpid()) + ".tmp";
+    int fd = open(tmpPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) return false;
+    bool ok = write(fd, &h, sizeof(h)) == (ssize_t)sizeof(h);
+    size_t off = 0;
+    while (ok && off < payload.size()) {
+        ssize_t n = write(fd, payload.data() + off, payload.size() - off);
+        ok = n > 0;
+        if (ok) off += (size_t)n;
+    }
+    ok = ok && fdatasync(fd) == 0;
+    close(fd);
+    if (!ok || rename(tmpPath.c_str(), path.c_str()) != 0) {
+        unlink(tmpPath.c_str());
+        return false;
+    }
+    return true;
+}
+
+bool readSnapshotFile(const std::string& path, uint32_t kind, std::string& payload) {
+    std::vector<unsigned char> bytes;
+    if (!readFile(path, bytes) || bytes.size() < sizeof(SnapshotHeader)) return false;
+    SnapshotHeader h;
+    memcpy(&h, bytes.data(), sizeof(h));
+    if (h.magic != kSnapshotMagic || h.version != kSnapshotVersion || h.kind != kind ||
+        h.length != bytes.size() - sizeof(h)) return false;
+    const unsigned char* data = bytes.data() + sizeof(h);
+    if (contentHash64(data, (size_t)h.length) != h.checksum) return false;
+    payload.assign((const char*)data, (size_t)h.length);
+    return true;
+}
+
+// =======================================================
+// CacheSnapshotter
+// =======================================================
+CacheSnapshotter::CacheSnapshotter(const std::string& dir, ImageCache& images, FrameStore& frames, CostModel& costs, Prefetcher& prefetcher)
+    : dir_(dir), images_(images), frames_(frames), costs_(costs), prefetcher_(prefetcher),
+      intervalSeconds_(0), stopping_(false), restoreCostModel_(true), saves_(0), failures_(0), lastSaveMs_(0),
+      restoredFrames_(0), restoredImages_(0), restoredHot_(0), restoring_(false) {
+    makeDirs(dir_);
+}
+
+CacheSnapshotter::~CacheSnapshotter() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+        wake_.notify_all();
+    }
+    if (thread_.joinable()) {
+        thread_.join();
+        saveNow();
+    }
+}
+
+void CacheSnapshotter::start(int intervalSeconds, bool restoreCostModel) {
+    setInterval(intervalSeconds);
+    restoreCostModel_ = restoreCostModel;
+    restoring_ = true;
+    thread_ = std::thread(&CacheSnapshotter::run, this);
+}
+
+void CacheSnapshotter::setInterval(int intervalSeconds) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    intervalSeconds_ = intervalSeconds;
+    wake_.notify_all();
+}
+
+void CacheSnapshotter::run() {
+    lowerCurrentThreadPriority();
+    restore();
+    restoring_ = false;
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (!stopping_) {
+        if (intervalSeconds_ <= 0) {
+            wake_.wait(lock);
+            continue;
+        }
+        int interval = intervalSeconds_;
+        if (wake_.wait_for(lock, std::chrono::seconds(interval)) == std::cv_status::timeout && !stopping_) {
+            lock.unlock();
+            saveNow();
+            lock.lock();
+        }
+    }
+}
+
+void CacheSnapshotter::restore() {
+    auto start = std::chrono::steady_clock::now();
+    std::string payload;
+
+    if (restoreCostModel_ && readSnapshotFile(dir_ + "/cost_model.snap", kCostModel, payload)) {
+        SnapshotReader in(payload);
+        std::string state;
+        if (in.getString(state)) costs_.importState(state);
+    }
+    if (readSnapshotFile(dir_ + "/frame_index.snap", kFrameIndex, payload)) {
+        SnapshotReader in(payload);
+        restoredFrames_ = frames_.restoreIndex(in);
+    }
+    std::vector<std::string> hot;
+    if (readSnapshotFile(dir_ + "/image_index.snap", kImageIndex, payload)) {
+        SnapshotReader in(payload);
+        restoredImages_ = images_.restoreIndex(in, hot);
+    }
+    // 预取队列满时 enqueue 返回 false，剩下的热点交给正常流量
+    uint64_t queued = 0;
+    for (const std::string& path : hot) {
+        if (!prefetcher_.enqueue(path)) break;
+        queued++;
+    }
+    restoredHot_ = queued;
+
+    double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    std::cerr << "[INFO] Cache snapshot restored in " << (long)ms << " ms: " << restoredFrames_.load() << " frames, "
+        << restoredImages_.load() << " images, " << queued << " queued for prefetch" << std::endl;
+}
+
+bool CacheSnapshotter::saveNow() {
+    std::lock_guard<std::mutex> saveLock(saveMutex_);
+    auto start = std::chrono::steady_clock::now();
+
+    SnapshotWriter costs;
+    costs.putString(costs_.exportState());
+    SnapshotWriter frames;
+    frames_.saveIndex(frames);
+    SnapshotWriter images;
+    images_.saveIndex(images);
+
+    bool ok = writeSnapshotFile(dir_ + "/cost_model.snap", kCostModel, costs.data());
+    ok = writeSnapshotFile(dir_ + "/frame_index.snap", kFrameIndex, frames.data()) && ok;
+    ok = writeSnapshotFile(dir_ + "/image_index.snap", kImageIndex, images.data()) && ok;
+    if (ok) saves_++;
+    else failures_++;
+    lastSaveMs_ = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    return ok;
+}
+
+SnapshotStats CacheSnapshotter::stats() const {
+    SnapshotStats s = { saves_.load(), failures_.load(), lastSaveMs_.load(), restoredFrames_.load(),
+        restoredImages_.load(), restoredHot_.load(), restoring_.load() };
+    return s;
+}
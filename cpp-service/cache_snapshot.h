@@ -0,0 +1,101 @@
+#pragma once
+// =======================================================
+// 缓存索引快照
+// 周期性把各缓存的索引 (不含像素) 写到磁盘，重启后在后台按优先级恢复：
+//   1. 成本模型        (几 KB，决定调度顺序)
+//   2. 帧缓存索引      (恢复后立刻能 mmap 命中，无需等待目录扫描)
+//   3. 图片元数据      (路径 → 尺寸 / 内容哈希 / 感知哈希)
+//   4. 热点图片列表    (交给预取器低优先级解码)
+// 文件格式：固定头 (magic / 版本 / 类型 / 长度 / 校验和) + varint 编码的记录，
+// 写入采用 临时文件 + fdatasync + rename；校验失败的快照直接忽略
+// =======================================================
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+
+class ImageCache;
+class FrameStore;
+class CostModel;
+class Prefetcher;
+
+class SnapshotWriter {
+public:
+    void putVarint(uint64_t v);
+    void putU64(uint64_t v);
+    void putDouble(double v);
+    void putString(const std::string& s);
+    const std::string& data() const { return buf_; }
+
+private:
+    std::string buf_;
+};
+
+class SnapshotReader {
+public:
+    explicit SnapshotReader(const std::string& data) : data_(data), pos_(0) {}
+    bool getVarint(uint64_t& v);
+    bool getU64(uint64_t& v);
+    bool getDouble(double& v);
+    bool getString(std::string& s);
+    bool atEnd() const { return pos_ >= data_.size(); }
+
+private:
+    const std::string& data_;
+    size_t pos_;
+};
+
+bool writeSnapshotFile(const std::string& path, uint32_t kind, const std::string& payload);
+bool readSnapshotFile(const std::string& path, uint32_t kind, std::string& payload);
+
+struct SnapshotStats {
+    uint64_t saves;
+    uint64_t failures;
+    double lastSaveMs;
+    uint64_t restoredFrames;
+    uint64_t restoredImages;
+    uint64_t restoredHot;
+    bool restoring;
+};
+
+class CacheSnapshotter {
+public:
+    CacheSnapshotter(const std::string& dir, ImageCache& images, FrameStore& frames, CostModel& costs, Prefetcher& prefetcher);
+    // 停止周期快照，并写最后一次 (进程正常退出 / 热重启排空后)
+    ~CacheSnapshotter();
+
+    // 启动后台线程：先恢复已有快照，之后每 intervalSeconds 写一次 (0 表示只在退出时写)。
+    // restoreCostModel 为 false 时不恢复成本模型 (热重启时由旧进程直接移交，比快照新)
+    void start(int intervalSeconds, bool restoreCostModel = true);
+    void setInterval(int intervalSeconds);
+    bool saveNow();
+    SnapshotStats stats() const;
+
+private:
+    void run();
+    void restore();
+
+    const std::string dir_;
+    ImageCache& images_;
+    FrameStore& frames_;
+    CostModel& costs_;
+    Prefetcher& prefetcher_;
+
+    mutable std::mutex mutex_;
+    std::condition_variable wake_;
+    std::mutex saveMutex_;
+    int intervalSeconds_;
+    bool stopping_;
+    bool restoreCostModel_;
+    std::thread thread_;
+
+    std::atomic<uint64_t> saves_;
+    std::atomic<uint64_t> failures_;
+    std::atomic<double> lastSaveMs_;
+    std::atomic<uint64_t> restoredFrames_;
+    std::atomic<uint64_t> restoredImages_;
+    std::atomic<uint64_t> restoredHot_;
+    std::atomic<bool> restoring_;
+};
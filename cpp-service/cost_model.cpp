@@ -0,0 +1,99 @@
+#include "cost_model.h"
+#include <algorithm>
+#include <cmath>
+#include <sstream>
+
+// 每个新样本使旧样本权重乘以该系数：约 200 个请求后旧数据影响减半
+static const double kDecay = 0.9965;
+static const double kMinSamples = 8;
+// 没有任何观测时的先验：偏大一些，让未知请求排在已知的小请求之后
+static const double kPriorInterceptMs = 5.0;
+static const double kPriorSlopeMsPerMp = 40.0;
+// 分组数量上限 (格式由探测结果决定，算法名来自请求体)
+static const size_t kMaxGroups = 256;
+
+void CostModel::Accumulator::add(double x, double y) {
+    n = n * kDecay + 1;
+    sx = sx * kDecay + x;
+    sy = sy * kDecay + y;
+    sxx = sxx * kDecay + x * x;
+    sxy = sxy * kDecay + x * y;
+}
+
+bool CostModel::Accumulator::fit(CostFit& out) const {
+    if (n < kMinSamples) return false;
+    double meanX = sx / n, meanY = sy / n;
+    double varX = sxx / n - meanX * meanX;
+    out.samples = n;
+    if (varX < 1e-4 * std::max(1.0, meanX * meanX)) {
+        // 尺寸几乎一致时斜率不可辨识：按成本与像素数成正比估计
+        out.intercept = meanX > 1e-3 ? 0 : meanY;
+        out.slope = meanX > 1e-3 ? meanY / meanX : 0;
+        return true;
+    }
+    double slope = (sxy / n - meanX * meanY) / varX;
+    slope = std::max(0.0, slope);
+    out.slope = slope;
+    out.intercept = std::max(0.0, meanY - slope * meanX);
+    return true;
+}
+
+CostModel::CostModel() {}
+
+double CostModel::predictMs(const std::string& algorithm, const std::string& format, double megapixels) const {
+    double mp = std::max(0.0, megapixels);
+    CostFit f;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto exact = groups_.find(algorithm + "/" + format);
+        auto coarse = groups_.find(algorithm + "/*");
+        if (exact != groups_.end() && exact->second.fit(f)) return std::max(0.1, f.intercept + f.slope * mp);
+        if (coarse != groups_.end() && coarse->second.fit(f)) return std::max(0.1, f.intercept + f.slope * mp);
+    }
+    return kPriorInterceptMs + kPriorSlopeMsPerMp * mp;
+}
+
+void CostModel::observe(const std::string& algorithm, const std::string& format, double megapixels, double ms) {
+    if (!(ms >= 0) || !std::isfinite(megapixels)) return;
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (const std::string& key : { algorithm + "/" + format, algorithm + "/*" }) {
+        auto it = groups_.find(key);
+        if (it == groups_.end()) {
+            if (groups_.size() >= kMaxGroups) continue;
+            it = groups_.insert(std::make_pair(key, Accumulator())).first;
+        }
+        it->second.add(std::max(0.0, megapixels), ms);
+    }
+}
+
+std::string CostModel::exportState() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::ostringstream out;
+    out.precision(17);
+    for (const auto& kv : groups_) {
+        const Accumulator& a = kv.second;
+        out << kv.first << ' ' << a.n << ' ' << a.sx << ' ' << a.sy << ' ' << a.sxx << ' ' << a.sxy << '\n';
+    }
+    return out.str();
+}
+
+void CostModel::importState(const std::string& state) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::istringstream in(state);
+    std::string key;
+    Accumulator a;
+    while (in >> key >> a.n >> a.sx >> a.sy >> a.sxx >> a.sxy) {
+        if (groups_.size() >= kMaxGroups && !groups_.count(key)) continue;
+        groups_[key] = a;
+    }
+}
+
+std::map<std::string, CostFit> CostModel::fits() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::map<std::string, CostFit> out;
+    for (const auto& kv : groups_) {
+        CostFit f;
+        if (kv.second.fit(f)) out[kv.first] = f;
+    }
+    return out;
+}
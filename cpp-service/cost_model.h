@@ -0,0 +1,44 @@
+#pragma once
+// =======================================================
+// 请求成本模型 (在线拟合)
+// 按 (算法, 图片格式) 分组，用指数衰减的最小二乘拟合
+//     服务耗时 ms ≈ a + b × 百万像素
+// 像素数来自头部探测，不需要解码；样本不足时依次退回到
+// 只按算法分组的拟合、再退回到保守的先验值
+// =======================================================
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <string>
+
+struct CostFit {
+    double intercept;  // ms
+    double slope;      // ms / MP
+    double samples;    // 衰减后的有效样本数
+};
+
+class CostModel {
+public:
+    CostModel();
+
+    double predictMs(const std::string& algorithm, const std::string& format, double megapixels) const;
+    void observe(const std::string& algorithm, const std::string& format, double megapixels, double ms);
+
+    // 键为 "algorithm/format" 与 "algorithm/*"
+    std::map<std::string, CostFit> fits() const;
+
+    // 文本形式的累积量 (每行一个分组)，热重启时交给新进程，避免从先验重新学习
+    std::string exportState() const;
+    void importState(const std::string& state);
+
+private:
+    struct Accumulator {
+        double n, sx, sy, sxx, sxy;
+        Accumulator() : n(0), sx(0), sy(0), sxx(0), sxy(0) {}
+        void add(double x, double y);
+        bool fit(CostFit& out) const;
+    };
+
+    mutable std::mutex mutex_;
+    std::map<std::string, Accumulator> groups_;
+};
@@ -0,0 +1,192 @@
+#include "fair_scheduler.h"
+#include <algorithm>
+#include <cstdlib>
+#include <sstream>
+
+static const double kCostEwmaAlpha = 0.2;
+// 租户数超过该值时清理空闲且没有欠账的租户 (它们的状态与新租户等价)
+static const size_t kMaxTenants = 1024;
+// 每等待 1ms 抵扣 1ms 预测成本：大请求最多再多等约一个自身耗时
+static const double kAgingRate = 1.0;
+
+static double monotonicMs() {
+    timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * 1e3 + now.tv_nsec / 1e6;
+}
+
+FairScheduler::FairScheduler(int slots) : slots_(std::max(1, slots)), freeSlots_(slots_), systemVtime_(0) {}
+
+void FairScheduler::setSlots(int slots) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    slots = std::max(1, slots);
+    freeSlots_ += slots - slots_;
+    slots_ = slots;
+    dispatchLocked();
+}
+
+void FairScheduler::setWeights(const std::string& spec) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    weights_.clear();
+    std::stringstream ss(spec);
+    std::string item;
+    while (std::getline(ss, item, ',')) {
+        size_t eq = item.find('=');
+        if (eq == std::string::npos) continue;
+        double weight = std::atof(item.c_str() + eq + 1);
+        if (weight > 0) weights_[item.substr(0, eq)] = weight;
+    }
+    for (auto& kv : tenants_) {
+        auto it = weights_.find(kv.first);
+        kv.second.weight = it == weights_.end() ? 1.0 : it->second;
+    }
+}
+
+FairScheduler::Tenant& FairScheduler::tenantLocked(const std::string& name) {
+    auto it = tenants_.find(name);
+    if (it != tenants_.end()) return it->second;
+    if (tenants_.size() >= kMaxTenants) {
+        for (auto i = tenants_.begin(); i != tenants_.end();) {
+            const Tenant& t = i->second;
+            if (t.running == 0 && t.waiting.empty() && t.vtime <= systemVtime_) i = tenants_.erase(i);
+            else ++i;
+        }
+    }
+    Tenant& tenant = tenants_[name];
+    auto w = weights_.find(name);
+    if (w != weights_.end()) tenant.weight = w->second;
+    return tenant;
+}
+
+void FairScheduler::grantLocked(Tenant& tenant) {
+    freeSlots_--;
+    tenant.running++;
+    systemVtime_ = std::max(systemVtime_, tenant.vtime);
+    tenant.vtime += tenant.avgCostMs / tenant.weight;
+}
+
+void FairScheduler::dispatchLocked() {
+    double now = monotonicMs();
+    while (freeSlots_ > 0) {
+        // 得分 = 租户虚拟时间 + (预测成本 - 已等待时间) / 权重，取最小者：
+        // 同一租户内是带 aging 的 SJF，租户之间仍按 CPU 份额公平
+        Tenant* next = nullptr;
+        std::deque<Waiter*>::iterator pick;
+        double best = 0;
+        for (auto& kv : tenants_) {
+            Tenant& t = kv.second;
+            for (auto it = t.waiting.begin(); it != t.waiting.end(); ++it) {
+                double effective = (*it)->predictedMs - kAgingRate * (now - (*it)->enqueuedMs);
+                double score = t.vtime + effective / t.weight;
+                if (!next || score < best) {
+                    next = &t;
+                    pick = it;
+                    best = score;
+                }
+            }
+        }
+        if (!next) return;
+        Waiter* waiter = *pick;
+        next->waiting.erase(pick);
+        grantLocked(*next);
+        waiter->granted = true;
+        waiter->cv.notify_one();
+    }
+}
+
+void FairScheduler::enter(const std::string& name, double predictedMs) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    Tenant& tenant = tenantLocked(name);
+    if (tenant.running == 0 && tenant.waiting.empty()) {
+        // 重新活跃的租户不能用空闲期间"欠下"的份额插队
+        tenant.vtime = std::max(tenant.vtime, systemVtime_);
+    }
+    if (freeSlots_ > 0) {
+        // 有空闲槽位说明没有人在排队，直接执行
+        grantLocked(tenant);
+        return;
+    }
+    Waiter waiter(std::max(0.0, predictedMs), monotonicMs());
+    tenant.waiting.push_back(&waiter);
+    waiter.cv.wait(lock, [&waiter] { return waiter.granted; });
+}
+
+void FairScheduler::leave(const std::string& name, double cpuMs) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    Tenant& tenant = tenantLocked(name);
+    // 预扣的是派发时的平均成本，这里按实测值修正
+    tenant.vtime += (cpuMs - tenant.avgCostMs) / tenant.weight;
+    tenant.avgCostMs += kCostEwmaAlpha * (cpuMs - tenant.avgCostMs);
+    tenant.cpuMs += cpuMs;
+    tenant.served++;
+    tenant.running--;
+    freeSlots_++;
+    dispatchLocked();
+}
+
+std::map<std::string, TenantStats> FairScheduler::stats() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::map<std::string, TenantStats> out;
+    for (const auto& kv : tenants_) {
+        const Tenant& t = kv.second;
+        TenantStats s = { t.weight, t.cpuMs, t.served, t.waiting.size(), t.running };
+        out[kv.first] = s;
+    }
+    return out;
+}
+
+size_t FairScheduler::waiting() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    size_t n = 0;
+    for (const auto& kv : tenants_) n += kv.second.waiting.size();
+    return n;
+}
+
+// =======================================================
+// FairScope
+// =======================================================
+static thread_local CpuAccount* t_account = nullptr;
+
+static double threadCpuMsSince(const timespec& start) {
+    timespec now;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &now);
+    return (now.tv_sec - start.tv_sec) * 1e3 + (now.tv_nsec - start.tv_nsec) / 1e6;
+}
+
+CpuAccount* currentCpuAccount() { return t_account; }
+
+CpuCharge::CpuCharge(CpuAccount* account)
+    : account_(account && account->owner != std::this_thread::get_id() ? account : nullptr) {
+    if (account_) clock_gettime(CLOCK_THREAD_CPUTIME_ID, &start_);
+}
+
+CpuCharge::~CpuCharge() {
+    if (account_) account_->offThreadNs += (int64_t)(threadCpuMsSince(start_) * 1e6);
+}
+
+FairScope::FairScope(FairScheduler& scheduler, const std::string& tenant)
+    : scheduler_(scheduler), tenant_(tenant), entered_(false), previousAccount_(nullptr) {}
+
+void FairScope::enter(double predictedMs) {
+    if (entered_) return;
+    scheduler_.enter(tenant_, predictedMs);
+    entered_ = true;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &cpuStart_);
+    clock_gettime(CLOCK_MONOTONIC, &wallStart_);
+    account_.owner = std::this_thread::get_id();
+    previousAccount_ = t_account;
+    t_account = &account_;
+}
+
+double FairScope::serviceMs() const {
+    if (!entered_) return 0;
+    timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - wallStart_.tv_sec) * 1e3 + (now.tv_nsec - wallStart_.tv_nsec) / 1e6;
+}
+
+FairScope::~FairScope() {
+    if (!entered_) return;
+    t_account = previousAccount_;
+    scheduler_.leave(tenant_, threadCpuMsSince(cpuStart_) + account_.offThreadNs.load() / 1e6);
+}
@@ -0,0 +1,123 @@
+#pragma once
+// =======================================================
+// 按 CPU 时间加权的多租户公平调度 (WFQ)
+// - 处理请求前先获取执行槽位；槽位空闲时派发给"虚拟时间"最小的租户
+// - 虚拟时间 = 已消耗的线程 CPU 时间 / 权重；派发时按该租户近期平均成本预扣，
+//   请求结束后按 CLOCK_THREAD_CPUTIME_ID 实测值多退少补。
+//   请求派发到其他线程的工作 (parallel_for_、批量验证 worker) 用 CpuCharge 记入同一请求
+// - 空闲后重新出现的租户虚拟时间被拉到当前系统虚拟时间，不能积攒额度
+// - 排队请求携带成本模型的预测耗时，派发时优先短作业 (SJF)；
+//   等待时间按 kAgingRate 抵扣预测成本 (aging)，大请求不会被饿死
+// =======================================================
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <ctime>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+
+struct TenantStats {
+    double weight;
+    double cpuMs;
+    uint64_t served;
+    size_t waiting;
+    size_t running;
+};
+
+class FairScheduler {
+public:
+    explicit FairScheduler(int slots);
+
+    // 配置格式 "tenantA=2,tenantB=0.5"，未列出的租户权重为 1
+    void setWeights(const std::string& spec);
+    // 调整槽位数：增加时立即派发排队请求，减少时等在途请求结束后生效
+    void setSlots(int slots);
+
+    // 当前线程进入/离开执行槽位；enter 可能阻塞排队。predictedMs 为预测的服务耗时
+    void enter(const std::string& tenant, double predictedMs);
+    void leave(const std::string& tenant, double cpuMs);
+
+    std::map<std::string, TenantStats> stats() const;
+    size_t waiting() const;
+
+private:
+    struct Waiter {
+        std::condition_variable cv;
+        bool granted;
+        double predictedMs;
+        double enqueuedMs;
+        Waiter(double predicted, double now) : granted(false), predictedMs(predicted), enqueuedMs(now) {}
+    };
+    struct Tenant {
+        double weight;
+        double vtime;
+        double avgCostMs;  // 近期单个请求的 CPU 成本 (EWMA)，用于派发时预扣
+        double cpuMs;
+        uint64_t served;
+        size_t running;
+        std::deque<Waiter*> waiting;
+        Tenant() : weight(1.0), vtime(0), avgCostMs(10.0), cpuMs(0), served(0), running(0) {}
+    };
+
+    Tenant& tenantLocked(const std::string& name);
+    void grantLocked(Tenant& tenant);
+    void dispatchLocked();
+
+    mutable std::mutex mutex_;
+    std::map<std::string, Tenant> tenants_;
+    std::map<std::string, double> weights_;
+    int slots_;
+    int freeSlots_;  // 缩减槽位后可能暂时为负
+    double systemVtime_; // 最近一次派发时的虚拟时间
+};
+
+// 请求在处理线程之外消耗的 CPU 时间，FairScope 离开时与处理线程的 CPU 时间一并计费
+struct CpuAccount {
+    std::atomic<int64_t> offThreadNs;
+    std::thread::id owner;
+    CpuAccount() : offThreadNs(0) {}
+};
+
+// 当前线程所在 FairScope 的账户 (enter 之后才有)，否则为 nullptr。
+// 在派发并行任务之前取出，再传给任务体里的 CpuCharge
+CpuAccount* currentCpuAccount();
+
+// RAII：把本线程在作用域内的 CPU 时间记入 account。account 为空或就是 owner 线程时不记
+// (parallel_for_ 可能在调用线程上执行部分任务，那部分已由 FairScope 计入)
+class CpuCharge {
+public:
+    explicit CpuCharge(CpuAccount* account);
+    ~CpuCharge();
+
+private:
+    CpuAccount* account_;
+    timespec start_;
+    CpuCharge(const CpuCharge&);
+    CpuCharge& operator=(const CpuCharge&);
+};
+
+// RAII：enter() 时排队获取槽位 (请求体解析完、能预测成本之后才调用)，
+// 析构时按本线程消耗的 CPU 时间计费；未 enter 则不占槽位
+class FairScope {
+public:
+    FairScope(FairScheduler& scheduler, const std::string& tenant);
+    ~FairScope();
+
+    void enter(double predictedMs);
+    // 获得槽位到现在的墙钟时间，用于回馈成本模型
+    double serviceMs() const;
+
+private:
+    FairScheduler& scheduler_;
+    std::string tenant_;
+    bool entered_;
+    timespec cpuStart_;
+    timespec wallStart_;
+    CpuAccount account_;
+    CpuAccount* previousAccount_;
+    FairScope(const FairScope&);
+    FairScope& operator=(const FairScope&);
+};
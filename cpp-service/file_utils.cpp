@@ -0,0 +1,99 @@
+#include "file_utils.h"
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <dirent.h>
+#include <fcntl.h>
+#include <stdexcept>
+#include <sys/stat.h>
+#include <unistd.h>
+
+bool isImageFile(const std::string& path) {
+    static const char* kExtensions[] = { "png", "jpg", "jpeg", "bmp", "webp", "tif", "tiff" };
+    size_t dot = path.find_last_of('.');
+    if (dot == std::string::npos) return false;
+    std::string ext = path.substr(dot + 1);
+    for (char& c : ext) c = (char)tolower(c);
+    for (const char* known : kExtensions) {
+        if (ext == known) return true;
+    }
+    return false;
+}
+
+bool isDirectory(const std::string& path) {
+    struct stat st;
+    return stat(path.c_str(), &st) == 0 && S_ISDIR(st.st_mode);
+}
+
+static void listImageFilesRecursive(const std::string& dir, std::vector<std::string>& out) {
+    DIR* d = opendir(dir.c_str());
+    if (!d) throw std::runtime_error("无法打开目录: " + dir);
+    while (struct dirent* entry = readdir(d)) {
+        std::string name = entry->d_name;
+        if (name == "." || name == "..") continue;
+        std::string path = dir + "/" + name;
+        if (isDirectory(path)) {
+            listImageFilesRecursive(path, out);
+        }
+        else if (isImageFile(path)) {
+            out.push_back(path);
+        }
+    }
+    closedir(d);
+}
+
+void listImageFiles(const std::string& dir, std::vector<std::string>& out) {
+    size_t first = out.size();
+    listImageFilesRecursive(dir, out);
+    std::sort(out.begin() + first, out.end());
+}
+
+void makeDirs(const std::string& dir) {
+    if (dir.empty() || isDirectory(dir)) return;
+    makeDirs(parentDir(dir));
+    if (mkdir(dir.c_str(), 0755) != 0 && errno != EEXIST) {
+        throw std::runtime_error("无法创建目录: " + dir);
+    }
+}
+
+std::string parentDir(const std::string& path) {
+    size_t slash = path.find_last_of('/');
+    if (slash == std::string::npos) return "";
+    if (slash == 0) return "/";
+    return path.substr(0, slash);
+}
+
+std::string replaceExtension(const std::string& path, const std::string& ext) {
+    size_t slash = path.find_last_of('/');
+    size_t dot = path.find_last_of('.');
+    if (dot == std::string::npos || (slash != std::string::npos && dot < slash)) return path + "." + ext;
+    return path.substr(0, dot + 1) + ext;
+}
+
+bool readFile(const std::string& path, std::vector<unsigned char>& out) {
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) return false;
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        return false;
+    }
+    out.resize(st.st_size);
+    size_t done = 0;
+    while (done < out.size()) {
+        ssize_t n = read(fd, out.data() + done, out.size() - done);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) break;
+        done += n;
+    }
+    close(fd);
+    out.resize(done);
+    return done == (size_t)st.st_size;
+}
+
+void adviseWillNeed(const std::string& path) {
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) return;
+    posix_fadvise(fd, 0, 0, POSIX_FADV_WILLNEED);
+    close(fd);
+}
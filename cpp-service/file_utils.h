@@ -0,0 +1,23 @@
+#pragma once
+// =======================================================
+// 文件系统辅助函数 (POSIX)
+// =======================================================
+#include <string>
+#include <vector>
+
+bool isImageFile(const std::string& path);
+bool isDirectory(const std::string& path);
+
+// 递归列出目录下的图片文件，结果按路径排序
+void listImageFiles(const std::string& dir, std::vector<std::string>& out);
+
+// 等价于 mkdir -p
+void makeDirs(const std::string& dir);
+
+std::string parentDir(const std::string& path);
+std::string replaceExtension(const std::string& path, const std::string& ext);
+
+bool readFile(const std::string& path, std::vector<unsigned char>& out);
+
+// 提示内核预读文件 (posix_fadvise WILLNEED)
+void adviseWillNeed(const std::string& path);
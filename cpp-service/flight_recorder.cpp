@@ -0,0 +1,327 @@
+#include "flight_recorder.h"
+#include "file_utils.h"
+#include <algorithm>
+#include <cerrno>
+#include <csignal>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <fcntl.h>
+#include <stdexcept>
+#include <unistd.h>
+#include <vector>
+
+using json = ArenaJson;
+
+static const char kFlightMagic[8] = { 'S', 'N', 'T', 'L', 'F', 'L', 'T', '1' };
+
+// 初始化后不再释放：致命信号处理函数随时可能读取
+static FlightRecord* g_records = nullptr;
+static size_t g_capacity = 0;
+static std::atomic<uint64_t> g_next(0);
+static std::atomic<uint32_t> g_dumpCount(0);
+static char g_dumpDir[256];
+
+static thread_local FlightRequest* t_current = nullptr;
+
+static const int kFatalSignals[] = { SIGSEGV, SIGBUS, SIGFPE, SIGILL, SIGABRT };
+
+static int64_t wallNs() {
+    timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return (int64_t)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static int64_t monotonicNs() {
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+// 截断复制，保证以 0 结尾
+static void copyField(char* dst, size_t size, const char* src) {
+    size_t n = strnlen(src, size - 1);
+    memcpy(dst, src, n);
+    dst[n] = 0;
+}
+
+// =======================================================
+// 写入
+// =======================================================
+static void commit(uint8_t kind, const void* payload, size_t size) {
+    uint64_t seq = g_next.fetch_add(1, std::memory_order_relaxed) + 1;
+    FlightRecord& r = g_records[(seq - 1) % g_capacity];
+    r.seqEnd.store(0, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    r.wallNs = (uint64_t)wallNs();
+    r.kind = kind;
+    memcpy(&r.request, payload, size);
+    r.seq.store(seq, std::memory_order_release);
+    r.seqEnd.store(seq, std::memory_order_release);
+}
+
+bool flightRecorderEnabled() { return g_records != nullptr; }
+
+void recordFlightState(const FlightState& state) {
+    if (g_records) commit(kFlightState, &state, sizeof(state));
+}
+
+bool flightStageActive() { return t_current != nullptr; }
+
+void flightStage(const char* stage, int64_t durationNs) {
+    FlightRequest* r = t_current;
+    if (!r) return;
+    if (r->stageCount >= kFlightMaxStages) {
+        if (r->stagesDropped < 255) r->stagesDropped++;
+        return;
+    }
+    FlightStage& s = r->stages[r->stageCount++];
+    copyField(s.name, sizeof(s.name), stage);
+    s.us = (uint32_t)std::min<int64_t>(durationNs / 1000, UINT32_MAX);
+}
+
+FlightEntry::FlightEntry(const char* endpoint, int inflight) : startNs_(0), previous_(t_current) {
+    memset(&record_, 0, sizeof(record_));
+    if (!g_records) return;
+    startNs_ = monotonicNs();
+    record_.inflight = (uint16_t)std::min(inflight, 65535);
+    copyField(record_.endpoint, sizeof(record_.endpoint), endpoint);
+    t_current = &record_;
+}
+
+FlightEntry::~FlightEntry() {
+    if (!g_records) return;
+    t_current = previous_;
+    record_.totalUs = (uint32_t)std::min<int64_t>((monotonicNs() - startNs_) / 1000, UINT32_MAX);
+    if (record_.status == 0) record_.status = 200;
+    commit(kFlightRequest, &record_, sizeof(record_));
+}
+
+void FlightEntry::setAlgorithm(const std::string& algorithm) {
+    copyField(record_.algorithm, sizeof(record_.algorithm), algorithm.c_str());
+}
+
+void FlightEntry::setTenant(const std::string& tenant) {
+    copyField(record_.tenant, sizeof(record_.tenant), tenant.c_str());
+}
+
+void FlightEntry::setBrownoutLevel(int level) { record_.brownoutLevel = (uint8_t)level; }
+
+void FlightEntry::markStarted() {
+    if (g_records) record_.waitUs = (uint32_t)std::min<int64_t>((monotonicNs() - startNs_) / 1000, UINT32_MAX);
+}
+
+void FlightEntry::setError(const char* message) {
+    copyField(record_.error, sizeof(record_.error), message);
+}
+
+// =======================================================
+// 转储 (信号处理函数中调用：只用异步信号安全的系统调用，不分配内存)
+// =======================================================
+static char* appendText(char* p, char* end, const char* text) {
+    while (*text && p < end) *p++ = *text++;
+    return p;
+}
+
+static char* appendNumber(char* p, char* end, uint64_t value) {
+    char digits[24];
+    int n = 0;
+    do {
+        digits[n++] = (char)('0' + value % 10);
+        value /= 10;
+    } while (value);
+    while (n > 0 && p < end) *p++ = digits[--n];
+    return p;
+}
+
+static bool writeAll(int fd, const void* data, size_t size) {
+    const char* p = (const char*)data;
+    while (size > 0) {
+        ssize_t n = write(fd, p, size);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return false;
+        p += n;
+        size -= (size_t)n;
+    }
+    return true;
+}
+
+// 成功时 path 为最终文件名
+static bool writeDump(const char* reason, int signal, char* path, size_t pathSize) {
+    if (!g_records) return false;
+    int64_t now = wallNs();
+    char* end = path + pathSize - 6;  // 留出 ".tmp" 与结尾 0
+    char* p = appendText(path, end, g_dumpDir);
+    p = appendText(p, end, "/flight-");
+    p = appendNumber(p, end, (uint64_t)getpid());
+    p = appendText(p, end, "-");
+    p = appendNumber(p, end, (uint64_t)(now / 1000000000LL));
+    p = appendText(p, end, "-");
+    p = appendNumber(p, end, g_dumpCount.fetch_add(1));
+    p = appendText(p, end, "-");
+    p = appendText(p, end, reason);
+    p = appendText(p, end, ".bin");
+    char* suffix = p;
+    p = appendText(p, path + pathSize - 1, ".tmp");
+    *p = 0;
+
+    FlightDumpHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, kFlightMagic, sizeof(header.magic));
+    header.recordSize = sizeof(FlightRecord);
+    header.capacity = (uint32_t)g_capacity;
+    header.written = g_next.load();
+    header.dumpWallNs = (uint64_t)now;
+    header.pid = getpid();
+    header.signal = signal;
+    for (size_t i = 0; i < sizeof(header.reason) - 1 && reason[i]; ++i) header.reason[i] = reason[i];
+
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) return false;
+    bool ok = writeAll(fd, &header, sizeof(header)) && writeAll(fd, g_records, g_capacity * sizeof(FlightRecord));
+    close(fd);
+    char tmpPath[512];
+    memcpy(tmpPath, path, (size_t)(p - path) + 1);
+    *suffix = 0;
+    if (!ok || rename(tmpPath, path) != 0) {
+        unlink(tmpPath);
+        return false;
+    }
+    return true;
+}
+
+static void onDumpSignal(int) {
+    int savedErrno = errno;
+    char path[512];
+    writeDump("sigusr1", SIGUSR1, path, sizeof(path));
+    errno = savedErrno;
+}
+
+static void onFatalSignal(int sig) {
+    char path[512];
+    const char* reason = sig == SIGSEGV ? "sigsegv" : sig == SIGBUS ? "sigbus" : sig == SIGFPE ? "sigfpe" :
+        sig == SIGILL ? "sigill" : "sigabrt";
+    if (writeDump(reason, sig, path, sizeof(path))) {
+        const char prefix[] = "[FLIGHT] 致命信号，飞行记录已写出: ";
+        writeAll(STDERR_FILENO, prefix, sizeof(prefix) - 1);
+        writeAll(STDERR_FILENO, path, strlen(path));
+        writeAll(STDERR_FILENO, "\n", 1);
+    }
+    // SA_RESETHAND 已恢复默认处理：重新投递信号，保留原有的退出码与 core dump
+    raise(sig);
+}
+
+void initFlightRecorder(size_t capacity, const std::string& dumpDir) {
+    if (capacity == 0 || g_records) return;
+    if (dumpDir.size() >= sizeof(g_dumpDir) - 64) throw std::runtime_error("飞行记录目录路径过长: " + dumpDir);
+    makeDirs(dumpDir);
+    copyField(g_dumpDir, sizeof(g_dumpDir), dumpDir.c_str());
+    g_capacity = capacity;
+    g_records = new FlightRecord[capacity]();
+
+    struct sigaction sa = {};
+    sa.sa_handler = onDumpSignal;
+    sigemptyset(&sa.sa_mask);
+    sa.sa_flags = SA_RESTART;
+    sigaction(SIGUSR1, &sa, nullptr);
+
+    struct sigaction fatal = {};
+    fatal.sa_handler = onFatalSignal;
+    sigemptyset(&fatal.sa_mask);
+    fatal.sa_flags = SA_RESETHAND | SA_NODEFER;
+    for (int sig : kFatalSignals) sigaction(sig, &fatal, nullptr);
+}
+
+std::string dumpFlightRecorder(const char* reason) {
+    if (!g_records) throw std::runtime_error("飞行记录器未开启 (flightRecords = 0)");
+    char path[512];
+    if (!writeDump(reason, 0, path, sizeof(path))) throw std::runtime_error(std::string("写出飞行记录失败: ") + strerror(errno));
+    return path;
+}
+
+// =======================================================
+// 解码
+// =======================================================
+static std::string fieldText(const char* field, size_t size) {
+    return std::string(field, strnlen(field, size));
+}
+
+static std::string isoTime(uint64_t ns) {
+    time_t sec = (time_t)(ns / 1000000000ULL);
+    tm utc;
+    gmtime_r(&sec, &utc);
+    char buf[40];
+    size_t n = strftime(buf, sizeof(buf), "%Y-%m-%dT%H:%M:%S", &utc);
+    snprintf(buf + n, sizeof(buf) - n, ".%03uZ", (unsigned)(ns / 1000000ULL % 1000));
+    return buf;
+}
+
+static json requestJson(const FlightRequest& r) {
+    json stages = json::array();
+    for (int i = 0; i < std::min<int>(r.stageCount, kFlightMaxStages); ++i) {
+        stages.push_back({ {"stage", fieldText(r.stages[i].name, sizeof(r.stages[i].name))}, {"ms", r.stages[i].us / 1000.0} });
+    }
+    json out = {
+        {"endpoint", fieldText(r.endpoint, sizeof(r.endpoint))}, {"algorithm", fieldText(r.algorithm, sizeof(r.algorithm))},
+        {"tenant", fieldText(r.tenant, sizeof(r.tenant))}, {"status", r.status},
+        {"totalMs", r.totalUs / 1000.0}, {"waitMs", r.waitUs / 1000.0}, {"inflight", r.inflight},
+        {"brownoutLevel", r.brownoutLevel}, {"stages", stages},
+    };
+    if (r.stagesDropped) out["stagesDropped"] = r.stagesDropped;
+    if (r.error[0]) out["error"] = fieldText(r.error, sizeof(r.error));
+    return out;
+}
+
+static json stateJson(const FlightState& s) {
+    return {
+        {"inflight", s.inflight}, {"schedulerWaiting", s.schedulerWaiting}, {"prefetchPending", s.prefetchPending},
+        {"recompressPending", s.recompressPending}, {"brownoutLevel", s.brownoutLevel},
+        {"imageCacheHits", s.imageCacheHits}, {"imageCacheMisses", s.imageCacheMisses}, {"imageCacheBytes", s.imageCacheBytes},
+        {"frameStoreHits", s.frameStoreHits}, {"frameStoreMisses", s.frameStoreMisses},
+        {"taskQueueRejected", s.taskQueueRejected}, {"failedRequests", s.failedRequests},
+    };
+}
+
+json decodeFlightDump(const std::string& bytes) {
+    FlightDumpHeader header;
+    if (bytes.size() < sizeof(header)) throw std::runtime_error("飞行记录文件过短");
+    memcpy(&header, bytes.data(), sizeof(header));
+    if (memcmp(header.magic, kFlightMagic, sizeof(header.magic)) != 0) throw std::runtime_error("不是飞行记录文件");
+    if (header.recordSize != sizeof(FlightRecord)) {
+        throw std::runtime_error("记录大小不匹配: " + std::to_string(header.recordSize) + " (当前版本 " + std::to_string(sizeof(FlightRecord)) + ")");
+    }
+    if (bytes.size() < sizeof(header) + (size_t)header.capacity * sizeof(FlightRecord)) throw std::runtime_error("飞行记录文件被截断");
+
+    // 按序号排序；序号与槽位不符或首尾不一致的是转储时正在改写的槽位
+    std::vector<const FlightRecord*> records;
+    size_t torn = 0;
+    const FlightRecord* slots = (const FlightRecord*)(bytes.data() + sizeof(header));
+    for (uint32_t i = 0; i < header.capacity; ++i) {
+        uint64_t seq = slots[i].seq.load(std::memory_order_relaxed);
+        uint64_t seqEnd = slots[i].seqEnd.load(std::memory_order_relaxed);
+        if (seq == 0 && seqEnd == 0 && slots[i].kind == kFlightEmpty) continue;
+        if (seq == 0 || seq != seqEnd || (seq - 1) % header.capacity != i) torn++;
+        else records.push_back(&slots[i]);
+    }
+    std::sort(records.begin(), records.end(), [](const FlightRecord* a, const FlightRecord* b) {
+        return a->seq.load(std::memory_order_relaxed) < b->seq.load(std::memory_order_relaxed);
+    });
+
+    json list = json::array();
+    for (const FlightRecord* r : records) {
+        json entry;
+        if (r->kind == kFlightRequest) entry = requestJson(r->request);
+        else if (r->kind == kFlightState) entry = stateJson(r->state);
+        else continue;
+        entry["seq"] = r->seq.load(std::memory_order_relaxed);
+        entry["time"] = isoTime(r->wallNs);
+        entry["kind"] = r->kind == kFlightRequest ? "request" : "state";
+        list.push_back(entry);
+    }
+    return {
+        {"pid", header.pid}, {"reason", fieldText(header.reason, sizeof(header.reason))}, {"signal", header.signal},
+        {"dumpedAt", isoTime(header.dumpWallNs)}, {"capacity", header.capacity}, {"written", header.written},
+        {"torn", torn}, {"records", list},
+    };
+}
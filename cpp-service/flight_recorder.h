@@ -0,0 +1,123 @@
+#pragma once
+// =======================================================
+// 飞行记录器
+// 进程内固定大小的二进制环，保存最近的请求 (各阶段耗时、排队时间、在途数、错误)
+// 与每秒一次的状态采样 (队列深度、缓存命中、分发队列拒绝数)。
+// 写入只有一次 fetch_add + 256 字节拷贝，不加锁、不分配内存。
+// 以下情况把整个环原样写到 SENTINEL_FLIGHT_DIR (默认 /tmp/sentinel-flight)：
+//   SIGUSR1、致命信号 (SIGSEGV / SIGBUS / SIGFPE / SIGILL / SIGABRT)、POST /admin/flight/dump
+// 写出只用 open / write / rename 等异步信号安全的调用；正在被改写的槽位由首尾序号
+// 识别，解码时丢弃。sentinel-cli --flight-dump <文件> 把转储解码为 JSON
+// =======================================================
+#include "request_arena.h"
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+enum FlightKind : uint8_t { kFlightEmpty = 0, kFlightRequest = 1, kFlightState = 2 };
+
+static const int kFlightMaxStages = 6;
+
+struct FlightStage {
+    char name[12];
+    uint32_t us;
+};
+
+struct FlightRequest {
+    uint32_t totalUs;
+    uint32_t waitUs;        // 等待执行槽位的时间
+    uint16_t status;
+    uint16_t inflight;      // 请求开始时的在途请求数
+    uint8_t stageCount;
+    uint8_t stagesDropped;  // 超出 kFlightMaxStages 未记录的阶段数
+    uint8_t brownoutLevel;
+    uint8_t reserved;
+    char endpoint[16];
+    char algorithm[16];
+    char tenant[16];
+    FlightStage stages[kFlightMaxStages];
+    char error[64];
+};
+
+struct FlightState {
+    uint32_t inflight;
+    uint32_t schedulerWaiting;
+    uint32_t prefetchPending;
+    uint32_t recompressPending;
+    uint32_t brownoutLevel;
+    uint32_t reserved;
+    uint64_t imageCacheHits;
+    uint64_t imageCacheMisses;
+    uint64_t imageCacheBytes;
+    uint64_t frameStoreHits;
+    uint64_t frameStoreMisses;
+    uint64_t taskQueueRejected;
+    uint64_t failedRequests;
+};
+
+// 一个槽位。写入顺序：seqEnd = 0 -> 内容 -> seq -> seqEnd；seq == seqEnd 且非 0 才是完整记录
+struct FlightRecord {
+    std::atomic<uint64_t> seq;
+    uint64_t wallNs;  // CLOCK_REALTIME
+    uint8_t kind;
+    uint8_t reserved[7];
+    union {
+        FlightRequest request;
+        FlightState state;
+    };
+    std::atomic<uint64_t> seqEnd;
+};
+static_assert(sizeof(FlightRecord) == 256, "flight record layout changed");
+
+// 转储文件头，后面紧跟 capacity 个 FlightRecord
+struct FlightDumpHeader {
+    char magic[8];  // "SNTLFLT1"
+    uint32_t recordSize;
+    uint32_t capacity;
+    uint64_t written;  // 进程启动以来写入的记录总数
+    uint64_t dumpWallNs;
+    int32_t pid;
+    int32_t signal;    // 触发转储的信号，0 表示按需转储
+    char reason[16];
+    uint8_t reserved[8];
+};
+static_assert(sizeof(FlightDumpHeader) == 64, "flight dump header layout changed");
+
+// 启动时调用一次：分配 capacity 个槽位并安装信号处理函数；capacity 为 0 时保持关闭
+void initFlightRecorder(size_t capacity, const std::string& dumpDir);
+bool flightRecorderEnabled();
+
+// 写出当前环；返回文件路径，失败抛出 std::runtime_error
+std::string dumpFlightRecorder(const char* reason);
+
+void recordFlightState(const FlightState& state);
+
+// 当前线程上的请求记录 (若有) 追加一个阶段耗时；由 PerfScope 调用
+bool flightStageActive();
+void flightStage(const char* stage, int64_t durationNs);
+
+// 一个请求的记录：构造时开始计时，析构时写入环。请求内的 PerfScope 阶段自动记入
+class FlightEntry {
+public:
+    FlightEntry(const char* endpoint, int inflight);
+    ~FlightEntry();
+
+    void setAlgorithm(const std::string& algorithm);
+    void setTenant(const std::string& tenant);
+    void setBrownoutLevel(int level);
+    // 获得执行槽位时调用，之前的时间计为排队
+    void markStarted();
+    void setStatus(int status) { record_.status = (uint16_t)status; }
+    void setError(const char* message);
+
+private:
+    FlightRequest record_;
+    int64_t startNs_;
+    FlightRequest* previous_;
+    FlightEntry(const FlightEntry&);
+    FlightEntry& operator=(const FlightEntry&);
+};
+
+// 解码转储文件内容 (按写入顺序，丢弃未写完的槽位)；格式不符时抛出 std::runtime_error
+ArenaJson decodeFlightDump(const std::string& bytes);
@@ -0,0 +1,133 @@
+#include "forensics_refiner.h"
+#include "file_utils.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fcntl.h>
+#include <iostream>
+#include <stdexcept>
+#include <unistd.h>
+#include <vector>
+
+static const int kPollMs = 200;
+
+static bool sameFile(const struct stat& a, const struct stat& b) {
+    return a.st_ino == b.st_ino && a.st_dev == b.st_dev && a.st_size == b.st_size &&
+        a.st_mtim.tv_sec == b.st_mtim.tv_sec && a.st_mtim.tv_nsec == b.st_mtim.tv_nsec;
+}
+
+ForensicsRefiner::ForensicsRefiner(ForegroundTracker& foreground, size_t maxPending, int idleSeconds, RefinedCallback onRefined)
+    : foreground_(foreground), maxPending_(maxPending), onRefined_(onRefined), idleSeconds_(idleSeconds), stopping_(false),
+      refined_(0), superseded_(0), failed_(0) {
+    worker_ = std::thread([this] { run(); });
+}
+
+ForensicsRefiner::~ForensicsRefiner() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+        wake_.notify_all();
+    }
+    worker_.join();
+}
+
+bool ForensicsRefiner::enqueue(const std::string& inputPath, const std::string& outputPath, const cv::Rect& roi, const CodecOptions& codec) {
+    Job job;
+    job.inputPath = inputPath;
+    job.outputPath = outputPath;
+    job.roi = roi;
+    job.codec = codec;
+    if (stat(outputPath.c_str(), &job.written) != 0) return false;
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (queue_.size() >= maxPending_) return false;
+    queue_.push_back(job);
+    wake_.notify_one();
+    return true;
+}
+
+void ForensicsRefiner::setIdleSeconds(int idleSeconds) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    idleSeconds_ = idleSeconds;
+    wake_.notify_all();
+}
+
+ForensicsRefineStats ForensicsRefiner::stats() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    ForensicsRefineStats s = { refined_.load(), superseded_.load(), failed_.load(), queue_.size() };
+    return s;
+}
+
+bool ForensicsRefiner::waitForIdle() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (!stopping_) {
+        if (idleSeconds_ <= 0 || queue_.empty()) {
+            wake_.wait(lock);
+            continue;
+        }
+        if (foreground_.idleForMs() >= (int64_t)idleSeconds_ * 1000) return true;
+        wake_.wait_for(lock, std::chrono::milliseconds(kPollMs));
+    }
+    return false;
+}
+
+void ForensicsRefiner::run() {
+    lowerCurrentThreadPriority();
+    while (waitForIdle()) {
+        Job job;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (queue_.empty()) continue;
+            job = queue_.front();
+            queue_.pop_front();
+        }
+        process(job);
+    }
+}
+
+void ForensicsRefiner::process(const Job& job) {
+    struct stat now;
+    if (stat(job.outputPath.c_str(), &now) != 0 || !sameFile(job.written, now)) {
+        superseded_++;
+        return;
+    }
+
+    // 临时文件与输出同目录、同扩展名 (writeImage 按扩展名选择编码器)，rename 为原子替换
+    std::string base = job.outputPath.substr(job.outputPath.find_last_of('/') + 1);
+    size_t dot = base.find_last_of('.');
+    std::string ext = dot == std::string::npos ? "" : base.substr(dot);
+    std::string pattern = parentDir(job.outputPath) + "/." + base + ".refine.XXXXXX" + ext;
+    std::vector<char> name(pattern.begin(), pattern.end());
+    name.push_back('\0');
+    int fd = mkostemps(name.data(), (int)ext.size(), O_CLOEXEC);
+    if (fd < 0) {
+        failed_++;
+        return;
+    }
+    // mkostemps 以 0600 创建，替换后保持原输出的权限
+    fchmod(fd, job.written.st_mode & 07777);
+    close(fd);
+    std::string tmpPath = name.data();
+
+    try {
+        refineForensics(job.inputPath, tmpPath, job.roi, job.codec);
+    }
+    catch (const std::exception& e) {
+        unlink(tmpPath.c_str());
+        failed_++;
+        std::cerr << "[REFINE] 全分辨率取证失败，保留粗略结果: " << job.outputPath << ": " << e.what() << std::endl;
+        return;
+    }
+    // 分析期间输出被重新生成时放弃
+    if (stat(job.outputPath.c_str(), &now) != 0 || !sameFile(job.written, now)) {
+        unlink(tmpPath.c_str());
+        superseded_++;
+        return;
+    }
+    if (rename(tmpPath.c_str(), job.outputPath.c_str()) != 0) {
+        unlink(tmpPath.c_str());
+        failed_++;
+        return;
+    }
+    refined_++;
+    if (onRefined_) onRefined_(job.outputPath);
+}
@@ -0,0 +1,69 @@
+#pragma once
+// =======================================================
+// 推迟的取证精细化
+// brownout L4 下取证只在缩小图上分析 (响应带 refinementDeferred)，输出是粗略结果。
+// 这些输出在这里排队，前台连续空闲一段时间后 (与 Recompressor 相同的空闲判断)
+// 以全分辨率重新分析，写入同目录的临时文件后原子替换输出：
+//   - 输出在排队期间被改写 (例如同一文件被重新处理) 时放弃，以新文件为准
+//   - 替换成功后回调 onRefined (服务端用它把新文件交给 Recompressor)
+// 队列只在内存中，进程退出时未处理的条目保留粗略结果
+// =======================================================
+#include "algorithms.h"
+#include "prefetch.h"
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <sys/stat.h>
+#include <thread>
+
+struct ForensicsRefineStats {
+    uint64_t refined;     // 已替换为全分辨率结果
+    uint64_t superseded;  // 输出在排队期间被改写，放弃
+    uint64_t failed;      // 读写或分析失败
+    size_t pending;
+};
+
+class ForensicsRefiner {
+public:
+    typedef std::function<void(const std::string& outputPath)> RefinedCallback;
+
+    ForensicsRefiner(ForegroundTracker& foreground, size_t maxPending, int idleSeconds, RefinedCallback onRefined);
+    ~ForensicsRefiner();
+
+    // 在写出粗略输出之后调用；输出不存在或队列已满时返回 false
+    bool enqueue(const std::string& inputPath, const std::string& outputPath, const cv::Rect& roi, const CodecOptions& codec);
+    // 前台需要连续空闲多少秒才开始处理；0 表示暂停
+    void setIdleSeconds(int idleSeconds);
+    ForensicsRefineStats stats() const;
+
+private:
+    struct Job {
+        std::string inputPath;
+        std::string outputPath;
+        cv::Rect roi;
+        CodecOptions codec;
+        struct stat written;  // 入队时粗略输出的文件状态
+    };
+
+    void run();
+    bool waitForIdle();
+    void process(const Job& job);
+
+    ForegroundTracker& foreground_;
+    const size_t maxPending_;
+    RefinedCallback onRefined_;
+
+    mutable std::mutex mutex_;
+    std::condition_variable wake_;
+    std::deque<Job> queue_;
+    int idleSeconds_;
+    bool stopping_;
+
+    std::atomic<uint64_t> refined_;
+    std::atomic<uint64_t> superseded_;
+    std::atomic<uint64_t> failed_;
+    std::thread worker_;
+};
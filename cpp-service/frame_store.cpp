@@ -0,0 +1,499 @@
+#include "frame_store.h"
+#include "file_utils.h"
+#include "image_cache.h"
+#include "prefetch.h"
+#include "cache_snapshot.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <dirent.h>
+#include <fcntl.h>
+#include <iostream>
+#include <iterator>
+#include <limits>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace cv;
+
+// 文件头之后的像素数据从 4096 字节处开始，保证映射后按页对齐
+static const size_t kDataOffset = 4096;
+static const uint32_t kFormatVersion = 2;
+// 启动扫描只清理足够旧的临时文件：较新的可能属于热重启交接中仍在写入的旧进程
+static const time_t kStaleTmpSeconds = 600;
+// 金字塔逐级减半，直到最长边不超过该值
+static const int kMinPyramidSide = 256;
+static const size_t kWriteQueueDepth = 8;
+
+struct FrameHeader {
+    char magic[4];
+    uint32_t version;
+    uint64_t hash;
+    int32_t level;
+    int32_t rows;
+    int32_t cols;
+    int32_t type;
+    uint64_t step;
+    uint64_t dataOffset;
+    uint64_t sourceSize;             // 原文件长度
+    unsigned char sourceDigest[32];  // 原文件 SHA-256
+    uint64_t checksum; // 以上字段的校验和
+};
+
+static uint64_t headerChecksum(const FrameHeader& h) {
+    return contentHash64(reinterpret_cast<const unsigned char*>(&h), offsetof(FrameHeader, checksum));
+}
+
+static bool validHeader(const FrameHeader& h, uint64_t hash, int level, size_t fileBytes) {
+    if (memcmp(h.magic, "SFRM", 4) != 0 || h.version != kFormatVersion) return false;
+    if (h.hash != hash || h.level != level || h.checksum != headerChecksum(h)) return false;
+    if (h.rows <= 0 || h.cols <= 0 || h.dataOffset != kDataOffset) return false;
+    return fileBytes >= h.dataOffset + h.step * (uint64_t)h.rows;
+}
+
+static bool sameSource(const FrameHeader& h, const ContentKey& key) {
+    return h.sourceSize == key.size && memcmp(h.sourceDigest, key.digest, sizeof(h.sourceDigest)) == 0;
+}
+
+// =======================================================
+// mmap 支撑的 Mat：最后一个引用释放时 munmap
+// =======================================================
+#if CV_VERSION_MAJOR >= 4
+typedef AccessFlag AllocatorAccessFlag;
+#else
+typedef int AllocatorAccessFlag;
+#endif
+
+class MappedFileAllocator : public MatAllocator {
+public:
+    // 映射的 Mat 不会重新分配数据，以下两个接口只为满足 MatAllocator 约定
+    UMatData* allocate(int dims, const int* sizes, int type, void* data, size_t* step,
+        AllocatorAccessFlag flags, UMatUsageFlags usageFlags) const override {
+        return Mat::getStdAllocator()->allocate(dims, sizes, type, data, step, flags, usageFlags);
+    }
+    bool allocate(UMatData* data, AllocatorAccessFlag flags, UMatUsageFlags usageFlags) const override {
+        return Mat::getStdAllocator()->allocate(data, flags, usageFlags);
+    }
+    void deallocate(UMatData* u) const override {
+        if (!u) return;
+        munmap(u->handle, u->size);
+        delete u;
+    }
+};
+
+static MappedFileAllocator g_mappedAllocator;
+
+static Mat wrapMapping(void* base, size_t length, const FrameHeader& h) {
+    uchar* data = static_cast<uchar*>(base) + h.dataOffset;
+    Mat m(h.rows, h.cols, h.type, data, h.step);
+    UMatData* u = new UMatData(&g_mappedAllocator);
+    u->data = u->origdata = data;
+    u->size = length;
+    u->handle = base;
+    u->refcount = 1;
+    m.u = u;
+    m.allocator = &g_mappedAllocator;
+    return m;
+}
+
+static bool writeAll(int fd, const void* data, size_t size) {
+    const char* p = static_cast<const char*>(data);
+    while (size > 0) {
+        ssize_t n = write(fd, p, size);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        p += n;
+        size -= n;
+    }
+    return true;
+}
+
+// rename 之后同步目录，否则掉电后新文件名可能丢失
+static void syncDirectory(const std::string& dir) {
+    int fd = open(dir.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fd < 0) return;
+    fsync(fd);
+    close(fd);
+}
+
+static bool hasSuffix(const std::string& name, const char* suffix) {
+    size_t n = strlen(suffix);
+    return name.size() >= n && name.compare(name.size() - n, n, suffix) == 0;
+}
+
+// =======================================================
+// FrameStore
+// =======================================================
+FrameStore::FrameStore(const std::string& root, size_t capacityBytes)
+    : root_(root), enabled_(capacityBytes > 0), capacity_(capacityBytes), bytes_(0), scanned_(false), hits_(0), misses_(0), writes_(0), dropped_(0), evictions_(0),
+    queue_(kWriteQueueDepth) {
+    if (!enabled()) return;
+    makeDirs(root_);
+    writer_ = std::thread(&FrameStore::writerLoop, this);
+}
+
+FrameStore::~FrameStore() {
+    queue_.close();
+    if (writer_.joinable()) writer_.join();
+}
+
+bool FrameStore::setCapacity(size_t capacityBytes) {
+    if (!enabled_ || capacityBytes == 0) return false;
+    std::lock_guard<std::mutex> lock(mutex_);
+    capacity_ = capacityBytes;
+    evictLocked();
+    return true;
+}
+
+std::string FrameStore::pathFor(uint64_t hash, int level) const {
+    char name[64];
+    snprintf(name, sizeof(name), "%02x/%016llx.L%d.frame", (unsigned)(hash >> 56), (unsigned long long)hash, level);
+    return root_ + "/" + name;
+}
+
+Mat FrameStore::mapLevel(const ContentKey& key, int level) {
+    std::string path = pathFor(key.hash, level);
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return Mat();
+    struct stat st;
+    void* base = MAP_FAILED;
+    if (fstat(fd, &st) == 0 && (size_t)st.st_size >= kDataOffset) {
+        // MAP_PRIVATE + 可写：调用方误写时只触发写时复制，不会破坏缓存文件
+        base = mmap(nullptr, st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    }
+    close(fd);
+    if (base == MAP_FAILED) return Mat();
+
+    FrameHeader h;
+    memcpy(&h, base, sizeof(h));
+    if (!validHeader(h, key.hash, level, st.st_size) || !sameSource(h, key)) {
+        munmap(base, st.st_size);
+        return Mat();
+    }
+    // 记录访问时间，重启后据此恢复 LRU 顺序
+    utimensat(AT_FDCWD, path.c_str(), nullptr, 0);
+    return wrapMapping(base, st.st_size, h);
+}
+
+Mat FrameStore::load(const ContentKey& key) {
+    // 没有任何层级满足时选择层级 0
+    return loadAtLeast(key, std::numeric_limits<int>::max());
+}
+
+Mat FrameStore::loadAtLeast(const ContentKey& key, int minSide) {
+    if (!enabled()) return Mat();
+    const uint64_t hash = key.hash;
+    int level = -1;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = entries_.find(hash);
+        if (it != entries_.end()) {
+            const std::vector<Level>& levels = it->second.levels;
+            for (size_t i = 0; i < levels.size(); ++i) {
+                if (std::max(levels[i].rows, levels[i].cols) >= minSide) level = (int)i;
+            }
+            if (level < 0) level = 0;
+            touchLocked(it->second);
+        }
+    }
+    if (level < 0) {
+        misses_++;
+        return Mat();
+    }
+
+    Mat m = mapLevel(key, level);
+    if (m.empty()) {
+        // 文件被外部删除、已损坏或属于哈希相同的另一文件：移除整个条目
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = entries_.find(hash);
+        if (it != entries_.end()) {
+            removeFiles(hash, it->second.levels.size());
+            bytes_ -= it->second.bytes;
+            lru_.erase(it->second.lru);
+            entries_.erase(it);
+        }
+        misses_++;
+        return m;
+    }
+    hits_++;
+    return m;
+}
+
+void FrameStore::storeAsync(const ContentKey& key, const Mat& frame) {
+    if (!enabled() || frame.empty()) return;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (entries_.count(key.hash)) return;
+    }
+    WriteJob job = { key, frame };
+    if (!queue_.tryPush(std::move(job))) dropped_++;
+}
+
+FrameStoreStats FrameStore::stats() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    FrameStoreStats s = { hits_.load(), misses_.load(), writes_.load(), dropped_.load(), evictions_.load(), entries_.size(), bytes_ };
+    return s;
+}
+
+void FrameStore::saveIndex(SnapshotWriter& out) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    out.putVarint(lru_.size());
+    for (uint64_t hash : lru_) {
+        const Entry& entry = entries_.at(hash);
+        out.putU64(hash);
+        out.putVarint(entry.levels.size());
+        for (const Level& l : entry.levels) {
+            out.putVarint((uint64_t)l.rows);
+            out.putVarint((uint64_t)l.cols);
+            out.putVarint(l.fileBytes);
+        }
+    }
+}
+
+size_t FrameStore::restoreIndex(SnapshotReader& in) {
+    if (!enabled()) return 0;
+    uint64_t count = 0;
+    if (!in.getVarint(count)) return 0;
+    size_t restored = 0;
+    std::vector<Level> levels;
+    for (uint64_t i = 0; i < count; ++i) {
+        uint64_t hash = 0, nLevels = 0;
+        if (!in.getU64(hash) || !in.getVarint(nLevels) || nLevels == 0 || nLevels > 64) break;
+        levels.clear();
+        bool ok = true;
+        for (uint64_t k = 0; k < nLevels && ok; ++k) {
+            uint64_t rows = 0, cols = 0, bytes = 0;
+            ok = in.getVarint(rows) && in.getVarint(cols) && in.getVarint(bytes);
+            Level l = { (int)rows, (int)cols, (size_t)bytes };
+            levels.push_back(l);
+        }
+        if (!ok) break;
+        std::lock_guard<std::mutex> lock(mutex_);
+        // 扫描已经完成时索引是准确的，快照只会引入过期条目
+        if (scanned_) break;
+        insertLocked(hash, levels, false);
+        restored++;
+    }
+    return restored;
+}
+
+bool FrameStore::writeLevel(const ContentKey& key, int level, const Mat& frame, size_t& fileBytes) {
+    std::string path = pathFor(key.hash, level);
+    makeDirs(parentDir(path));
+    // 热重启期间新旧进程可能同时写同一帧，临时文件按进程区分
+    std::string tmpPath = path + "." + std::to_string(getpid()) + ".tmp";
+
+    FrameHeader h;
+    memset(&h, 0, sizeof(h));
+    memcpy(h.magic, "SFRM", 4);
+    h.version = kFormatVersion;
+    h.hash = key.hash;
+    h.level = level;
+    h.rows = frame.rows;
+    h.cols = frame.cols;
+    h.type = frame.type();
+    h.step = frame.cols * frame.elemSize();
+    h.dataOffset = kDataOffset;
+    h.sourceSize = key.size;
+    memcpy(h.sourceDigest, key.digest, sizeof(h.sourceDigest));
+    h.checksum = headerChecksum(h);
+
+    int fd = open(tmpPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) return false;
+    std::vector<char> head(kDataOffset, 0);
+    memcpy(head.data(), &h, sizeof(h));
+    bool ok = writeAll(fd, head.data(), head.size());
+    if (ok && frame.isContinuous()) {
+        ok = writeAll(fd, frame.data, h.step * frame.rows);
+    }
+    else {
+        for (int y = 0; ok && y < frame.rows; ++y) ok = writeAll(fd, frame.ptr(y), h.step);
+    }
+    // 数据落盘后再 rename，崩溃时要么是完整文件，要么是启动时会被清理的 .tmp
+    ok = ok && fdatasync(fd) == 0;
+    close(fd);
+    if (!ok || rename(tmpPath.c_str(), path.c_str()) != 0) {
+        unlink(tmpPath.c_str());
+        return false;
+    }
+    syncDirectory(parentDir(path));
+    fileBytes = kDataOffset + h.step * frame.rows;
+    return true;
+}
+
+void FrameStore::writerLoop() {
+    lowerCurrentThreadPriority();
+    // 大目录的扫描可能需要数十秒，放在后台进行，服务不必等待
+    scan();
+    WriteJob job;
+    while (queue_.pop(job)) {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (entries_.count(job.key.hash)) continue;
+        }
+
+        std::vector<Level> levels;
+        Mat current = job.frame;
+        job.frame.release();
+        while (true) {
+            Level level = { current.rows, current.cols, 0 };
+            if (!writeLevel(job.key, (int)levels.size(), current, level.fileBytes)) break;
+            levels.push_back(level);
+            if (std::max(current.rows, current.cols) <= kMinPyramidSide) break;
+            Mat half;
+            resize(current, half, Size(std::max(1, current.cols / 2), std::max(1, current.rows / 2)), 0, 0, INTER_AREA);
+            current = half;
+        }
+
+        if (levels.empty()) {
+            std::cerr << "[WARN] Frame store write failed: " << pathFor(job.key.hash, 0) << std::endl;
+            continue;
+        }
+        writes_++;
+        insert(job.key.hash, levels, true);
+    }
+}
+
+void FrameStore::insert(uint64_t hash, const std::vector<Level>& levels, bool newest) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    insertLocked(hash, levels, newest);
+}
+
+void FrameStore::insertLocked(uint64_t hash, const std::vector<Level>& levels, bool newest) {
+    if (entries_.count(hash)) return;
+    Entry entry;
+    entry.levels = levels;
+    entry.bytes = 0;
+    for (const Level& l : levels) entry.bytes += l.fileBytes;
+    if (newest) {
+        lru_.push_front(hash);
+        entry.lru = lru_.begin();
+    }
+    else {
+        lru_.push_back(hash);
+        entry.lru = std::prev(lru_.end());
+    }
+    bytes_ += entry.bytes;
+    entries_.insert(std::make_pair(hash, entry));
+    evictLocked();
+}
+
+void FrameStore::touchLocked(Entry& entry) {
+    lru_.splice(lru_.begin(), lru_, entry.lru);
+}
+
+void FrameStore::removeFiles(uint64_t hash, size_t levels) {
+    // 已映射的文件在 unlink 后仍然可读，使用中的 Mat 不受影响
+    for (size_t i = 0; i < levels; ++i) unlink(pathFor(hash, (int)i).c_str());
+}
+
+void FrameStore::evictLocked() {
+    while (bytes_ > capacity_ && !lru_.empty()) {
+        uint64_t hash = lru_.back();
+        auto it = entries_.find(hash);
+        removeFiles(hash, it->second.levels.size());
+        bytes_ -= it->second.bytes;
+        lru_.pop_back();
+        entries_.erase(it);
+        evictions_++;
+    }
+}
+
+// =======================================================
+// 启动扫描：只信任头部校验通过、且层级从 0 开始连续的条目
+// =======================================================
+void FrameStore::scan() {
+    std::unordered_map<uint64_t, std::vector<std::pair<int, Level> > > byHash;
+    std::unordered_map<uint64_t, long long> mtimes;
+
+    DIR* top = opendir(root_.c_str());
+    if (!top) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        scanned_ = true;
+        return;
+    }
+    while (struct dirent* shard = readdir(top)) {
+        if (shard->d_name[0] == '.') continue;
+        std::string dir = root_ + "/" + shard->d_name;
+        DIR* d = opendir(dir.c_str());
+        if (!d) continue;
+        while (struct dirent* e = readdir(d)) {
+            std::string name = e->d_name;
+            if (name[0] == '.') continue;
+            std::string path = dir + "/" + name;
+            unsigned long long hash = 0;
+            int level = -1;
+            char suffix[8] = { 0 };
+            // 只清理缓存自己写出的文件 (*.frame 与 *.frame.<pid>.tmp)，目录里其它文件一律不碰
+            if (hasSuffix(name, ".tmp")) {
+                struct stat st;
+                if (name.find(".frame.") != std::string::npos &&
+                    stat(path.c_str(), &st) == 0 && time(nullptr) - st.st_mtime > kStaleTmpSeconds) unlink(path.c_str());
+                continue;
+            }
+            if (!hasSuffix(name, ".frame")) continue;
+            if (sscanf(name.c_str(), "%16llx.L%d.%7s", &hash, &level, suffix) != 3 || strcmp(suffix, "frame") != 0) {
+                unlink(path.c_str());
+                continue;
+            }
+
+            FrameHeader h;
+            struct stat st;
+            int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+            bool ok = fd >= 0 && fstat(fd, &st) == 0 && pread(fd, &h, sizeof(h), 0) == (ssize_t)sizeof(h) &&
+                validHeader(h, hash, level, st.st_size);
+            if (fd >= 0) close(fd);
+            if (!ok) {
+                unlink(path.c_str());
+                continue;
+            }
+            Level l = { h.rows, h.cols, (size_t)st.st_size };
+            byHash[hash].push_back(std::make_pair(level, l));
+            long long mtime = (long long)st.st_mtim.tv_sec;
+            if (mtime > mtimes[hash]) mtimes[hash] = mtime;
+        }
+        closedir(d);
+    }
+    closedir(top);
+
+    std::vector<std::pair<long long, uint64_t> > order;
+    for (auto& kv : byHash) order.push_back(std::make_pair(mtimes[kv.first], kv.first));
+    std::sort(order.begin(), order.end());
+
+    // 按 mtime 从新到旧插入到 LRU 尾部，超出容量的旧条目随之淘汰
+    for (auto it = order.rbegin(); it != order.rend(); ++it) {
+        uint64_t hash = it->second;
+        auto& found = byHash[hash];
+        std::sort(found.begin(), found.end(), [](const std::pair<int, Level>& a, const std::pair<int, Level>& b) { return a.first < b.first; });
+        std::vector<Level> levels;
+        for (const auto& f : found) {
+            if (f.first != (int)levels.size()) break;
+            levels.push_back(f.second);
+        }
+        if (levels.size() != found.size()) {
+            for (const auto& f : found) unlink(pathFor(hash, f.first).c_str());
+            continue;
+        }
+        insert(hash, levels, false);
+    }
+
+    // 快照中记录、但磁盘上已不存在的条目
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (auto it = entries_.begin(); it != entries_.end();) {
+        if (byHash.count(it->first)) {
+            ++it;
+            continue;
+        }
+        bytes_ -= it->second.bytes;
+        lru_.erase(it->second.lru);
+        it = entries_.erase(it);
+    }
+    scanned_ = true;
+    std::cerr << "[INFO] Frame store " << root_ << ": " << entries_.size() << " entries, " << (bytes_ >> 20) << " MB" << std::endl;
+}
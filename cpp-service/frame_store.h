@@ -0,0 +1,108 @@
+#pragma once
+// =======================================================
+// 解码帧磁盘缓存 (ImageCache 的第二层)
+// - 以文件内容哈希为键，保存解码后的原始像素及其金字塔层级 (逐级减半)；
+//   文件头同时记录原文件长度与 SHA-256，命中时必须一致，哈希碰撞不会返回别人的像素
+// - 每个层级一个文件：固定头 + 按页对齐的像素数据，命中时直接 mmap 为 Mat，无需解码
+// - 写入采用 临时文件 + fdatasync + rename + 目录 fsync，启动后由写入线程在后台扫描目录重建索引，
+//   校验失败的文件直接删除，残留的临时文件 (按进程命名) 超过 10 分钟后删除，
+//   因此进程崩溃不会留下损坏的条目。
+//   扫描完成前可先从索引快照恢复 (见 cache_snapshot.h)
+// - 按总字节数做 LRU 淘汰 (以文件 mtime 记录最近访问，重启后顺序不丢失)
+// =======================================================
+#include "bounded_queue.h"
+#include "image_cache.h"
+#include <atomic>
+#include <cstdint>
+#include <list>
+#include <mutex>
+#include <opencv2/opencv.hpp>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+struct FrameStoreStats {
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t writes;
+    uint64_t dropped;   // 写入队列已满而放弃的帧
+    uint64_t evictions;
+    size_t entries;
+    size_t bytes;
+};
+
+class SnapshotReader;
+class SnapshotWriter;
+
+class FrameStore {
+public:
+    // capacityBytes 为 0 时关闭磁盘缓存
+    FrameStore(const std::string& root, size_t capacityBytes);
+    ~FrameStore();
+
+    bool enabled() const { return enabled_; }
+    // 运行中调整容量 (超出部分立即淘汰)；启动时关闭的缓存不能在运行中开启
+    bool setCapacity(size_t capacityBytes);
+
+    // 读取层级 0 (原始分辨率)。返回的 Mat 映射自缓存文件 (MAP_PRIVATE)，与 ImageCache 一样视为只读
+    cv::Mat load(const ContentKey& key);
+    // 返回最长边不小于 minSide 的最小层级；没有缓存时返回空 Mat
+    cv::Mat loadAtLeast(const ContentKey& key, int minSide);
+
+    // 异步写入帧及其金字塔，由后台低优先级线程完成；队列已满时丢弃
+    void storeAsync(const ContentKey& key, const cv::Mat& frame);
+
+    FrameStoreStats stats() const;
+
+    // 索引快照：按 LRU 顺序 (最近使用在前) 写出。恢复时追加到 LRU 尾部，已有条目不覆盖；
+    // 目录扫描完成后不再恢复。文件在 mmap 时仍会校验头部，快照过期只会造成一次未命中
+    void saveIndex(SnapshotWriter& out) const;
+    size_t restoreIndex(SnapshotReader& in);
+
+private:
+    struct Level {
+        int rows;
+        int cols;
+        size_t fileBytes;
+    };
+    struct Entry {
+        std::vector<Level> levels;
+        size_t bytes;
+        std::list<uint64_t>::iterator lru;
+    };
+    struct WriteJob {
+        ContentKey key;
+        cv::Mat frame;
+    };
+
+    std::string pathFor(uint64_t hash, int level) const;
+    cv::Mat mapLevel(const ContentKey& key, int level);
+    bool writeLevel(const ContentKey& key, int level, const cv::Mat& frame, size_t& fileBytes);
+    void scan();
+    void writerLoop();
+    void insert(uint64_t hash, const std::vector<Level>& levels, bool newest);
+    void insertLocked(uint64_t hash, const std::vector<Level>& levels, bool newest);
+    void touchLocked(Entry& entry);
+    void evictLocked();
+    void removeFiles(uint64_t hash, size_t levels);
+
+    const std::string root_;
+    const bool enabled_;
+    size_t capacity_;
+
+    mutable std::mutex mutex_;
+    std::unordered_map<uint64_t, Entry> entries_;
+    std::list<uint64_t> lru_; // 前端为最近使用
+    size_t bytes_;
+    bool scanned_;
+
+    std::atomic<uint64_t> hits_;
+    std::atomic<uint64_t> misses_;
+    std::atomic<uint64_t> writes_;
+    std::atomic<uint64_t> dropped_;
+    std::atomic<uint64_t> evictions_;
+
+    BoundedQueue<WriteJob> queue_;
+    std::thread writer_;
+};
@@ -0,0 +1,281 @@
+#include "hot_restart.h"
+#include <cerrno>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <iostream>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+static const uint32_t kHandoffMagic = 0x4c544e53; // "SNTL"
+static const char kTakeoverRequest[] = "TAKEOVER\n";
+static const char kReady = 'R';
+// 新进程迟迟不回复 READY 时放弃交接，旧进程继续服务
+static const int kReadyTimeoutMs = 120000;
+
+// =======================================================
+// HandoffServer
+// =======================================================
+HandoffServer::HandoffServer() : detachedFd_(-1) {
+    // 默认 accept 会一直阻塞；设置空闲间隔后 accept 循环会定期检查 svr_sock_，
+    // stopAccepting() 才能在不 shutdown 共享 socket 的情况下结束循环
+    set_idle_interval(0, 200000);
+}
+
+HandoffServer::~HandoffServer() {
+    int fd = detachedFd_.exchange(-1);
+    if (fd >= 0) close(fd);
+}
+
+static void setNonBlocking(int fd) {
+    int flags = fcntl(fd, F_GETFL);
+    if (flags >= 0 && !(flags & O_NONBLOCK)) fcntl(fd, F_SETFL, flags | O_NONBLOCK);
+}
+
+void HandoffServer::adoptListeningSocket(int fd) {
+    setNonBlocking(fd);
+    svr_sock_ = fd;
+}
+
+void HandoffServer::stopAccepting() {
+    // 先把 fd 保存下来再置为无效：httplib 的 stop() 会 shutdown 监听 socket，
+    // 那会连同新进程一起停止服务。fd 在对象析构时才关闭，避免编号被复用
+    int fd = svr_sock_.exchange(INVALID_SOCKET);
+    if (fd != INVALID_SOCKET) detachedFd_ = fd;
+}
+
+// =======================================================
+// 公共工具
+// =======================================================
+static bool writeAll(int fd, const void* data, size_t size) {
+    const char* p = (const char*)data;
+    while (size > 0) {
+        ssize_t n = send(fd, p, size, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return false;
+        p += n;
+        size -= (size_t)n;
+    }
+    return true;
+}
+
+static bool readAll(int fd, void* data, size_t size) {
+    char* p = (char*)data;
+    while (size > 0) {
+        ssize_t n = recv(fd, p, size, 0);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return false;
+        p += n;
+        size -= (size_t)n;
+    }
+    return true;
+}
+
+// 对端必须与本进程属于同一用户
+static bool trustedPeer(int fd) {
+    ucred cred;
+    socklen_t len = sizeof(cred);
+    return getsockopt(fd, SOL_SOCKET, SO_PEERCRED, &cred, &len) == 0 && cred.uid == geteuid();
+}
+
+std::string defaultHandoffSocketPath(std::string& error) {
+    const char* runtime = std::getenv("XDG_RUNTIME_DIR");
+    std::string dir = runtime && *runtime ? std::string(runtime) + "/sentinel" : "/tmp/sentinel-" + std::to_string(geteuid());
+    if (mkdir(dir.c_str(), 0700) != 0 && errno != EEXIST) {
+        error = "无法创建目录 " + dir + ": " + strerror(errno);
+        return "";
+    }
+    // lstat：不跟随符号链接，防止被指向其他用户控制的目录
+    struct stat st;
+    if (lstat(dir.c_str(), &st) != 0 || !S_ISDIR(st.st_mode) || st.st_uid != geteuid() || (st.st_mode & 077) != 0) {
+        error = "目录 " + dir + " 不属于当前用户或权限不是 0700";
+        return "";
+    }
+    return dir + "/handoff.sock";
+}
+
+static bool unixAddress(const std::string& path, sockaddr_un& addr) {
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    // 空路径会落到抽象命名空间，不受目录权限保护
+    if (path.empty() || path.size() >= sizeof(addr.sun_path)) return false;
+    memcpy(addr.sun_path, path.c_str(), path.size());
+    return true;
+}
+
+// =======================================================
+// 新进程侧
+// =======================================================
+bool receiveHandoff(const std::string& socketPath, HandoffState& out, std::string& error) {
+    sockaddr_un addr;
+    if (!unixAddress(socketPath, addr)) {
+        error = "Unix socket 路径无效: " + socketPath;
+        return false;
+    }
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0 || connect(fd, (sockaddr*)&addr, sizeof(addr)) != 0) {
+        error = "无法连接旧进程 " + socketPath + ": " + strerror(errno);
+        if (fd >= 0) close(fd);
+        return false;
+    }
+    if (!trustedPeer(fd)) {
+        error = "交接 socket 的对端不是当前用户的进程: " + socketPath;
+        close(fd);
+        return false;
+    }
+    if (!writeAll(fd, kTakeoverRequest, sizeof(kTakeoverRequest) - 1)) {
+        error = "发送交接请求失败";
+        close(fd);
+        return false;
+    }
+
+    uint32_t header[2];
+    char control[CMSG_SPACE(sizeof(int))];
+    iovec iov = { header, sizeof(header) };
+    msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+    ssize_t n;
+    do {
+        n = recvmsg(fd, &msg, MSG_CMSG_CLOEXEC | MSG_WAITALL);
+    } while (n < 0 && errno == EINTR);
+
+    int listenFd = -1;
+    for (cmsghdr* c = CMSG_FIRSTHDR(&msg); c; c = CMSG_NXTHDR(&msg, c)) {
+        if (c->cmsg_level == SOL_SOCKET && c->cmsg_type == SCM_RIGHTS) memcpy(&listenFd, CMSG_DATA(c), sizeof(int));
+    }
+    if (n != (ssize_t)sizeof(header) || header[0] != kHandoffMagic || listenFd < 0) {
+        error = "旧进程的交接应答无效";
+        if (listenFd >= 0) close(listenFd);
+        close(fd);
+        return false;
+    }
+
+    std::string state(header[1], '\0');
+    if (header[1] > 0 && !readAll(fd, &state[0], state.size())) {
+        error = "读取预热状态失败";
+        close(listenFd);
+        close(fd);
+        return false;
+    }
+    out.listenFd = listenFd;
+    out.warmState.swap(state);
+    out.channel = fd;
+    return true;
+}
+
+void confirmHandoff(HandoffState& state) {
+    if (state.channel < 0) return;
+    if (!writeAll(state.channel, &kReady, 1)) {
+        std::cerr << "[HANDOFF] 通知旧进程失败 (旧进程可能已退出)" << std::endl;
+    }
+}
+
+void waitForDonorExit(HandoffState& state) {
+    if (state.channel < 0) return;
+    char c;
+    while (true) {
+        ssize_t n = recv(state.channel, &c, 1, 0);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) break;
+    }
+    close(state.channel);
+    state.channel = -1;
+}
+
+// =======================================================
+// 旧进程侧
+// =======================================================
+HandoffDonor::HandoffDonor(const std::string& socketPath, int listenFd, StateExporter exportState, ReadyCallback onReady)
+    : socketPath_(socketPath), listenFd_(listenFd), exportState_(exportState), onReady_(onReady), serverFd_(-1) {
+    sockaddr_un addr;
+    if (!unixAddress(socketPath_, addr)) {
+        std::cerr << "[HANDOFF] Unix socket 路径无效，热重启不可用: " << socketPath_ << std::endl;
+        return;
+    }
+    serverFd_ = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    // 旧进程 (若有) 在交接完成前一直持有自己的监听 socket；这里只替换路径，
+    // 之后的新进程会连到本进程
+    unlink(socketPath_.c_str());
+    // 目录本身已是 0700，socket 文件再收紧一次，兼容通过环境变量指定的路径
+    mode_t oldMask = umask(077);
+    bool bound = serverFd_ >= 0 && bind(serverFd_, (sockaddr*)&addr, sizeof(addr)) == 0;
+    umask(oldMask);
+    if (!bound || listen(serverFd_, 1) != 0) {
+        std::cerr << "[HANDOFF] 无法监听 " << socketPath_ << ": " << strerror(errno) << std::endl;
+        if (serverFd_ >= 0) close(serverFd_);
+        serverFd_ = -1;
+        return;
+    }
+    thread_ = std::thread(&HandoffDonor::run, this);
+}
+
+HandoffDonor::~HandoffDonor() {
+    if (serverFd_ >= 0) shutdown(serverFd_, SHUT_RDWR);
+    if (thread_.joinable()) thread_.join();
+    if (serverFd_ >= 0) close(serverFd_);
+}
+
+void HandoffDonor::run() {
+    while (true) {
+        int conn = accept4(serverFd_, nullptr, nullptr, SOCK_CLOEXEC);
+        if (conn < 0) {
+            if (errno == EINTR || errno == ECONNABORTED) continue;
+            return; // 析构时 shutdown
+        }
+        if (serve(conn)) {
+            // 连接保持到进程退出，新进程据此得知旧进程何时释放了端口
+            return;
+        }
+        close(conn);
+    }
+}
+
+bool HandoffDonor::serve(int conn) {
+    if (!trustedPeer(conn)) {
+        std::cerr << "[HANDOFF] 拒绝其他用户的交接请求" << std::endl;
+        return false;
+    }
+    // 交出之后两个进程共享同一个打开的文件描述，非阻塞标志对双方同时生效
+    setNonBlocking(listenFd_);
+    char request[sizeof(kTakeoverRequest) - 1];
+    if (!readAll(conn, request, sizeof(request)) || memcmp(request, kTakeoverRequest, sizeof(request)) != 0) return false;
+
+    std::string state = exportState_ ? exportState_() : std::string();
+    uint32_t header[2] = { kHandoffMagic, (uint32_t)state.size() };
+    char control[CMSG_SPACE(sizeof(int))];
+    memset(control, 0, sizeof(control));
+    iovec iov = { header, sizeof(header) };
+    msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+    cmsghdr* c = CMSG_FIRSTHDR(&msg);
+    c->cmsg_level = SOL_SOCKET;
+    c->cmsg_type = SCM_RIGHTS;
+    c->cmsg_len = CMSG_LEN(sizeof(int));
+    memcpy(CMSG_DATA(c), &listenFd_, sizeof(int));
+    if (sendmsg(conn, &msg, MSG_NOSIGNAL) != (ssize_t)sizeof(header)) return false;
+    if (!state.empty() && !writeAll(conn, state.data(), state.size())) return false;
+
+    // 新进程启动期间本进程照常 accept；收到 READY 后才停止
+    pollfd pfd = { conn, POLLIN, 0 };
+    if (poll(&pfd, 1, kReadyTimeoutMs) <= 0) {
+        std::cerr << "[HANDOFF] 新进程未在超时前就绪，继续服务" << std::endl;
+        return false;
+    }
+    char ready = 0;
+    if (!readAll(conn, &ready, 1) || ready != kReady) return false;
+    std::cout << "[HANDOFF] 新进程已接管监听 socket，停止 accept 并排空在途请求" << std::endl;
+    if (onReady_) onReady_();
+    return true;
+}
@@ -0,0 +1,82 @@
+#pragma once
+// =======================================================
+// 热重启：监听 socket 交接
+// 新进程以 --takeover 启动，通过 Unix socket 向旧进程索取监听 socket
+// (SCM_RIGHTS) 和预热状态；新进程就绪后回复 READY，旧进程随即停止 accept、
+// 处理完在途请求后退出。交接期间两个进程共享同一个监听 socket，
+// 内核队列中的连接不会丢失，也不会出现 ECONNREFUSED
+//
+//   旧进程                          新进程
+//   HandoffDonor 监听 ------------> receiveHandoff() 连接
+//   发送 fd + 状态 ---------------> 接管 fd，接管 Unix socket 路径
+//   stopAccepting() <------------- confirmHandoff() 发送 READY
+//   排空在途请求，退出 -----------> EOF：旧进程已退出 (释放 9100 等端口)
+//
+// 共享的监听 socket 设为非阻塞：两个进程同时被唤醒时，没抢到连接的一方 accept
+// 返回 EAGAIN 而不是一直阻塞，旧进程因此总能回到循环检查并退出。
+// 交接 socket 放在只有本用户可访问的目录 (0700) 中，双方都用 SO_PEERCRED
+// 确认对端是同一用户，其他本地用户无法抢先创建或冒充
+// =======================================================
+#include "lib/httplib.h"
+#include <atomic>
+#include <functional>
+#include <string>
+#include <thread>
+
+// 可接管已有监听 socket 的 httplib::Server
+class HandoffServer : public httplib::Server {
+public:
+    HandoffServer();
+
+    // 使用继承来的监听 socket，之后调用 listen_after_bind()
+    void adoptListeningSocket(int fd);
+    int listeningSocket() const { return svr_sock_; }
+
+    // 停止 accept 但不 shutdown 监听 socket (它已被新进程共享)；
+    // listen_after_bind() 在在途请求处理完后返回
+    void stopAccepting();
+    ~HandoffServer();
+
+private:
+    std::atomic<int> detachedFd_;
+};
+
+// 默认的交接 socket 路径：$XDG_RUNTIME_DIR/sentinel 或 /tmp/sentinel-<uid> 下的 handoff.sock。
+// 目录不存在时以 0700 创建；已存在但不属于当前用户或对其他用户开放时返回空串并在 error 中说明
+std::string defaultHandoffSocketPath(std::string& error);
+
+struct HandoffState {
+    int listenFd;
+    std::string warmState;  // 旧进程导出的预热数据 (不透明)
+    int channel;            // 与旧进程的连接，用于 READY 与等待其退出
+
+    HandoffState() : listenFd(-1), channel(-1) {}
+};
+
+// 新进程：连接旧进程并接收监听 socket；失败返回 false 并在 error 中说明
+bool receiveHandoff(const std::string& socketPath, HandoffState& out, std::string& error);
+// 新进程开始 accept 之后调用：通知旧进程停止 accept
+void confirmHandoff(HandoffState& state);
+// 阻塞直到旧进程退出 (连接被关闭)
+void waitForDonorExit(HandoffState& state);
+
+// 旧进程：在 socketPath 上等待下一次交接 (同一时间只处理一个新进程)
+class HandoffDonor {
+public:
+    typedef std::function<std::string()> StateExporter;
+    typedef std::function<void()> ReadyCallback;
+
+    HandoffDonor(const std::string& socketPath, int listenFd, StateExporter exportState, ReadyCallback onReady);
+    ~HandoffDonor();
+
+private:
+    void run();
+    bool serve(int conn);
+
+    const std::string socketPath_;
+    const int listenFd_;
+    StateExporter exportState_;
+    ReadyCallback onReady_;
+    int serverFd_;
+    std::thread thread_;
+};
@@ -0,0 +1,350 @@
+#include "image_cache.h"
+#include "file_utils.h"
+#include "frame_store.h"
+#include "image_decoder.h"
+#include "cache_snapshot.h"
+#include <algorithm>
+#include <cstring>
+#include <iterator>
+#include <openssl/sha.h>
+#include <sys/stat.h>
+
+using namespace cv;
+
+// =======================================================
+// 哈希
+// =======================================================
+static inline uint64_t mix64(uint64_t x) {
+    x ^= x >> 33;
+    x *= 0xff51afd7ed558ccdULL;
+    x ^= x >> 33;
+    x *= 0xc4ceb9fe1a85ec53ULL;
+    x ^= x >> 33;
+    return x;
+}
+
+uint64_t contentHash64(const unsigned char* data, size_t size) {
+    const uint64_t kMul = 0x9E3779B97F4A7C15ULL;
+    uint64_t h = size * kMul;
+    size_t i = 0;
+    for (; i + 8 <= size; i += 8) {
+        uint64_t word;
+        memcpy(&word, data + i, 8);
+        h = (h ^ mix64(word)) * kMul;
+    }
+    uint64_t tail = 0;
+    for (size_t k = 0; i + k < size; ++k) tail |= (uint64_t)data[i + k] << (8 * k);
+    h = (h ^ mix64(tail)) * kMul;
+    return mix64(h);
+}
+
+ContentKey contentKeyOf(const unsigned char* data, size_t size) {
+    ContentKey key;
+    key.hash = contentHash64(data, size);
+    key.size = size;
+    SHA256(data, size, key.digest);
+    return key;
+}
+
+uint64_t perceptualHash64(const Mat& img) {
+    Mat gray, small;
+    if (img.channels() == 3) cvtColor(img, gray, COLOR_BGR2GRAY);
+    else gray = img;
+    resize(gray, small, Size(9, 8), 0, 0, INTER_AREA);
+    uint64_t hash = 0;
+    for (int y = 0; y < 8; ++y) {
+        const uchar* row = small.ptr<uchar>(y);
+        for (int x = 0; x < 8; ++x) {
+            hash = (hash << 1) | (row[x] < row[x + 1] ? 1 : 0);
+        }
+    }
+    return hash;
+}
+
+// =======================================================
+// LRU 缓存
+// =======================================================
+// 仅含元数据的条目不计入字节数，另设条目数上限
+static const size_t kMaxEntries = 100000;
+
+static size_t matBytes(const Mat& m) { return m.empty() ? 0 : m.total() * m.elemSize(); }
+
+ImageCache::ImageCache(size_t capacityBytes) : capacity_(capacityBytes), bytes_(0), frameStore_(nullptr), hits_(0), misses_(0) {}
+
+bool ImageCache::statFile(const std::string& path, FileStamp& stamp) {
+    struct stat st;
+    if (stat(path.c_str(), &st) != 0) return false;
+    stamp.mtimeNs = (long long)st.st_mtim.tv_sec * 1000000000LL + st.st_mtim.tv_nsec;
+    stamp.size = st.st_size;
+    return true;
+}
+
+Mat ImageCache::load(const std::string& path) {
+    FileStamp stamp;
+    if (!statFile(path, stamp)) return Mat();
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = entries_.find(path);
+        if (it != entries_.end() && it->second.stamp == stamp && !it->second.image.pixels.empty()) {
+            lru_.splice(lru_.begin(), lru_, it->second.lru);
+            hits_++;
+            return it->second.image.pixels;
+        }
+    }
+
+    misses_++;
+    CachedImage info;
+    if (frameStore_ && frameStore_->enabled()) {
+        std::vector<uchar> bytes;
+        if (!readFile(path, bytes)) return Mat();
+        info.content = contentKeyOf(bytes.data(), bytes.size());
+        info.hasContentHash = true;
+        info.pixels = decode(bytes, info.content);
+    }
+    else {
+        info.pixels = decodeImageFile(path);
+    }
+    if (info.pixels.empty()) return Mat();
+
+    merge(path, info);
+    return info.pixels;
+}
+
+Mat ImageCache::loadAtLeast(const std::string& path, int minSide) {
+    CachedImage cached;
+    bool known = lookup(path, cached);
+    if (known && !cached.pixels.empty()) {
+        hits_++;
+        return cached.pixels;
+    }
+    if (!frameStore_ || !frameStore_->enabled()) return load(path);
+
+    if (!known || !cached.hasContentHash) {
+        std::vector<uchar> bytes;
+        if (!readFile(path, bytes)) return Mat();
+        cached.content = contentKeyOf(bytes.data(), bytes.size());
+    }
+    // 缩小的层级不放入内存缓存，避免与全尺寸帧混淆
+    Mat level = frameStore_->loadAtLeast(cached.content, minSide);
+    return level.empty() ? load(path) : level;
+}
+
+Mat ImageCache::loadRegion(const std::string& path, Rect& roi) {
+    CachedImage cached;
+    if (lookup(path, cached) && !cached.pixels.empty()) {
+        hits_++;
+        roi = roi & Rect(0, 0, cached.pixels.cols, cached.pixels.rows);
+        return roi.empty() ? Mat() : cached.pixels(roi);
+    }
+    misses_++;
+    std::vector<uchar> bytes;
+    if (!readFile(path, bytes)) return Mat();
+    return decodeImageRegion(bytes, roi);
+}
+
+bool ImageCache::isJpeg(const std::string& path) {
+    CachedImage cached;
+    if (lookup(path, cached) && cached.probe.valid()) return cached.probe.format == "jpeg";
+    return probeImageFile(path).format == "jpeg";
+}
+
+Mat ImageCache::loadLuma(const std::string& path, int minSide) {
+    if (isJpeg(path)) {
+        // JPEG 直接解码 Y 分量，不经过内存缓存
+        misses_++;
+        std::vector<uchar> bytes;
+        if (!readFile(path, bytes)) return Mat();
+        return decodeImageLuma(bytes, minSide);
+    }
+    Mat color = minSide > 0 ? loadAtLeast(path, minSide) : load(path);
+    if (color.empty()) return Mat();
+    Mat gray;
+    cvtColor(color, gray, COLOR_BGR2GRAY);
+    return gray;
+}
+
+Mat ImageCache::loadRegionLuma(const std::string& path, Rect& roi) {
+    if (isJpeg(path)) {
+        // JPEG 直接解码 Y 分量，不经过内存缓存
+        misses_++;
+        std::vector<uchar> bytes;
+        if (!readFile(path, bytes)) return Mat();
+        return decodeImageRegionLuma(bytes, roi);
+    }
+    Mat color = loadRegion(path, roi);
+    if (color.empty()) return Mat();
+    Mat gray;
+    cvtColor(color, gray, COLOR_BGR2GRAY);
+    return gray;
+}
+
+Mat ImageCache::decode(const std::vector<uchar>& bytes, const ContentKey& key) {
+    if (frameStore_) {
+        Mat mapped = frameStore_->load(key);
+        if (!mapped.empty()) return mapped;
+    }
+    Mat img = decodeImage(bytes);
+    if (frameStore_ && !img.empty()) frameStore_->storeAsync(key, img);
+    return img;
+}
+
+bool ImageCache::lookup(const std::string& path, CachedImage& out) {
+    FileStamp stamp;
+    if (!statFile(path, stamp)) return false;
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = entries_.find(path);
+    if (it == entries_.end()) return false;
+    if (!(it->second.stamp == stamp)) {
+        eraseLocked(it);
+        return false;
+    }
+    lru_.splice(lru_.begin(), lru_, it->second.lru);
+    out = it->second.image;
+    return true;
+}
+
+void ImageCache::merge(const std::string& path, const CachedImage& info) {
+    FileStamp stamp;
+    if (!statFile(path, stamp)) return;
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = entries_.find(path);
+    if (it != entries_.end() && !(it->second.stamp == stamp)) {
+        eraseLocked(it);
+        it = entries_.end();
+    }
+    if (it == entries_.end()) {
+        lru_.push_front(path);
+        Entry entry;
+        entry.stamp = stamp;
+        entry.lru = lru_.begin();
+        it = entries_.insert(std::make_pair(path, entry)).first;
+    }
+    else {
+        lru_.splice(lru_.begin(), lru_, it->second.lru);
+    }
+
+    CachedImage& dst = it->second.image;
+    if (!info.pixels.empty()) {
+        bytes_ -= matBytes(dst.pixels);
+        dst.pixels = info.pixels;
+        bytes_ += matBytes(dst.pixels);
+    }
+    if (info.probe.valid()) dst.probe = info.probe;
+    if (info.hasContentHash) {
+        dst.content = info.content;
+        dst.hasContentHash = true;
+    }
+    if (info.hasPerceptualHash) {
+        dst.perceptualHash = info.perceptualHash;
+        dst.hasPerceptualHash = true;
+    }
+    evictLocked();
+}
+
+void ImageCache::erase(const std::string& path) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = entries_.find(path);
+    if (it != entries_.end()) eraseLocked(it);
+}
+
+void ImageCache::setCapacity(size_t capacityBytes) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    capacity_ = capacityBytes;
+    evictLocked();
+}
+
+ImageCacheStats ImageCache::stats() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    ImageCacheStats s = { hits_.load(), misses_.load(), entries_.size(), bytes_ };
+    return s;
+}
+
+std::vector<std::string> ImageCache::recentDecoded(size_t limit) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::vector<std::string> out;
+    for (auto it = lru_.begin(); it != lru_.end() && out.size() < limit; ++it) {
+        if (!entries_.at(*it).image.pixels.empty()) out.push_back(*it);
+    }
+    return out;
+}
+
+// kSnapContentHash 为旧格式 (只有 64 位哈希)，恢复时跳过；新快照写 kSnapContentKey
+enum { kSnapContentHash = 1, kSnapPerceptualHash = 2, kSnapDecoded = 4, kSnapContentKey = 8 };
+
+void ImageCache::saveIndex(SnapshotWriter& out) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    out.putVarint(lru_.size());
+    for (const std::string& path : lru_) {
+        const Entry& entry = entries_.at(path);
+        const CachedImage& img = entry.image;
+        out.putString(path);
+        out.putVarint((uint64_t)entry.stamp.mtimeNs);
+        out.putVarint((uint64_t)entry.stamp.size);
+        out.putString(img.probe.format);
+        out.putVarint((uint64_t)std::max(0, img.probe.width));
+        out.putVarint((uint64_t)std::max(0, img.probe.height));
+        out.putVarint((img.hasContentHash ? kSnapContentKey : 0) | (img.hasPerceptualHash ? kSnapPerceptualHash : 0) |
+            (img.pixels.empty() ? 0 : kSnapDecoded));
+        if (img.hasContentHash) {
+            out.putU64(img.content.hash);
+            out.putVarint(img.content.size);
+            out.putString(std::string((const char*)img.content.digest, sizeof(img.content.digest)));
+        }
+        if (img.hasPerceptualHash) out.putU64(img.perceptualHash);
+    }
+}
+
+size_t ImageCache::restoreIndex(SnapshotReader& in, std::vector<std::string>& hotPaths) {
+    uint64_t count = 0;
+    if (!in.getVarint(count)) return 0;
+    size_t restored = 0;
+    for (uint64_t i = 0; i < count; ++i) {
+        std::string path, format;
+        uint64_t mtimeNs = 0, size = 0, width = 0, height = 0, flags = 0;
+        CachedImage img;
+        if (!in.getString(path) || !in.getVarint(mtimeNs) || !in.getVarint(size) || !in.getString(format) ||
+            !in.getVarint(width) || !in.getVarint(height) || !in.getVarint(flags)) break;
+        uint64_t legacyHash = 0;
+        std::string digest;
+        if ((flags & kSnapContentHash) && !in.getU64(legacyHash)) break;
+        if ((flags & kSnapContentKey) && (!in.getU64(img.content.hash) || !in.getVarint(img.content.size) ||
+            !in.getString(digest) || digest.size() != sizeof(img.content.digest))) break;
+        if ((flags & kSnapPerceptualHash) && !in.getU64(img.perceptualHash)) break;
+        if (flags & kSnapContentKey) memcpy(img.content.digest, digest.data(), digest.size());
+        img.hasContentHash = (flags & kSnapContentKey) != 0;
+        img.hasPerceptualHash = (flags & kSnapPerceptualHash) != 0;
+        img.probe.format = format;
+        img.probe.width = (int)width;
+        img.probe.height = (int)height;
+
+        // 文件在重启期间被替换或删除时丢弃该条目
+        FileStamp stamp;
+        if (!statFile(path, stamp) || stamp.mtimeNs != (long long)mtimeNs || stamp.size != (long long)size) continue;
+        if (flags & kSnapDecoded) hotPaths.push_back(path);
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (entries_.count(path) || entries_.size() >= kMaxEntries) continue;
+        lru_.push_back(path);
+        Entry entry;
+        entry.image = img;
+        entry.stamp = stamp;
+        entry.lru = std::prev(lru_.end());
+        entries_.insert(std::make_pair(path, entry));
+        restored++;
+    }
+    return restored;
+}
+
+void ImageCache::eraseLocked(std::unordered_map<std::string, Entry>::iterator it) {
+    bytes_ -= matBytes(it->second.image.pixels);
+    lru_.erase(it->second.lru);
+    entries_.erase(it);
+}
+
+void ImageCache::evictLocked() {
+    // 超出容量时从最久未使用的条目开始整体淘汰
+    while ((bytes_ > capacity_ || entries_.size() > kMaxEntries) && !lru_.empty()) {
+        auto it = entries_.find(lru_.back());
+        eraseLocked(it);
+    }
+}
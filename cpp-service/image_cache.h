@@ -0,0 +1,114 @@
+#pragma once
+// =======================================================
+// 解码结果缓存 (进程内 LRU)
+// 以文件路径为键，文件的 mtime / size 变化后自动失效。
+// 缓存中的 Mat 为只读共享数据，调用方需要修改时必须先 clone()
+// 可挂接 FrameStore 作为第二层：内存未命中时按内容哈希映射磁盘上的解码帧
+// =======================================================
+#include "image_probe.h"
+#include <atomic>
+#include <cstdint>
+#include <list>
+#include <mutex>
+#include <opencv2/opencv.hpp>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+class FrameStore;
+class SnapshotReader;
+class SnapshotWriter;
+
+// 64 位内容哈希 (每次处理 8 字节的乘法混合)，用于按内容识别重复图片
+uint64_t contentHash64(const unsigned char* data, size_t size);
+
+// 磁盘帧缓存的键：hash 只用于定位文件 (64 位，可能碰撞)，
+// 命中时还要核对原文件的长度与 SHA-256，不一致按未命中处理
+struct ContentKey {
+    uint64_t hash;
+    uint64_t size;
+    unsigned char digest[32];
+};
+ContentKey contentKeyOf(const unsigned char* data, size_t size);
+// dHash 感知哈希：9x8 灰度缩略图中相邻像素的大小关系
+uint64_t perceptualHash64(const cv::Mat& img);
+
+struct CachedImage {
+    cv::Mat pixels; // 可能为空 (只缓存了元数据)
+    ImageProbe probe;
+    ContentKey content;
+    uint64_t perceptualHash;
+    bool hasContentHash;
+    bool hasPerceptualHash;
+
+    CachedImage() : content(), perceptualHash(0), hasContentHash(false), hasPerceptualHash(false) {}
+};
+
+struct ImageCacheStats {
+    uint64_t hits;
+    uint64_t misses;
+    size_t entries;
+    size_t bytes;
+};
+
+class ImageCache {
+public:
+    explicit ImageCache(size_t capacityBytes);
+
+    // 读取解码后的 BGR 图像，命中时无需解码；失败返回空 Mat
+    cv::Mat load(const std::string& path);
+    // 只需要缩小图时使用：返回最长边不小于 minSide 的图像 (可能是磁盘上的金字塔层级)
+    cv::Mat loadAtLeast(const std::string& path, int minSide);
+    // 只需要 roi 区域时使用 (roi 裁剪到图像范围后写回)：已缓存时直接取子区域，
+    // 否则区域解码，结果不放入缓存
+    cv::Mat loadRegion(const std::string& path, cv::Rect& roi);
+    // 只需要亮度时使用。亮度来源只由格式决定，与缓存状态无关：
+    // JPEG 总是解 Y 分量 (不放入缓存)，其余格式经 load / loadAtLeast / loadRegion 取 BGR 再转灰度。
+    // minSide > 0 时可能返回较小的图 (最长边不小于 minSide)；roi 非空时只取该区域 (裁剪后写回)
+    cv::Mat loadLuma(const std::string& path, int minSide = 0);
+    cv::Mat loadRegionLuma(const std::string& path, cv::Rect& roi);
+    // 解码已读入内存的文件：先查磁盘帧缓存，未命中时解码并异步写入
+    cv::Mat decode(const std::vector<unsigned char>& bytes, const ContentKey& key);
+
+    bool lookup(const std::string& path, CachedImage& out);
+    // 合并写入：只覆盖 info 中已填充的字段
+    void merge(const std::string& path, const CachedImage& info);
+    void erase(const std::string& path);
+
+    void setCapacity(size_t capacityBytes);
+    void setFrameStore(FrameStore* store) { frameStore_ = store; }
+    ImageCacheStats stats() const;
+    // 最近使用且已解码的路径 (最新的在前)，热重启时交给新进程预热
+    std::vector<std::string> recentDecoded(size_t limit) const;
+
+    // 元数据快照 (不含像素)，按 LRU 顺序写出。恢复时只采用 mtime / size 未变的文件，
+    // 追加到 LRU 尾部、不覆盖已有条目；快照时已解码的路径按原顺序放入 hotPaths
+    void saveIndex(SnapshotWriter& out) const;
+    size_t restoreIndex(SnapshotReader& in, std::vector<std::string>& hotPaths);
+
+private:
+    struct FileStamp {
+        long long mtimeNs;
+        long long size;
+        bool operator==(const FileStamp& o) const { return mtimeNs == o.mtimeNs && size == o.size; }
+    };
+    struct Entry {
+        CachedImage image;
+        FileStamp stamp;
+        std::list<std::string>::iterator lru;
+    };
+
+    static bool statFile(const std::string& path, FileStamp& stamp);
+    bool isJpeg(const std::string& path);
+    void evictLocked();
+    void eraseLocked(std::unordered_map<std::string, Entry>::iterator it);
+
+    mutable std::mutex mutex_;
+    std::unordered_map<std::string, Entry> entries_;
+    std::list<std::string> lru_; // 前端为最近使用
+    size_t capacity_;
+    size_t bytes_;
+    FrameStore* frameStore_;
+    std::atomic<uint64_t> hits_;
+    std::atomic<uint64_t> misses_;
+};
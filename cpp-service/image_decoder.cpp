@@ -0,0 +1,309 @@
+#include "image_decoder.h"
+#include "file_utils.h"
+#include "png_decoder.h"
+#include <algorithm>
+#include <atomic>
+#include <csetjmp>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <jpeglib.h>
+
+using namespace cv;
+
+static std::atomic<bool> g_fastPng(true);
+// 抽样比对发现不一致后置位，配置热加载不会清除，直到进程重启
+static std::atomic<bool> g_fastPngTripped(false);
+static std::atomic<double> g_checkRate(0.0);
+static std::atomic<uint64_t> g_fastDecodes(0);
+static std::atomic<uint64_t> g_fallbackDecodes(0);
+static std::atomic<uint64_t> g_jpegRegions(0);
+static std::atomic<uint64_t> g_pngRegions(0);
+static std::atomic<uint64_t> g_jpegLuma(0);
+static std::atomic<uint64_t> g_checked(0);
+static std::atomic<uint64_t> g_mismatches(0);
+
+void setFastPngDecode(bool enabled) { g_fastPng = enabled; }
+
+static bool fastPngActive() {
+    return g_fastPng.load(std::memory_order_relaxed) && !g_fastPngTripped.load(std::memory_order_relaxed);
+}
+
+void setDecoderCheckRate(double rate) { g_checkRate = rate; }
+
+DecoderStats decoderStats() {
+    DecoderStats s = { g_fastDecodes.load(), g_fallbackDecodes.load(), g_jpegRegions.load(), g_pngRegions.load(),
+        g_jpegLuma.load(), g_checked.load(), g_mismatches.load(), fastPngActive(), g_fastPngTripped.load() };
+    return s;
+}
+
+static bool sampleCheck() {
+    double rate = g_checkRate.load(std::memory_order_relaxed);
+    if (rate <= 0) return false;
+    thread_local std::mt19937 rng(std::random_device{}());
+    return std::uniform_real_distribution<double>(0.0, 1.0)(rng) < rate;
+}
+
+static bool identical(const Mat& a, const Mat& b) {
+    if (a.rows != b.rows || a.cols != b.cols || a.type() != b.type()) return false;
+    for (int y = 0; y < a.rows; ++y) {
+        if (memcmp(a.ptr(y), b.ptr(y), a.cols * a.elemSize()) != 0) return false;
+    }
+    return true;
+}
+
+static bool decodeFastPng(const std::vector<uchar>& bytes, Mat& out) {
+    PngHeader header;
+    bool supported;
+    if (!readPngHeader(bytes.data(), bytes.size(), header, supported) || !supported) return false;
+    Mat img(header.height, header.width, CV_8UC3);
+    if (!decodePngBgr(bytes.data(), bytes.size(), img.data, img.step)) return false;
+    out = img;
+    return true;
+}
+
+// 抽样比对：reference 为 OpenCV 对同一范围的解码结果，不一致时关闭快速路径
+static bool matchesReference(const Mat& fast, const Mat& reference) {
+    g_checked++;
+    if (identical(fast, reference)) return true;
+    g_mismatches++;
+    g_fastPngTripped = true;
+    std::cerr << "[DECODER] 快速 PNG 解码结果与 OpenCV 不一致，已关闭快速路径 (重启前不再开启)" << std::endl;
+    return false;
+}
+
+Mat decodeImage(const std::vector<uchar>& bytes) {
+    Mat img;
+    if (fastPngActive() && isPngSignature(bytes.data(), bytes.size()) && decodeFastPng(bytes, img)) {
+        g_fastDecodes++;
+        if (!sampleCheck()) return img;
+        Mat reference = imdecode(bytes, IMREAD_COLOR);
+        return matchesReference(img, reference) ? img : reference;
+    }
+    g_fallbackDecodes++;
+    return imdecode(bytes, IMREAD_COLOR);
+}
+
+Mat decodeImageFile(const std::string& path) {
+    std::vector<uchar> bytes;
+    if (!readFile(path, bytes)) return Mat();
+    return decodeImage(bytes);
+}
+
+// =======================================================
+// 区域解码
+// =======================================================
+static bool isJpegSignature(const std::vector<uchar>& bytes) {
+    return bytes.size() >= 3 && bytes[0] == 0xFF && bytes[1] == 0xD8 && bytes[2] == 0xFF;
+}
+
+struct JpegErrorManager {
+    jpeg_error_mgr pub;
+    jmp_buf jump;
+};
+
+static void onJpegError(j_common_ptr cinfo) {
+    longjmp(((JpegErrorManager*)cinfo->err)->jump, 1);
+}
+
+static void ignoreJpegMessage(j_common_ptr) {}
+
+// APP1 中 EXIF IFD0 的 Orientation (0x0112)，没有时返回 1。
+// imdecode 会按方向旋转，ROI 坐标以旋转后的图像为准，方向不为 1 时只能完整解码
+static int jpegOrientation(j_decompress_ptr cinfo) {
+    for (jpeg_saved_marker_ptr m = cinfo->marker_list; m; m = m->next) {
+        if (m->marker != JPEG_APP0 + 1 || m->data_length < 14 || memcmp(m->data, "Exif\0\0", 6) != 0) continue;
+        const uint8_t* tiff = m->data + 6;
+        size_t size = m->data_length - 6;
+        bool little = tiff[0] == 'I';
+        auto read16 = [&](size_t at) { return little ? (tiff[at] | tiff[at + 1] << 8) : (tiff[at] << 8 | tiff[at + 1]); };
+        auto read32 = [&](size_t at) {
+            return little ? ((uint32_t)read16(at) | (uint32_t)read16(at + 2) << 16) : ((uint32_t)read16(at) << 16 | (uint32_t)read16(at + 2));
+        };
+        size_t ifd = read32(4);
+        if (ifd + 2 > size) return 1;
+        int entries = read16(ifd);
+        for (int i = 0; i < entries && ifd + 2 + (size_t)(i + 1) * 12 <= size; ++i) {
+            size_t entry = ifd + 2 + (size_t)i * 12;
+            if (read16(entry) == 0x0112) return read16(entry + 8);
+        }
+        return 1;
+    }
+    return 1;
+}
+
+// 成功时 roi 已裁剪到图像范围。luma 为 true 时只解 Y 分量，输出 CV_8UC1
+static bool decodeJpegRegion(const std::vector<uchar>& bytes, Rect& roi, Mat& out, bool luma) {
+    jpeg_decompress_struct cinfo;
+    JpegErrorManager err;
+    cinfo.err = jpeg_std_error(&err.pub);
+    err.pub.error_exit = onJpegError;
+    err.pub.output_message = ignoreJpegMessage;
+    // longjmp 会跳过其间构造的对象，需要析构的对象都在 setjmp 之前创建
+    std::vector<uint8_t> row;
+    Mat img;
+    if (setjmp(err.jump)) {
+        jpeg_destroy_decompress(&cinfo);
+        return false;
+    }
+    jpeg_create_decompress(&cinfo);
+    jpeg_mem_src(&cinfo, bytes.data(), (unsigned long)bytes.size());
+    jpeg_save_markers(&cinfo, JPEG_APP0 + 1, 0xFFFF);
+    jpeg_read_header(&cinfo, TRUE);
+    roi = roi & Rect(0, 0, (int)cinfo.image_width, (int)cinfo.image_height);
+    const bool supported = luma ? cinfo.jpeg_color_space == JCS_YCbCr || cinfo.jpeg_color_space == JCS_GRAYSCALE
+                                : cinfo.jpeg_color_space != JCS_CMYK && cinfo.jpeg_color_space != JCS_YCCK;
+    if (roi.empty() || jpegOrientation(&cinfo) != 1 || !supported) {
+        jpeg_destroy_decompress(&cinfo);
+        return false;
+    }
+    cinfo.out_color_space = luma ? JCS_GRAYSCALE : JCS_EXT_BGR;
+    const int channels = luma ? 1 : 3;
+    jpeg_start_decompress(&cinfo);
+
+    // 色度上采样 (fancy upsampling) 会参考相邻像素，裁剪与跳过的边界处结果与完整解码不同；
+    // 四周多解一个 iMCU 作为上下文，只取内部的 ROI，保证与 decodeImage 逐像素一致
+    const int marginX = cinfo.max_h_samp_factor * DCTSIZE;
+    const int marginY = cinfo.max_v_samp_factor * DCTSIZE;
+    const int x0 = std::max(0, roi.x - marginX);
+    const int x1 = std::min((int)cinfo.output_width, roi.x + roi.width + marginX);
+    const int y0 = std::max(0, roi.y - marginY);
+    // 起点对齐到 iMCU 边界，宽度随之扩大
+    JDIMENSION xoffset = (JDIMENSION)x0;
+    JDIMENSION width = (JDIMENSION)(x1 - x0);
+    jpeg_crop_scanline(&cinfo, &xoffset, &width);
+    if (y0 > 0 && jpeg_skip_scanlines(&cinfo, (JDIMENSION)y0) != (JDIMENSION)y0) {
+        jpeg_destroy_decompress(&cinfo);
+        return false;
+    }
+    row.resize((size_t)width * channels);
+    img.create(roi.height, roi.width, CV_8UC(channels));
+    const size_t skip = (size_t)(roi.x - (int)xoffset) * channels;
+    for (int y = y0; y < roi.y + roi.height; ++y) {
+        JSAMPROW rows[1] = { row.data() };
+        if (jpeg_read_scanlines(&cinfo, rows, 1) != 1) {
+            jpeg_destroy_decompress(&cinfo);
+            return false;
+        }
+        if (y >= roi.y) memcpy(img.ptr(y - roi.y), row.data() + skip, (size_t)roi.width * channels);
+    }
+    // ROI 之下的扫描线不再解码
+    jpeg_destroy_decompress(&cinfo);
+    out = img;
+    return true;
+}
+
+static bool decodePngRegion(const std::vector<uchar>& bytes, Rect& roi, Mat& out) {
+    PngHeader header;
+    bool supported;
+    if (!readPngHeader(bytes.data(), bytes.size(), header, supported) || !supported) return false;
+    Rect clipped = roi & Rect(0, 0, header.width, header.height);
+    if (clipped.empty()) return false;
+    Mat img(clipped.height, clipped.width, CV_8UC3);
+    if (!decodePngBgrRegion(bytes.data(), bytes.size(), clipped.x, clipped.y, clipped.width, clipped.height, img.data, img.step)) {
+        return false;
+    }
+    roi = clipped;
+    out = img;
+    return true;
+}
+
+Mat decodeImageRegion(const std::vector<uchar>& bytes, Rect& roi) {
+    Mat img;
+    Rect requested = roi;
+    if (isJpegSignature(bytes) && decodeJpegRegion(bytes, roi, img, false)) {
+        g_jpegRegions++;
+        return img;
+    }
+    roi = requested;
+    if (fastPngActive() && isPngSignature(bytes.data(), bytes.size()) && decodePngRegion(bytes, roi, img)) {
+        g_pngRegions++;
+        if (!sampleCheck()) return img;
+        // 区域解码同样参与抽样比对，参照为完整解码后裁剪出的同一区域
+        Mat full = imdecode(bytes, IMREAD_COLOR);
+        Rect bounds = roi & Rect(0, 0, full.cols, full.rows);
+        Mat reference = bounds.empty() ? Mat() : full(bounds).clone();
+        if (matchesReference(img, reference)) return img;
+        roi = bounds;
+        return reference;
+    }
+    Mat full = decodeImage(bytes);
+    roi = roi & Rect(0, 0, full.cols, full.rows);
+    if (roi.empty()) return Mat();
+    return full(roi).clone();
+}
+
+// =======================================================
+// 亮度解码
+// =======================================================
+static bool decodeJpegLuma(const std::vector<uchar>& bytes, int minSide, Mat& out) {
+    jpeg_decompress_struct cinfo;
+    JpegErrorManager err;
+    cinfo.err = jpeg_std_error(&err.pub);
+    err.pub.error_exit = onJpegError;
+    err.pub.output_message = ignoreJpegMessage;
+    Mat img;
+    if (setjmp(err.jump)) {
+        jpeg_destroy_decompress(&cinfo);
+        return false;
+    }
+    jpeg_create_decompress(&cinfo);
+    jpeg_mem_src(&cinfo, bytes.data(), (unsigned long)bytes.size());
+    jpeg_save_markers(&cinfo, JPEG_APP0 + 1, 0xFFFF);
+    jpeg_read_header(&cinfo, TRUE);
+    // YCbCr 输出灰度时 libjpeg 只解 Y 分量；CMYK / YCCK 没有亮度分量可取
+    if (jpegOrientation(&cinfo) != 1 || (cinfo.jpeg_color_space != JCS_YCbCr && cinfo.jpeg_color_space != JCS_GRAYSCALE)) {
+        jpeg_destroy_decompress(&cinfo);
+        return false;
+    }
+    cinfo.out_color_space = JCS_GRAYSCALE;
+    // 只需要缩小图时按 1/8 ~ 1/2 做 DCT 缩放，取最长边仍不小于 minSide 的最小比例
+    int denom = 1;
+    for (int d = 8; minSide > 0 && d > 1 && denom == 1; d /= 2) {
+        cinfo.scale_num = 1;
+        cinfo.scale_denom = d;
+        jpeg_calc_output_dimensions(&cinfo);
+        if ((int)std::max(cinfo.output_width, cinfo.output_height) >= minSide) denom = d;
+    }
+    cinfo.scale_num = 1;
+    cinfo.scale_denom = denom;
+    jpeg_start_decompress(&cinfo);
+    img.create((int)cinfo.output_height, (int)cinfo.output_width, CV_8UC1);
+    while (cinfo.output_scanline < cinfo.output_height) {
+        JSAMPROW rows[1] = { img.ptr((int)cinfo.output_scanline) };
+        if (jpeg_read_scanlines(&cinfo, rows, 1) != 1) {
+            jpeg_destroy_decompress(&cinfo);
+            return false;
+        }
+    }
+    jpeg_destroy_decompress(&cinfo);
+    out = img;
+    return true;
+}
+
+Mat decodeImageLuma(const std::vector<uchar>& bytes, int minSide) {
+    Mat img;
+    if (isJpegSignature(bytes) && decodeJpegLuma(bytes, minSide, img)) {
+        g_jpegLuma++;
+        return img;
+    }
+    Mat color = decodeImage(bytes);
+    if (color.empty()) return Mat();
+    cvtColor(color, img, COLOR_BGR2GRAY);
+    return img;
+}
+
+Mat decodeImageRegionLuma(const std::vector<uchar>& bytes, Rect& roi) {
+    Mat img;
+    Rect requested = roi;
+    if (isJpegSignature(bytes) && decodeJpegRegion(bytes, roi, img, true)) {
+        g_jpegRegions++;
+        return img;
+    }
+    roi = requested;
+    Mat color = decodeImageRegion(bytes, roi);
+    if (color.empty()) return Mat();
+    cvtColor(color, img, COLOR_BGR2GRAY);
+    return img;
+}
@@ -0,0 +1,51 @@
+#pragma once
+// =======================================================
+// 解码后端选择
+// 按文件头嗅探格式：PNG 优先走 png_decoder.h 的快速解码器，其余格式以及
+// 快速解码器不支持的 PNG (16 位、调色板、隔行 ...) 回退到 OpenCV。
+// 语义与 imdecode / imread 的 IMREAD_COLOR 相同 (8 位 BGR，失败返回空 Mat)。
+// 按 checkRate 抽样用 OpenCV 再解一次逐字节比对，不一致时返回 OpenCV 的结果
+// 并关闭快速路径直到进程重启 (配置热加载无法重新开启)。
+// 区域解码 (decodeImageRegion) 只解出覆盖 ROI 的部分：
+//   JPEG  libjpeg-turbo 跳过 ROI 之上的扫描线 (只做熵解码，不做 IDCT)，
+//         横向裁剪到覆盖 ROI 的 MCU 列，ROI 之下的数据不再读取
+//   PNG   快速解码器读到 ROI 最后一行即停止，只转换 ROI 内的列
+// 其余情况 (EXIF 方向不为 1、CMYK、快速解码器不支持的 PNG ...) 完整解码后裁剪。
+// 亮度解码 (decodeImageLuma / decodeImageRegionLuma) 供只看灰度的检测器使用：JPEG 直接输出 Y 分量，
+// 色度分量不做 IDCT、上采样与颜色转换；其余格式按 BGR 解码后转灰度
+// =======================================================
+#include <cstdint>
+#include <opencv2/opencv.hpp>
+#include <string>
+#include <vector>
+
+struct DecoderStats {
+    uint64_t fastPng;     // 快速 PNG 解码器完成的解码
+    uint64_t fallback;    // 交给 OpenCV 的解码
+    uint64_t jpegRegion;  // JPEG 区域解码
+    uint64_t pngRegion;   // PNG 区域解码
+    uint64_t jpegLuma;    // JPEG 亮度解码
+    uint64_t checked;     // 抽样比对次数
+    uint64_t mismatches;  // 比对不一致次数
+    bool fastPngEnabled;
+    bool fastPngTripped;  // 因比对不一致而关闭
+};
+
+cv::Mat decodeImage(const std::vector<uchar>& bytes);
+cv::Mat decodeImageFile(const std::string& path);
+
+// roi 先裁剪到图像范围内 (结果写回 roi)；与图像不相交或解码失败时返回空 Mat。
+// 返回的 Mat 与 decodeImage(bytes)(roi) 像素相同
+cv::Mat decodeImageRegion(const std::vector<uchar>& bytes, cv::Rect& roi);
+
+// 返回 CV_8UC1 亮度图，失败返回空 Mat。JPEG 的 Y 分量与 BGR 解码后 COLOR_BGR2GRAY
+// 的结果并不逐像素相同 (舍入；高饱和色在 RGB 截断处差异更大)，其余格式逐像素相同。
+// minSide > 0 时 JPEG 用 DCT 缩放解出最长边不小于 minSide 的较小图，其余格式仍为原尺寸
+cv::Mat decodeImageLuma(const std::vector<uchar>& bytes, int minSide = 0);
+// 区域版本，roi 的处理与 decodeImageRegion 相同
+cv::Mat decodeImageRegionLuma(const std::vector<uchar>& bytes, cv::Rect& roi);
+
+// 运行时配置 fastPngDecode / decoderCheckRate
+void setFastPngDecode(bool enabled);
+void setDecoderCheckRate(double rate);
+DecoderStats decoderStats();
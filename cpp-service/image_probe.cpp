@@ -0,0 +1,87 @@
+#include "image_probe.h"
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+static unsigned be16(const unsigned char* p) { return (p[0] << 8) | p[1]; }
+static unsigned be32(const unsigned char* p) { return ((unsigned)p[0] << 24) | (p[1] << 16) | (p[2] << 8) | p[3]; }
+static unsigned le16(const unsigned char* p) { return p[0] | (p[1] << 8); }
+static unsigned le24(const unsigned char* p) { return p[0] | (p[1] << 8) | (p[2] << 16); }
+static int le32s(const unsigned char* p) { return (int)(p[0] | (p[1] << 8) | (p[2] << 16) | ((unsigned)p[3] << 24)); }
+
+static void probeJpeg(const unsigned char* data, size_t size, ImageProbe& probe) {
+    probe.format = "jpeg";
+    size_t pos = 2;
+    while (pos + 4 <= size) {
+        if (data[pos] != 0xFF) return;
+        unsigned char marker = data[pos + 1];
+        if (marker == 0xFF) { ++pos; continue; }
+        // 无负载的标记
+        if (marker == 0xD8 || marker == 0x01 || (marker >= 0xD0 && marker <= 0xD7)) { pos += 2; continue; }
+        unsigned len = be16(data + pos + 2);
+        // SOF0-SOF15，排除 DHT(C4) / JPG(C8) / DAC(CC)
+        if (marker >= 0xC0 && marker <= 0xCF && marker != 0xC4 && marker != 0xC8 && marker != 0xCC) {
+            if (pos + 9 > size) return;
+            probe.height = be16(data + pos + 5);
+            probe.width = be16(data + pos + 7);
+            return;
+        }
+        if (marker == 0xDA) return; // 扫描数据开始仍未遇到 SOF
+        pos += 2 + len;
+    }
+}
+
+static void probeWebp(const unsigned char* data, size_t size, ImageProbe& probe) {
+    probe.format = "webp";
+    if (size < 30) return;
+    if (memcmp(data + 12, "VP8 ", 4) == 0) {
+        probe.width = le16(data + 26) & 0x3FFF;
+        probe.height = le16(data + 28) & 0x3FFF;
+    }
+    else if (memcmp(data + 12, "VP8L", 4) == 0) {
+        unsigned bits = data[21] | (data[22] << 8) | (data[23] << 16) | ((unsigned)data[24] << 24);
+        probe.width = (bits & 0x3FFF) + 1;
+        probe.height = ((bits >> 14) & 0x3FFF) + 1;
+    }
+    else if (memcmp(data + 12, "VP8X", 4) == 0) {
+        probe.width = le24(data + 24) + 1;
+        probe.height = le24(data + 27) + 1;
+    }
+}
+
+ImageProbe probeImageBuffer(const unsigned char* data, size_t size) {
+    ImageProbe probe;
+    static const unsigned char kPng[8] = { 0x89, 'P', 'N', 'G', 0x0D, 0x0A, 0x1A, 0x0A };
+    if (size >= 24 && memcmp(data, kPng, 8) == 0) {
+        probe.format = "png";
+        probe.width = be32(data + 16);
+        probe.height = be32(data + 20);
+    }
+    else if (size >= 4 && data[0] == 0xFF && data[1] == 0xD8) {
+        probeJpeg(data, size, probe);
+    }
+    else if (size >= 16 && memcmp(data, "RIFF", 4) == 0 && memcmp(data + 8, "WEBP", 4) == 0) {
+        probeWebp(data, size, probe);
+    }
+    else if (size >= 26 && data[0] == 'B' && data[1] == 'M') {
+        probe.format = "bmp";
+        probe.width = le32s(data + 18);
+        int h = le32s(data + 22);
+        probe.height = h < 0 ? -h : h;
+    }
+    else if (size >= 10 && memcmp(data, "GIF8", 4) == 0) {
+        probe.format = "gif";
+        probe.width = le16(data + 6);
+        probe.height = le16(data + 8);
+    }
+    return probe;
+}
+
+ImageProbe probeImageFile(const std::string& path) {
+    FILE* f = fopen(path.c_str(), "rb");
+    if (!f) return ImageProbe();
+    std::vector<unsigned char> head(64 * 1024);
+    size_t n = fread(head.data(), 1, head.size(), f);
+    fclose(f);
+    return probeImageBuffer(head.data(), n);
+}
@@ -0,0 +1,20 @@
+#pragma once
+// =======================================================
+// 图片头部探测：只读取文件头，不解码像素
+// =======================================================
+#include <cstddef>
+#include <string>
+
+struct ImageProbe {
+    std::string format; // png / jpeg / webp / bmp / gif / unknown
+    int width;
+    int height;
+
+    ImageProbe() : format("unknown"), width(0), height(0) {}
+    bool valid() const { return width > 0 && height > 0; }
+    double megapixels() const { return (double)width * height / 1e6; }
+};
+
+// 从内存中的文件头探测，buffer 至少应包含前 64KB (JPEG 的 SOF 可能较靠后)
+ImageProbe probeImageBuffer(const unsigned char* data, size_t size);
+ImageProbe probeImageFile(const std::string& path);
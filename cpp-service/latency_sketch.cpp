@@ -0,0 +1,149 @@
+#include "latency_sketch.h"
+#include <chrono>
+#include <cmath>
+
+// 相对误差 alpha = 2%：gamma = (1 + alpha) / (1 - alpha)
+static const double kGamma = 1.02 / 0.98;
+static const double kLogGamma = std::log(kGamma);
+// 覆盖 0.01 ms ~ 1e6 ms，超出范围的值落入首尾桶
+static const int kMinIndex = (int)std::floor(std::log(0.01) / std::log(1.02 / 0.98));
+static const int kMaxIndex = (int)std::ceil(std::log(1e6) / std::log(1.02 / 0.98));
+static const int kBuckets = kMaxIndex - kMinIndex + 1;
+
+static int bucketIndex(double ms) {
+    if (ms <= 0.01) return 0;
+    int index = (int)std::ceil(std::log(ms) / kLogGamma) - kMinIndex;
+    return index >= kBuckets ? kBuckets - 1 : index;
+}
+
+static double bucketValue(int bucket) {
+    // 桶 (gamma^(i-1), gamma^i] 的代表值，保证相对误差不超过 alpha
+    return 2.0 * std::pow(kGamma, bucket + kMinIndex) / (kGamma + 1.0);
+}
+
+static int64_t currentEpoch() {
+    auto now = std::chrono::steady_clock::now().time_since_epoch();
+    return std::chrono::duration_cast<std::chrono::seconds>(now).count() / LatencySeries::kSliceSeconds;
+}
+
+// 线程编号，用于选择分片；超过 kMaxShards 个线程时分片会被共享，
+// 此时时间片重置存在轻微竞争，只影响精度不影响正确性
+static int threadSlot() {
+    static std::atomic<int> nextSlot(0);
+    thread_local int slot = nextSlot++ % LatencySeries::kMaxShards;
+    return slot;
+}
+
+// =======================================================
+// 快照
+// =======================================================
+LatencySnapshot::LatencySnapshot() : count(0), sumMs(0), buckets(kBuckets, 0), totalCount(0), totalSumMs(0) {}
+
+double LatencySnapshot::quantile(double q) const {
+    if (count == 0) return 0.0;
+    uint64_t rank = (uint64_t)std::ceil(q * count);
+    if (rank == 0) rank = 1;
+    uint64_t seen = 0;
+    for (int i = 0; i < kBuckets; ++i) {
+        seen += buckets[i];
+        if (seen >= rank) return bucketValue(i);
+    }
+    return bucketValue(kBuckets - 1);
+}
+
+// =======================================================
+// 分片：每个时间片一组桶，由所属线程在进入新时间片时清零
+// =======================================================
+struct LatencySeries::Shard {
+    struct Slice {
+        std::atomic<int64_t> epoch;
+        std::atomic<uint64_t> count;
+        std::atomic<uint64_t> sumMicros;
+        std::unique_ptr<std::atomic<uint32_t>[]> buckets;
+
+        Slice() : epoch(-1), count(0), sumMicros(0), buckets(new std::atomic<uint32_t>[kBuckets]) {
+            for (int i = 0; i < kBuckets; ++i) buckets[i].store(0, std::memory_order_relaxed);
+        }
+    };
+    Slice slices[kSlices];
+    // 不随时间片重置
+    std::atomic<uint64_t> totalCount{0};
+    std::atomic<uint64_t> totalSumMicros{0};
+};
+
+LatencySeries::LatencySeries(const std::string& endpoint, const std::string& algorithm)
+    : endpoint(endpoint), algorithm(algorithm) {
+    for (auto& s : shards_) s.store(nullptr);
+}
+
+LatencySeries::~LatencySeries() {
+    for (auto& s : shards_) delete s.load();
+}
+
+LatencySeries::Shard* LatencySeries::shardForCurrentThread() {
+    std::atomic<Shard*>& slot = shards_[threadSlot()];
+    Shard* shard = slot.load(std::memory_order_acquire);
+    if (shard) return shard;
+    Shard* fresh = new Shard();
+    if (slot.compare_exchange_strong(shard, fresh, std::memory_order_acq_rel)) return fresh;
+    delete fresh;
+    return shard;
+}
+
+void LatencySeries::record(double ms) {
+    Shard* shard = shardForCurrentThread();
+    int64_t epoch = currentEpoch();
+    Shard::Slice& slice = shard->slices[epoch % kSlices];
+    if (slice.epoch.load(std::memory_order_relaxed) != epoch) {
+        for (int i = 0; i < kBuckets; ++i) slice.buckets[i].store(0, std::memory_order_relaxed);
+        slice.count.store(0, std::memory_order_relaxed);
+        slice.sumMicros.store(0, std::memory_order_relaxed);
+        slice.epoch.store(epoch, std::memory_order_release);
+    }
+    uint64_t micros = (uint64_t)(ms * 1000.0);
+    slice.buckets[bucketIndex(ms)].fetch_add(1, std::memory_order_relaxed);
+    slice.count.fetch_add(1, std::memory_order_relaxed);
+    slice.sumMicros.fetch_add(micros, std::memory_order_relaxed);
+    shard->totalCount.fetch_add(1, std::memory_order_relaxed);
+    shard->totalSumMicros.fetch_add(micros, std::memory_order_relaxed);
+}
+
+LatencySnapshot LatencySeries::snapshot(int windowSeconds) const {
+    LatencySnapshot snap;
+    int64_t now = currentEpoch();
+    int64_t slices = (windowSeconds + kSliceSeconds - 1) / kSliceSeconds;
+    if (slices < 1) slices = 1;
+    if (slices >= kSlices) slices = kSlices - 1;
+    for (const auto& s : shards_) {
+        const Shard* shard = s.load(std::memory_order_acquire);
+        if (!shard) continue;
+        snap.totalCount += shard->totalCount.load(std::memory_order_relaxed);
+        snap.totalSumMs += shard->totalSumMicros.load(std::memory_order_relaxed) / 1000.0;
+        for (const Shard::Slice& slice : shard->slices) {
+            int64_t epoch = slice.epoch.load(std::memory_order_acquire);
+            // 当前时间片加上之前 slices - 1 个完整时间片，总跨度不超过 windowSeconds
+            if (epoch < 0 || epoch > now || now - epoch >= slices) continue;
+            snap.count += slice.count.load(std::memory_order_relaxed);
+            snap.sumMs += slice.sumMicros.load(std::memory_order_relaxed) / 1000.0;
+            for (int i = 0; i < kBuckets; ++i) snap.buckets[i] += slice.buckets[i].load(std::memory_order_relaxed);
+        }
+    }
+    return snap;
+}
+
+// =======================================================
+// 序列注册表
+// =======================================================
+LatencySeries* LatencyRegistry::series(const std::string& endpoint, const std::string& algorithm) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::unique_ptr<LatencySeries>& slot = series_[std::make_pair(endpoint, algorithm)];
+    if (!slot) slot.reset(new LatencySeries(endpoint, algorithm));
+    return slot.get();
+}
+
+std::vector<LatencySeries*> LatencyRegistry::all() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::vector<LatencySeries*> out;
+    for (const auto& kv : series_) out.push_back(kv.second.get());
+    return out;
+}
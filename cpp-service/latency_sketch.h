@@ -0,0 +1,63 @@
+#pragma once
+// =======================================================
+// 延迟分位数草图 (DDSketch，相对误差 2%)
+// - 每个序列 (endpoint + algorithm) 按线程分片，写入只做 relaxed 原子自增，无锁
+// - 按 15 秒时间片滚动，查询时合并最近 N 个时间片 (含当前未结束的一片) 得到滑动窗口，
+//   窗口按时间片对齐，实际覆盖的时长在 (windowSeconds - 15s, windowSeconds] 之间
+// - 另记进程启动以来的累计次数与总耗时 (单调递增)，供 Summary 的 _count / _sum 使用
+// - 不同分片 / 时间片的草图可直接按桶相加合并
+// =======================================================
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+struct LatencySnapshot {
+    uint64_t count;      // 窗口内
+    double sumMs;
+    std::vector<uint64_t> buckets;
+    uint64_t totalCount; // 进程启动以来
+    double totalSumMs;
+
+    LatencySnapshot();
+    double quantile(double q) const;
+    double mean() const { return count ? sumMs / count : 0.0; }
+};
+
+class LatencySeries {
+public:
+    static const int kSliceSeconds = 15;
+    static const int kSlices = 21;          // 5 分钟窗口 (20 片) + 1 片余量，避免读到正在重置的时间片
+    static const int kMaxShards = 64;
+
+    LatencySeries(const std::string& endpoint, const std::string& algorithm);
+    ~LatencySeries();
+
+    void record(double ms);
+    // 合并最近 windowSeconds 秒内的所有分片
+    LatencySnapshot snapshot(int windowSeconds) const;
+
+    const std::string endpoint;
+    const std::string algorithm;
+
+private:
+    struct Shard;
+    Shard* shardForCurrentThread();
+
+    std::array<std::atomic<Shard*>, kMaxShards> shards_;
+};
+
+class LatencyRegistry {
+public:
+    // 返回的指针在进程生命周期内有效，调用方可缓存
+    LatencySeries* series(const std::string& endpoint, const std::string& algorithm);
+    std::vector<LatencySeries*> all() const;
+
+private:
+    mutable std::mutex mutex_;
+    std::map<std::pair<std::string, std::string>, std::unique_ptr<LatencySeries> > series_;
+};
@@ -1,5 +1,28 @@
 #include "lib/httplib.h"
 #include "lib/json.hpp"
+#include "algorithms.h"
+#include "pipeline.h"
+#include "rendition.h"
+#include "image_cache.h"
+#include "image_decoder.h"
+#include "frame_store.h"
+#include "prefetch.h"
+#include "recompress.h"
+#include "shadow.h"
+#include "brownout.h"
+#include "forensics_refiner.h"
+#include "fair_scheduler.h"
+#include "cost_model.h"
+#include "runtime_config.h"
+#include "hot_restart.h"
+#include "task_queue.h"
+#include "cache_snapshot.h"
+#include "bulk_verify.h"
+#include "file_utils.h"
+#include "latency_sketch.h"
+#include "perf_counters.h"
+#include "flight_recorder.h"
+#include "signed_payload.h"
 #include <opencv2/opencv.hpp>
 #include <iostream>
 #include <string>
@@ -9,6 +32,15 @@
 #include <memory>
 #include <numeric>
 #include <cmath> 
+#include <functional>
+#include <cctype>
+#include <cstdlib>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 // =======================================================
 // Prometheus C++ 客户端头文件 
@@ -18,310 +50,682 @@
 #include <prometheus/counter.h>
 #include <prometheus/histogram.h>
 #include <prometheus/gauge.h>
+#include <prometheus/collectable.h>
 
 // =======================================================
 // 全局 USING 声明
 // =======================================================
 using namespace httplib;
-using json = nlohmann::json;
+using json = ArenaJson;
 using namespace cv;
 using namespace prometheus;
 
 // =======================================================
-// 全局常量配置
-// =======================================================
-const std::string MAGIC_HEADER = "#IS#"; // 水印头部标记
-
-// =======================================================
-// LSB 隐写辅助函数
+// 全局监控指标 (保留了完整的监控指标)
 // =======================================================
+struct Metrics {
+    std::shared_ptr<Registry> registry;
+    Counter* total_requests;
+    Counter* failed_requests;
+    Counter* processed_images;
+    Counter* watermark_calls;
+    Counter* forensics_calls;
+    Histogram* request_duration;
+    Gauge* active_requests;
 
-std::string sanitizeString(const std::string& input) {
-    std::string result;
-    for (char c : input) {
-        if (c >= 32 && c <= 126) {
-            result += c;
-        }
-        else {
-            result += '?';
-        }
+    explicit Metrics(const std::vector<double>& durationBucketsMs) {
+        registry = std::make_shared<Registry>();
+        auto& total_f = BuildCounter().Name("http_requests_total").Help("Total requests").Register(*registry);
+        total_requests = &total_f.Add({});
+        auto& failed_f = BuildCounter().Name("http_requests_failed_total").Help("Failed requests").Register(*registry);
+        failed_requests = &failed_f.Add({});
+        auto& img_f = BuildCounter().Name("images_processed_total").Help("Images processed").Register(*registry);
+        processed_images = &img_f.Add({});
+        auto& wm_f = BuildCounter().Name("algorithm_watermark_calls_total").Help("Watermark calls").Register(*registry);
+        watermark_calls = &wm_f.Add({});
+        auto& for_f = BuildCounter().Name("algorithm_forensics_calls_total").Help("Forensics calls").Register(*registry);
+        forensics_calls = &for_f.Add({});
+        auto& dur_f = BuildHistogram().Name("http_request_duration_ms").Help("Duration ms").Register(*registry);
+        request_duration = &dur_f.Add({}, durationBucketsMs);
+        auto& act_f = BuildGauge().Name("active_requests").Help("Active requests").Register(*registry);
+        active_requests = &act_f.Add({});
     }
-    return result;
-}
+};
 
-std::string textToBinary(const std::string& text) {
-    if (text.empty() || text.length() > 255) return "";
+// 抓取时才计算的指标 (缓存、后台任务等组件自身维护计数，抓取时读取快照)
+class CallbackCollectable : public Collectable {
+public:
+    explicit CallbackCollectable(std::function<std::vector<MetricFamily>()> fn) : fn_(fn) {}
+    std::vector<MetricFamily> Collect() const override { return fn_(); }
 
-    std::string binaryStr = "";
-    int len = text.length();
+private:
+    std::function<std::vector<MetricFamily>()> fn_;
+};
 
-    // 1. 编码长度（8位，高位在前）
-    for (int i = 7; i >= 0; --i) {
-        binaryStr += ((len >> i) & 1) ? '1' : '0';
+// 指标端口：热重启时要等旧进程退出、释放端口后才能绑定，因此 Exposer 延迟创建，
+// 在此之前注册的 Collectable 先记下来
+class MetricsEndpoint {
+public:
+    void RegisterCollectable(const std::shared_ptr<Collectable>& collectable) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        collectables_.push_back(collectable);
+        if (exposer_) exposer_->RegisterCollectable(collectable);
     }
 
-    // 2. 编码数据
-    for (char c : text) {
-        for (int i = 7; i >= 0; --i) {
-            binaryStr += ((c >> i) & 1) ? '1' : '0';
+    bool bind(const std::string& address) {
+        std::unique_ptr<Exposer> exposer;
+        try {
+            exposer.reset(new Exposer(address));
         }
+        catch (const std::exception& e) {
+            std::cerr << "[METRICS] 无法监听 " << address << ": " << e.what() << std::endl;
+            return false;
+        }
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (const auto& c : collectables_) exposer->RegisterCollectable(c);
+        exposer_ = std::move(exposer);
+        return true;
     }
-    return binaryStr;
+
+private:
+    std::mutex mutex_;
+    std::vector<std::weak_ptr<Collectable> > collectables_;
+    std::unique_ptr<Exposer> exposer_;
+};
+
+static MetricFamily makeEmptyFamily(const std::string& name, const std::string& help, MetricType type) {
+    MetricFamily family;
+    family.name = name;
+    family.help = help;
+    family.type = type;
+    return family;
 }
 
-std::string binaryToText(const std::string& binaryStr, double& confidence) {
-    if (binaryStr.length() < 8) {
-        confidence = 0.0;
-        return "";
+static void addLabeledValue(MetricFamily& family, const std::map<std::string, std::string>& labels, double value) {
+    ClientMetric metric;
+    for (const auto& kv : labels) {
+        ClientMetric::Label label;
+        label.name = kv.first;
+        label.value = kv.second;
+        metric.label.push_back(label);
     }
+    if (family.type == MetricType::Counter) metric.counter.value = value;
+    else metric.gauge.value = value;
+    family.metric.push_back(metric);
+}
 
-    int len = 0;
-    for (int i = 0; i < 8; ++i) {
-        if (binaryStr[i] == '1') {
-            len |= (1 << (7 - i));
-        }
-    }
+static MetricFamily makeFamily(const std::string& name, const std::string& help, MetricType type, double value) {
+    MetricFamily family = makeEmptyFamily(name, help, type);
+    addLabeledValue(family, {}, value);
+    return family;
+}
 
-    if (len == 0 || (8 + len * 8) > binaryStr.length()) {
-        confidence = 0.0;
-        return "";
-    }
+// 延迟分位数：每个滑动窗口 (1m / 5m) 各导出一个 Summary 族，避免同一累计 _count / _sum
+// 在同一族内按 window 标签重复出现而被聚合时重复计数。
+// 分位数取自窗口，_count / _sum 为进程启动以来的累计值 (Prometheus 要求单调递增)
+static const int kLatencyWindows[] = { 60, 300 };
+static const double kLatencyQuantiles[] = { 0.5, 0.9, 0.95, 0.99, 0.999 };
+static const char* const kLatencyQuantileNames[] = { "p50", "p90", "p95", "p99", "p999" };
+
+static std::string windowLabel(int seconds) {
+    return std::to_string(seconds / 60) + "m";
+}
 
-    std::string text = "";
-    for (int i = 0; i < len; ++i) {
-        int charValue = 0;
-        int start_index = 8 + i * 8;
-        for (int j = 0; j < 8; ++j) {
-            if (binaryStr[start_index + j] == '1') {
-                charValue |= (1 << (7 - j));
+static std::vector<MetricFamily> makeLatencySummaries(const LatencyRegistry& latency) {
+    std::vector<MetricFamily> families;
+    for (int window : kLatencyWindows) {
+        MetricFamily family = makeEmptyFamily("request_latency_quantiles_" + windowLabel(window) + "_ms",
+            "Request latency quantiles per endpoint and algorithm over a " + windowLabel(window) + " window (DDSketch, 2% relative error)",
+            MetricType::Summary);
+        for (LatencySeries* series : latency.all()) {
+            LatencySnapshot snap = series->snapshot(window);
+            ClientMetric metric;
+            metric.label = { {"endpoint", series->endpoint}, {"algorithm", series->algorithm} };
+            metric.summary.sample_count = snap.totalCount;
+            metric.summary.sample_sum = snap.totalSumMs;
+            for (double q : kLatencyQuantiles) {
+                ClientMetric::Quantile quantile;
+                quantile.quantile = q;
+                quantile.value = snap.quantile(q);
+                metric.summary.quantile.push_back(quantile);
             }
+            family.metric.push_back(metric);
         }
-        text += (char)charValue;
+        families.push_back(family);
     }
-
-    confidence = 0.99;
-    return text;
+    return families;
 }
 
-
-// =======================================================
-// 算法 1: 隐形水印嵌入 (Blue Channel + Magic Header)
-// =======================================================
-void processWatermark(const std::string& inputPath, const std::string& outputPath, const std::string& watermarkText, json& response) {
-    Mat img = imread(inputPath);
-    if (img.empty()) throw std::runtime_error("无法读取图片: " + inputPath);
-
-    // 加盐：拼接 Header
-    std::string fullPayload = MAGIC_HEADER + watermarkText;
-
-    std::string binaryWatermark = textToBinary(fullPayload);
-    int watermarkLen = binaryWatermark.length();
-
-    if (watermarkLen == 0) throw std::runtime_error("水印内容无效");
-    if (watermarkLen > (img.rows * img.cols)) throw std::runtime_error("图片太小，无法嵌入水印");
-
-    Mat watermarked_full = img.clone();
-    int bitIndex = 0;
-
-    // 嵌入到 Blue 通道
-    for (int i = 0; i < watermarked_full.rows; ++i) {
-        for (int j = 0; j < watermarked_full.cols; ++j) {
-            Vec3b& pixel = watermarked_full.at<Vec3b>(i, j);
-            uchar& blue = pixel[0];
-
-            if (bitIndex < watermarkLen) {
-                char bit = binaryWatermark[bitIndex];
-                blue = (blue & 0xFE) | (bit == '1' ? 0x01 : 0x00);
-                bitIndex++;
-            }
-            else {
-                goto embedding_done;
+static json latencyDebugJson(const LatencyRegistry& latency) {
+    json out = json::array();
+    for (LatencySeries* series : latency.all()) {
+        json windows = json::object();
+        for (int window : kLatencyWindows) {
+            LatencySnapshot snap = series->snapshot(window);
+            json quantiles = json::object();
+            for (size_t i = 0; i < sizeof(kLatencyQuantiles) / sizeof(kLatencyQuantiles[0]); ++i) {
+                quantiles[kLatencyQuantileNames[i]] = snap.quantile(kLatencyQuantiles[i]);
             }
+            windows[windowLabel(window)] = { {"count", snap.count}, {"meanMs", snap.mean()}, {"quantilesMs", quantiles} };
         }
+        out.push_back({ {"endpoint", series->endpoint}, {"algorithm", series->algorithm}, {"windows", windows} });
     }
+    return out;
+}
 
-embedding_done:;
+static double elapsedMs(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
 
-    if (!imwrite(outputPath, watermarked_full)) throw std::runtime_error("保存失败: " + outputPath);
+static std::string envOr(const char* name, const std::string& fallback) {
+    const char* value = getenv(name);
+    return value && *value ? value : fallback;
+}
 
-    // 生成预览图
-    Mat preview_img = watermarked_full.clone();
-    int box_h = 100;
-    Rect rect(10, 10, preview_img.cols - 20, box_h);
-    if (rect.x >= 0 && rect.y >= 0 && rect.width <= preview_img.cols && rect.height <= preview_img.rows) {
-        Mat sub_region = preview_img(rect);
-        addWeighted(sub_region, 0.7, Mat::zeros(sub_region.size(), sub_region.type()), 0.3, 0, sub_region);
+static std::string requiredString(const json& body, const char* key) {
+    if (!body.contains(key) || !body[key].is_string()) {
+        throw std::runtime_error(std::string("Required key '") + key + "' is missing.");
     }
+    return body[key].get<std::string>();
+}
 
-    putText(preview_img, "DIGITAL WATERMARK EMBEDDED", Point(30, 40),
-        FONT_HERSHEY_DUPLEX, 0.7, Scalar(0, 255, 0), 1, LINE_AA);
-    putText(preview_img, "Data: " + watermarkText, Point(30, 80),
-        FONT_HERSHEY_SIMPLEX, 0.6, Scalar(255, 255, 255), 1, LINE_AA);
-
-    std::string previewPath = outputPath.substr(0, outputPath.find_last_of('.')) + "_preview.png";
-    if (!imwrite(previewPath, preview_img)) throw std::runtime_error("保存预览失败");
-
-    response["success"] = true;
-    response["previewPath"] = previewPath;
-    response["embeddedText"] = watermarkText;
-    response["algorithm"] = "LSB (Blue Channel + Header)";
+// 租户标识来自 X-Tenant-Id，只保留安全字符并限制长度 (同时用作指标标签)。
+// 本服务只监听 127.0.0.1，该头由 server.js 在服务端确定，不转发浏览器提供的值
+static std::string tenantOf(const Request& req) {
+    std::string tenant;
+    for (char c : req.get_header_value("X-Tenant-Id")) {
+        if (tenant.size() >= 64) break;
+        if (isalnum((unsigned char)c) || c == '-' || c == '_' || c == '.') tenant += c;
+    }
+    return tenant.empty() ? "anonymous" : tenant;
 }
 
-// =======================================================
-// 算法 2: 图像取证
-// =======================================================
-void processForensics(const std::string& inputPath, const std::string& outputPath, const std::string& watermarkText, json& response) {
-    Mat img = imread(inputPath);
-    if (img.empty()) throw std::runtime_error("无法读取图片: " + inputPath);
-
-    Mat preview_img = img.clone();
-    Mat edges;
-    cvtColor(img, edges, COLOR_BGR2GRAY);
-    Canny(edges, edges, 100, 200);
-    cvtColor(edges, preview_img, COLOR_GRAY2BGR);
-    putText(preview_img, "FORENSICS ANALYSIS PREVIEW", Point(30, 50), FONT_HERSHEY_DUPLEX, 0.7, Scalar(0, 0, 255), 2, LINE_AA);
-
-    std::string previewPath = outputPath.substr(0, outputPath.find_last_of('.')) + "_preview.png";
-    if (!imwrite(outputPath, preview_img)) throw std::runtime_error("保存失败");
-    if (!imwrite(previewPath, preview_img)) throw std::runtime_error("保存失败");
-
-    response["success"] = true;
-    response["previewPath"] = previewPath;
-    response["score"] = 90;
-    response["riskLevel"] = "Low";
+// 只读文件头的尺寸/格式，结果记入缓存，后续请求和解码无需再次探测
+static ImageProbe probeCached(ImageCache& cache, const std::string& path) {
+    CachedImage cached;
+    if (cache.lookup(path, cached) && cached.probe.valid()) return cached.probe;
+    CachedImage info;
+    info.probe = probeImageFile(path);
+    if (info.probe.valid()) cache.merge(path, info);
+    return info.probe;
 }
 
-// =======================================================
-// 水印提取/验证算法 (Blue Channel + Header Check)
-// =======================================================
-void processVerify(const std::string& inputPath, const std::string& originalWatermarkData, json& response) {
-    Mat img = imread(inputPath);
-    if (img.empty()) throw std::runtime_error("无法读取图片: " + inputPath);
-
-    std::string lengthBits = "";
-    int bitIndex = 0;
-    const int max_pixels = img.rows * img.cols;
-    const int max_bits_to_read = std::min(max_pixels, 8);
-
-    // 1. 提取长度
-    for (int i = 0; i < img.rows; ++i) {
-        for (int j = 0; j < img.cols; ++j) {
-            Vec3b pixel = img.at<Vec3b>(i, j);
-            lengthBits += ((pixel[0] & 0x01) == 1) ? '1' : '0';
-            bitIndex++;
-            if (bitIndex >= 8) goto decode_length;
-        }
+// 成本模型的分组名：流水线按阶段数区分 (阶段越多越慢)；
+// 区域请求的固定开销 (扫描跳过的数据) 与整图不同，单独分组
+static std::string costKeyOf(const json& body) {
+    std::string suffix = body.contains("roi") ? "+roi" : "";
+    if (body.contains("stages") && body["stages"].is_array()) {
+        return "pipeline:" + std::to_string(std::min<size_t>(body["stages"].size(), 8)) + suffix;
     }
-decode_length:;
-
-    double confidence = 0.0;
-    int len = 0;
-    for (int i = 0; i < 8; ++i) {
-        if (lengthBits.length() > i && lengthBits[i] == '1') len |= (1 << (7 - i));
+    if (body.contains("renditions") && body["renditions"].is_array()) {
+        return "renditions:" + std::to_string(std::min<size_t>(body["renditions"].size(), 8)) + suffix;
     }
+    return body.value("algorithm", "pipeline") + suffix;
+}
 
-    if (len == 0 || (8 + len * 8) > (img.rows * img.cols)) {
-        response["success"] = false;
-        response["extractedText"] = "";
-        response["confidenceScore"] = 0.0;
-        return;
-    }
+// 成本模型使用的像素数：有 roi 时只计区域内的部分
+static double workMegapixels(const ImageProbe& probe, const cv::Rect& roi) {
+    if (roi.empty()) return probe.megapixels();
+    // 按 double 计算面积，超大 roi 的 int 乘积会溢出
+    if (!probe.valid()) return (double)roi.width * roi.height / 1e6;
+    cv::Rect clipped = roi & cv::Rect(0, 0, probe.width, probe.height);
+    return (double)clipped.width * clipped.height / 1e6;
+}
 
-    // 3. 提取全部数据
-    std::string binaryData = lengthBits;
-    int totalBits = 8 + len * 8;
-    bitIndex = 8;
-
-    for (int i = 0; i < img.rows; ++i) {
-        for (int j = 0; j < img.cols; ++j) {
-            if (i * img.cols + j < 8) continue;
-            Vec3b pixel = img.at<Vec3b>(i, j);
-            binaryData += ((pixel[0] & 0x01) == 1) ? '1' : '0';
-            bitIndex++;
-            if (bitIndex >= totalBits) goto decode_text;
-        }
+static json costModelDebugJson(const CostModel& model) {
+    json out = json::object();
+    for (const auto& kv : model.fits()) {
+        out[kv.first] = { {"interceptMs", kv.second.intercept}, {"msPerMegapixel", kv.second.slope}, {"samples", kv.second.samples} };
     }
-decode_text:;
+    return out;
+}
+
+static void sendError(Response& res, int status, const std::string& message) {
+    json err = { {"success", false}, {"error", message} };
+    res.status = status;
+    res.set_content(err.dump(), "application/json");
+}
 
-    std::string rawText = binaryToText(binaryData, confidence);
 
-    // 4. 校验 Magic Header
-    if (rawText.find(MAGIC_HEADER) == 0) {
-        std::string actualContent = rawText.substr(MAGIC_HEADER.length());
-        response["success"] = true;
-        response["extractedText"] = sanitizeString(actualContent);
-        response["confidenceScore"] = 0.99;
+// 热重启时交给新进程的预热状态：成本模型的累积量 + 最近解码过的图片 (新进程后台预取)
+static std::string exportWarmState(const CostModel& costModel, const ImageCache& imageCache) {
+    json state = { {"costModel", costModel.exportState()}, {"recentImages", json::array()} };
+    for (const std::string& path : imageCache.recentDecoded(256)) state["recentImages"].push_back(path);
+    return state.dump();
+}
+
+static void importWarmState(const std::string& text, CostModel& costModel, Prefetcher& prefetcher) {
+    if (text.empty()) return;
+    try {
+        json state = json::parse(text);
+        costModel.importState(state.value("costModel", ""));
+        for (const auto& path : state["recentImages"]) prefetcher.enqueue(path.get<std::string>());
     }
-    else {
-        response["success"] = false;
-        response["extractedText"] = "";
-        response["confidenceScore"] = 0.1;
+    catch (const std::exception& e) {
+        std::cerr << "[HANDOFF] 忽略无效的预热状态: " << e.what() << std::endl;
     }
 }
 
 
-// =======================================================
-// 全局监控指标 (保留了完整的监控指标)
-// =======================================================
-struct Metrics {
-    std::shared_ptr<Registry> registry;
-    Counter* total_requests;
-    Counter* failed_requests;
-    Counter* processed_images;
-    Counter* watermark_calls;
-    Counter* forensics_calls;
-    Histogram* request_duration;
-    Gauge* active_requests;
-
-    Metrics() {
-        registry = std::make_shared<Registry>();
-        auto& total_f = BuildCounter().Name("http_requests_total").Help("Total requests").Register(*registry);
-        total_requests = &total_f.Add({});
-        auto& failed_f = BuildCounter().Name("http_requests_failed_total").Help("Failed requests").Register(*registry);
-        failed_requests = &failed_f.Add({});
-        auto& img_f = BuildCounter().Name("images_processed_total").Help("Images processed").Register(*registry);
-        processed_images = &img_f.Add({});
-        auto& wm_f = BuildCounter().Name("algorithm_watermark_calls_total").Help("Watermark calls").Register(*registry);
-        watermark_calls = &wm_f.Add({});
-        auto& for_f = BuildCounter().Name("algorithm_forensics_calls_total").Help("Forensics calls").Register(*registry);
-        forensics_calls = &for_f.Add({});
-        auto& dur_f = BuildHistogram().Name("http_request_duration_ms").Help("Duration ms").Register(*registry);
-        request_duration = &dur_f.Add({}, std::vector<double>{10, 50, 100, 200, 500, 1000});
-        auto& act_f = BuildGauge().Name("active_requests").Help("Active requests").Register(*registry);
-        active_requests = &act_f.Add({});
+int main(int argc, char** argv) {
+    // 运行时配置 (SENTINEL_CONFIG 指定的 JSON 文件)：SIGHUP 或 POST /admin/reload 重新加载。
+    // 启动时先读一次，端口、线程数等只在这里取值
+    RuntimeConfigManager::installSignalHandler();
+    std::unique_ptr<RuntimeConfigManager> configManager;
+    try {
+        configManager.reset(new RuntimeConfigManager(envOr("SENTINEL_CONFIG", ""), RuntimeConfig::fromEnvironment()));
+    }
+    catch (const std::exception&) {
+        // 启动时配置非法：reload 已记录原因，正常退出而不是 abort
+        return 1;
+    }
+    RuntimeConfigManager& config = *configManager;
+    std::shared_ptr<const RuntimeConfig> boot = config.current();
+    // 飞行记录器：最近的请求与状态采样，SIGUSR1 / 致命信号 / POST /admin/flight/dump 时写出
+    initFlightRecorder(boot->flightRecords, envOr("SENTINEL_FLIGHT_DIR", "/tmp/sentinel-flight"));
+    // 水印签名密钥 (SENTINEL_SIGNING_KEY / SENTINEL_VERIFY_KEYS / SENTINEL_MAC_KEY)：配置了却无法读取时直接退出
+    try {
+        loadSignatureKeys();
+    }
+    catch (const std::exception& e) {
+        std::cerr << "[ERROR] " << e.what() << std::endl;
+        return 1;
     }
-};
 
+    // 热重启：--takeover 时从旧进程接管监听 socket，旧进程排空后退出
+    std::string handoffSocket = envOr("SENTINEL_HANDOFF_SOCKET", "");
+    if (handoffSocket.empty()) {
+        std::string error;
+        handoffSocket = defaultHandoffSocketPath(error);
+        if (handoffSocket.empty()) std::cerr << "[HANDOFF] " << error << "，热重启不可用" << std::endl;
+    }
+    bool takeover = false;
+    for (int i = 1; i < argc; ++i) takeover = takeover || std::string(argv[i]) == "--takeover";
+    HandoffState inherited;
+    if (takeover) {
+        std::string error;
+        if (!receiveHandoff(handoffSocket, inherited, error)) {
+            std::cerr << "[HANDOFF] " << error << std::endl;
+            return 1;
+        }
+    }
 
-int main() {
-    Exposer exposer{ "0.0.0.0:9100" };
-    auto metrics = std::make_shared<Metrics>();
+    const std::string metricsAddress = "0.0.0.0:" + std::to_string(boot->metricsPort);
+    MetricsEndpoint exposer;
+    if (!takeover) exposer.bind(metricsAddress);
+    auto metrics = std::make_shared<Metrics>(boot->histogramBucketsMs);
     exposer.RegisterCollectable(metrics->registry);
 
-    Server svr;
-    svr.new_task_queue = [] { return new ThreadPool(8); };
+    // 解码缓存 (内存 LRU + 本地磁盘帧缓存) + 上传后预取
+    // frameCacheMB 为 0 (默认) 时关闭磁盘层；开启时目录应位于持久磁盘上 (/tmp 可能是内存文件系统)
+    FrameStore frameStore(envOr("SENTINEL_FRAME_CACHE_DIR", "/tmp/sentinel-frames"), boot->frameCacheMB * 1024 * 1024);
+    ImageCache imageCache(boot->imageCacheMB * 1024 * 1024);
+    imageCache.setFrameStore(&frameStore);
+    ForegroundTracker foreground;
+    Prefetcher prefetcher(imageCache, foreground, boot->prefetchQueue);
+    setImageLoader([&imageCache](const std::string& path) { return imageCache.load(path); });
+    setScaledImageLoader([&imageCache](const std::string& path, int minSide) { return imageCache.loadAtLeast(path, minSide); });
+    setRegionImageLoader([&imageCache](const std::string& path, cv::Rect& roi) { return imageCache.loadRegion(path, roi); });
+    setLumaImageLoader([&imageCache](const std::string& path, cv::Rect& roi, int minSide) {
+        return roi.empty() ? imageCache.loadLuma(path, minSide) : imageCache.loadRegionLuma(path, roi);
+    });
+
+    auto cacheMetrics = std::make_shared<CallbackCollectable>([&imageCache, &frameStore, &prefetcher] {
+        ImageCacheStats cs = imageCache.stats();
+        FrameStoreStats fs = frameStore.stats();
+        PrefetchStats ps = prefetcher.stats();
+        DecoderStats ds = decoderStats();
+        MetricFamily decodes = makeEmptyFamily("image_decodes_total", "Image decodes by backend", MetricType::Counter);
+        addLabeledValue(decodes, { {"backend", "fast_png"} }, (double)ds.fastPng);
+        addLabeledValue(decodes, { {"backend", "opencv"} }, (double)ds.fallback);
+        addLabeledValue(decodes, { {"backend", "jpeg_roi"} }, (double)ds.jpegRegion);
+        addLabeledValue(decodes, { {"backend", "png_roi"} }, (double)ds.pngRegion);
+        addLabeledValue(decodes, { {"backend", "jpeg_luma"} }, (double)ds.jpegLuma);
+        return std::vector<MetricFamily>{
+            makeFamily("image_cache_hits_total", "Decoded image cache hits", MetricType::Counter, (double)cs.hits),
+            makeFamily("image_cache_misses_total", "Decoded image cache misses", MetricType::Counter, (double)cs.misses),
+            makeFamily("image_cache_bytes", "Decoded image cache size in bytes", MetricType::Gauge, (double)cs.bytes),
+            makeFamily("frame_store_hits_total", "Disk frame cache hits (mapped without decode)", MetricType::Counter, (double)fs.hits),
+            makeFamily("frame_store_misses_total", "Disk frame cache misses", MetricType::Counter, (double)fs.misses),
+            makeFamily("frame_store_writes_total", "Frames written to the disk cache", MetricType::Counter, (double)fs.writes),
+            makeFamily("frame_store_dropped_total", "Frames not written because the write queue was full", MetricType::Counter, (double)fs.dropped),
+            makeFamily("frame_store_evictions_total", "Disk frame cache evictions", MetricType::Counter, (double)fs.evictions),
+            makeFamily("frame_store_bytes", "Disk frame cache size in bytes", MetricType::Gauge, (double)fs.bytes),
+            makeFamily("prefetch_completed_total", "Completed prefetch jobs", MetricType::Counter, (double)ps.completed),
+            makeFamily("prefetch_cancelled_total", "Cancelled prefetch jobs", MetricType::Counter, (double)ps.cancelled),
+            makeFamily("prefetch_dropped_total", "Prefetch jobs dropped because the queue was full", MetricType::Counter, (double)ps.dropped),
+            makeFamily("prefetch_pending", "Queued prefetch jobs", MetricType::Gauge, (double)ps.pending),
+            decodes,
+            makeFamily("image_decoder_checks_total", "Fast PNG decodes cross-checked against OpenCV", MetricType::Counter, (double)ds.checked),
+            makeFamily("image_decoder_mismatches_total", "Fast PNG decodes that differed from OpenCV", MetricType::Counter, (double)ds.mismatches),
+            makeFamily("image_decoder_fast_png_enabled", "1 while the fast PNG decoder is in use", MetricType::Gauge, ds.fastPngEnabled ? 1 : 0),
+            makeFamily("image_decoder_fast_png_tripped", "1 after a cross-check mismatch disabled the fast PNG decoder until restart", MetricType::Gauge, ds.fastPngTripped ? 1 : 0),
+        };
+    });
+    exposer.RegisterCollectable(cacheMetrics);
+
+    auto signatureMetrics = std::make_shared<CallbackCollectable>([] {
+        SignatureStats ss = signatureStats();
+        MetricFamily checks = makeEmptyFamily("watermark_signature_checks_total", "Signed watermark payloads verified, by outcome", MetricType::Counter);
+        addLabeledValue(checks, { {"outcome", "valid"} }, (double)ss.valid);
+        addLabeledValue(checks, { {"outcome", "invalid"} }, (double)ss.invalid);
+        return std::vector<MetricFamily>{ checks,
+            makeFamily("watermark_signature_cache_hits_total", "Signature checks answered from the verification cache", MetricType::Counter, (double)ss.cached),
+        };
+    });
+    exposer.RegisterCollectable(signatureMetrics);
+
+    // 影子流量：SENTINEL_SHADOW_RATE 为采样比例 (0 关闭)，候选实现在此注册
+    ShadowEvaluator shadow(boot->shadowRate, envOr("SENTINEL_SHADOW_DIR", "/tmp/sentinel-shadow"), foreground);
+    shadow.registerCandidate("watermark", "fused-pipeline-v1", [](const json& request, const std::string& output, json& response) {
+        json stages = json::array({ { {"type", "watermark"}, {"text", request.value("watermarkData", "COPYRIGHT-CHECK")} } });
+        processPipeline(request["inputPath"], output, stages, ProcessOptions(), response);
+    });
+    shadow.registerCandidate("forensics", "fused-pipeline-v1", [](const json& request, const std::string& output, json& response) {
+        Pipeline pipeline(json::array({ { {"type", "forensics"} } }));
+        // 与主路径取同一份亮度 (JPEG 的 Y 分量)，只比较流水线本身
+        Mat frame;
+        cvtColor(loadImageLuma(request["inputPath"]), frame, COLOR_GRAY2BGR);
+        pipeline.execute(frame, response);
+        writeImage(output, renderForensicsPreview(pipeline.sidePreview()), CodecOptions());
+    });
+    shadow.registerCandidate("verify", "uncached-decode-v1", [](const json& request, const std::string&, json& response) {
+        // 绕过解码缓存与快速 PNG 解码器，直接用 OpenCV 读取，验证两条路径结果一致
+        Mat img = imread(request["inputPath"].get<std::string>());
+        if (img.empty()) throw std::runtime_error("无法读取图片");
+        VerifyResult result = verifyImage(img);
+        response["success"] = result.success;
+        response["extractedText"] = result.extractedText;
+        response["confidenceScore"] = result.confidenceScore;
+    });
+
+    auto shadowMetrics = std::make_shared<CallbackCollectable>([&shadow] {
+        MetricFamily comparisons = makeEmptyFamily("shadow_comparisons_total", "Shadow evaluations by algorithm and outcome", MetricType::Counter);
+        MetricFamily primaryMs = makeEmptyFamily("shadow_primary_latency_ms_sum", "Primary latency of shadowed requests", MetricType::Counter);
+        MetricFamily candidateMs = makeEmptyFamily("shadow_candidate_latency_ms_sum", "Candidate latency of shadowed requests", MetricType::Counter);
+        MetricFamily pixelDiff = makeEmptyFamily("shadow_max_pixel_diff", "Largest per-channel output difference seen", MetricType::Gauge);
+        for (const auto& kv : shadow.stats()) {
+            const ShadowAlgorithmStats& st = kv.second;
+            addLabeledValue(comparisons, { {"algorithm", kv.first}, {"outcome", "match"} }, (double)st.matched);
+            addLabeledValue(comparisons, { {"algorithm", kv.first}, {"outcome", "mismatch"} }, (double)st.mismatched);
+            addLabeledValue(comparisons, { {"algorithm", kv.first}, {"outcome", "error"} }, (double)st.errors);
+            addLabeledValue(primaryMs, { {"algorithm", kv.first} }, st.primaryMsSum);
+            addLabeledValue(candidateMs, { {"algorithm", kv.first} }, st.candidateMsSum);
+            addLabeledValue(pixelDiff, { {"algorithm", kv.first} }, st.maxPixelDiff);
+        }
+        return std::vector<MetricFamily>{ comparisons, primaryMs, candidateMs, pixelDiff,
+            makeFamily("shadow_dropped_total", "Shadow samples dropped because the queue was full", MetricType::Counter, (double)shadow.dropped()) };
+    });
+    exposer.RegisterCollectable(shadowMetrics);
+
+    // Brownout：按在途请求数与延迟逐级降级预览、压缩与取证精细化
+    BrownoutController brownout;
+
+    auto brownoutMetrics = std::make_shared<CallbackCollectable>([&brownout] {
+        return std::vector<MetricFamily>{
+            makeFamily("brownout_level", "Current brownout level (0 = normal)", MetricType::Gauge, brownout.level()),
+            makeFamily("brownout_latency_ewma_ms", "Latency estimate driving the brownout controller", MetricType::Gauge, brownout.latencyEwmaMs()),
+            makeFamily("request_arena_resets_total", "Requests served from a per-worker arena", MetricType::Counter, (double)requestArenaStats().requests),
+            makeFamily("request_arena_spilled_bytes_total", "Arena bytes that overflowed the retained block", MetricType::Counter, (double)requestArenaStats().spilledBytes),
+        };
+    });
+    exposer.RegisterCollectable(brownoutMetrics);
+
+    // 延迟分位数草图：保留原有直方图，另按 endpoint + algorithm 导出精确分位数
+    // 序列在启动时创建，请求路径上只做无锁写入
+    LatencyRegistry latency;
+    std::map<std::string, LatencySeries*> processLatency;
+    for (const char* label : { "pipeline", "renditions", "watermark", "forensics", "invalid" }) processLatency[label] = latency.series("process", label);
+    LatencySeries* verifyLatency = latency.series("verify", "lsb");
+    auto latencyMetrics = std::make_shared<CallbackCollectable>([&latency] {
+        return makeLatencySummaries(latency);
+    });
+    exposer.RegisterCollectable(latencyMetrics);
+
+    // 多租户公平调度：executionSlots 个执行槽位按各租户实际消耗的 CPU 时间分配。
+    // HTTP 线程多于槽位，排队发生在调度器内部而不是 httplib 的 FIFO 队列；
+    // 排队请求按成本模型预测的耗时短作业优先
+    FairScheduler scheduler(boot->executionSlots);
+    CostModel costModel;
+
+    // 缓存索引快照：启动后在后台按优先级恢复，之后定期写出，退出时再写一次
+    CacheSnapshotter snapshots(envOr("SENTINEL_SNAPSHOT_DIR", "/tmp/sentinel-snapshot"), imageCache, frameStore, costModel, prefetcher);
+    // 热重启时成本模型随预热状态移交 (importWarmState)，不能再被较旧的快照覆盖
+    snapshots.start(boot->snapshotIntervalSeconds, !takeover);
+    auto snapshotMetrics = std::make_shared<CallbackCollectable>([&snapshots] {
+        SnapshotStats ss = snapshots.stats();
+        MetricFamily restored = makeEmptyFamily("cache_snapshot_restored_entries", "Entries restored from the last cache snapshot", MetricType::Gauge);
+        addLabeledValue(restored, { {"index", "frames"} }, (double)ss.restoredFrames);
+        addLabeledValue(restored, { {"index", "images"} }, (double)ss.restoredImages);
+        addLabeledValue(restored, { {"index", "prefetch"} }, (double)ss.restoredHot);
+        return std::vector<MetricFamily>{ restored,
+            makeFamily("cache_snapshot_saves_total", "Cache index snapshots written", MetricType::Counter, (double)ss.saves),
+            makeFamily("cache_snapshot_failures_total", "Cache index snapshots that failed to write", MetricType::Counter, (double)ss.failures),
+            makeFamily("cache_snapshot_last_save_ms", "Duration of the last snapshot write", MetricType::Gauge, ss.lastSaveMs),
+            makeFamily("cache_snapshot_restoring", "1 while snapshots are being restored in the background", MetricType::Gauge, ss.restoring ? 1 : 0),
+        };
+    });
+    exposer.RegisterCollectable(snapshotMetrics);
+
+    // 空闲时重新压缩输出：/process 写出的文件入队，SENTINEL_OUTPUT_DIR 中已有的 PNG 启动时入队
+    Recompressor recompressor(foreground, 4096, boot->recompressIdleSeconds);
+    const std::string outputDir = envOr("SENTINEL_OUTPUT_DIR", "");
+    if (!outputDir.empty()) recompressor.sweep(outputDir);
+    auto recompressMetrics = std::make_shared<CallbackCollectable>([&recompressor] {
+        RecompressStats rs = recompressor.stats();
+        MetricFamily files = makeEmptyFamily("recompress_files_total", "Stored outputs examined by the idle-time recompressor", MetricType::Counter);
+        addLabeledValue(files, { {"outcome", "optimized"} }, (double)rs.optimized);
+        addLabeledValue(files, { {"outcome", "skipped"} }, (double)rs.skipped);
+        addLabeledValue(files, { {"outcome", "rejected"} }, (double)rs.rejected);
+        addLabeledValue(files, { {"outcome", "failed"} }, (double)rs.failed);
+        return std::vector<MetricFamily>{ files,
+            makeFamily("recompress_bytes_saved_total", "Bytes saved by recompressing stored outputs", MetricType::Counter, (double)rs.bytesSaved),
+            makeFamily("recompress_pending", "Outputs waiting for idle-time recompression", MetricType::Gauge, (double)rs.pending),
+        };
+    });
+    exposer.RegisterCollectable(recompressMetrics);
+
+    // brownout L4 推迟的全分辨率取证：同样在前台空闲时补做，替换后的输出再交给 recompressor
+    ForensicsRefiner refiner(foreground, 4096, boot->recompressIdleSeconds,
+        [&recompressor](const std::string& outputPath) { recompressor.enqueue(outputPath); });
+    auto refineMetrics = std::make_shared<CallbackCollectable>([&refiner] {
+        ForensicsRefineStats rs = refiner.stats();
+        MetricFamily jobs = makeEmptyFamily("forensics_refinements_total", "Deferred full-resolution forensics runs", MetricType::Counter);
+        addLabeledValue(jobs, { {"outcome", "refined"} }, (double)rs.refined);
+        addLabeledValue(jobs, { {"outcome", "superseded"} }, (double)rs.superseded);
+        addLabeledValue(jobs, { {"outcome", "failed"} }, (double)rs.failed);
+        return std::vector<MetricFamily>{ jobs,
+            makeFamily("forensics_refinements_pending", "Coarse forensics outputs waiting for idle-time refinement", MetricType::Gauge, (double)rs.pending),
+        };
+    });
+    exposer.RegisterCollectable(refineMetrics);
+
+    // 各阶段硬件性能计数器 (运行时配置 perfCounters 开启)
+    auto perfMetrics = std::make_shared<CallbackCollectable>([] {
+        static const char* const kFamilies[kPerfEventCount][2] = {
+            { "stage_cpu_cycles_total", "CPU cycles spent in each stage (user space)" },
+            { "stage_instructions_total", "Instructions retired in each stage (user space)" },
+            { "stage_llc_misses_total", "Last-level cache misses in each stage" },
+            { "stage_branch_misses_total", "Branch mispredictions in each stage" },
+        };
+        std::vector<MetricFamily> families;
+        for (int i = 0; i < kPerfEventCount; ++i) families.push_back(makeEmptyFamily(kFamilies[i][0], kFamilies[i][1], MetricType::Counter));
+        MetricFamily samples = makeEmptyFamily("stage_counter_samples_total", "Stage executions measured with hardware counters", MetricType::Counter);
+        for (const auto& kv : perfCounterTotals()) {
+            std::map<std::string, std::string> labels = { {"algorithm", kv.first.first}, {"stage", kv.first.second} };
+            for (int i = 0; i < kPerfEventCount; ++i) addLabeledValue(families[i], labels, (double)kv.second.values[i]);
+            addLabeledValue(samples, labels, (double)kv.second.samples);
+        }
+        families.push_back(samples);
+        return families;
+    });
+    exposer.RegisterCollectable(perfMetrics);
+
+    // 可热更新的参数在这里统一下发 (订阅时立即应用一次当前配置)
+    config.subscribe([&](const RuntimeConfig& next, const RuntimeConfig&) {
+        scheduler.setSlots(next.executionSlots);
+        scheduler.setWeights(next.tenantWeights);
+        imageCache.setCapacity(next.imageCacheMB * 1024 * 1024);
+        if (!frameStore.setCapacity(next.frameCacheMB * 1024 * 1024) && frameStore.enabled() != (next.frameCacheMB > 0)) {
+            std::cerr << "[CONFIG] 磁盘帧缓存的开启/关闭需要重启才能生效" << std::endl;
+        }
+        prefetcher.setMaxPending(next.prefetchQueue);
+        shadow.setSampleRate(next.shadowRate);
+        brownout.setThresholds(next.brownout);
+        snapshots.setInterval(next.snapshotIntervalSeconds);
+        recompressor.setIdleSeconds(next.recompressIdleSeconds);
+        refiner.setIdleSeconds(next.recompressIdleSeconds);
+        setPerfCountersEnabled(next.perfCounters);
+        // 比对不一致后的关闭是锁定的，这里重新开启不会恢复快速路径
+        setFastPngDecode(next.fastPngDecode);
+        setDecoderCheckRate(next.decoderCheckRate);
+        setSignatureRequired(next.requireSignature);
+    });
+
+    auto configMetrics = std::make_shared<CallbackCollectable>([&config] {
+        return std::vector<MetricFamily>{
+            makeFamily("config_version", "Runtime configuration version (0 = built-in defaults)", MetricType::Gauge, (double)config.version()),
+            makeFamily("config_reload_failures_total", "Configuration reloads rejected by validation", MetricType::Counter, (double)config.failures()),
+        };
+    });
+    exposer.RegisterCollectable(configMetrics);
+
+    auto schedulerMetrics = std::make_shared<CallbackCollectable>([&scheduler] {
+        MetricFamily cpu = makeEmptyFamily("tenant_cpu_ms_total", "Thread CPU time charged to each tenant", MetricType::Counter);
+        MetricFamily served = makeEmptyFamily("tenant_requests_total", "Requests executed per tenant", MetricType::Counter);
+        MetricFamily waiting = makeEmptyFamily("tenant_waiting_requests", "Requests queued for an execution slot", MetricType::Gauge);
+        for (const auto& kv : scheduler.stats()) {
+            addLabeledValue(cpu, { {"tenant", kv.first} }, kv.second.cpuMs);
+            addLabeledValue(served, { {"tenant", kv.first} }, (double)kv.second.served);
+            addLabeledValue(waiting, { {"tenant", kv.first} }, (double)kv.second.waiting);
+        }
+        return std::vector<MetricFamily>{ cpu, served, waiting };
+    });
+    exposer.RegisterCollectable(schedulerMetrics);
+
+    // brownout 的并发输入：执行中的前台请求 + 在公平调度中排队的请求。
+    // 前台请求获得槽位后才计数，最多 executionSlots 个，只看它就看不到排队深度
+    auto brownoutLoad = [&]() { return foreground.active() + (int)scheduler.waiting(); };
+
+    // 每秒：推进 brownout 控制器、处理 SIGHUP、向飞行记录器写一条状态采样
+    std::atomic<bool> stopping(false);
+    std::thread housekeeping([&] {
+        while (!stopping) {
+            std::this_thread::sleep_for(std::chrono::seconds(1));
+            brownout.tick(brownoutLoad());
+            config.reloadIfSignalled();
+            if (flightRecorderEnabled()) {
+                ImageCacheStats cs = imageCache.stats();
+                FrameStoreStats fs = frameStore.stats();
+                FlightState state = {};
+                state.inflight = (uint32_t)foreground.active();
+                state.schedulerWaiting = (uint32_t)scheduler.waiting();
+                state.prefetchPending = (uint32_t)prefetcher.stats().pending;
+                state.recompressPending = (uint32_t)recompressor.stats().pending;
+                state.brownoutLevel = (uint32_t)brownout.level();
+                state.imageCacheHits = cs.hits;
+                state.imageCacheMisses = cs.misses;
+                state.imageCacheBytes = cs.bytes;
+                state.frameStoreHits = fs.hits;
+                state.frameStoreMisses = fs.misses;
+                state.taskQueueRejected = taskQueueTotals().rejected;
+                state.failedRequests = (uint64_t)metrics->failed_requests->Value();
+                recordFlightState(state);
+            }
+        }
+    });
+
+    HandoffServer svr;
+    // 请求分发：默认为 httplib 自带的线程池，taskQueue = "ring" 时使用无锁环 (task_queue.h，基准见 bench/task_queue_bench.cpp)
+    int httpThreads = boot->httpThreads;
+    bool ringQueue = boot->taskQueue == "ring";
+    svr.new_task_queue = [httpThreads, ringQueue]() -> TaskQueue* {
+        if (ringQueue) return new RingTaskQueue(httpThreads, 16384);
+        return new ThreadPool(httpThreads);
+    };
+    auto taskQueueMetrics = std::make_shared<CallbackCollectable>([] {
+        TaskQueueStats ts = taskQueueTotals();
+        return std::vector<MetricFamily>{
+            makeFamily("task_queue_executed_total", "HTTP tasks executed by the ring dispatch queue", MetricType::Counter, (double)ts.executed),
+            makeFamily("task_queue_rejected_total", "HTTP tasks rejected because the dispatch ring was full", MetricType::Counter, (double)ts.rejected),
+            makeFamily("task_queue_parks_total", "Times an idle dispatch worker stopped spinning and parked", MetricType::Counter, (double)ts.parks),
+        };
+    });
+    exposer.RegisterCollectable(taskQueueMetrics);
 
     // /process 接口 (保留了完整的监控和计时)
-    svr.Post("/process", [metrics](const Request& req, Response& res) {
+    svr.Post("/process", [&](const Request& req, Response& res) {
+        // 请求内的 JSON 节点等小对象从 worker 的 arena 分配，处理结束时整体回收
+        ArenaScope arenaScope;
+        // 获得执行槽位后才计入前台 (brownout、预取、影子评估都以此判断负载)
+        ForegroundScope foregroundScope(foreground, false);
+        FlightEntry flight("process", foreground.active());
         metrics->active_requests->Increment();
         auto start = std::chrono::steady_clock::now();
         metrics->total_requests->Increment();
+        std::string tenant = tenantOf(req);
+        flight.setTenant(tenant);
+        FairScope fairScope(scheduler, tenant);
 
         json body, responseData;
+        std::string latencyLabel = "invalid";
 
         try {
             body = json::parse(req.body);
             std::string input = body["inputPath"];
-            std::string output = body["outputPath"];
-            std::string algo = body["algorithm"];
+            // renditions 请求的输出路径在各个 rendition 中
+            std::string output;
+            if (!body.contains("renditions")) output = body["outputPath"];
+            std::string algo = body.value("algorithm", "pipeline");
             std::string wmText = body.value("watermarkData", "COPYRIGHT-CHECK");
 
-            if (algo == "watermark") {
-                processWatermark(input, output, wmText, responseData);
+            cv::Rect roi = body.contains("roi") ? parseRoi(body["roi"]) : cv::Rect();
+            std::string costKey = costKeyOf(body);
+            ImageProbe probe = probeCached(imageCache, input);
+            double megapixels = workMegapixels(probe, roi);
+            flight.setAlgorithm(costKey);
+            fairScope.enter(costModel.predictMs(costKey, probe.format, megapixels));
+            foregroundScope.enter();
+            flight.markStarted();
+
+            BrownoutPolicy policy = brownout.policy();
+            std::shared_ptr<const RuntimeConfig> tuning = config.current();
+            ProcessOptions options;
+            options.codec = tuning->codec;
+            options.previewBannerHeight = tuning->previewBannerHeight;
+            options.signature = body.value("signature", "");
+            options.roi = roi;
+            if (policy.pngCompression >= 0) options.codec.pngCompression = policy.pngCompression;
+            options.previewMaxSide = policy.previewMaxSide;
+            options.coarseForensics = policy.coarseForensics;
+            responseData["brownoutLevel"] = policy.level;
+            flight.setBrownoutLevel(policy.level);
+
+            if (body.contains("stages")) {
+                // 组合流水线：一次解码、融合逐像素阶段、一次编码
+                latencyLabel = "pipeline";
+                processPipeline(input, output, body["stages"], options, responseData);
+                // 每个 watermark / forensics 阶段与单算法调用一样计数
+                for (const json& stage : body["stages"]) {
+                    std::string type = stage.is_object() ? stage.value("type", "") : "";
+                    if (type == "watermark") metrics->watermark_calls->Increment();
+                    else if (type == "forensics") metrics->forensics_calls->Increment();
+                }
+            }
+            else if (body.contains("renditions")) {
+                // 多尺寸交付：一次解码、共享金字塔、各尺寸并行嵌入与编码
+                latencyLabel = "renditions";
+                processRenditions(input, body["renditions"], wmText, options, responseData);
+                metrics->watermark_calls->Increment();
+            }
+            else if (algo == "watermark") {
+                latencyLabel = algo;
+                processWatermark(input, output, wmText, responseData, options);
                 metrics->watermark_calls->Increment();
             }
             else if (algo == "forensics") {
-                processForensics(input, output, wmText, responseData);
+                latencyLabel = algo;
+                processForensics(input, output, wmText, responseData, options);
                 metrics->forensics_calls->Increment();
             }
             else {
@@ -329,12 +733,34 @@ int main() {
             }
 
             metrics->processed_images->Increment();
+            // 粗略取证结果排队补做，补做完成后才交给 recompressor
+            bool refining = responseData.value("refinementDeferred", false) &&
+                refiner.enqueue(input, output, options.roi, options.codec);
+            if (responseData.value("refinementDeferred", false)) responseData["refinementQueued"] = refining;
             res.set_content(responseData.dump(), "application/json");
+            costModel.observe(costKey, probe.format, megapixels, fairScope.serviceMs());
+            if (body.contains("renditions")) {
+                for (const json& r : responseData["renditions"]) recompressor.enqueue(r["outputPath"].get<std::string>());
+            }
+            else if (!refining) {
+                recompressor.enqueue(output);
+            }
+
+            // 降级期间不做影子评估：既减轻负载，也避免降级输出被误判为差异；
+            // 候选实现不嵌入签名载荷、不支持 roi，这两类请求同样跳过
+            if (!body.contains("stages") && !body.contains("renditions") && policy.level == 0 && options.signature.empty() && roi.empty()) {
+                // 样本会进入后台队列，必须在 arena 之外复制
+                ArenaSuspend arenaSuspend;
+                ShadowSample sample = { algo, body, responseData, fairScope.serviceMs() };
+                shadow.maybeSubmit(sample);
+            }
 
         }
         catch (const std::exception& e) {
             metrics->failed_requests->Increment();
             std::cerr << "[ERROR] " << e.what() << std::endl;
+            flight.setStatus(500);
+            flight.setError(e.what());
             json err = { {"success", false}, {"error", e.what()} };
             res.status = 500;
             res.set_content(err.dump(), "application/json");
@@ -344,12 +770,25 @@ int main() {
         auto dur = std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count();
         metrics->request_duration->Observe(dur);
         metrics->active_requests->Decrement();
+        // 多个 worker 并发读取：只用 find，不能用会插入元素的 operator[]
+        auto latencySeries = processLatency.find(latencyLabel);
+        if (latencySeries == processLatency.end()) latencySeries = processLatency.find("invalid");
+        latencySeries->second->record(elapsedMs(start));
+        // 延迟取执行耗时 (排队等待由公平调度负责)，排队深度通过并发输入反映
+        brownout.observe(fairScope.serviceMs(), brownoutLoad());
         });
 
     // /verify 接口 (保留了完整的监控和计时)
-    svr.Post("/verify", [metrics](const Request& req, Response& res) {
+    svr.Post("/verify", [&](const Request& req, Response& res) {
+        ArenaScope arenaScope;
+        ForegroundScope foregroundScope(foreground, false);
+        FlightEntry flight("verify", foreground.active());
+        flight.setAlgorithm("verify");
         metrics->active_requests->Increment();
         auto start = std::chrono::steady_clock::now();
+        std::string tenant = tenantOf(req);
+        flight.setTenant(tenant);
+        FairScope fairScope(scheduler, tenant);
 
         json body, responseData;
 
@@ -363,12 +802,29 @@ int main() {
                 throw std::runtime_error("Required key 'inputPath' is missing.");
             }
 
-            processVerify(input, "", responseData);
+            cv::Rect roi = body.contains("roi") ? parseRoi(body["roi"]) : cv::Rect();
+            std::string costKey = roi.empty() ? "verify" : "verify+roi";
+            ImageProbe probe = probeCached(imageCache, input);
+            double megapixels = workMegapixels(probe, roi);
+            fairScope.enter(costModel.predictMs(costKey, probe.format, megapixels));
+            foregroundScope.enter();
+            flight.markStarted();
+            processVerify(input, "", responseData, roi);
+            costModel.observe(costKey, probe.format, megapixels, fairScope.serviceMs());
+            responseData["brownoutLevel"] = brownout.level();
             res.set_content(responseData.dump(), "application/json");
 
+            if (brownout.level() == 0 && roi.empty()) {
+                ArenaSuspend arenaSuspend;
+                ShadowSample sample = { "verify", body, responseData, fairScope.serviceMs() };
+                shadow.maybeSubmit(sample);
+            }
+
         }
         catch (const std::exception& e) {
             std::cerr << "[ERROR] Verification Error: " << e.what() << std::endl;
+            flight.setStatus(500);
+            flight.setError(e.what());
             json err = { {"success", false}, {"error", e.what()} };
             res.status = 500;
             res.set_content(err.dump(), "application/json");
@@ -378,6 +834,129 @@ int main() {
         auto dur = std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count();
         metrics->request_duration->Observe(dur);
         metrics->active_requests->Decrement();
+        verifyLatency->record(elapsedMs(start));
+        });
+
+    // /verify/bulk 接口：流式读取 tar / tar.gz / zip 归档并逐条返回 NDJSON，不解包到磁盘。
+    // 所有批量请求共用一半的 CPU 作为 worker 配额 (单个请求可占满)，用尽时返回 503
+    const int bulkWorkers = std::max(1u, std::thread::hardware_concurrency() / 2);
+    BulkWorkerBudget bulkBudget(bulkWorkers);
+    svr.Post("/verify/bulk", [&](const Request& req, Response& res) {
+        std::string input;
+        try {
+            input = requiredString(json::parse(req.body), "inputPath");
+        }
+        catch (const std::exception& e) {
+            sendError(res, 400, e.what());
+            return;
+        }
+        int jobs = bulkBudget.acquire(bulkWorkers);
+        if (jobs == 0) {
+            res.set_header("Retry-After", "5");
+            sendError(res, 503, "批量验证并发已满，请稍后重试");
+            return;
+        }
+        int fd = open(input.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) {
+            bulkBudget.release(jobs);
+            sendError(res, 404, "无法打开归档: " + input);
+            return;
+        }
+        adviseWillNeed(input);
+        // 批量请求同样经过公平调度，worker 线程的 CPU 时间计入该租户；成本按归档大小 (MB) 预测
+        struct stat st;
+        double archiveMb = fstat(fd, &st) == 0 ? st.st_size / 1e6 : 0;
+        std::string tenant = tenantOf(req);
+
+        res.set_chunked_content_provider("application/x-ndjson",
+            [fd, jobs, archiveMb, tenant, &scheduler, &costModel](size_t, DataSink& sink) {
+                FairScope fairScope(scheduler, tenant);
+                fairScope.enter(costModel.predictMs("verify/bulk", "archive", archiveMb));
+                BulkVerifyOptions options;
+                options.jobs = jobs;
+                verifyArchive(fdByteSource(fd), options, [&sink](const std::string& line) {
+                    // 客户端断开时停止读取归档
+                    return sink.write(line.data(), line.size());
+                });
+                costModel.observe("verify/bulk", "archive", archiveMb, fairScope.serviceMs());
+                sink.done();
+                return true;
+            },
+            // 响应结束 (含客户端断开) 时归还配额
+            [fd, jobs, &bulkBudget](bool) {
+                close(fd);
+                bulkBudget.release(jobs);
+            });
+        });
+
+    // /prefetch 接口：上传完成后由 Node 调用，后台低优先级预热缓存
+    svr.Post("/prefetch", [&](const Request& req, Response& res) {
+        try {
+            json body = json::parse(req.body);
+            bool queued = prefetcher.enqueue(requiredString(body, "inputPath"));
+            json out = { {"success", true}, {"queued", queued} };
+            res.status = 202;
+            res.set_content(out.dump(), "application/json");
+        }
+        catch (const std::exception& e) {
+            sendError(res, 400, e.what());
+        }
+        });
+
+    svr.Post("/prefetch/cancel", [&](const Request& req, Response& res) {
+        try {
+            json body = json::parse(req.body);
+            bool cancelled = prefetcher.cancel(requiredString(body, "inputPath"));
+            json out = { {"success", true}, {"cancelled", cancelled} };
+            res.set_content(out.dump(), "application/json");
+        }
+        catch (const std::exception& e) {
+            sendError(res, 400, e.what());
+        }
+        });
+
+    svr.Get("/debug/latency", [&](const Request&, Response& res) {
+        res.set_content(latencyDebugJson(latency).dump(2), "application/json");
+        });
+
+    // 运行时配置：查看当前生效的配置 / 重新加载配置文件 (与 SIGHUP 等价)
+    svr.Get("/admin/config", [&](const Request&, Response& res) {
+        json out = { {"version", config.version()}, {"path", config.path()}, {"config", runtimeConfigJson(*config.current())} };
+        res.set_content(out.dump(2), "application/json");
+        });
+
+    svr.Post("/admin/reload", [&](const Request&, Response& res) {
+        try {
+            uint64_t version = config.reload();
+            json out = { {"success", true}, {"version", version} };
+            res.set_content(out.dump(), "application/json");
+        }
+        catch (const std::exception& e) {
+            sendError(res, 400, e.what());
+        }
+        });
+
+    // 飞行记录器：立即写出当前环 (与 SIGUSR1 等价)，用 sentinel-cli --flight-dump 解码
+    svr.Post("/admin/flight/dump", [](const Request&, Response& res) {
+        try {
+            json out = { {"success", true}, {"path", dumpFlightRecorder("admin")} };
+            res.set_content(out.dump(), "application/json");
+        }
+        catch (const std::exception& e) {
+            sendError(res, 503, e.what());
+        }
+        });
+
+    svr.Get("/debug/cost_model", [&](const Request&, Response& res) {
+        res.set_content(costModelDebugJson(costModel).dump(2), "application/json");
+        });
+
+    svr.Get("/debug/counters", [](const Request&, Response& res) {
+        res.set_content(perfCountersJson().dump(2), "application/json");
+        });
+
+    svr.Get("/debug/shadow", [&](const Request&, Response& res) {
+        res.set_content(shadow.debugJson().dump(2), "application/json");
         });
 
     svr.Get("/health", [](const Request&, Response& res) { res.set_content("C++ Service is Running", "text/plain"); });
@@ -386,7 +965,37 @@ int main() {
         res.set_content("# Prometheus metrics are scraped on port 9100", "text/plain");
         });
 
-    std::cout << ">>> Service Running on http://127.0.0.1:9000" << std::endl;
-    svr.listen("127.0.0.1", 9000);
+    if (takeover) {
+        svr.adoptListeningSocket(inherited.listenFd);
+        importWarmState(inherited.warmState, costModel, prefetcher);
+    }
+    else if (!svr.bind_to_port("127.0.0.1", boot->listenPort)) {
+        std::cerr << "[ERROR] 无法监听端口 " << boot->listenPort << std::endl;
+        stopping = true;
+        housekeeping.join();
+        return 1;
+    }
+
+    // 等待下一次热重启；新进程就绪后停止 accept，listen_after_bind 在在途请求处理完后返回
+    HandoffDonor donor(handoffSocket, svr.listeningSocket(),
+        [&costModel, &imageCache] { return exportWarmState(costModel, imageCache); },
+        [&svr] { svr.stopAccepting(); });
+
+    if (takeover) {
+        confirmHandoff(inherited);
+        std::thread([&exposer, &inherited, metricsAddress] {
+            waitForDonorExit(inherited);
+            // 旧进程退出后 CivetWeb 释放端口可能稍有延迟
+            for (int attempt = 0; attempt < 50 && !exposer.bind(metricsAddress); ++attempt) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(200));
+            }
+        }).detach();
+    }
+
+    std::cout << ">>> Service Running on http://127.0.0.1:" << boot->listenPort << std::endl;
+    svr.listen_after_bind();
+    std::cout << ">>> 在途请求已处理完毕，退出" << std::endl;
+    stopping = true;
+    housekeeping.join();
     return 0;
 }
\ No newline at end of file
@@ -0,0 +1,94 @@
+#pragma once
+// =======================================================
+// 有界无锁 MPMC 环形队列 (Dmitry Vyukov 的序号数组算法)
+// 每个槽位带一个序号：序号 == 位置 表示可写，序号 == 位置 + 1 表示可读。
+// 生产者与消费者各自只对 tail_ / head_ 做一次 CAS，不需要互斥锁；
+// 满或空时立即返回 false，由调用方决定等待策略
+// =======================================================
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <utility>
+
+template <typename T>
+class MpmcRing {
+public:
+    // capacity 向上取整为 2 的幂
+    explicit MpmcRing(size_t capacity) : mask_(roundUp(capacity) - 1), cells_(new Cell[mask_ + 1]), head_(0), tail_(0) {
+        for (size_t i = 0; i <= mask_; ++i) cells_[i].seq.store(i, std::memory_order_relaxed);
+    }
+
+    bool tryPush(T&& value) {
+        size_t pos = tail_.load(std::memory_order_relaxed);
+        for (;;) {
+            Cell& cell = cells_[pos & mask_];
+            size_t seq = cell.seq.load(std::memory_order_acquire);
+            intptr_t diff = (intptr_t)seq - (intptr_t)pos;
+            if (diff == 0) {
+                if (tail_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    cell.value = std::move(value);
+                    cell.seq.store(pos + 1, std::memory_order_release);
+                    return true;
+                }
+            }
+            else if (diff < 0) {
+                return false;  // 满
+            }
+            else {
+                pos = tail_.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    bool tryPop(T& value) {
+        size_t pos = head_.load(std::memory_order_relaxed);
+        for (;;) {
+            Cell& cell = cells_[pos & mask_];
+            size_t seq = cell.seq.load(std::memory_order_acquire);
+            intptr_t diff = (intptr_t)seq - (intptr_t)(pos + 1);
+            if (diff == 0) {
+                if (head_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    value = std::move(cell.value);
+                    cell.value = T();
+                    cell.seq.store(pos + mask_ + 1, std::memory_order_release);
+                    return true;
+                }
+            }
+            else if (diff < 0) {
+                return false;  // 空
+            }
+            else {
+                pos = head_.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    // 近似判断：并发时只作为是否继续等待的提示
+    bool empty() const {
+        size_t pos = head_.load(std::memory_order_relaxed);
+        return cells_[pos & mask_].seq.load(std::memory_order_acquire) != pos + 1;
+    }
+
+    size_t capacity() const { return mask_ + 1; }
+
+private:
+    struct Cell {
+        std::atomic<size_t> seq;
+        T value;
+    };
+
+    static size_t roundUp(size_t n) {
+        size_t p = 2;
+        while (p < n) p <<= 1;
+        return p;
+    }
+
+    const size_t mask_;
+    std::unique_ptr<Cell[]> cells_;
+    // 生产者与消费者的游标放在不同缓存行，避免伪共享
+    alignas(64) std::atomic<size_t> head_;
+    alignas(64) std::atomic<size_t> tail_;
+
+    MpmcRing(const MpmcRing&);
+    MpmcRing& operator=(const MpmcRing&);
+};
@@ -0,0 +1,153 @@
+#include "perf_counters.h"
+#include "flight_recorder.h"
+#include <chrono>
+#include <cerrno>
+#include <cstring>
+#include <linux/perf_event.h>
+#include <mutex>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+using json = ArenaJson;
+
+static const char* const kEventNames[kPerfEventCount] = { "cycles", "instructions", "llc_misses", "branch_misses" };
+
+static std::atomic<bool> g_enabled(false);
+static std::mutex g_mutex;
+static std::map<std::pair<std::string, std::string>, PerfStageTotals> g_totals;
+static std::string g_openError;  // 最近一次打开失败的原因
+
+// =======================================================
+// 每线程计数器组
+// =======================================================
+static int openEvent(uint64_t config, int groupFd) {
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.config = config;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+    return (int)syscall(SYS_perf_event_open, &attr, 0, -1, groupFd, PERF_FLAG_FD_CLOEXEC);
+}
+
+class PerfGroup {
+public:
+    PerfGroup() : leader_(-1), opened_(0) {
+        static const uint64_t kConfigs[kPerfEventCount] = {
+            PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS, PERF_COUNT_HW_CACHE_MISSES, PERF_COUNT_HW_BRANCH_MISSES };
+        // 宿主不支持的事件 (常见于虚拟机里的 LLC misses) 跳过，其余照常计数
+        for (int i = 0; i < kPerfEventCount; ++i) {
+            slot_[i] = -1;
+            int fd = openEvent(kConfigs[i], leader_);
+            if (fd < 0) {
+                std::lock_guard<std::mutex> lock(g_mutex);
+                g_openError = std::string(kEventNames[i]) + ": " + strerror(errno);
+                continue;
+            }
+            if (leader_ < 0) leader_ = fd;
+            else fds_[opened_] = fd;
+            slot_[i] = opened_++;
+        }
+    }
+
+    ~PerfGroup() {
+        for (int i = 1; i < opened_; ++i) close(fds_[i]);
+        if (leader_ >= 0) close(leader_);
+    }
+
+    bool valid() const { return leader_ >= 0; }
+
+    // out: [time_enabled, time_running, 各事件计数 (按 PerfEvent 顺序，缺失为 0)]
+    bool read(uint64_t* out) const {
+        uint64_t buf[3 + kPerfEventCount];
+        ssize_t n = ::read(leader_, buf, sizeof(buf));
+        if (n < (ssize_t)(3 * sizeof(uint64_t)) || buf[0] != (uint64_t)opened_) return false;
+        out[0] = buf[1];
+        out[1] = buf[2];
+        for (int i = 0; i < kPerfEventCount; ++i) out[2 + i] = slot_[i] >= 0 ? buf[3 + slot_[i]] : 0;
+        return true;
+    }
+
+private:
+    int leader_;
+    int fds_[kPerfEventCount];
+    int slot_[kPerfEventCount];
+    int opened_;
+};
+
+// 首次在本线程采样时打开；打开失败的线程不再重试
+static const PerfGroup* threadGroup() {
+    thread_local PerfGroup group;
+    return group.valid() ? &group : nullptr;
+}
+
+static int64_t monotonicNs() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void setPerfCountersEnabled(bool enabled) { g_enabled = enabled; }
+
+bool perfCountersEnabled() { return g_enabled.load(std::memory_order_relaxed); }
+
+// =======================================================
+// PerfScope
+// =======================================================
+PerfScope::PerfScope(const char* algorithm, const char* stage, bool countSample, bool readCounters)
+    : active_(false), flight_(countSample && flightStageActive()), countSample_(countSample), readCounters_(readCounters),
+      algorithm_(algorithm), stage_(stage), startNs_(0) {
+    if (perfCountersEnabled()) {
+        const PerfGroup* group = readCounters_ ? threadGroup() : nullptr;
+        active_ = !readCounters_ || (group && group->read(start_));
+    }
+    if (active_ || flight_) startNs_ = monotonicNs();
+}
+
+PerfScope::~PerfScope() {
+    if (!active_ && !flight_) return;
+    int64_t endNs = monotonicNs();
+    // 同时记入当前请求的飞行记录 (与计数器是否开启无关)
+    if (flight_) flightStage(stage_, endNs - startNs_);
+    if (!active_) return;
+    uint64_t end[kPerfEventCount + 2];
+    if (readCounters_ && !threadGroup()->read(end)) return;
+
+    std::lock_guard<std::mutex> lock(g_mutex);
+    PerfStageTotals& t = g_totals[std::make_pair(std::string(algorithm_), std::string(stage_))];
+    if (countSample_) {
+        t.samples++;
+        t.wallMs += (endNs - startNs_) / 1e6;
+    }
+    if (!readCounters_) return;
+    // 计数器组被复用时只在 running 期间计数，按 enabled / running 放大
+    uint64_t enabled = end[0] - start_[0];
+    uint64_t running = end[1] - start_[1];
+    if (running == 0) return;
+    double scale = running < enabled ? (double)enabled / running : 1.0;
+    for (int i = 0; i < kPerfEventCount; ++i) t.values[i] += (uint64_t)((end[2 + i] - start_[2 + i]) * scale);
+}
+
+std::map<std::pair<std::string, std::string>, PerfStageTotals> perfCounterTotals() {
+    std::lock_guard<std::mutex> lock(g_mutex);
+    return g_totals;
+}
+
+json perfCountersJson() {
+    std::lock_guard<std::mutex> lock(g_mutex);
+    json out = { {"enabled", perfCountersEnabled()}, {"stages", json::array()} };
+    if (!g_openError.empty()) out["openError"] = g_openError;
+    for (const auto& kv : g_totals) {
+        const PerfStageTotals& t = kv.second;
+        json stage = { {"algorithm", kv.first.first}, {"stage", kv.first.second}, {"samples", t.samples}, {"wallMs", t.wallMs} };
+        for (int i = 0; i < kPerfEventCount; ++i) stage[kEventNames[i]] = t.values[i];
+        double instructions = (double)t.values[kPerfInstructions];
+        if (t.values[kPerfCycles] > 0) stage["ipc"] = instructions / t.values[kPerfCycles];
+        if (instructions > 0) {
+            stage["llcMissesPerKiloInstruction"] = t.values[kPerfLlcMisses] * 1000.0 / instructions;
+            stage["branchMissesPerKiloInstruction"] = t.values[kPerfBranchMisses] * 1000.0 / instructions;
+        }
+        out["stages"].push_back(stage);
+    }
+    return out;
+}
@@ -0,0 +1,58 @@
+#pragma once
+// =======================================================
+// 硬件性能计数器 (perf_event_open)
+// 每个线程首次采样时打开一组计数器 (cycles / instructions / LLC misses /
+// branch misses，只统计用户态)，之后一直保持开启；PerfScope 在阶段前后各
+// read() 一次，差值按 (算法, 阶段) 累加。计数器被内核复用时按
+// time_enabled / time_running 缩放。
+// 关闭时 PerfScope 只做一次原子读取；请求带有飞行记录时另外计时并记入该请求
+// (见 flight_recorder.h)。
+// 计数只覆盖调用线程：并行循环外层用 readCounters = false 只记次数和耗时，
+// 循环体内每个工作线程另开 countSample = false 的 PerfScope 累加计数。
+// 宿主不允许 perf_event_open (perf_event_paranoid、容器 seccomp) 时
+// 只记录原因，不影响请求处理
+// =======================================================
+#include "request_arena.h"
+#include <atomic>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <utility>
+
+enum PerfEvent { kPerfCycles = 0, kPerfInstructions, kPerfLlcMisses, kPerfBranchMisses, kPerfEventCount };
+
+struct PerfStageTotals {
+    uint64_t samples;
+    double wallMs;
+    uint64_t values[kPerfEventCount];
+
+    PerfStageTotals() : samples(0), wallMs(0), values() {}
+};
+
+// 运行中开启 / 关闭 (运行时配置 perfCounters)
+void setPerfCountersEnabled(bool enabled);
+bool perfCountersEnabled();
+
+// key 为 (algorithm, stage)
+std::map<std::pair<std::string, std::string>, PerfStageTotals> perfCounterTotals();
+// /debug/counters：各阶段累计值与派生指标 (IPC、每千条指令的未命中数)
+ArenaJson perfCountersJson();
+
+class PerfScope {
+public:
+    // algorithm / stage 只需在 PerfScope 存活期间有效，结束时复制到汇总表
+    PerfScope(const char* algorithm, const char* stage, bool countSample = true, bool readCounters = true);
+    ~PerfScope();
+
+private:
+    bool active_;
+    bool flight_;
+    bool countSample_;
+    bool readCounters_;
+    const char* algorithm_;
+    const char* stage_;
+    int64_t startNs_;
+    uint64_t start_[kPerfEventCount + 2];
+    PerfScope(const PerfScope&);
+    PerfScope& operator=(const PerfScope&);
+};
@@ -0,0 +1,327 @@
+#include "pipeline.h"
+#include "fair_scheduler.h"
+#include "perf_counters.h"
+#include "signed_payload.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <stdexcept>
+
+using json = ArenaJson;
+using namespace cv;
+
+// 融合遍历时每个并行任务处理的行数，保证行带内的数据留在缓存中
+static const int kRowBand = 32;
+
+// =======================================================
+// 逐像素阶段
+// =======================================================
+
+// 亮度 / 对比度：dst = src * contrast + brightness，查表实现
+class AdjustStage : public PipelineStage {
+public:
+    explicit AdjustStage(const json& spec) : PipelineStage("adjust") {
+        double contrast = spec.value("contrast", 1.0);
+        double brightness = spec.value("brightness", 0.0);
+        if (contrast < 0 || contrast > 4) throw std::runtime_error("adjust.contrast 超出范围 [0, 4]");
+        for (int i = 0; i < 256; ++i) lut_[i] = saturate_cast<uchar>(i * contrast + brightness);
+    }
+    bool isPerPixel() const override { return true; }
+    void applyRow(uchar* row, int, int cols) const override {
+        for (int i = 0; i < cols * 3; ++i) row[i] = lut_[row[i]];
+    }
+
+private:
+    uchar lut_[256];
+};
+
+// 灰度化，结果仍为三通道以便后续阶段统一处理
+class GrayscaleStage : public PipelineStage {
+public:
+    GrayscaleStage() : PipelineStage("grayscale") {}
+    bool isPerPixel() const override { return true; }
+    void applyRow(uchar* row, int, int cols) const override {
+        for (int x = 0; x < cols; ++x, row += 3) {
+            uchar gray = (uchar)((row[0] * 29 + row[1] * 150 + row[2] * 77 + 128) >> 8);
+            row[0] = row[1] = row[2] = gray;
+        }
+    }
+};
+
+// LSB 水印：第 y 行的像素对应比特下标 y * cols + x，与 embedWatermark 完全一致；
+// spec.signature 指定签名方案时嵌入签名载荷
+class WatermarkStage : public PipelineStage {
+public:
+    explicit WatermarkStage(const json& spec) : PipelineStage("watermark") {
+        text = spec.value("text", std::string("COPYRIGHT-CHECK"));
+        std::string payload = watermarkPayload(text, spec.value("signature", std::string()));
+        size_t count = payloadBitCount(payload);
+        if (count == 0) throw std::runtime_error("水印内容无效");
+        bits_.reserve(count);
+        for (size_t i = 0; i < count; ++i) bits_.push_back(payloadBit(payload, i));
+    }
+    bool isPerPixel() const override { return true; }
+    void prepare(const Mat& frame) override {
+        if (bits_.size() > (size_t)frame.rows * frame.cols) throw std::runtime_error("图片太小，无法嵌入水印");
+    }
+    void applyRow(uchar* row, int y, int cols) const override {
+        size_t start = (size_t)y * cols;
+        if (start >= bits_.size()) return;
+        size_t n = std::min((size_t)cols, bits_.size() - start);
+        for (size_t x = 0; x < n; ++x) row[x * 3] = (row[x * 3] & 0xFE) | bits_[start + x];
+    }
+
+    std::string text;
+
+private:
+    ArenaVector<uchar> bits_;
+};
+
+// =======================================================
+// 整帧阶段
+// =======================================================
+
+// 可见水印：半透明横幅 + 文字
+class OverlayStage : public PipelineStage {
+public:
+    explicit OverlayStage(const json& spec) : PipelineStage("overlay") {
+        text_ = spec.value("text", std::string("PROTECTED BY IMAGE SENTINEL"));
+    }
+    void applyFrame(Mat& frame, json&) override {
+        int box_h = 60;
+        Rect rect(10, frame.rows - box_h - 10, frame.cols - 20, box_h);
+        if (rect.x >= 0 && rect.y >= 0 && rect.width > 0) {
+            Mat sub_region = frame(rect);
+            addWeighted(sub_region, 0.7, Mat::zeros(sub_region.size(), sub_region.type()), 0.3, 0, sub_region);
+        }
+        putText(frame, text_, Point(30, frame.rows - 30), FONT_HERSHEY_DUPLEX, 0.7, Scalar(255, 255, 255), 1, LINE_AA);
+    }
+
+private:
+    std::string text_;
+};
+
+// 输出像素上限，与 OpenCV 解码上限 (CV_IO_MAX_IMAGE_PIXELS) 的默认值相同
+static const double kMaxResizePixels = (double)(1 << 30);
+
+class ResizeStage : public PipelineStage {
+public:
+    explicit ResizeStage(const json& spec) : PipelineStage("resize"),
+        width_(spec.value("width", (int64_t)0)), height_(spec.value("height", (int64_t)0)), scale_(spec.value("scale", 0.0)) {
+        if (width_ <= 0 && height_ <= 0 && scale_ <= 0) throw std::runtime_error("resize 需要 width/height 或 scale");
+        if (width_ > kMaxResizePixels || height_ > kMaxResizePixels || !(scale_ <= kMaxResizePixels)) {
+            throw std::runtime_error("resize 参数过大");
+        }
+    }
+    void applyFrame(Mat& frame, json&) override {
+        // 先按 double 算出目标尺寸，检查上限后再转成 int，避免溢出或巨量分配
+        double w, h;
+        if (scale_ > 0) {
+            w = frame.cols * scale_;
+            h = frame.rows * scale_;
+        }
+        else if (width_ > 0 && height_ > 0) {
+            w = (double)width_;
+            h = (double)height_;
+        }
+        else if (width_ > 0) {
+            w = (double)width_;
+            h = (double)frame.rows * width_ / frame.cols;
+        }
+        else {
+            w = (double)frame.cols * height_ / frame.rows;
+            h = (double)height_;
+        }
+        w = std::max(1.0, std::round(w));
+        h = std::max(1.0, std::round(h));
+        if (w * h > kMaxResizePixels) {
+            throw std::runtime_error("resize 输出 " + std::to_string((int64_t)w) + "x" + std::to_string((int64_t)h) + " 超过像素上限");
+        }
+        Size target((int)w, (int)h);
+        bool shrinking = (int64_t)target.width * target.height < (int64_t)frame.rows * frame.cols;
+        Mat resized;
+        resize(frame, resized, target, 0, 0, shrinking ? INTER_AREA : INTER_LINEAR);
+        frame = resized;
+    }
+
+private:
+    int64_t width_;
+    int64_t height_;
+    double scale_;
+};
+
+// 取证分析：读取当前画面生成边缘图 (预览在缩小后着色)，不修改输出
+class ForensicsStage : public PipelineStage {
+public:
+    ForensicsStage() : PipelineStage("forensics") {}
+    bool modifiesPixels() const override { return false; }
+    void applyFrame(Mat& frame, json& response) override {
+        preview = detectForensicEdges(frame);
+        response["score"] = 90;
+        response["riskLevel"] = "Low";
+    }
+
+    Mat preview;
+};
+
+static std::unique_ptr<PipelineStage> makeStage(const json& spec) {
+    if (!spec.is_object() || !spec.contains("type") || !spec["type"].is_string()) {
+        throw std::runtime_error("stage 必须是包含 type 字段的对象");
+    }
+    std::string type = spec["type"];
+    if (type == "adjust") return std::unique_ptr<PipelineStage>(new AdjustStage(spec));
+    if (type == "grayscale") return std::unique_ptr<PipelineStage>(new GrayscaleStage());
+    if (type == "watermark") return std::unique_ptr<PipelineStage>(new WatermarkStage(spec));
+    if (type == "overlay") return std::unique_ptr<PipelineStage>(new OverlayStage(spec));
+    if (type == "resize") return std::unique_ptr<PipelineStage>(new ResizeStage(spec));
+    if (type == "forensics") return std::unique_ptr<PipelineStage>(new ForensicsStage());
+    throw std::runtime_error("未知的 stage 类型: " + type);
+}
+
+// =======================================================
+// 执行计划
+// =======================================================
+Pipeline::Pipeline(const json& stages) : reordered_(false) {
+    if (!stages.is_array() || stages.empty()) throw std::runtime_error("stages 必须是非空数组");
+    if (stages.size() > 16) throw std::runtime_error("stages 最多 16 个");
+    for (const json& spec : stages) stages_.push_back(makeStage(spec));
+    if (std::count_if(stages_.begin(), stages_.end(), [](const std::unique_ptr<PipelineStage>& s) { return s->type == "watermark"; }) > 1) {
+        throw std::runtime_error("每个流水线只能包含一个 watermark 阶段");
+    }
+
+    // LSB 水印之后任何修改像素的阶段都会抹掉水印，
+    // 因此把 watermark 移到最后一个修改像素的阶段之后，分析类阶段保持原位
+    for (size_t i = 0; i < stages_.size(); ++i) {
+        if (stages_[i]->type != "watermark") continue;
+        size_t lastModifier = i;
+        for (size_t j = i + 1; j < stages_.size(); ++j) {
+            if (stages_[j]->modifiesPixels() && stages_[j]->type != "watermark") lastModifier = j;
+        }
+        if (lastModifier != i) {
+            std::unique_ptr<PipelineStage> wm = std::move(stages_[i]);
+            stages_.erase(stages_.begin() + i);
+            stages_.insert(stages_.begin() + lastModifier, std::move(wm));
+            reordered_ = true;
+        }
+        break;
+    }
+
+    // 相邻逐像素阶段合并为一个融合遍历
+    for (size_t i = 0; i < stages_.size(); ++i) {
+        PipelineStage* stage = stages_[i].get();
+        if (stage->isPerPixel() && !plan_.empty() && plan_.back().fused) {
+            plan_.back().stages.push_back(stage);
+            continue;
+        }
+        PipelinePass pass;
+        pass.fused = stage->isPerPixel();
+        pass.stages.push_back(stage);
+        plan_.push_back(pass);
+    }
+    for (PipelinePass& pass : plan_) {
+        pass.label = pass.fused ? "fused:" : "";
+        for (size_t i = 0; i < pass.stages.size(); ++i) pass.label += (i ? "+" : "") + pass.stages[i]->type;
+    }
+}
+
+bool Pipeline::hasStage(const std::string& type) const {
+    for (const std::unique_ptr<PipelineStage>& s : stages_) {
+        if (s->type == type) return true;
+    }
+    return false;
+}
+
+json Pipeline::describePlan() const {
+    json passes = json::array();
+    for (const PipelinePass& pass : plan_) {
+        json names = json::array();
+        for (const PipelineStage* s : pass.stages) names.push_back(s->type);
+        passes.push_back({ {"pass", pass.fused ? "fused" : "frame"}, {"stages", names} });
+    }
+    return { {"passes", passes}, {"reordered", reordered_} };
+}
+
+void Pipeline::runFusedPass(const PipelinePass& pass, Mat& frame) {
+    const int rows = frame.rows;
+    const int cols = frame.cols;
+    const int bands = (rows + kRowBand - 1) / kRowBand;
+    CpuAccount* account = currentCpuAccount();
+    parallel_for_(Range(0, bands), [&](const Range& range) {
+        // 计数器只统计所在线程，每个工作线程各自累加到本遍历；CPU 时间记到发起请求的租户
+        PerfScope perf("pipeline", pass.label.c_str(), false);
+        CpuCharge charge(account);
+        for (int band = range.start; band < range.end; ++band) {
+            int yEnd = std::min(rows, (band + 1) * kRowBand);
+            for (int y = band * kRowBand; y < yEnd; ++y) {
+                uchar* row = frame.ptr<uchar>(y);
+                for (const PipelineStage* stage : pass.stages) stage->applyRow(row, y, cols);
+            }
+        }
+    });
+}
+
+void Pipeline::execute(Mat& frame, json& response) {
+    json timings = json::array();
+    for (const PipelinePass& pass : plan_) {
+        auto start = std::chrono::steady_clock::now();
+        PerfScope perf("pipeline", pass.label.c_str(), true, !pass.fused);
+        for (PipelineStage* stage : pass.stages) stage->prepare(frame);
+        if (pass.fused) {
+            runFusedPass(pass, frame);
+        }
+        else {
+            pass.stages[0]->applyFrame(frame, response);
+        }
+        double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        timings.push_back(ms);
+    }
+
+    for (const std::unique_ptr<PipelineStage>& s : stages_) {
+        if (s->type == "forensics") sidePreview_ = static_cast<ForensicsStage*>(s.get())->preview;
+        if (s->type == "watermark") response["embeddedText"] = static_cast<WatermarkStage*>(s.get())->text;
+    }
+    response["passTimingsMs"] = timings;
+}
+
+// =======================================================
+// 流水线入口：解码一次 -> 执行计划 -> 编码一次
+// =======================================================
+void processPipeline(const std::string& inputPath, const std::string& outputPath, const json& stages,
+    const ProcessOptions& options, json& response) {
+    Pipeline pipeline(stages);
+
+    Mat frame;
+    {
+        PerfScope perf("pipeline", "decode");
+        frame = loadProcessingImage(inputPath, options.roi, response).clone();
+    }
+
+    pipeline.execute(frame, response);
+    {
+        PerfScope perf("pipeline", "encode");
+        writeImage(outputPath, frame, options.codec);
+    }
+
+    // 预览：有取证阶段时用取证结果，否则沿用水印预览样式
+    {
+        PerfScope perf("pipeline", "preview");
+        Mat preview_img;
+        if (!pipeline.sidePreview().empty()) {
+            preview_img = renderForensicsPreview(shrinkToMaxSide(pipeline.sidePreview(), options.previewMaxSide));
+        }
+        else if (pipeline.hasStage("watermark")) {
+            preview_img = renderWatermarkPreview(shrinkToMaxSide(frame, options.previewMaxSide), response["embeddedText"].get<std::string>(),
+                options.previewBannerHeight);
+        }
+        else {
+            preview_img = shrinkToMaxSide(frame, options.previewMaxSide);
+        }
+        std::string previewPath = previewPathFor(outputPath);
+        writeImage(previewPath, preview_img, options.codec);
+        response["previewPath"] = previewPath;
+    }
+
+    response["success"] = true;
+    response["plan"] = pipeline.describePlan();
+    response["algorithm"] = "pipeline";
+}
@@ -0,0 +1,62 @@
+#pragma once
+// =======================================================
+// 可组合算法流水线
+// 请求中按顺序列出各阶段；引擎生成执行计划，只解码一次，
+// 相邻的逐像素阶段融合为按行带 (row band) 的单遍扫描，最后只编码一次
+// =======================================================
+#include "algorithms.h"
+#include "request_arena.h"
+#include <memory>
+#include <opencv2/opencv.hpp>
+#include <string>
+#include <vector>
+
+class PipelineStage {
+public:
+    explicit PipelineStage(const std::string& type) : type(type) {}
+    virtual ~PipelineStage() {}
+
+    // 逐像素阶段只依赖当前像素 (及其坐标)，可与相邻的逐像素阶段融合
+    virtual bool isPerPixel() const { return false; }
+    // 分析类阶段只读取画面，不修改输出
+    virtual bool modifiesPixels() const { return true; }
+
+    // 执行前按当前画面尺寸做准备 (例如容量检查)
+    virtual void prepare(const cv::Mat& frame) {}
+    // 逐像素阶段：处理第 y 行 (BGR, cols 个像素)
+    virtual void applyRow(uchar* row, int y, int cols) const {}
+    // 整帧阶段
+    virtual void applyFrame(cv::Mat& frame, ArenaJson& response) {}
+
+    const std::string type;
+};
+
+struct PipelinePass {
+    bool fused;
+    std::vector<PipelineStage*> stages;
+    std::string label;  // 性能计数器的阶段名，如 "fused:adjust+watermark"
+};
+
+class Pipeline {
+public:
+    // 解析请求中的 stages 数组并生成执行计划，参数非法时抛出 std::runtime_error
+    explicit Pipeline(const ArenaJson& stages);
+
+    ArenaJson describePlan() const;
+    void execute(cv::Mat& frame, ArenaJson& response);
+
+    bool hasStage(const std::string& type) const;
+    // 取证阶段的边缘图 (单通道，未着色)
+    const cv::Mat& sidePreview() const { return sidePreview_; }
+
+private:
+    void runFusedPass(const PipelinePass& pass, cv::Mat& frame);
+
+    std::vector<std::unique_ptr<PipelineStage> > stages_;
+    std::vector<PipelinePass> plan_;
+    bool reordered_;
+    cv::Mat sidePreview_;
+};
+
+void processPipeline(const std::string& inputPath, const std::string& outputPath, const ArenaJson& stages,
+    const ProcessOptions& options, ArenaJson& response);
@@ -0,0 +1,335 @@
+#include "png_decoder.h"
+#include <cstdlib>
+#include <cstring>
+#include <utility>
+#include <vector>
+#include <zlib.h>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+static const uint8_t kPngSignature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n' };
+// 与 libpng 默认的 user limit 一致，超出时交给 libpng 报错
+static const uint32_t kMaxDimension = 1000000;
+
+static uint32_t readBigEndian32(const uint8_t* p) {
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | (uint32_t)p[3];
+}
+
+static int channelsOf(int colorType) {
+    switch (colorType) {
+    case 0: return 1;
+    case 4: return 2;
+    case 2: return 3;
+    case 6: return 4;
+    default: return 0;
+    }
+}
+
+bool isPngSignature(const uint8_t* data, size_t size) {
+    return size >= 8 && memcmp(data, kPngSignature, 8) == 0;
+}
+
+bool readPngHeader(const uint8_t* data, size_t size, PngHeader& header, bool& supported) {
+    supported = false;
+    if (!isPngSignature(data, size) || size < 8 + 8 + 13 + 4) return false;
+    const uint8_t* ihdr = data + 8;
+    if (readBigEndian32(ihdr) != 13 || memcmp(ihdr + 4, "IHDR", 4) != 0) return false;
+    const uint8_t* p = ihdr + 8;
+    uint32_t width = readBigEndian32(p);
+    uint32_t height = readBigEndian32(p + 4);
+    header.bitDepth = p[8];
+    header.colorType = p[9];
+    header.interlace = p[12];
+    if (width == 0 || height == 0 || width > kMaxDimension || height > kMaxDimension) return false;
+    header.width = (int)width;
+    header.height = (int)height;
+    supported = header.bitDepth == 8 && channelsOf(header.colorType) > 0 && p[10] == 0 && p[11] == 0 && header.interlace == 0;
+    return true;
+}
+
+// =======================================================
+// 反滤波 (PNG 规范 9.2)
+// =======================================================
+static inline uint8_t paethPredictor(int a, int b, int c) {
+    int pa = std::abs(b - c);
+    int pb = std::abs(a - c);
+    int pc = std::abs(a + b - 2 * c);
+    if (pa <= pb && pa <= pc) return (uint8_t)a;
+    return (uint8_t)(pb <= pc ? b : c);
+}
+
+static void unfilterScalar(int filter, uint8_t* row, const uint8_t* prev, size_t n, int bpp) {
+    switch (filter) {
+    case 1:
+        for (size_t i = bpp; i < n; ++i) row[i] = (uint8_t)(row[i] + row[i - bpp]);
+        break;
+    case 2:
+        for (size_t i = 0; i < n; ++i) row[i] = (uint8_t)(row[i] + prev[i]);
+        break;
+    case 3:
+        for (size_t i = 0; i < (size_t)bpp && i < n; ++i) row[i] = (uint8_t)(row[i] + (prev[i] >> 1));
+        for (size_t i = bpp; i < n; ++i) row[i] = (uint8_t)(row[i] + ((row[i - bpp] + prev[i]) >> 1));
+        break;
+    case 4:
+        for (size_t i = 0; i < (size_t)bpp && i < n; ++i) row[i] = (uint8_t)(row[i] + prev[i]);
+        for (size_t i = bpp; i < n; ++i) row[i] = (uint8_t)(row[i] + paethPredictor(row[i - bpp], prev[i], prev[i - bpp]));
+        break;
+    }
+}
+
+#if defined(__SSE2__)
+// 3 / 4 字节像素：每次在寄存器里处理一个像素，左邻像素保留在寄存器中 (思路同 libpng 的 SSE2 实现)
+static inline __m128i loadPixel(const uint8_t* p, int bpp) {
+    int32_t v = 0;
+    memcpy(&v, p, bpp);
+    return _mm_cvtsi32_si128(v);
+}
+
+static inline void storePixel(uint8_t* p, __m128i v, int bpp) {
+    int32_t t = _mm_cvtsi128_si32(v);
+    memcpy(p, &t, bpp);
+}
+
+static void unfilterSub(uint8_t* row, size_t n, int bpp) {
+    __m128i a = _mm_setzero_si128();
+    for (size_t i = 0; i + bpp <= n; i += bpp) {
+        a = _mm_add_epi8(a, loadPixel(row + i, bpp));
+        storePixel(row + i, a, bpp);
+    }
+}
+
+static void unfilterAvg(uint8_t* row, const uint8_t* prev, size_t n, int bpp) {
+    const __m128i one = _mm_set1_epi8(1);
+    __m128i a = _mm_setzero_si128();
+    for (size_t i = 0; i + bpp <= n; i += bpp) {
+        __m128i b = loadPixel(prev + i, bpp);
+        // _mm_avg_epu8 向上取整，减去 (a ^ b) & 1 得到向下取整的 (a + b) >> 1
+        __m128i avg = _mm_sub_epi8(_mm_avg_epu8(a, b), _mm_and_si128(_mm_xor_si128(a, b), one));
+        a = _mm_add_epi8(loadPixel(row + i, bpp), avg);
+        storePixel(row + i, a, bpp);
+    }
+}
+
+static inline __m128i abs16(__m128i x) {
+    return _mm_max_epi16(x, _mm_sub_epi16(_mm_setzero_si128(), x));
+}
+
+static inline __m128i select16(__m128i mask, __m128i yes, __m128i no) {
+    return _mm_or_si128(_mm_and_si128(mask, yes), _mm_andnot_si128(mask, no));
+}
+
+static void unfilterPaeth(uint8_t* row, const uint8_t* prev, size_t n, int bpp) {
+    const __m128i zero = _mm_setzero_si128();
+    __m128i a = zero, c = zero;  // 16 位展开后的左邻 / 左上
+    for (size_t i = 0; i + bpp <= n; i += bpp) {
+        __m128i b = _mm_unpacklo_epi8(loadPixel(prev + i, bpp), zero);
+        __m128i x = _mm_unpacklo_epi8(loadPixel(row + i, bpp), zero);
+        __m128i pa = _mm_sub_epi16(b, c);
+        __m128i pb = _mm_sub_epi16(a, c);
+        __m128i pc = abs16(_mm_add_epi16(pa, pb));
+        pa = abs16(pa);
+        pb = abs16(pb);
+        __m128i smallest = _mm_min_epi16(pc, _mm_min_epi16(pa, pb));
+        // 平局时按 a、b、c 的优先级
+        __m128i nearest = select16(_mm_cmpeq_epi16(smallest, pc), c, b);
+        nearest = select16(_mm_cmpeq_epi16(smallest, pb), b, nearest);
+        nearest = select16(_mm_cmpeq_epi16(smallest, pa), a, nearest);
+        x = _mm_and_si128(_mm_add_epi16(x, nearest), _mm_set1_epi16(0xff));
+        storePixel(row + i, _mm_packus_epi16(x, x), bpp);
+        a = x;
+        c = b;
+    }
+}
+
+static void unfilterUp(uint8_t* row, const uint8_t* prev, size_t n) {
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m128i x = _mm_loadu_si128((const __m128i*)(row + i));
+        __m128i b = _mm_loadu_si128((const __m128i*)(prev + i));
+        _mm_storeu_si128((__m128i*)(row + i), _mm_add_epi8(x, b));
+    }
+    for (; i < n; ++i) row[i] = (uint8_t)(row[i] + prev[i]);
+}
+#endif
+
+static bool unfilterRow(int filter, uint8_t* row, const uint8_t* prev, size_t n, int bpp) {
+    if (filter == 0) return true;
+    if (filter > 4) return false;
+#if defined(__SSE2__)
+    if (filter == 2) {
+        unfilterUp(row, prev, n);
+        return true;
+    }
+    if (bpp == 3 || bpp == 4) {
+        if (filter == 1) unfilterSub(row, n, bpp);
+        else if (filter == 3) unfilterAvg(row, prev, n, bpp);
+        else unfilterPaeth(row, prev, n, bpp);
+        return true;
+    }
+#endif
+    unfilterScalar(filter, row, prev, n, bpp);
+    return true;
+}
+
+// =======================================================
+// 像素格式转换 -> BGR
+// =======================================================
+static void convertRow(const uint8_t* src, uint8_t* dst, int width, int colorType) {
+    switch (colorType) {
+    case 2:
+        for (int x = 0; x < width; ++x, src += 3, dst += 3) {
+            dst[0] = src[2];
+            dst[1] = src[1];
+            dst[2] = src[0];
+        }
+        break;
+    case 6:
+        for (int x = 0; x < width; ++x, src += 4, dst += 3) {
+            dst[0] = src[2];
+            dst[1] = src[1];
+            dst[2] = src[0];
+        }
+        break;
+    case 0:
+    case 4: {
+        const int step = colorType == 0 ? 1 : 2;
+        for (int x = 0; x < width; ++x, src += step, dst += 3) dst[0] = dst[1] = dst[2] = src[0];
+        break;
+    }
+    }
+}
+
+// =======================================================
+// 解码
+// =======================================================
+struct IdatSpan {
+    const uint8_t* data;
+    uint32_t length;
+    uint32_t crc;  // 块尾记录的 CRC，送入 inflate 前校验
+};
+
+static bool idatCrcOk(const IdatSpan& span) {
+    return (uint32_t)crc32(0L, span.data - 4, span.length + 4) == span.crc;
+}
+
+// imread 不会据此改变像素的附属块。其余附属块一律放弃：eXIf 会让 imread 按方向旋转，
+// tRNS / bKGD 等可能影响颜色转换，未知块的语义也无从保证
+static bool harmlessAncillary(const uint8_t* type) {
+    static const char* const kHarmless[] = { "tEXt", "zTXt", "iTXt", "tIME", "pHYs", "gAMA", "cHRM", "sRGB", "iCCP", "sBIT" };
+    for (const char* name : kHarmless) {
+        if (memcmp(type, name, 4) == 0) return true;
+    }
+    return false;
+}
+
+// 遍历所有块：校验 IDAT 以外关键块的 CRC，收集 IDAT (其 CRC 在使用时才校验，区域解码不读的部分不必计算)；
+// 遇到 PLTE、未知关键块或白名单以外的附属块时放弃
+static bool collectIdat(const uint8_t* data, size_t size, std::vector<IdatSpan>& idat) {
+    size_t pos = 8;
+    bool seenEnd = false;
+    while (!seenEnd) {
+        if (size - pos < 12) return false;
+        uint32_t length = readBigEndian32(data + pos);
+        if (length > size - pos - 12) return false;
+        const uint8_t* type = data + pos + 4;
+        const uint8_t* body = type + 4;
+        bool critical = !(type[0] & 0x20);
+        if (memcmp(type, "IDAT", 4) == 0) {
+            IdatSpan span = { body, length, readBigEndian32(body + length) };
+            idat.push_back(span);
+        }
+        else if (critical && (uint32_t)crc32(0L, type, length + 4) != readBigEndian32(body + length)) {
+            return false;
+        }
+        else if (memcmp(type, "IEND", 4) == 0) seenEnd = true;
+        else if (critical ? memcmp(type, "IHDR", 4) != 0 : !harmlessAncillary(type)) return false;
+        pos += 12 + (size_t)length;
+    }
+    return !idat.empty();
+}
+
+// 解码 [y0, y1) 行中 [x0, x0 + width) 列。之前的行仍要 inflate 与反滤波 (Up / Avg / Paeth 依赖上一行)，
+// 但不做格式转换；y1 之后的数据不再读取。完整解码 (y1 == height) 时额外校验 zlib 尾部与全部 IDAT 的 CRC
+static bool decodeRows(const uint8_t* data, size_t size, int x0, int y0, int width, int y1, uint8_t* out, size_t outStride) {
+    PngHeader header;
+    bool supported;
+    if (!readPngHeader(data, size, header, supported) || !supported) return false;
+    if (x0 < 0 || y0 < 0 || width <= 0 || y1 <= y0 || x0 + width > header.width || y1 > header.height) return false;
+    const bool complete = y1 == header.height;
+    std::vector<IdatSpan> idat;
+    if (!collectIdat(data, size, idat)) return false;
+
+    const int bpp = channelsOf(header.colorType);
+    const size_t rowBytes = (size_t)header.width * bpp;
+    // [filter][row] 两行交替使用，prev 的第一行为全 0
+    std::vector<uint8_t> buffers(2 * (rowBytes + 1), 0);
+    uint8_t* cur = buffers.data();
+    uint8_t* prev = cur + rowBytes + 1;
+
+    z_stream zs;
+    memset(&zs, 0, sizeof(zs));
+    if (inflateInit(&zs) != Z_OK) return false;
+    size_t nextIdat = 0;
+    bool ok = true;
+    int status = Z_OK;
+    for (int y = 0; ok && y < y1; ++y) {
+        zs.next_out = cur;
+        zs.avail_out = (uInt)(rowBytes + 1);
+        while (zs.avail_out > 0) {
+            if (zs.avail_in == 0 && nextIdat < idat.size()) {
+                if (!idatCrcOk(idat[nextIdat])) {
+                    ok = false;
+                    break;
+                }
+                zs.next_in = (Bytef*)idat[nextIdat].data;
+                zs.avail_in = idat[nextIdat].length;
+                nextIdat++;
+            }
+            status = inflate(&zs, Z_NO_FLUSH);
+            // 数据不足 (提前结束或 IDAT 已用完) 时由 libpng 决定如何处理
+            if (status == Z_STREAM_END && zs.avail_out > 0) ok = false;
+            if (status != Z_OK && status != Z_STREAM_END) ok = false;
+            if (status == Z_BUF_ERROR || !ok) {
+                ok = false;
+                break;
+            }
+        }
+        if (!ok) break;
+        ok = unfilterRow(cur[0], cur + 1, prev + 1, rowBytes, bpp);
+        if (ok && y >= y0) convertRow(cur + 1 + (size_t)x0 * bpp, out + (size_t)(y - y0) * outStride, width, header.colorType);
+        std::swap(cur, prev);
+    }
+    // 行数据之后只允许剩下 zlib 尾部的 Adler-32；多余的像素数据交给 libpng 处理
+    while (ok && complete && status != Z_STREAM_END) {
+        uint8_t extra;
+        if (zs.avail_in == 0 && nextIdat < idat.size()) {
+            if (!idatCrcOk(idat[nextIdat])) {
+                ok = false;
+                break;
+            }
+            zs.next_in = (Bytef*)idat[nextIdat].data;
+            zs.avail_in = idat[nextIdat].length;
+            nextIdat++;
+        }
+        zs.next_out = &extra;
+        zs.avail_out = 1;
+        status = inflate(&zs, Z_NO_FLUSH);
+        ok = (status == Z_OK || status == Z_STREAM_END) && zs.avail_out == 1;
+    }
+    // zlib 流之后剩余的 IDAT (通常为空块) 也要通过 CRC
+    for (size_t i = nextIdat; ok && complete && i < idat.size(); ++i) ok = idatCrcOk(idat[i]);
+    inflateEnd(&zs);
+    return ok;
+}
+
+bool decodePngBgr(const uint8_t* data, size_t size, uint8_t* out, size_t outStride) {
+    PngHeader header;
+    bool supported;
+    if (!readPngHeader(data, size, header, supported) || !supported) return false;
+    return decodeRows(data, size, 0, 0, header.width, header.height, out, outStride);
+}
+
+bool decodePngBgrRegion(const uint8_t* data, size_t size, int x, int y, int width, int height, uint8_t* out, size_t outStride) {
+    return decodeRows(data, size, x, y, width, y + height, out, outStride);
+}
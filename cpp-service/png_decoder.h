@@ -0,0 +1,35 @@
+#pragma once
+// =======================================================
+// 快速 PNG 解码 (不依赖 OpenCV)
+// 只覆盖服务自己产出的常见格式：8 位、非隔行、灰度 / 灰度+Alpha / RGB / RGBA，
+// 无调色板，附属块只接受不影响像素的白名单 (文本、pHYs、色彩空间等；eXIf / tRNS 不在其中)。
+// 输出与 imread(IMREAD_COLOR) 相同的 BGR 像素
+// (Alpha 直接丢弃，灰度复制到三个通道)。
+// IDAT 按行流式 inflate 到两行缓冲区，反滤波后立即转成 BGR 写出，
+// 工作集只有两行；Sub / Avg / Paeth / Up 反滤波在 x86 上用 SSE2 实现。
+// 任何不支持或异常的输入 (CRC 错误、数据长度不符 ...) 都返回 false，
+// 由调用方回退到 libpng，错误处理行为与原路径保持一致
+// =======================================================
+#include <cstddef>
+#include <cstdint>
+
+struct PngHeader {
+    int width;
+    int height;
+    int bitDepth;
+    int colorType;
+    int interlace;
+};
+
+bool isPngSignature(const uint8_t* data, size_t size);
+
+// 解析 IHDR；返回 true 且 supported 为 true 时可以用 decodePngBgr 解码
+bool readPngHeader(const uint8_t* data, size_t size, PngHeader& header, bool& supported);
+
+// 解码为 BGR，out 至少 height 行，每行 outStride 字节 (>= width * 3)
+bool decodePngBgr(const uint8_t* data, size_t size, uint8_t* out, size_t outStride);
+
+// 只解码 (x, y, width, height) 区域：读到区域最后一行即停止，之后的 IDAT 不再 inflate
+// (也就无法校验 zlib 尾部与其后的 CRC)。区域必须在图像内
+bool decodePngBgrRegion(const uint8_t* data, size_t size, int x, int y, int width, int height, uint8_t* out, size_t outStride);
+
@@ -0,0 +1,176 @@
+#include "prefetch.h"
+#include "file_utils.h"
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <vector>
+
+// =======================================================
+// 前台请求计数
+// =======================================================
+static int64_t steadyNowMs() {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+ForegroundTracker::ForegroundTracker() : active_(0), lastLeaveMs_(steadyNowMs()) {}
+
+void ForegroundTracker::enter() { active_++; }
+
+void ForegroundTracker::leave() {
+    lastLeaveMs_ = steadyNowMs();
+    if (--active_ == 0) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        idle_.notify_all();
+    }
+}
+
+bool ForegroundTracker::waitIdle(int timeoutMs) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    return idle_.wait_for(lock, std::chrono::milliseconds(timeoutMs), [this] { return active_.load() == 0; });
+}
+
+int64_t ForegroundTracker::idleForMs() const {
+    if (active_.load() > 0) return 0;
+    return std::max<int64_t>(0, steadyNowMs() - lastLeaveMs_.load());
+}
+
+void lowerCurrentThreadPriority() {
+    pid_t tid = (pid_t)syscall(SYS_gettid);
+    setpriority(PRIO_PROCESS, tid, 19);
+#ifdef SYS_ioprio_set
+    const int IOPRIO_WHO_PROCESS = 1;
+    const int IOPRIO_CLASS_IDLE = 3;
+    syscall(SYS_ioprio_set, IOPRIO_WHO_PROCESS, tid, IOPRIO_CLASS_IDLE << 13);
+#endif
+}
+
+// =======================================================
+// 预取任务
+// =======================================================
+Prefetcher::Prefetcher(ImageCache& cache, ForegroundTracker& foreground, size_t maxPending)
+    : cache_(cache), foreground_(foreground), maxPending_(maxPending), stopping_(false),
+      queued_(0), completed_(0), cancelled_(0), dropped_(0) {
+    worker_ = std::thread([this] { run(); });
+}
+
+Prefetcher::~Prefetcher() {
+    stopping_ = true;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (auto& kv : jobs_) kv.second->cancelled = true;
+        wake_.notify_all();
+    }
+    worker_.join();
+}
+
+void Prefetcher::setMaxPending(size_t maxPending) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    maxPending_ = maxPending;
+}
+
+bool Prefetcher::enqueue(const std::string& path) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (jobs_.count(path)) return false;
+    if (queue_.size() >= maxPending_) {
+        dropped_++;
+        return false;
+    }
+    std::shared_ptr<Job> job = std::make_shared<Job>(path);
+    queue_.push_back(job);
+    jobs_[path] = job;
+    queued_++;
+    wake_.notify_one();
+    return true;
+}
+
+bool Prefetcher::cancel(const std::string& path) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = jobs_.find(path);
+    if (it == jobs_.end()) return false;
+    it->second->cancelled = true;
+    for (auto q = queue_.begin(); q != queue_.end(); ++q) {
+        if (*q == it->second) {
+            queue_.erase(q);
+            jobs_.erase(it);
+            cancelled_++;
+            break;
+        }
+    }
+    return true;
+}
+
+PrefetchStats Prefetcher::stats() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    PrefetchStats s = { queued_.load(), completed_.load(), cancelled_.load(), dropped_.load(), queue_.size() };
+    return s;
+}
+
+void Prefetcher::run() {
+    lowerCurrentThreadPriority();
+    while (true) {
+        std::shared_ptr<Job> job;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            wake_.wait(lock, [this] { return stopping_ || !queue_.empty(); });
+            if (stopping_) return;
+            job = queue_.front();
+            queue_.pop_front();
+        }
+
+        try {
+            execute(*job);
+        }
+        catch (const std::exception& e) {
+            std::cerr << "[WARN] Prefetch " << job->path << ": " << e.what() << std::endl;
+        }
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        jobs_.erase(job->path);
+        if (job->cancelled) cancelled_++;
+        else completed_++;
+    }
+}
+
+bool Prefetcher::yieldToForeground(const Job& job) {
+    while (!job.cancelled && !stopping_) {
+        if (foreground_.active() == 0) return true;
+        foreground_.waitIdle(50);
+    }
+    return false;
+}
+
+void Prefetcher::execute(Job& job) {
+    CachedImage existing;
+    if (cache_.lookup(job.path, existing) && !existing.pixels.empty() && existing.hasPerceptualHash) return;
+
+    // 1. 头部探测
+    if (!yieldToForeground(job)) return;
+    CachedImage info;
+    info.probe = probeImageFile(job.path);
+    if (!info.probe.valid()) return;
+
+    // 2. 读入并计算内容哈希
+    if (!yieldToForeground(job)) return;
+    std::vector<uchar> bytes;
+    if (!readFile(job.path, bytes)) return;
+    info.content = contentKeyOf(bytes.data(), bytes.size());
+    info.hasContentHash = true;
+    cache_.merge(job.path, info);
+
+    // 3. 解码入缓存 (磁盘帧缓存命中时直接映射)
+    if (!yieldToForeground(job)) return;
+    cv::Mat img = cache_.decode(bytes, info.content);
+    bytes.clear();
+    if (img.empty()) return;
+
+    // 4. 感知哈希
+    if (!yieldToForeground(job)) return;
+    CachedImage decoded;
+    decoded.pixels = img;
+    decoded.perceptualHash = perceptualHash64(img);
+    decoded.hasPerceptualHash = true;
+    cache_.merge(job.path, decoded);
+}
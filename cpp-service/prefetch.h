@@ -0,0 +1,110 @@
+#pragma once
+// =======================================================
+// 上传后预取：在用户点击处理之前，用低优先级后台线程完成
+// 头部探测、内容哈希、解码入缓存、感知哈希，使后续 /process / /verify 直接命中缓存。
+// 有前台请求在执行时让出，任务可随时取消
+// =======================================================
+#include "image_cache.h"
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+
+// 前台请求计数，后台任务在计数非零时等待
+class ForegroundTracker {
+public:
+    ForegroundTracker();
+
+    void enter();
+    void leave();
+    int active() const { return active_.load(); }
+    // 等待前台空闲；超时返回 false
+    bool waitIdle(int timeoutMs);
+    // 前台已连续空闲的毫秒数，有请求在执行时为 0
+    int64_t idleForMs() const;
+
+private:
+    std::atomic<int> active_;
+    std::atomic<int64_t> lastLeaveMs_;
+    std::mutex mutex_;
+    std::condition_variable idle_;
+};
+
+class ForegroundScope {
+public:
+    explicit ForegroundScope(ForegroundTracker& tracker, bool enterNow = true) : tracker_(tracker), entered_(false) {
+        if (enterNow) enter();
+    }
+    ~ForegroundScope() {
+        if (entered_) tracker_.leave();
+    }
+    // 延迟进入：在公平调度队列中等待的请求还没有占用 CPU，不算前台
+    void enter() {
+        if (entered_) return;
+        tracker_.enter();
+        entered_ = true;
+    }
+
+private:
+    ForegroundTracker& tracker_;
+    bool entered_;
+    ForegroundScope(const ForegroundScope&);
+    ForegroundScope& operator=(const ForegroundScope&);
+};
+
+// 把当前线程设为低 CPU / IO 优先级 (nice 19 + IOPRIO_CLASS_IDLE)
+void lowerCurrentThreadPriority();
+
+struct PrefetchStats {
+    uint64_t queued;
+    uint64_t completed;
+    uint64_t cancelled;
+    uint64_t dropped;
+    size_t pending;
+};
+
+class Prefetcher {
+public:
+    Prefetcher(ImageCache& cache, ForegroundTracker& foreground, size_t maxPending);
+    ~Prefetcher();
+
+    // 入队成功返回 true；队列已满或重复提交返回 false
+    bool enqueue(const std::string& path);
+    // 取消排队中或执行中的任务
+    bool cancel(const std::string& path);
+    PrefetchStats stats() const;
+    // 只影响之后的入队，已排队的任务不会被丢弃
+    void setMaxPending(size_t maxPending);
+
+private:
+    struct Job {
+        std::string path;
+        std::atomic<bool> cancelled;
+        explicit Job(const std::string& p) : path(p), cancelled(false) {}
+    };
+
+    void run();
+    void execute(Job& job);
+    // 每个步骤之前调用：等待前台空闲，任务被取消或服务停止时返回 false
+    bool yieldToForeground(const Job& job);
+
+    ImageCache& cache_;
+    ForegroundTracker& foreground_;
+    size_t maxPending_;
+
+    mutable std::mutex mutex_;
+    std::condition_variable wake_;
+    std::deque<std::shared_ptr<Job> > queue_;
+    std::unordered_map<std::string, std::shared_ptr<Job> > jobs_; // 排队中 + 执行中
+    std::atomic<bool> stopping_;
+    std::atomic<uint64_t> queued_;
+    std::atomic<uint64_t> completed_;
+    std::atomic<uint64_t> cancelled_;
+    std::atomic<uint64_t> dropped_;
+    std::thread worker_;
+};
@@ -0,0 +1,225 @@
+#include "recompress.h"
+#include "algorithms.h"
+#include "file_utils.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <dirent.h>
+#include <fcntl.h>
+#include <iostream>
+#include <opencv2/opencv.hpp>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vector>
+
+using namespace cv;
+
+// 节省不到 2% 时不替换，避免为几十字节改写文件、使下游缓存失效
+static const double kMinSavingRatio = 0.02;
+static const int kPollMs = 200;
+
+// =======================================================
+// PNG 检查与文件操作
+// =======================================================
+static uint32_t readBigEndian32(const unsigned char* p) {
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | (uint32_t)p[3];
+}
+
+// 只含 IHDR / PLTE / IDAT / IEND 的 PNG 才能无损地重新编码；
+// 其余块 (iCCP、tEXt、pHYs ...) OpenCV 编码器不会写回
+static bool isPlainPng(const std::vector<unsigned char>& bytes) {
+    static const unsigned char kSignature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n' };
+    if (bytes.size() < 8 || memcmp(bytes.data(), kSignature, 8) != 0) return false;
+    size_t pos = 8;
+    while (pos + 12 <= bytes.size()) {
+        uint32_t length = readBigEndian32(&bytes[pos]);
+        std::string type((const char*)&bytes[pos + 4], 4);
+        if (type != "IHDR" && type != "PLTE" && type != "IDAT" && type != "IEND") return false;
+        if (type == "IEND") return true;
+        if (length > bytes.size() - pos - 12) return false;
+        pos += 12 + length;
+    }
+    return false;
+}
+
+static bool sameFile(const struct stat& a, const struct stat& b) {
+    return a.st_ino == b.st_ino && a.st_dev == b.st_dev && a.st_size == b.st_size &&
+        a.st_mtim.tv_sec == b.st_mtim.tv_sec && a.st_mtim.tv_nsec == b.st_mtim.tv_nsec;
+}
+
+static bool samePixels(const Mat& a, const Mat& b) {
+    if (a.rows != b.rows || a.cols != b.cols || a.type() != b.type()) return false;
+    for (int y = 0; y < a.rows; ++y) {
+        if (memcmp(a.ptr(y), b.ptr(y), a.cols * a.elemSize()) != 0) return false;
+    }
+    return true;
+}
+
+// 临时文件放在同一目录下，保证 rename 是同一文件系统内的原子替换。
+// 文件名由 mkostemp 生成 (O_EXCL)，不会与并发的写入冲突或跟随预先放置的链接；成功时 tmpPath 为其路径
+static bool writeReplacement(const std::string& path, std::string& tmpPath, const std::vector<unsigned char>& bytes, mode_t mode) {
+    std::string pattern = parentDir(path) + "/." + path.substr(path.find_last_of('/') + 1) + ".recompress.XXXXXX";
+    std::vector<char> name(pattern.begin(), pattern.end());
+    name.push_back('\0');
+    int fd = mkostemp(name.data(), O_CLOEXEC);
+    if (fd < 0) return false;
+    tmpPath = name.data();
+    size_t off = 0;
+    bool ok = fchmod(fd, mode & 07777) == 0;
+    while (ok && off < bytes.size()) {
+        ssize_t n = write(fd, bytes.data() + off, bytes.size() - off);
+        ok = n > 0;
+        if (ok) off += (size_t)n;
+    }
+    ok = ok && fdatasync(fd) == 0;
+    close(fd);
+    if (!ok) unlink(tmpPath.c_str());
+    return ok;
+}
+
+// =======================================================
+// Recompressor
+// =======================================================
+Recompressor::Recompressor(ForegroundTracker& foreground, size_t maxPending, int idleSeconds)
+    : foreground_(foreground), maxPending_(maxPending), idleSeconds_(idleSeconds), stopping_(false),
+      optimized_(0), skipped_(0), rejected_(0), failed_(0), bytesSaved_(0) {
+    worker_ = std::thread([this] { run(); });
+}
+
+Recompressor::~Recompressor() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+        wake_.notify_all();
+    }
+    worker_.join();
+}
+
+bool Recompressor::enqueue(const std::string& path) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (queued_.count(path) || queue_.size() >= maxPending_) return false;
+    queue_.push_back(path);
+    queued_.insert(path);
+    wake_.notify_one();
+    return true;
+}
+
+size_t Recompressor::sweep(const std::string& dir) {
+    size_t count = 0;
+    DIR* d = opendir(dir.c_str());
+    if (!d) return 0;
+    while (struct dirent* e = readdir(d)) {
+        std::string name = e->d_name;
+        if (name.size() > 4 && name[0] != '.' && name.compare(name.size() - 4, 4, ".png") == 0 &&
+            enqueue(dir + "/" + name)) count++;
+    }
+    closedir(d);
+    return count;
+}
+
+void Recompressor::setIdleSeconds(int idleSeconds) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    idleSeconds_ = idleSeconds;
+    wake_.notify_all();
+}
+
+RecompressStats Recompressor::stats() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    RecompressStats s = { optimized_.load(), skipped_.load(), rejected_.load(), failed_.load(), bytesSaved_.load(), queue_.size() };
+    return s;
+}
+
+bool Recompressor::waitForIdle() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (!stopping_) {
+        if (idleSeconds_ <= 0 || queue_.empty()) {
+            wake_.wait(lock);
+            continue;
+        }
+        if (foreground_.idleForMs() >= (int64_t)idleSeconds_ * 1000) return true;
+        wake_.wait_for(lock, std::chrono::milliseconds(kPollMs));
+    }
+    return false;
+}
+
+void Recompressor::run() {
+    lowerCurrentThreadPriority();
+    while (waitForIdle()) {
+        std::string path;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (queue_.empty()) continue;
+            path = queue_.front();
+            queue_.pop_front();
+        }
+        process(path);
+        std::lock_guard<std::mutex> lock(mutex_);
+        queued_.erase(path);
+    }
+}
+
+void Recompressor::process(const std::string& path) {
+    struct stat before;
+    std::vector<unsigned char> original;
+    if (stat(path.c_str(), &before) != 0 || !readFile(path, original)) {
+        failed_++;
+        return;
+    }
+    if (!isPlainPng(original)) {
+        skipped_++;
+        return;
+    }
+
+    Mat pixels = imdecode(original, IMREAD_UNCHANGED);
+    if (pixels.empty()) {
+        failed_++;
+        return;
+    }
+
+    // 最高压缩级别下逐个尝试 deflate 策略，取最小结果；每次编码前让出给前台
+    static const int kStrategies[] = { IMWRITE_PNG_STRATEGY_DEFAULT, IMWRITE_PNG_STRATEGY_FILTERED, IMWRITE_PNG_STRATEGY_RLE };
+    std::vector<unsigned char> best;
+    for (int strategy : kStrategies) {
+        while (foreground_.active() > 0) foreground_.waitIdle(kPollMs);
+        std::vector<unsigned char> encoded;
+        std::vector<int> params = { IMWRITE_PNG_COMPRESSION, 9, IMWRITE_PNG_STRATEGY, strategy };
+        if (imencode(".png", pixels, encoded, params) && (best.empty() || encoded.size() < best.size())) best.swap(encoded);
+    }
+    if (best.empty() || best.size() > original.size() * (1.0 - kMinSavingRatio)) {
+        skipped_++;
+        return;
+    }
+
+    // 替换前校验：像素逐位一致，水印提取结果不变
+    Mat roundTrip = imdecode(best, IMREAD_UNCHANGED);
+    if (roundTrip.empty() || !samePixels(pixels, roundTrip)) {
+        rejected_++;
+        std::cerr << "[RECOMPRESS] 重新编码后像素不一致，保留原文件: " << path << std::endl;
+        return;
+    }
+    Mat originalBgr = imdecode(original, IMREAD_COLOR);
+    Mat candidateBgr = imdecode(best, IMREAD_COLOR);
+    VerifyResult expected = verifyImage(originalBgr);
+    VerifyResult actual = verifyImage(candidateBgr);
+    if (expected.success != actual.success || expected.extractedText != actual.extractedText) {
+        rejected_++;
+        std::cerr << "[RECOMPRESS] 重新编码后水印提取结果变化，保留原文件: " << path << std::endl;
+        return;
+    }
+
+    std::string tmpPath;
+    if (!writeReplacement(path, tmpPath, best, before.st_mode)) {
+        failed_++;
+        return;
+    }
+    // 处理期间文件被重新生成时放弃，以新文件为准
+    struct stat now;
+    if (stat(path.c_str(), &now) != 0 || !sameFile(before, now) || rename(tmpPath.c_str(), path.c_str()) != 0) {
+        unlink(tmpPath.c_str());
+        failed_++;
+        return;
+    }
+    optimized_++;
+    bytesSaved_ += original.size() - best.size();
+}
@@ -0,0 +1,66 @@
+#pragma once
+// =======================================================
+// 空闲时重新压缩已存储的输出
+// 请求路径上的编码受延迟预算限制 (brownout 时甚至降低 PNG 压缩级别)，
+// 输出文件普遍偏大。前台连续空闲一段时间后，后台线程以最高压缩级别
+// 尝试多种 deflate 策略重新编码 PNG，取最小结果，并在替换前确认：
+//   - 解码后像素逐位一致 (尺寸 / 通道 / 位深 / 每个值)
+//   - 水印提取结果 (成功与否、文本) 与原文件一致
+//   - 文件在处理期间没有被改写
+// 通过后以 临时文件 + fdatasync + rename 原子替换。带有附加块 (ICC、文本等)
+// 的 PNG 和非 PNG 输出不处理，重新编码会丢失这些信息
+// =======================================================
+#include "prefetch.h"
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+
+struct RecompressStats {
+    uint64_t optimized;   // 已原子替换
+    uint64_t skipped;     // 非 PNG / 带附加块 / 压缩后不够小
+    uint64_t rejected;    // 像素或水印校验不一致，保留原文件
+    uint64_t failed;      // 读写错误或文件在处理期间被改写
+    uint64_t bytesSaved;
+    size_t pending;
+};
+
+class Recompressor {
+public:
+    Recompressor(ForegroundTracker& foreground, size_t maxPending, int idleSeconds);
+    ~Recompressor();
+
+    // 入队成功返回 true；队列已满或重复提交返回 false
+    bool enqueue(const std::string& path);
+    // 把目录下 (不递归) 的 .png 文件全部入队，返回入队数量
+    size_t sweep(const std::string& dir);
+    // 前台需要连续空闲多少秒才开始处理；0 表示暂停
+    void setIdleSeconds(int idleSeconds);
+    RecompressStats stats() const;
+
+private:
+    void run();
+    // 等待前台连续空闲 idleSeconds_ 秒；服务停止时返回 false
+    bool waitForIdle();
+    void process(const std::string& path);
+
+    ForegroundTracker& foreground_;
+    const size_t maxPending_;
+
+    mutable std::mutex mutex_;
+    std::condition_variable wake_;
+    std::deque<std::string> queue_;
+    std::set<std::string> queued_;
+    int idleSeconds_;
+    bool stopping_;
+
+    std::atomic<uint64_t> optimized_;
+    std::atomic<uint64_t> skipped_;
+    std::atomic<uint64_t> rejected_;
+    std::atomic<uint64_t> failed_;
+    std::atomic<uint64_t> bytesSaved_;
+    std::thread worker_;
+};
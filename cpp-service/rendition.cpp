@@ -0,0 +1,137 @@
+#include "rendition.h"
+#include "fair_scheduler.h"
+#include "perf_counters.h"
+#include "signed_payload.h"
+#include <algorithm>
+#include <cmath>
+#include <set>
+#include <stdexcept>
+
+using json = ArenaJson;
+using namespace cv;
+
+static const size_t kMaxRenditions = 8;
+
+std::vector<RenditionSpec> parseRenditions(const json& renditions) {
+    if (!renditions.is_array() || renditions.empty()) throw std::runtime_error("renditions 必须是非空数组");
+    if (renditions.size() > kMaxRenditions) throw std::runtime_error("renditions 最多 " + std::to_string(kMaxRenditions) + " 个");
+    std::vector<RenditionSpec> specs;
+    std::set<std::string> outputs;
+    for (const json& r : renditions) {
+        if (!r.is_object() || !r.contains("outputPath") || !r["outputPath"].is_string()) {
+            throw std::runtime_error("rendition 必须是包含 outputPath 的对象");
+        }
+        RenditionSpec spec;
+        spec.outputPath = r["outputPath"].get<std::string>();
+        spec.name = r.value("name", "rendition" + std::to_string(specs.size()));
+        spec.maxSide = r.value("maxSide", 0);
+        spec.width = r.value("width", 0);
+        spec.height = r.value("height", 0);
+        if (spec.maxSide <= 0 && spec.width <= 0 && spec.height <= 0) {
+            throw std::runtime_error("rendition " + spec.name + " 需要 maxSide、width 或 height");
+        }
+        // 水印在缩放后按 LSB 嵌入，有损编码会抹掉它，交付的文件将无法验证
+        if (!isLosslessOutput(spec.outputPath)) {
+            throw std::runtime_error("rendition " + spec.name + " 必须使用无损格式 (png / bmp / tiff): " + spec.outputPath);
+        }
+        if (!outputs.insert(spec.outputPath).second) throw std::runtime_error("rendition 的 outputPath 重复: " + spec.outputPath);
+        specs.push_back(spec);
+    }
+    return specs;
+}
+
+Size renditionSize(const RenditionSpec& spec, const Size& source) {
+    double scale;
+    if (spec.maxSide > 0) scale = (double)spec.maxSide / std::max(source.width, source.height);
+    else if (spec.width > 0 && spec.height > 0) scale = std::min((double)spec.width / source.width, (double)spec.height / source.height);
+    else if (spec.width > 0) scale = (double)spec.width / source.width;
+    else scale = (double)spec.height / source.height;
+    if (scale >= 1.0) return source;
+    return Size(std::max(1, (int)std::lround(source.width * scale)), std::max(1, (int)std::lround(source.height * scale)));
+}
+
+// 不小于 target 的最小层级
+static const Mat& pickLevel(const std::vector<Mat>& pyramid, const Size& target) {
+    size_t best = 0;
+    for (size_t i = 1; i < pyramid.size(); ++i) {
+        if (pyramid[i].cols >= target.width && pyramid[i].rows >= target.height) best = i;
+    }
+    return pyramid[best];
+}
+
+void processRenditions(const std::string& inputPath, const json& renditions, const std::string& watermarkText,
+    const ProcessOptions& options, json& response) {
+    std::vector<RenditionSpec> specs = parseRenditions(renditions);
+    // 所有尺寸嵌入同一份载荷，签名只算一次；所需像素数为每像素 1 bit
+    std::string payload = watermarkPayload(watermarkText, options.signature);
+    size_t needed = payloadBitCount(payload);
+    if (needed == 0) throw std::runtime_error("水印内容无效");
+
+    Mat source;
+    {
+        PerfScope perf("renditions", "decode");
+        source = loadProcessingImage(inputPath, options.roi, response);
+    }
+
+    // 开始任何编码之前先确认所有尺寸都放得下水印，避免产出一半的交付
+    std::vector<Size> targets;
+    Size smallest = source.size();
+    for (const RenditionSpec& spec : specs) {
+        Size target = renditionSize(spec, source.size());
+        if ((size_t)target.area() < needed) {
+            throw std::runtime_error("rendition " + spec.name + " (" + std::to_string(target.width) + "x" +
+                std::to_string(target.height) + ") 太小，无法嵌入水印");
+        }
+        targets.push_back(target);
+        smallest = Size(std::min(smallest.width, target.width), std::min(smallest.height, target.height));
+    }
+
+    // 共享金字塔：只在还有目标需要更小层级时继续减半
+    std::vector<Mat> pyramid(1, source);
+    {
+        PerfScope perf("renditions", "pyramid");
+        for (;;) {
+            const Mat& top = pyramid.back();
+            Size half(top.cols / 2, top.rows / 2);
+            if (half.width < smallest.width || half.height < smallest.height) break;
+            Mat level;
+            resize(top, level, half, 0, 0, INTER_AREA);
+            pyramid.push_back(level);
+        }
+    }
+
+    // 各尺寸互相独立：缩放 + 嵌入 + 编码并行执行
+    std::vector<std::string> errors(specs.size());
+    CpuAccount* account = currentCpuAccount();
+    parallel_for_(Range(0, (int)specs.size()), [&](const Range& range) {
+        // OpenCV 工作线程上的 CPU 时间同样记到发起请求的租户
+        CpuCharge charge(account);
+        for (int i = range.start; i < range.end; ++i) {
+            try {
+                PerfScope perf("renditions", "render");
+                const Mat& level = pickLevel(pyramid, targets[i]);
+                Mat out;
+                if (level.cols == targets[i].width && level.rows == targets[i].height) out = level.clone();
+                else resize(level, out, targets[i], 0, 0, INTER_AREA);
+                embedPayload(out, payload);
+                writeImage(specs[i].outputPath, out, options.codec);
+            }
+            catch (const std::exception& e) {
+                errors[i] = e.what();
+            }
+        }
+    }, (double)specs.size());
+
+    json results = json::array();
+    for (size_t i = 0; i < specs.size(); ++i) {
+        if (!errors[i].empty()) throw std::runtime_error("rendition " + specs[i].name + ": " + errors[i]);
+        results.push_back({ {"name", specs[i].name}, {"outputPath", specs[i].outputPath},
+            {"width", targets[i].width}, {"height", targets[i].height} });
+    }
+    response["success"] = true;
+    response["embeddedText"] = watermarkText;
+    response["algorithm"] = "renditions";
+    if (!options.signature.empty()) response["signature"] = options.signature;
+    response["pyramidLevels"] = pyramid.size();
+    response["renditions"] = results;
+}
@@ -0,0 +1,29 @@
+#pragma once
+// =======================================================
+// 多尺寸交付 (renditions)
+// 一次请求产出同一图片的多个尺寸 (web / social / print ...)：
+//   1. 只解码一次
+//   2. 从原图逐级做 2 倍 INTER_AREA 缩小，得到共享的金字塔，
+//      每个尺寸从不小于目标的最小层级缩放，大图只被完整读取一次
+//   3. 各尺寸并行地缩放、嵌入水印、编码
+// 水印在缩放之后嵌入，每个交付尺寸都能独立验证 (因此只接受无损输出格式)
+// =======================================================
+#include "algorithms.h"
+#include <string>
+#include <vector>
+
+struct RenditionSpec {
+    std::string name;
+    std::string outputPath;  // 扩展名决定编码格式
+    int maxSide;             // 三者取其一；都大于原图时保持原尺寸，不放大
+    int width;
+    int height;
+};
+
+// 解析请求中的 renditions 数组，参数非法时抛出 std::runtime_error
+std::vector<RenditionSpec> parseRenditions(const ArenaJson& renditions);
+
+cv::Size renditionSize(const RenditionSpec& spec, const cv::Size& source);
+
+void processRenditions(const std::string& inputPath, const ArenaJson& renditions, const std::string& watermarkText,
+    const ProcessOptions& options, ArenaJson& response);
@@ -0,0 +1,102 @@
+#include "request_arena.h"
+#include <new>
+
+static const size_t kInitialArenaBytes = 64 * 1024;
+static const size_t kMaxRetainedArenaBytes = 1024 * 1024;
+
+static std::atomic<uint64_t> g_arenaRequests(0);
+static std::atomic<uint64_t> g_arenaSpilledBytes(0);
+
+static thread_local RequestArena* t_currentArena = nullptr;
+// 当前线程上生效的 arena (ArenaSuspend 期间也保持)，释放内存时据此判断来源
+static thread_local RequestArena* t_scopeArena = nullptr;
+
+// =======================================================
+// RequestArena
+// =======================================================
+void* RequestArena::ChunkTracker::do_allocate(size_t n, size_t align) {
+    void* p = std::pmr::new_delete_resource()->allocate(n, align);
+    chunks.push_back(std::make_pair(static_cast<const char*>(p), n));
+    bytes += n;
+    return p;
+}
+
+void RequestArena::ChunkTracker::do_deallocate(void* p, size_t n, size_t align) {
+    for (size_t i = 0; i < chunks.size(); ++i) {
+        if (chunks[i].first == p) {
+            chunks.erase(chunks.begin() + i);
+            break;
+        }
+    }
+    std::pmr::new_delete_resource()->deallocate(p, n, align);
+}
+
+RequestArena::RequestArena(size_t initialBytes, size_t maxRetainedBytes)
+    : initial_(initialBytes), maxRetained_(maxRetainedBytes),
+    monotonic_(new std::pmr::monotonic_buffer_resource(initial_.data(), initial_.size(), &tracker_)) {}
+
+bool RequestArena::owns(const void* p) const {
+    const char* c = static_cast<const char*>(p);
+    if (c >= initial_.data() && c < initial_.data() + initial_.size()) return true;
+    for (const auto& chunk : tracker_.chunks) {
+        if (c >= chunk.first && c < chunk.first + chunk.second) return true;
+    }
+    return false;
+}
+
+void RequestArena::reset() {
+    size_t spilled = tracker_.bytes;
+    monotonic_->release();
+    tracker_.bytes = 0;
+    g_arenaRequests++;
+    if (spilled == 0) return;
+
+    g_arenaSpilledBytes += spilled;
+    if (initial_.size() < maxRetained_) {
+        // 按本次高水位扩大初始块，后续同类请求不再溢出
+        size_t grown = std::min(maxRetained_, initial_.size() + spilled);
+        monotonic_.reset();
+        std::vector<char>(grown).swap(initial_);
+        monotonic_.reset(new std::pmr::monotonic_buffer_resource(initial_.data(), initial_.size(), &tracker_));
+    }
+}
+
+RequestArenaStats requestArenaStats() {
+    RequestArenaStats s = { g_arenaRequests.load(), g_arenaSpilledBytes.load() };
+    return s;
+}
+
+RequestArena* currentArena() { return t_currentArena; }
+
+// =======================================================
+// 作用域
+// =======================================================
+ArenaScope::ArenaScope() : previous_(t_currentArena) {
+    static thread_local RequestArena workerArena(kInitialArenaBytes, kMaxRetainedArenaBytes);
+    // 嵌套时沿用外层 arena
+    if (!previous_) t_currentArena = t_scopeArena = &workerArena;
+}
+
+ArenaScope::~ArenaScope() {
+    if (previous_) return;
+    t_scopeArena->reset();
+    t_currentArena = t_scopeArena = nullptr;
+}
+
+ArenaSuspend::ArenaSuspend() : previous_(t_currentArena) { t_currentArena = nullptr; }
+
+ArenaSuspend::~ArenaSuspend() { t_currentArena = previous_; }
+
+// =======================================================
+// ArenaAllocator 后端
+// =======================================================
+void* arenaAllocate(size_t bytes, size_t align) {
+    if (t_currentArena) return t_currentArena->resource()->allocate(bytes, align);
+    return ::operator new(bytes);
+}
+
+void arenaDeallocate(void* p, size_t, size_t) noexcept {
+    // arena 中的内存在 reset() 时整体回收；作用域内释放的堆对象照常归还
+    if (t_scopeArena && t_scopeArena->owns(p)) return;
+    ::operator delete(p);
+}
@@ -0,0 +1,106 @@
+#pragma once
+// =======================================================
+// 请求级内存池 (std::pmr)
+// - 每个 worker 线程持有一个 RequestArena：单调分配，请求结束时整体释放，初始块跨请求复用
+// - ArenaScope 在请求处理期间把当前线程的分配导向该 arena；作用域外 ArenaAllocator 退化为 new/delete，
+//   因此同一份类型 (ArenaJson 等) 在 CLI、后台线程中照常工作
+// - 约束：作用域内分配的对象不得在作用域结束后继续使用。需要长期保存的数据
+//   (如影子流量样本) 必须在 ArenaSuspend 下构造
+// =======================================================
+#include "lib/json.hpp"
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <memory_resource>
+#include <string>
+#include <vector>
+
+class RequestArena {
+public:
+    RequestArena(size_t initialBytes, size_t maxRetainedBytes);
+
+    std::pmr::memory_resource* resource() { return monotonic_.get(); }
+    bool owns(const void* p) const;
+    // 整体释放；本次溢出到上游的字节会在不超过 maxRetainedBytes 的前提下并入初始块
+    void reset();
+
+private:
+    // 记录 monotonic_buffer_resource 向上游申请的块，用于 owns() 判断
+    class ChunkTracker : public std::pmr::memory_resource {
+    public:
+        std::vector<std::pair<const char*, size_t> > chunks;
+        size_t bytes = 0;
+
+    private:
+        void* do_allocate(size_t bytes, size_t align) override;
+        void do_deallocate(void* p, size_t bytes, size_t align) override;
+        bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override { return this == &other; }
+    };
+
+    std::vector<char> initial_;
+    size_t maxRetained_;
+    ChunkTracker tracker_;
+    std::unique_ptr<std::pmr::monotonic_buffer_resource> monotonic_;
+};
+
+struct RequestArenaStats {
+    uint64_t requests;
+    uint64_t spilledBytes; // 超出初始块、向上游申请的字节
+};
+RequestArenaStats requestArenaStats();
+
+// 当前线程正在使用的 arena，没有时为 nullptr
+RequestArena* currentArena();
+
+class ArenaScope {
+public:
+    ArenaScope();
+    ~ArenaScope();
+
+private:
+    RequestArena* previous_;
+    ArenaScope(const ArenaScope&) = delete;
+    ArenaScope& operator=(const ArenaScope&) = delete;
+};
+
+// 临时关闭当前线程的 arena，作用域内的分配走普通堆
+class ArenaSuspend {
+public:
+    ArenaSuspend();
+    ~ArenaSuspend();
+
+private:
+    RequestArena* previous_;
+    ArenaSuspend(const ArenaSuspend&) = delete;
+    ArenaSuspend& operator=(const ArenaSuspend&) = delete;
+};
+
+void* arenaAllocate(size_t bytes, size_t align);
+void arenaDeallocate(void* p, size_t bytes, size_t align) noexcept;
+
+// 无状态分配器：分配时取当前线程的 arena，释放时按地址判断来源，因此所有实例互相等价
+template <typename T>
+struct ArenaAllocator {
+    typedef T value_type;
+
+    ArenaAllocator() noexcept {}
+    template <typename U>
+    ArenaAllocator(const ArenaAllocator<U>&) noexcept {}
+
+    T* allocate(size_t n) { return static_cast<T*>(arenaAllocate(n * sizeof(T), alignof(T))); }
+    void deallocate(T* p, size_t n) noexcept { arenaDeallocate(p, n * sizeof(T), alignof(T)); }
+};
+
+template <typename T, typename U>
+bool operator==(const ArenaAllocator<T>&, const ArenaAllocator<U>&) noexcept { return true; }
+template <typename T, typename U>
+bool operator!=(const ArenaAllocator<T>&, const ArenaAllocator<U>&) noexcept { return false; }
+
+template <typename T>
+using ArenaVector = std::vector<T, ArenaAllocator<T> >;
+
+// 请求路径使用的 JSON 类型：对象 / 数组节点来自 arena。
+// 字符串仍为 std::string (短字符串走 SSO)，以保持与现有接口的 std::string 互转
+using ArenaJson = nlohmann::basic_json<std::map, std::vector, std::string, bool, std::int64_t, std::uint64_t, double, ArenaAllocator>;
@@ -0,0 +1,294 @@
+#include "runtime_config.h"
+#include "lib/json.hpp"
+#include <csignal>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <sys/stat.h>
+
+using json = ArenaJson;
+
+static volatile sig_atomic_t g_reloadRequested = 0;
+
+static std::string envOr(const char* name, const std::string& fallback) {
+    const char* value = std::getenv(name);
+    return value && *value ? value : fallback;
+}
+
+RuntimeConfig RuntimeConfig::fromEnvironment() {
+    RuntimeConfig c;
+    c.listenPort = 9000;
+    c.metricsPort = 9100;
+    c.httpThreads = 32;
+    c.histogramBucketsMs = { 10, 50, 100, 200, 500, 1000 };
+    c.taskQueue = "threadpool";
+    c.flightRecords = 4096;
+    c.executionSlots = 8;
+    c.imageCacheMB = 512;
+    // 磁盘帧缓存默认关闭：需显式设置容量，并把 SENTINEL_FRAME_CACHE_DIR 指向持久化的状态目录
+    c.frameCacheMB = (size_t)std::atoll(envOr("SENTINEL_FRAME_CACHE_MB", "0").c_str());
+    c.prefetchQueue = 256;
+    c.shadowRate = std::atof(envOr("SENTINEL_SHADOW_RATE", "0").c_str());
+    c.tenantWeights = envOr("SENTINEL_TENANT_WEIGHTS", "");
+    c.previewBannerHeight = 100;
+    c.snapshotIntervalSeconds = 300;
+    c.recompressIdleSeconds = 30;
+    c.perfCounters = false;
+    c.fastPngDecode = true;
+    c.decoderCheckRate = 0.01;
+    c.requireSignature = false;
+    return c;
+}
+
+// =======================================================
+// 解析与校验
+// =======================================================
+// 横幅要盖住预览上的两行文字 (第二行基线 y = 80)
+static const int kMinPreviewBannerHeight = 90;
+
+static void fail(const std::string& key, const std::string& message) {
+    throw std::invalid_argument("配置项 " + key + ": " + message);
+}
+
+static double numberField(const json& value, const std::string& key, double lo, double hi) {
+    if (!value.is_number()) fail(key, "必须是数字");
+    double v = value.get<double>();
+    if (v < lo || v > hi) {
+        std::ostringstream ss;
+        ss << "取值范围为 [" << lo << ", " << hi << "]";
+        fail(key, ss.str());
+    }
+    return v;
+}
+
+static int intField(const json& value, const std::string& key, int lo, int hi) {
+    if (!value.is_number_integer()) fail(key, "必须是整数");
+    return (int)numberField(value, key, lo, hi);
+}
+
+static bool boolField(const json& value, const std::string& key) {
+    if (!value.is_boolean()) fail(key, "必须是 true 或 false");
+    return value.get<bool>();
+}
+
+static void parseCodec(const json& j, CodecOptions& codec) {
+    if (!j.is_object()) fail("codec", "必须是对象");
+    for (auto it = j.begin(); it != j.end(); ++it) {
+        const std::string key = "codec." + it.key();
+        if (it.key() == "pngCompression") codec.pngCompression = intField(it.value(), key, -1, 9);
+        else if (it.key() == "jpegQuality") codec.jpegQuality = intField(it.value(), key, -1, 100);
+        else if (it.key() == "webpQuality") codec.webpQuality = intField(it.value(), key, -1, 100);
+        else fail(key, "未知配置项");
+    }
+}
+
+static void parseBrownout(const json& j, BrownoutThresholds& t) {
+    if (!j.is_object()) fail("brownout", "必须是对象");
+    for (auto it = j.begin(); it != j.end(); ++it) {
+        const std::string key = "brownout." + it.key();
+        if (it.key() == "activeRequests" || it.key() == "latencyMs") {
+            if (!it.value().is_array() || it.value().size() != 4) fail(key, "必须是长度为 4 的数组");
+            for (int i = 0; i < 4; ++i) {
+                if (it.key() == "activeRequests") t.activeRequests[i] = intField(it.value()[i], key, 0, 100000);
+                else t.latencyMs[i] = numberField(it.value()[i], key, 1, 3600e3);
+            }
+        }
+        else if (it.key() == "recoverFactor") t.recoverFactor = numberField(it.value(), key, 0.05, 1);
+        else if (it.key() == "escalateHoldMs") t.escalateHoldMs = intField(it.value(), key, 0, 600000);
+        else if (it.key() == "recoverHoldMs") t.recoverHoldMs = intField(it.value(), key, 0, 3600000);
+        else fail(key, "未知配置项");
+    }
+    for (int i = 1; i < 4; ++i) {
+        if (t.latencyMs[i] < t.latencyMs[i - 1]) fail("brownout.latencyMs", "阈值必须逐级不减");
+    }
+}
+
+RuntimeConfig parseRuntimeConfig(const std::string& text, const RuntimeConfig& defaults) {
+    json j;
+    try {
+        j = json::parse(text);
+    }
+    catch (const std::exception& e) {
+        throw std::invalid_argument(std::string("配置文件不是合法的 JSON: ") + e.what());
+    }
+    if (!j.is_object()) throw std::invalid_argument("配置文件顶层必须是对象");
+
+    RuntimeConfig c = defaults;
+    for (auto it = j.begin(); it != j.end(); ++it) {
+        const std::string& key = it.key();
+        const json& v = it.value();
+        if (key == "listenPort") c.listenPort = intField(v, key, 1, 65535);
+        else if (key == "metricsPort") c.metricsPort = intField(v, key, 1, 65535);
+        else if (key == "httpThreads") c.httpThreads = intField(v, key, 1, 1024);
+        else if (key == "histogramBucketsMs") {
+            if (!v.is_array() || v.empty()) fail(key, "必须是非空数组");
+            std::vector<double> buckets;
+            for (const auto& b : v) {
+                buckets.push_back(numberField(b, key, 0, 3600e3));
+                if (buckets.size() > 1 && buckets.back() <= buckets[buckets.size() - 2]) fail(key, "必须严格递增");
+            }
+            c.histogramBucketsMs = buckets;
+        }
+        else if (key == "taskQueue") {
+            if (!v.is_string() || (v.get<std::string>() != "ring" && v.get<std::string>() != "threadpool")) {
+                fail(key, "必须是 \"ring\" 或 \"threadpool\"");
+            }
+            c.taskQueue = v.get<std::string>();
+        }
+        else if (key == "flightRecords") c.flightRecords = intField(v, key, 0, 1 << 20);
+        else if (key == "executionSlots") c.executionSlots = intField(v, key, 1, 1024);
+        else if (key == "imageCacheMB") c.imageCacheMB = (size_t)intField(v, key, 0, 1 << 20);
+        else if (key == "frameCacheMB") c.frameCacheMB = (size_t)intField(v, key, 0, 1 << 24);
+        else if (key == "prefetchQueue") c.prefetchQueue = (size_t)intField(v, key, 0, 1 << 20);
+        else if (key == "shadowRate") c.shadowRate = numberField(v, key, 0, 1);
+        else if (key == "tenantWeights") {
+            if (!v.is_string()) fail(key, "必须是字符串，格式 \"tenantA=2,tenantB=0.5\"");
+            c.tenantWeights = v.get<std::string>();
+        }
+        else if (key == "previewBannerHeight") c.previewBannerHeight = intField(v, key, kMinPreviewBannerHeight, 1000);
+        else if (key == "snapshotIntervalSeconds") c.snapshotIntervalSeconds = intField(v, key, 0, 86400);
+        else if (key == "recompressIdleSeconds") c.recompressIdleSeconds = intField(v, key, 0, 86400);
+        else if (key == "perfCounters") c.perfCounters = boolField(v, key);
+        else if (key == "fastPngDecode") c.fastPngDecode = boolField(v, key);
+        else if (key == "decoderCheckRate") c.decoderCheckRate = numberField(v, key, 0, 1);
+        else if (key == "requireSignature") c.requireSignature = boolField(v, key);
+        else if (key == "codec") parseCodec(v, c.codec);
+        else if (key == "brownout") parseBrownout(v, c.brownout);
+        else fail(key, "未知配置项");
+    }
+    return c;
+}
+
+json runtimeConfigJson(const RuntimeConfig& c) {
+    json brownout = {
+        {"activeRequests", json::array()}, {"latencyMs", json::array()},
+        {"recoverFactor", c.brownout.recoverFactor},
+        {"escalateHoldMs", c.brownout.escalateHoldMs},
+        {"recoverHoldMs", c.brownout.recoverHoldMs},
+    };
+    for (int i = 0; i < 4; ++i) {
+        brownout["activeRequests"].push_back(c.brownout.activeRequests[i]);
+        brownout["latencyMs"].push_back(c.brownout.latencyMs[i]);
+    }
+    json buckets = json::array();
+    for (double b : c.histogramBucketsMs) buckets.push_back(b);
+    return {
+        {"listenPort", c.listenPort}, {"metricsPort", c.metricsPort}, {"httpThreads", c.httpThreads},
+        {"histogramBucketsMs", buckets}, {"taskQueue", c.taskQueue}, {"flightRecords", c.flightRecords},
+        {"executionSlots", c.executionSlots}, {"imageCacheMB", c.imageCacheMB}, {"frameCacheMB", c.frameCacheMB},
+        {"prefetchQueue", c.prefetchQueue}, {"shadowRate", c.shadowRate}, {"tenantWeights", c.tenantWeights},
+        {"previewBannerHeight", c.previewBannerHeight}, {"snapshotIntervalSeconds", c.snapshotIntervalSeconds},
+        {"recompressIdleSeconds", c.recompressIdleSeconds}, {"perfCounters", c.perfCounters},
+        {"fastPngDecode", c.fastPngDecode}, {"decoderCheckRate", c.decoderCheckRate},
+        {"requireSignature", c.requireSignature},
+        {"codec", { {"pngCompression", c.codec.pngCompression}, {"jpegQuality", c.codec.jpegQuality}, {"webpQuality", c.codec.webpQuality} }},
+        {"brownout", brownout},
+    };
+}
+
+// =======================================================
+// RuntimeConfigManager
+// =======================================================
+static void onSighup(int) { g_reloadRequested = 1; }
+
+void RuntimeConfigManager::installSignalHandler() {
+    struct sigaction sa = {};
+    sa.sa_handler = onSighup;
+    sigemptyset(&sa.sa_mask);
+    sa.sa_flags = SA_RESTART;
+    sigaction(SIGHUP, &sa, nullptr);
+}
+
+RuntimeConfigManager::RuntimeConfigManager(const std::string& path, const RuntimeConfig& defaults)
+    : path_(path), defaults_(defaults), current_(std::make_shared<RuntimeConfig>(defaults)), version_(0),
+      failures_(0) {
+    struct stat st;
+    if (path_.empty() || stat(path_.c_str(), &st) != 0) {
+        if (!path_.empty()) std::cout << "[CONFIG] " << path_ << " 不存在，使用默认配置" << std::endl;
+    }
+    else {
+        // 启动时配置非法直接退出，避免带着错误配置上线
+        reload();
+    }
+    boot_ = current_;
+}
+
+void RuntimeConfigManager::subscribe(Listener listener) {
+    std::lock_guard<std::mutex> reloadLock(reloadMutex_);
+    std::shared_ptr<const RuntimeConfig> config = current();
+    listener(*config, *config);
+    std::lock_guard<std::mutex> lock(mutex_);
+    listeners_.push_back(listener);
+}
+
+uint64_t RuntimeConfigManager::reload() {
+    // 串行化重新加载，保证各监听者按版本顺序看到配置
+    std::lock_guard<std::mutex> reloadLock(reloadMutex_);
+    std::shared_ptr<const RuntimeConfig> next;
+    bool restartPending = false;
+    try {
+        std::ifstream in(path_.c_str(), std::ios::binary);
+        if (!in) throw std::invalid_argument("无法读取配置文件 " + path_);
+        std::stringstream buffer;
+        buffer << in.rdbuf();
+        RuntimeConfig parsed = parseRuntimeConfig(buffer.str(), defaults_);
+        if (boot_) {
+            restartPending = parsed.listenPort != boot_->listenPort || parsed.metricsPort != boot_->metricsPort ||
+                parsed.httpThreads != boot_->httpThreads || parsed.histogramBucketsMs != boot_->histogramBucketsMs ||
+                parsed.taskQueue != boot_->taskQueue || parsed.flightRecords != boot_->flightRecords;
+            // 只在重启时生效的字段保留启动值，发布出去 (/admin/config) 的是实际生效的配置；
+            // 执行槽位因此按运行中的 HTTP 线程数校验
+            parsed.listenPort = boot_->listenPort;
+            parsed.metricsPort = boot_->metricsPort;
+            parsed.httpThreads = boot_->httpThreads;
+            parsed.histogramBucketsMs = boot_->histogramBucketsMs;
+            parsed.taskQueue = boot_->taskQueue;
+            parsed.flightRecords = boot_->flightRecords;
+        }
+        // 请求并发不应超过运行中的 HTTP 线程数，否则多出的槽位永远用不上
+        if (parsed.executionSlots > parsed.httpThreads) {
+            fail("executionSlots", "不能大于运行中的 HTTP 线程数 " + std::to_string(parsed.httpThreads));
+        }
+        next = std::make_shared<RuntimeConfig>(parsed);
+    }
+    catch (const std::exception& e) {
+        failures_++;
+        std::cerr << "[CONFIG] 重新加载失败，保留版本 " << version_.load() << ": " << e.what() << std::endl;
+        throw;
+    }
+
+    std::shared_ptr<const RuntimeConfig> previous;
+    std::vector<Listener> listeners;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        previous = current_;
+        current_ = next;
+        listeners = listeners_;
+    }
+    if (restartPending) {
+        std::cerr << "[CONFIG] listenPort / metricsPort / httpThreads / histogramBucketsMs / taskQueue / flightRecords 需要重启才能生效" << std::endl;
+    }
+    for (const Listener& listener : listeners) listener(*next, *previous);
+    uint64_t version = ++version_;
+    std::cout << "[CONFIG] 已加载 " << path_ << " (版本 " << version << ")" << std::endl;
+    return version;
+}
+
+std::shared_ptr<const RuntimeConfig> RuntimeConfigManager::current() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return current_;
+}
+
+bool RuntimeConfigManager::reloadIfSignalled() {
+    if (!g_reloadRequested) return false;
+    g_reloadRequested = 0;
+    try {
+        reload();
+    }
+    catch (const std::exception&) {
+        // 已记录日志与失败计数
+    }
+    return true;
+}
@@ -0,0 +1,93 @@
+#pragma once
+// =======================================================
+// 运行时配置
+// 从 JSON 文件加载，收到 SIGHUP 或 POST /admin/reload 时重新读取。
+// 新配置整体校验通过后才生效，任一字段非法都保留旧配置；未出现的字段取默认值
+// (默认值来自环境变量，与没有配置文件时的行为一致)。
+//
+// 可热更新:
+//   executionSlots  imageCacheMB  frameCacheMB  prefetchQueue  shadowRate
+//   tenantWeights   previewBannerHeight  snapshotIntervalSeconds  recompressIdleSeconds
+//   perfCounters    fastPngDecode  decoderCheckRate  requireSignature
+//   codec    { pngCompression, jpegQuality, webpQuality }      (-1 为编码器默认值)
+//   brownout { activeRequests[4], latencyMs[4], recoverFactor, escalateHoldMs, recoverHoldMs }
+// 需要重启 (修改后记录警告，继续使用启动时的值):
+//   listenPort  metricsPort  httpThreads  histogramBucketsMs  taskQueue  flightRecords
+// =======================================================
+#include "algorithms.h"
+#include "brownout.h"
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+struct RuntimeConfig {
+    int listenPort;
+    int metricsPort;
+    int httpThreads;
+    std::vector<double> histogramBucketsMs;
+    std::string taskQueue;  // "threadpool" (httplib 自带，默认) 或 "ring" (无锁环)
+    int flightRecords;      // 飞行记录器的环形槽位数 (每条 256 字节)，0 表示关闭
+
+    int executionSlots;
+    size_t imageCacheMB;
+    size_t frameCacheMB;  // 0 (默认) 表示关闭磁盘帧缓存 (只能在启动时决定)
+    size_t prefetchQueue;
+    double shadowRate;
+    std::string tenantWeights;
+    int previewBannerHeight;      // 不小于 90，横幅要盖住两行文字
+    int snapshotIntervalSeconds;  // 缓存索引快照间隔，0 表示只在退出时写
+    int recompressIdleSeconds;    // 前台连续空闲多久后开始重新压缩输出，0 表示关闭
+    bool perfCounters;            // 按阶段采集硬件性能计数器 (/debug/counters)
+    bool fastPngDecode;           // PNG 使用内置快速解码器，关闭时全部交给 OpenCV
+    double decoderCheckRate;      // 快速解码结果与 OpenCV 逐字节比对的抽样比例
+    bool requireSignature;        // 验证时只接受签名有效的水印 (见 signed_payload.h)
+    CodecOptions codec;
+    BrownoutThresholds brownout;
+
+    // 默认值，读取 SENTINEL_FRAME_CACHE_MB / SENTINEL_SHADOW_RATE / SENTINEL_TENANT_WEIGHTS
+    static RuntimeConfig fromEnvironment();
+};
+
+// 解析并校验；出错时抛出 std::invalid_argument，消息中包含字段名
+RuntimeConfig parseRuntimeConfig(const std::string& text, const RuntimeConfig& defaults);
+
+class RuntimeConfigManager {
+public:
+    typedef std::function<void(const RuntimeConfig& next, const RuntimeConfig& previous)> Listener;
+
+    // path 为空或文件不存在时使用默认值 (版本号 0)
+    RuntimeConfigManager(const std::string& path, const RuntimeConfig& defaults);
+
+    // 注册后立即以当前配置调用一次
+    void subscribe(Listener listener);
+
+    // 重新读取配置文件：成功返回新版本号；失败抛出异常并保留当前配置
+    uint64_t reload();
+
+    std::shared_ptr<const RuntimeConfig> current() const;
+    uint64_t version() const { return version_.load(); }
+    uint64_t failures() const { return failures_.load(); }
+    const std::string& path() const { return path_; }
+
+    // SIGHUP 处理函数只设置标志；由后台线程周期性调用 reloadIfSignalled()
+    static void installSignalHandler();
+    bool reloadIfSignalled();
+
+private:
+    const std::string path_;
+    const RuntimeConfig defaults_;
+    mutable std::mutex mutex_;
+    std::mutex reloadMutex_;
+    std::shared_ptr<const RuntimeConfig> current_;
+    std::vector<Listener> listeners_;
+    // 启动时生效的配置，构造完成前为空。热加载时只在重启时生效的字段 (端口、httpThreads 等) 沿用它的值
+    std::shared_ptr<const RuntimeConfig> boot_;
+    std::atomic<uint64_t> version_;
+    std::atomic<uint64_t> failures_;
+};
+
+ArenaJson runtimeConfigJson(const RuntimeConfig& config);
@@ -0,0 +1,483 @@
+// =======================================================
+// sentinel-cli: 离线批处理工具
+// 遍历目录/文件列表 -> 预读 -> 有界并行流水线 -> 按配置编码写出
+// 通过 checkpoint 清单支持断点续跑；--spool 模式从共享目录领取任务 (见 spool_worker.h)；
+// --flight-dump 把服务写出的飞行记录解码为 JSON (见 flight_recorder.h)
+// =======================================================
+#include "algorithms.h"
+#include "bounded_queue.h"
+#include "bulk_verify.h"
+#include "file_utils.h"
+#include "flight_recorder.h"
+#include "image_decoder.h"
+#include "signed_payload.h"
+#include "spool_worker.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <fcntl.h>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+using json = ArenaJson;
+using namespace cv;
+
+struct CliOptions {
+    std::string algorithm;
+    std::vector<std::string> inputs;
+    std::string listFile;
+    std::string archive;
+    std::string spool;
+    std::string flightDump;
+    std::string outputDir;
+    std::string watermarkText;
+    std::string signature;
+    std::string payload;  // 实际嵌入的载荷，启动时按 --signature 生成一次
+    std::string format;
+    std::string checkpoint;
+    CodecOptions codec;
+    int jobs;
+    int readAhead;
+    int leaseSeconds;
+    int maxAttempts;
+
+    CliOptions() : watermarkText("COPYRIGHT-CHECK"), format("png"), jobs(0), readAhead(16), leaseSeconds(60), maxAttempts(3) {}
+};
+
+struct InputItem {
+    std::string path;
+    std::string relative; // 相对输入根目录的路径，用于在输出目录中保持层级
+};
+
+struct Job {
+    InputItem item;
+    std::vector<uchar> bytes;
+};
+
+static std::atomic<bool> g_stop(false);
+
+static void onInterrupt(int) { g_stop = true; }
+
+static void printUsage() {
+    std::cerr <<
+        "用法: sentinel-cli --algorithm watermark|forensics|verify [选项]\n"
+        "      sentinel-cli --spool <目录> [--jobs N] [--lease-seconds N] [--max-attempts N]\n"
+        "      sentinel-cli --flight-dump <文件>\n"
+        "  --input <目录|文件>     可重复；目录递归遍历\n"
+        "  --list <文件>           每行一个输入路径\n"
+        "  --archive <文件|->      (仅 verify) 流式验证 tar / tar.gz / zip 归档，- 表示 stdin\n"
+        "  --output-dir <目录>     输出目录 (verify 模式结果写到 stdout)\n"
+        "  --watermark <文本>      水印内容\n"
+        "  --signature <方案>      (watermark) ed25519 或 mac：嵌入签名载荷，密钥由环境变量指定\n"
+        "  --format png|jpg|webp   输出格式 (默认 png)\n"
+        "  --png-level <0-9>       PNG 压缩级别\n"
+        "  --jpeg-quality <0-100>  JPEG 质量\n"
+        "  --jobs <N>              并行 worker 数 (默认 CPU 核数)\n"
+        "  --read-ahead <N>        预读队列深度 (默认 16)\n"
+        "  --checkpoint <文件>     断点清单，重跑时跳过已成功的输入\n"
+        "  --spool <目录>          worker 模式：从共享目录领取任务文件，结果写回 done/ failed/\n"
+        "  --lease-seconds <N>     (spool) 租约时长，超时未续租的任务会被其他 worker 回收 (默认 60)\n"
+        "  --max-attempts <N>      (spool) 租约过期后最多重试次数 (默认 3)\n"
+        "  --flight-dump <文件>    把 image-service 的飞行记录转储解码为 JSON 输出到 stdout\n";
+}
+
+static CliOptions parseArgs(int argc, char** argv) {
+    CliOptions opts;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--help" || arg == "-h") {
+            printUsage();
+            exit(0);
+        }
+        if (i + 1 >= argc) throw std::runtime_error("参数缺少取值: " + arg);
+        std::string value = argv[++i];
+        if (arg == "--algorithm") opts.algorithm = value;
+        else if (arg == "--input") opts.inputs.push_back(value);
+        else if (arg == "--list") opts.listFile = value;
+        else if (arg == "--archive") opts.archive = value;
+        else if (arg == "--output-dir") opts.outputDir = value;
+        else if (arg == "--watermark") opts.watermarkText = value;
+        else if (arg == "--signature") opts.signature = value;
+        else if (arg == "--format") opts.format = value;
+        else if (arg == "--png-level") opts.codec.pngCompression = std::stoi(value);
+        else if (arg == "--jpeg-quality") opts.codec.jpegQuality = std::stoi(value);
+        else if (arg == "--jobs") opts.jobs = std::stoi(value);
+        else if (arg == "--read-ahead") opts.readAhead = std::stoi(value);
+        else if (arg == "--checkpoint") opts.checkpoint = value;
+        else if (arg == "--spool") opts.spool = value;
+        else if (arg == "--lease-seconds") opts.leaseSeconds = std::stoi(value);
+        else if (arg == "--max-attempts") opts.maxAttempts = std::stoi(value);
+        else if (arg == "--flight-dump") opts.flightDump = value;
+        else throw std::runtime_error("未知参数: " + arg);
+    }
+
+    if (opts.jobs <= 0) opts.jobs = std::max(1u, std::thread::hardware_concurrency());
+    if (!opts.flightDump.empty()) return opts;
+    if (!opts.spool.empty()) {
+        // 算法与输入输出由各任务文件指定
+        if (!opts.algorithm.empty() || !opts.inputs.empty() || !opts.listFile.empty() || !opts.archive.empty()) {
+            throw std::runtime_error("--spool 不能与 --algorithm / --input / --list / --archive 同时使用");
+        }
+        if (opts.leaseSeconds < 5) throw std::runtime_error("--lease-seconds 至少为 5");
+        if (opts.maxAttempts < 1) throw std::runtime_error("--max-attempts 至少为 1");
+        return opts;
+    }
+    if (opts.algorithm != "watermark" && opts.algorithm != "forensics" && opts.algorithm != "verify") {
+        throw std::runtime_error("--algorithm 必须为 watermark / forensics / verify");
+    }
+    if (!opts.archive.empty()) {
+        if (opts.algorithm != "verify") throw std::runtime_error("--archive 只能用于 verify 模式");
+        if (!opts.inputs.empty() || !opts.listFile.empty()) throw std::runtime_error("--archive 不能与 --input / --list 同时使用");
+    }
+    else if (opts.inputs.empty() && opts.listFile.empty()) {
+        throw std::runtime_error("至少需要一个 --input、--list 或 --archive");
+    }
+    if (opts.algorithm != "verify" && opts.outputDir.empty()) throw std::runtime_error("缺少 --output-dir");
+    if (opts.algorithm == "watermark" && opts.format != "png") {
+        // 与 server.js 一致：LSB 水印经有损压缩会被抹除
+        throw std::runtime_error("watermark 模式只支持 --format png");
+    }
+    if (opts.readAhead <= 0) opts.readAhead = 1;
+    return opts;
+}
+
+static std::string baseName(const std::string& path) {
+    size_t slash = path.find_last_of('/');
+    return slash == std::string::npos ? path : path.substr(slash + 1);
+}
+
+static std::vector<InputItem> collectInputs(const CliOptions& opts) {
+    std::vector<InputItem> items;
+    std::vector<std::string> roots = opts.inputs;
+    if (!opts.listFile.empty()) {
+        std::ifstream list(opts.listFile);
+        if (!list) throw std::runtime_error("无法读取文件列表: " + opts.listFile);
+        std::string line;
+        while (std::getline(list, line)) {
+            if (!line.empty()) roots.push_back(line);
+        }
+    }
+
+    for (const std::string& root : roots) {
+        if (isDirectory(root)) {
+            std::vector<std::string> files;
+            listImageFiles(root, files);
+            for (const std::string& f : files) {
+                InputItem item = { f, f.substr(root.size() + (root[root.size() - 1] == '/' ? 0 : 1)) };
+                items.push_back(item);
+            }
+        }
+        else {
+            InputItem item = { root, baseName(root) };
+            items.push_back(item);
+        }
+    }
+
+    // 同一文件重复给出时只处理一次；不同输入映射到同一输出 (a.jpg 与 a.png、不同目录下的同名文件)
+    // 会互相覆盖，处理前直接报错
+    std::vector<InputItem> unique;
+    std::set<std::string> seenInputs;
+    std::map<std::string, std::string> outputs;
+    for (const InputItem& item : items) {
+        if (!seenInputs.insert(item.path).second) continue;
+        if (opts.algorithm != "verify") {
+            std::string output = replaceExtension(item.relative, opts.format);
+            auto inserted = outputs.insert(std::make_pair(output, item.path));
+            if (!inserted.second) {
+                throw std::runtime_error("输出路径冲突: " + inserted.first->second + " 与 " + item.path + " 都会写入 " +
+                    opts.outputDir + "/" + output);
+            }
+        }
+        unique.push_back(item);
+    }
+    return unique;
+}
+
+// =======================================================
+// 断点清单：每行 "ok\t<路径>" 或 "fail\t<路径>\t<错误>"
+// 只接受以换行结尾的完整行，进程中断时写了一半的行会被忽略
+// =======================================================
+class Checkpoint {
+public:
+    explicit Checkpoint(const std::string& path) : path_(path) {
+        if (path_.empty()) return;
+        std::ifstream in(path_);
+        std::string content((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+        size_t pos = 0;
+        while (true) {
+            size_t nl = content.find('\n', pos);
+            if (nl == std::string::npos) break;
+            std::string line = content.substr(pos, nl - pos);
+            pos = nl + 1;
+            if (line.compare(0, 3, "ok\t") == 0) completed_.insert(line.substr(3));
+        }
+        out_.open(path_, std::ios::app);
+        if (!out_) throw std::runtime_error("无法写入断点清单: " + path_);
+    }
+
+    bool isCompleted(const std::string& input) const { return completed_.count(input) > 0; }
+
+    void record(const std::string& input, const std::string& error) {
+        if (path_.empty()) return;
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (error.empty()) out_ << "ok\t" << input << "\n";
+        else out_ << "fail\t" << input << "\t" << error << "\n";
+        out_.flush();
+    }
+
+private:
+    std::string path_;
+    std::set<std::string> completed_;
+    std::ofstream out_;
+    std::mutex mutex_;
+};
+
+struct Stats {
+    std::atomic<size_t> done;
+    std::atomic<size_t> failed;
+    std::atomic<unsigned long long> pixels;
+
+    Stats() : done(0), failed(0), pixels(0) {}
+};
+
+// 返回处理的像素数，用于统计 MP/s
+static size_t processJob(const CliOptions& opts, const Job& job, std::mutex& stdoutMutex) {
+    // 取证只需要亮度
+    Mat img = opts.algorithm == "forensics" ? decodeImageLuma(job.bytes) : decodeImage(job.bytes);
+    if (img.empty()) throw std::runtime_error("无法解码图片");
+    size_t pixels = (size_t)img.rows * img.cols;
+
+    if (opts.algorithm == "verify") {
+        VerifyResult result = verifyImage(img);
+        json line = {
+            {"inputPath", job.item.path},
+            {"success", result.success},
+            {"extractedText", result.extractedText},
+            {"confidenceScore", result.confidenceScore}
+        };
+        if (!result.signature.empty()) {
+            line["signature"] = result.signature;
+            line["signatureValid"] = result.signatureValid;
+        }
+        std::lock_guard<std::mutex> lock(stdoutMutex);
+        std::cout << line.dump() << "\n";
+        return pixels;
+    }
+
+    Mat output;
+    if (opts.algorithm == "watermark") {
+        embedPayload(img, opts.payload);
+        output = img;
+    }
+    else {
+        output = renderForensicsPreview(detectForensicEdges(img));
+    }
+
+    std::string outputPath = opts.outputDir + "/" + replaceExtension(job.item.relative, opts.format);
+    makeDirs(parentDir(outputPath));
+    writeImage(outputPath, output, opts.codec);
+    return pixels;
+}
+
+static void reportProgress(const Stats& stats, size_t total, std::chrono::steady_clock::time_point start, bool final) {
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    if (elapsed <= 0) elapsed = 1e-9;
+    double mp = stats.pixels / 1e6;
+    fprintf(stderr, "%s[sentinel-cli] %zu/%zu  失败 %zu  %.1f MP/s  %.1f img/s  %.0fs%s",
+        final ? "\n" : "\r", stats.done.load(), total, stats.failed.load(),
+        mp / elapsed, stats.done / elapsed, elapsed, final ? "\n" : "");
+    fflush(stderr);
+}
+
+// 归档模式：不解包，边读边验证，结果逐行写到 stdout
+static int runArchive(const CliOptions& opts) {
+    int fd = opts.archive == "-" ? STDIN_FILENO : open(opts.archive.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        std::cerr << "[ERROR] 无法打开归档: " << opts.archive << std::endl;
+        return 1;
+    }
+    if (fd != STDIN_FILENO) adviseWillNeed(opts.archive);
+
+    BulkVerifyOptions options;
+    options.jobs = opts.jobs;
+    options.queueDepth = opts.readAhead;
+    auto start = std::chrono::steady_clock::now();
+    BulkVerifySummary summary = verifyArchive(fdByteSource(fd), options, [](const std::string& line) {
+        std::cout << line;
+        std::cout.flush();
+        return !g_stop;
+    });
+    if (fd != STDIN_FILENO) close(fd);
+
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    fprintf(stderr, "[sentinel-cli] 归档条目 %zu  检出水印 %zu  失败 %zu  %.1f img/s\n",
+        summary.total, summary.found, summary.failed, summary.total / std::max(elapsed, 1e-9));
+    if (g_stop) return 130;
+    return summary.failed > 0 ? 1 : 0;
+}
+
+// 共享目录 worker 模式：直到收到 SIGINT / SIGTERM，处理中的任务完成后退出
+static int runSpool(const CliOptions& opts) {
+    SpoolOptions options;
+    options.dir = opts.spool;
+    options.workers = opts.jobs;
+    options.leaseSeconds = opts.leaseSeconds;
+    options.maxAttempts = opts.maxAttempts;
+    std::cerr << "[sentinel-cli] spool " << opts.spool << "，worker " << opts.jobs << "，租约 " << opts.leaseSeconds << "s" << std::endl;
+    SpoolSummary summary = runSpoolWorkers(options, g_stop);
+    fprintf(stderr, "[sentinel-cli] 完成 %zu  失败 %zu  回收租约 %zu\n", summary.done, summary.failed, summary.reclaimed);
+    return 0;
+}
+
+static int runFlightDump(const CliOptions& opts) {
+    std::vector<unsigned char> bytes;
+    if (!readFile(opts.flightDump, bytes)) {
+        std::cerr << "[ERROR] 无法读取 " << opts.flightDump << std::endl;
+        return 1;
+    }
+    try {
+        std::cout << decodeFlightDump(std::string(bytes.begin(), bytes.end())).dump(2) << std::endl;
+    }
+    catch (const std::exception& e) {
+        std::cerr << "[ERROR] " << opts.flightDump << ": " << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    CliOptions opts;
+    try {
+        opts = parseArgs(argc, argv);
+    }
+    catch (const std::exception& e) {
+        std::cerr << "[ERROR] " << e.what() << std::endl;
+        printUsage();
+        return 2;
+    }
+
+    if (!opts.flightDump.empty()) return runFlightDump(opts);
+
+    try {
+        loadSignatureKeys();
+        if (opts.algorithm == "watermark") opts.payload = watermarkPayload(opts.watermarkText, opts.signature);
+    }
+    catch (const std::exception& e) {
+        std::cerr << "[ERROR] " << e.what() << std::endl;
+        return 2;
+    }
+
+    signal(SIGINT, onInterrupt);
+    signal(SIGTERM, onInterrupt);
+    // 流水线内部已按文件并行，关闭 OpenCV 自身的线程池避免过度订阅
+    setNumThreads(1);
+
+    if (!opts.spool.empty()) return runSpool(opts);
+    if (!opts.archive.empty()) return runArchive(opts);
+
+    std::vector<InputItem> items;
+    try {
+        items = collectInputs(opts);
+    }
+    catch (const std::exception& e) {
+        std::cerr << "[ERROR] " << e.what() << std::endl;
+        return 2;
+    }
+    std::unique_ptr<Checkpoint> checkpointFile;
+    try {
+        checkpointFile.reset(new Checkpoint(opts.checkpoint));
+    }
+    catch (const std::exception& e) {
+        std::cerr << "[ERROR] " << e.what() << std::endl;
+        return 2;
+    }
+    Checkpoint& checkpoint = *checkpointFile;
+    std::vector<InputItem> pending;
+    for (const InputItem& item : items) {
+        if (!checkpoint.isCompleted(item.path)) pending.push_back(item);
+    }
+    std::cerr << "[sentinel-cli] 共 " << items.size() << " 个输入，待处理 " << pending.size()
+        << "，worker " << opts.jobs << std::endl;
+
+    BoundedQueue<Job> queue(opts.readAhead);
+    Stats stats;
+    std::mutex stdoutMutex;
+    auto start = std::chrono::steady_clock::now();
+
+    // 1. 预读线程：提前 readAhead 个文件发出 fadvise，再读入内存
+    std::thread reader([&] {
+        for (size_t i = 0; i < pending.size() && !g_stop; ++i) {
+            if (i == 0) {
+                for (size_t k = 0; k < (size_t)opts.readAhead && k < pending.size(); ++k) adviseWillNeed(pending[k].path);
+            }
+            else if (i + opts.readAhead - 1 < pending.size()) {
+                adviseWillNeed(pending[i + opts.readAhead - 1].path);
+            }
+
+            Job job;
+            job.item = pending[i];
+            if (!readFile(job.item.path, job.bytes)) {
+                stats.failed++;
+                stats.done++;
+                checkpoint.record(job.item.path, "读取失败");
+                continue;
+            }
+            if (!queue.push(std::move(job))) break;
+        }
+        queue.close();
+    });
+
+    // 2. 处理线程
+    std::vector<std::thread> workers;
+    for (int w = 0; w < opts.jobs; ++w) {
+        workers.push_back(std::thread([&] {
+            Job job;
+            while (queue.pop(job)) {
+                std::string error;
+                try {
+                    stats.pixels += processJob(opts, job, stdoutMutex);
+                }
+                catch (const std::exception& e) {
+                    error = e.what();
+                    std::cerr << "\n[ERROR] " << job.item.path << ": " << error << std::endl;
+                }
+                checkpoint.record(job.item.path, error);
+                if (!error.empty()) stats.failed++;
+                stats.done++;
+            }
+        }));
+    }
+
+    // 3. 进度汇报
+    std::atomic<bool> finished(false);
+    std::thread reporter([&] {
+        while (!finished) {
+            std::this_thread::sleep_for(std::chrono::seconds(1));
+            if (!finished) reportProgress(stats, pending.size(), start, false);
+        }
+    });
+
+    reader.join();
+    for (std::thread& t : workers) t.join();
+    finished = true;
+    reporter.join();
+    reportProgress(stats, pending.size(), start, true);
+
+    if (g_stop) {
+        std::cerr << "[sentinel-cli] 已中断，使用相同的 --checkpoint 重新运行即可继续" << std::endl;
+        return 130;
+    }
+    return stats.failed > 0 ? 1 : 0;
+}
@@ -0,0 +1,164 @@
+#include "shadow.h"
+#include "algorithms.h"
+#include "file_utils.h"
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <opencv2/opencv.hpp>
+
+using json = ArenaJson;
+using namespace cv;
+
+static const size_t kMaxPending = 64;
+static const size_t kRecentMismatches = 20;
+
+ShadowEvaluator::ShadowEvaluator(double sampleRate, const std::string& scratchDir, ForegroundTracker& foreground)
+    : sampleRate_(sampleRate), scratchDir_(scratchDir), foreground_(foreground), queue_(kMaxPending),
+      dropped_(0), sequence_(0), rng_(std::random_device()()) {
+    setSampleRate(sampleRate);
+}
+
+void ShadowEvaluator::setSampleRate(double sampleRate) {
+    sampleRate_ = sampleRate;
+    if (sampleRate > 0) {
+        std::call_once(workerStarted_, [this] {
+            makeDirs(scratchDir_);
+            worker_ = std::thread([this] { run(); });
+        });
+    }
+}
+
+ShadowEvaluator::~ShadowEvaluator() {
+    queue_.close();
+    if (worker_.joinable()) worker_.join();
+}
+
+void ShadowEvaluator::registerCandidate(const std::string& algorithm, const std::string& version, ShadowCandidate candidate) {
+    Candidate c = { version, candidate };
+    candidates_[algorithm] = c;
+}
+
+void ShadowEvaluator::maybeSubmit(const ShadowSample& sample) {
+    double rate = sampleRate_.load();
+    if (rate <= 0 || !candidates_.count(sample.algorithm)) return;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (std::uniform_real_distribution<double>(0.0, 1.0)(rng_) >= rate) return;
+    }
+    if (!queue_.tryPush(sample)) dropped_++;
+}
+
+void ShadowEvaluator::run() {
+    lowerCurrentThreadPriority();
+    ShadowSample sample;
+    while (queue_.pop(sample)) {
+        // 影子任务不与前台请求争抢 CPU
+        while (foreground_.active() > 0) foreground_.waitIdle(50);
+        auto it = candidates_.find(sample.algorithm);
+        if (it != candidates_.end()) evaluate(sample, it->second);
+    }
+}
+
+// 逐像素对比两张图，返回最大通道差值，尺寸或类型不同时返回 -1
+static double comparePixels(const std::string& a, const std::string& b, int& differingPixels) {
+    Mat ia = imread(a, IMREAD_UNCHANGED);
+    Mat ib = imread(b, IMREAD_UNCHANGED);
+    differingPixels = 0;
+    if (ia.empty() || ib.empty() || ia.rows != ib.rows || ia.cols != ib.cols || ia.type() != ib.type()) return -1;
+    Mat diff;
+    absdiff(ia, ib, diff);
+    Mat flat = diff.reshape(1);
+    differingPixels = countNonZero(flat);
+    return norm(ia, ib, NORM_INF);
+}
+
+void ShadowEvaluator::evaluate(const ShadowSample& sample, const Candidate& candidate) {
+    std::string candidateOutput;
+    if (sample.algorithm != "verify") {
+        candidateOutput = scratchDir_ + "/shadow_" + std::to_string(sequence_++) + ".png";
+    }
+
+    json candidateResponse;
+    auto start = std::chrono::steady_clock::now();
+    try {
+        candidate.fn(sample.request, candidateOutput, candidateResponse);
+    }
+    catch (const std::exception& e) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stats_[sample.algorithm].errors++;
+        std::cerr << "[WARN] Shadow " << sample.algorithm << "/" << candidate.version << ": " << e.what() << std::endl;
+        return;
+    }
+    double candidateMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+    json detail = { {"algorithm", sample.algorithm}, {"candidate", candidate.version} };
+    bool match = true;
+    double pixelDiff = 0;
+
+    if (sample.algorithm == "verify") {
+        static const char* kFields[] = { "success", "extractedText", "confidenceScore" };
+        for (const char* field : kFields) {
+            if (sample.primaryResponse.value(field, json()) != candidateResponse.value(field, json())) {
+                match = false;
+                detail["fields"][field] = { sample.primaryResponse.value(field, json()), candidateResponse.value(field, json()) };
+            }
+        }
+    }
+    else {
+        int differing = 0;
+        pixelDiff = comparePixels(sample.request.value("outputPath", std::string()), candidateOutput, differing);
+        if (pixelDiff != 0) {
+            match = false;
+            detail["maxPixelDiff"] = pixelDiff;
+            detail["differingValues"] = differing;
+        }
+        remove(candidateOutput.c_str());
+        remove(previewPathFor(candidateOutput).c_str());
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        ShadowAlgorithmStats& s = stats_[sample.algorithm];
+        if (match) s.matched++;
+        else s.mismatched++;
+        s.primaryMsSum += sample.primaryMs;
+        s.candidateMsSum += candidateMs;
+        if (pixelDiff > s.maxPixelDiff) s.maxPixelDiff = pixelDiff;
+    }
+    if (!match) {
+        detail["inputPath"] = sample.request.value("inputPath", std::string());
+        recordMismatch(detail);
+    }
+}
+
+void ShadowEvaluator::recordMismatch(const json& detail) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    recentMismatches_.push_back(detail);
+    if (recentMismatches_.size() > kRecentMismatches) recentMismatches_.pop_front();
+}
+
+std::map<std::string, ShadowAlgorithmStats> ShadowEvaluator::stats() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return stats_;
+}
+
+json ShadowEvaluator::debugJson() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    json out = { {"sampleRate", sampleRate_.load()}, {"dropped", dropped_.load()} };
+    for (const auto& kv : candidates_) out["candidates"][kv.first] = kv.second.version;
+    for (const auto& kv : stats_) {
+        const ShadowAlgorithmStats& s = kv.second;
+        uint64_t n = s.matched + s.mismatched;
+        out["algorithms"][kv.first] = {
+            {"matched", s.matched},
+            {"mismatched", s.mismatched},
+            {"errors", s.errors},
+            {"primaryMeanMs", n ? s.primaryMsSum / n : 0.0},
+            {"candidateMeanMs", n ? s.candidateMsSum / n : 0.0},
+            {"maxPixelDiff", s.maxPixelDiff}
+        };
+    }
+    out["recentMismatches"] = json::array();
+    for (const json& m : recentMismatches_) out["recentMismatches"].push_back(m);
+    return out;
+}
@@ -0,0 +1,82 @@
+#pragma once
+// =======================================================
+// 影子流量评估
+// 按采样率把 /process、/verify 请求复制给候选实现，在低优先级线程上离线执行，
+// 对比输出与耗时并导出差异指标，不影响用户响应
+// =======================================================
+#include "bounded_queue.h"
+#include "request_arena.h"
+#include "prefetch.h"
+#include <atomic>
+#include <deque>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+
+struct ShadowSample {
+    std::string algorithm;         // watermark / forensics / verify
+    ArenaJson request;        // 原始请求体
+    ArenaJson primaryResponse;
+    double primaryMs;
+};
+
+// 候选实现：candidateOutputPath 为影子输出路径 (verify 时为空)，结果写入 response
+typedef std::function<void(const ArenaJson& request, const std::string& candidateOutputPath, ArenaJson& response)> ShadowCandidate;
+
+struct ShadowAlgorithmStats {
+    uint64_t matched;
+    uint64_t mismatched;
+    uint64_t errors;
+    double primaryMsSum;
+    double candidateMsSum;
+    double maxPixelDiff;
+
+    ShadowAlgorithmStats() : matched(0), mismatched(0), errors(0), primaryMsSum(0), candidateMsSum(0), maxPixelDiff(0) {}
+};
+
+class ShadowEvaluator {
+public:
+    ShadowEvaluator(double sampleRate, const std::string& scratchDir, ForegroundTracker& foreground);
+    ~ShadowEvaluator();
+
+    void registerCandidate(const std::string& algorithm, const std::string& version, ShadowCandidate candidate);
+
+    // 请求处理线程调用：判断是否采样并非阻塞入队，队列满时丢弃
+    void maybeSubmit(const ShadowSample& sample);
+    // 运行中调整采样比例，0 表示暂停；首次开启时才创建工作线程
+    void setSampleRate(double sampleRate);
+
+    std::map<std::string, ShadowAlgorithmStats> stats() const;
+    uint64_t dropped() const { return dropped_.load(); }
+    ArenaJson debugJson() const;
+
+private:
+    struct Candidate {
+        std::string version;
+        ShadowCandidate fn;
+    };
+
+    void run();
+    void evaluate(const ShadowSample& sample, const Candidate& candidate);
+    void recordMismatch(const ArenaJson& detail);
+
+    std::atomic<double> sampleRate_;
+    const std::string scratchDir_;
+    ForegroundTracker& foreground_;
+
+    std::map<std::string, Candidate> candidates_;
+    BoundedQueue<ShadowSample> queue_;
+    std::atomic<uint64_t> dropped_;
+    std::atomic<uint64_t> sequence_;
+
+    mutable std::mutex mutex_;
+    std::mt19937 rng_;
+    std::map<std::string, ShadowAlgorithmStats> stats_;
+    std::deque<ArenaJson> recentMismatches_;
+
+    std::once_flag workerStarted_;
+    std::thread worker_;
+};
@@ -0,0 +1,237 @@
+#include "signed_payload.h"
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <unordered_map>
+#include <vector>
+#include <openssl/crypto.h>
+#include <openssl/evp.h>
+#include <openssl/hmac.h>
+#include <openssl/pem.h>
+#include <openssl/sha.h>
+
+static const char kDomain[] = "sentinel-wm-v1";
+static const size_t kVerifyCacheLimit = 65536;
+
+struct PkeyDeleter {
+    void operator()(EVP_PKEY* key) const { EVP_PKEY_free(key); }
+};
+typedef std::unique_ptr<EVP_PKEY, PkeyDeleter> PkeyPtr;
+
+struct MdCtxDeleter {
+    void operator()(EVP_MD_CTX* ctx) const { EVP_MD_CTX_free(ctx); }
+};
+typedef std::unique_ptr<EVP_MD_CTX, MdCtxDeleter> MdCtxPtr;
+
+struct VerifyKey {
+    uint8_t id;
+    PkeyPtr key;
+};
+
+// 只在启动时由 loadSignatureKeys 写入，之后只读
+static PkeyPtr g_signingKey;
+static uint8_t g_signingKeyId = 0;
+static std::vector<VerifyKey> g_verifyKeys;
+static std::string g_macKey;
+static uint8_t g_macKeyId = 0;
+
+static std::atomic<bool> g_required(false);
+static std::atomic<uint64_t> g_valid(0);
+static std::atomic<uint64_t> g_invalid(0);
+static std::atomic<uint64_t> g_cached(0);
+
+// 载荷 SHA-256 -> 签名是否有效
+static std::mutex g_cacheMutex;
+static std::unordered_map<std::string, bool> g_cache;
+
+static std::string sha256(const void* data, size_t size) {
+    unsigned char digest[SHA256_DIGEST_LENGTH];
+    SHA256((const unsigned char*)data, size, digest);
+    return std::string((const char*)digest, sizeof(digest));
+}
+
+static uint8_t keyIdOf(const std::string& material) {
+    return (uint8_t)sha256(material.data(), material.size())[0];
+}
+
+static std::string rawPublicKey(EVP_PKEY* key) {
+    unsigned char raw[32];
+    size_t size = sizeof(raw);
+    if (EVP_PKEY_get_raw_public_key(key, raw, &size) != 1) throw std::runtime_error("无法读取 Ed25519 公钥");
+    return std::string((const char*)raw, size);
+}
+
+static PkeyPtr readPemKey(const std::string& path, bool privateKey) {
+    FILE* f = fopen(path.c_str(), "r");
+    if (!f) throw std::runtime_error("无法打开密钥文件: " + path);
+    EVP_PKEY* key = privateKey ? PEM_read_PrivateKey(f, nullptr, nullptr, nullptr) : PEM_read_PUBKEY(f, nullptr, nullptr, nullptr);
+    fclose(f);
+    if (!key) throw std::runtime_error("无法解析 PEM 密钥: " + path);
+    PkeyPtr owned(key);
+    if (EVP_PKEY_get_id(key) != EVP_PKEY_ED25519) throw std::runtime_error("不是 Ed25519 密钥: " + path);
+    return owned;
+}
+
+static void addVerifyKey(PkeyPtr key) {
+    VerifyKey entry;
+    entry.id = keyIdOf(rawPublicKey(key.get()));
+    entry.key = std::move(key);
+    g_verifyKeys.push_back(std::move(entry));
+}
+
+void loadSignatureKeys() {
+    const char* signing = std::getenv("SENTINEL_SIGNING_KEY");
+    if (signing && *signing) {
+        g_signingKey = readPemKey(signing, true);
+        g_signingKeyId = keyIdOf(rawPublicKey(g_signingKey.get()));
+        // 私钥对象同样可用于验证
+        EVP_PKEY_up_ref(g_signingKey.get());
+        addVerifyKey(PkeyPtr(g_signingKey.get()));
+    }
+
+    const char* verify = std::getenv("SENTINEL_VERIFY_KEYS");
+    std::string list = verify ? verify : "";
+    size_t pos = 0;
+    while (pos < list.size()) {
+        size_t comma = list.find(',', pos);
+        std::string path = list.substr(pos, comma == std::string::npos ? std::string::npos : comma - pos);
+        if (!path.empty()) addVerifyKey(readPemKey(path, false));
+        if (comma == std::string::npos) break;
+        pos = comma + 1;
+    }
+
+    const char* mac = std::getenv("SENTINEL_MAC_KEY");
+    if (mac && *mac) {
+        FILE* f = fopen(mac, "rb");
+        if (!f) throw std::runtime_error(std::string("无法打开 MAC 密钥文件: ") + mac);
+        char buf[256];
+        size_t n = fread(buf, 1, sizeof(buf), f);
+        fclose(f);
+        if (n < 16) throw std::runtime_error(std::string("MAC 密钥至少需要 16 字节: ") + mac);
+        g_macKey.assign(buf, n);
+        OPENSSL_cleanse(buf, sizeof(buf));
+        g_macKeyId = keyIdOf(g_macKey);
+    }
+}
+
+bool signatureAvailable(const std::string& scheme) {
+    if (scheme == "ed25519") return (bool)g_signingKey;
+    if (scheme == "mac") return !g_macKey.empty();
+    return false;
+}
+
+// 签名覆盖的消息：域分隔串 + 方案 + 密钥 ID + 文本
+static std::string signedMessage(const std::string& payload, size_t tagBytes) {
+    return std::string(kDomain) + payload.substr(SIGNED_HEADER.size(), payload.size() - SIGNED_HEADER.size() - tagBytes);
+}
+
+static std::string macTag(const std::string& message) {
+    unsigned char out[EVP_MAX_MD_SIZE];
+    unsigned int size = 0;
+    if (!HMAC(EVP_sha256(), g_macKey.data(), (int)g_macKey.size(), (const unsigned char*)message.data(), message.size(), out, &size)) {
+        throw std::runtime_error("HMAC 计算失败");
+    }
+    return std::string((const char*)out, kMacBytes);
+}
+
+std::string watermarkPayload(const std::string& text, const std::string& signature) {
+    if (signature.empty()) return MAGIC_HEADER + text;
+    uint8_t scheme;
+    if (signature == "ed25519") scheme = kSignedSchemeEd25519;
+    else if (signature == "mac") scheme = kSignedSchemeMac;
+    else throw std::runtime_error("未知的签名方案: " + signature);
+    if (!signatureAvailable(signature)) throw std::runtime_error("签名方案 " + signature + " 未配置密钥");
+
+    size_t tagBytes = scheme == kSignedSchemeEd25519 ? kEd25519SignatureBytes : kMacBytes;
+    if (kSignedPrefixBytes + text.size() + tagBytes > 255) {
+        throw std::runtime_error("签名载荷超过 255 字节，文本最多 " + std::to_string(255 - kSignedPrefixBytes - tagBytes) + " 字节");
+    }
+    std::string payload = SIGNED_HEADER;
+    payload += (char)scheme;
+    payload += (char)(scheme == kSignedSchemeEd25519 ? g_signingKeyId : g_macKeyId);
+    payload += text;
+    std::string message = std::string(kDomain) + payload.substr(SIGNED_HEADER.size());
+
+    if (scheme == kSignedSchemeMac) return payload + macTag(message);
+
+    unsigned char sig[kEd25519SignatureBytes];
+    size_t sigSize = sizeof(sig);
+    MdCtxPtr ctx(EVP_MD_CTX_new());
+    if (!ctx || EVP_DigestSignInit(ctx.get(), nullptr, nullptr, nullptr, g_signingKey.get()) != 1 ||
+        EVP_DigestSign(ctx.get(), sig, &sigSize, (const unsigned char*)message.data(), message.size()) != 1) {
+        throw std::runtime_error("Ed25519 签名失败");
+    }
+    return payload + std::string((const char*)sig, sigSize);
+}
+
+bool isSignedPayload(const std::string& payload) {
+    return payload.compare(0, SIGNED_HEADER.size(), SIGNED_HEADER) == 0;
+}
+
+static bool checkEd25519(uint8_t keyId, const std::string& message, const unsigned char* sig) {
+    // 密钥 ID 只有 1 字节，可能有多把密钥同 ID，逐一尝试
+    for (const VerifyKey& k : g_verifyKeys) {
+        if (k.id != keyId) continue;
+        MdCtxPtr ctx(EVP_MD_CTX_new());
+        if (ctx && EVP_DigestVerifyInit(ctx.get(), nullptr, nullptr, nullptr, k.key.get()) == 1 &&
+            EVP_DigestVerify(ctx.get(), sig, kEd25519SignatureBytes, (const unsigned char*)message.data(), message.size()) == 1) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static bool checkSignature(uint8_t scheme, uint8_t keyId, const std::string& payload, size_t tagBytes) {
+    std::string digest = sha256(payload.data(), payload.size());
+    {
+        std::lock_guard<std::mutex> lock(g_cacheMutex);
+        auto it = g_cache.find(digest);
+        if (it != g_cache.end()) {
+            g_cached++;
+            return it->second;
+        }
+    }
+
+    std::string message = signedMessage(payload, tagBytes);
+    const unsigned char* tag = (const unsigned char*)payload.data() + payload.size() - tagBytes;
+    bool valid;
+    if (scheme == kSignedSchemeEd25519) {
+        valid = checkEd25519(keyId, message, tag);
+    }
+    else {
+        valid = !g_macKey.empty() && keyId == g_macKeyId && CRYPTO_memcmp(macTag(message).data(), tag, kMacBytes) == 0;
+    }
+
+    std::lock_guard<std::mutex> lock(g_cacheMutex);
+    if (g_cache.size() >= kVerifyCacheLimit) g_cache.clear();
+    g_cache[digest] = valid;
+    return valid;
+}
+
+VerifyResult verifySignedPayload(const std::string& payload) {
+    VerifyResult result = { false, "", 0.1, "", false };
+    SignedPayloadFields fields;
+    if (!parseSignedPayload(payload, fields)) return result;
+
+    result.signature = fields.name;
+    result.extractedText = sanitizeString(fields.text);
+    result.signatureValid = checkSignature(fields.scheme, fields.keyId, payload, fields.tagBytes);
+    if (result.signatureValid) g_valid++;
+    else g_invalid++;
+    result.success = result.signatureValid;
+    result.confidenceScore = result.signatureValid ? 0.99 : 0.1;
+    return result;
+}
+
+void setSignatureRequired(bool required) { g_required = required; }
+
+bool signatureRequired() { return g_required.load(std::memory_order_relaxed); }
+
+SignatureStats signatureStats() {
+    SignatureStats s = { g_valid.load(), g_invalid.load(), g_cached.load() };
+    return s;
+}
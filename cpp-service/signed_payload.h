@@ -0,0 +1,42 @@
+#pragma once
+// =======================================================
+// 签名水印载荷 (OpenSSL libcrypto)
+// MAGIC_HEADER 前缀任何人都能照抄；签名载荷使用 SIGNED_HEADER，格式为
+//   "#SG#" | 方案 (1 字节) | 密钥 ID (1 字节) | 文本 | 签名
+// 方案 1 = Ed25519 (签名 64 字节)；方案 2 = HMAC-SHA256 截断为 16 字节，用于小图 / 短载荷。
+// 签名覆盖 域分隔串 + 方案 + 密钥 ID + 文本。密钥 ID 为公钥 (MAC 为密钥) SHA-256 的首字节，
+// 轮换期间新旧密钥可同时用于验证。
+// 密钥在启动时从环境变量读取：
+//   SENTINEL_SIGNING_KEY   Ed25519 私钥 (PEM)，用于签名，对应公钥同时用于验证
+//   SENTINEL_VERIFY_KEYS   逗号分隔的 Ed25519 公钥 (PEM) 文件，只用于验证
+//   SENTINEL_MAC_KEY       MAC 密钥文件 (原始字节，至少 16 字节)
+// 验证结果按载荷摘要缓存：批量审计时同一载荷通常出现在大量图片中，
+// 每个不同的签名只做一次公钥运算
+// =======================================================
+#include "watermark_codec.h"
+#include <cstdint>
+#include <string>
+
+// 读取上述环境变量 (未设置的跳过)；密钥文件无效时抛出 std::runtime_error
+void loadSignatureKeys();
+// "ed25519" / "mac" 是否已配置签名密钥
+bool signatureAvailable(const std::string& scheme);
+
+// 要嵌入的完整载荷：signature 为空时为 MAGIC_HEADER + text，否则为签名载荷。
+// 方案未知、密钥未配置或载荷超过 255 字节时抛出 std::runtime_error
+std::string watermarkPayload(const std::string& text, const std::string& signature);
+
+bool isSignedPayload(const std::string& payload);
+// 校验签名载荷 (extractLsbPayload 的结果)；签名无效时 success 为 false，仍返回提取到的文本
+VerifyResult verifySignedPayload(const std::string& payload);
+
+// 运行时配置 requireSignature：开启后未签名的水印一律判定为未通过
+void setSignatureRequired(bool required);
+bool signatureRequired();
+
+struct SignatureStats {
+    uint64_t valid;
+    uint64_t invalid;
+    uint64_t cached;  // 命中验证缓存、未做公钥运算的次数
+};
+SignatureStats signatureStats();
@@ -0,0 +1,292 @@
+#include "spool_worker.h"
+#include "algorithms.h"
+#include "file_utils.h"
+#include "pipeline.h"
+#include "rendition.h"
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <dirent.h>
+#include <fcntl.h>
+#include <iostream>
+#include <mutex>
+#include <set>
+#include <sys/stat.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+using json = ArenaJson;
+
+// =======================================================
+// 文件名与目录操作
+// =======================================================
+// "<stem>.json" 为第 1 次尝试，"<stem>~<n>.json" 为第 n 次
+static bool parseJobName(const std::string& name, std::string& stem, int& attempt) {
+    static const std::string kSuffix = ".json";
+    if (name.empty() || name[0] == '.' || name.size() <= kSuffix.size() ||
+        name.compare(name.size() - kSuffix.size(), kSuffix.size(), kSuffix) != 0) return false;
+    stem = name.substr(0, name.size() - kSuffix.size());
+    attempt = 1;
+    size_t tilde = stem.rfind('~');
+    if (tilde != std::string::npos) {
+        attempt = std::max(1, std::atoi(stem.c_str() + tilde + 1));
+        stem.erase(tilde);
+    }
+    return !stem.empty();
+}
+
+static std::string jobName(const std::string& stem, int attempt) {
+    return attempt <= 1 ? stem + ".json" : stem + "~" + std::to_string(attempt) + ".json";
+}
+
+// 按文件名排序；生产者以时间戳开头命名即可得到先进先出
+static std::vector<std::string> listJobs(const std::string& dir) {
+    std::vector<std::string> names;
+    DIR* d = opendir(dir.c_str());
+    if (!d) return names;
+    while (struct dirent* e = readdir(d)) {
+        std::string stem;
+        int attempt;
+        if (parseJobName(e->d_name, stem, attempt)) names.push_back(e->d_name);
+    }
+    closedir(d);
+    std::sort(names.begin(), names.end());
+    return names;
+}
+
+static bool touch(const std::string& path) {
+    return utimensat(AT_FDCWD, path.c_str(), nullptr, 0) == 0;
+}
+
+// spool 所在文件系统的当前时间：共享目录时以文件服务器时钟为准
+static bool spoolNow(const std::string& dir, time_t& now) {
+    std::string clock = dir + "/.clock";
+    int fd = open(clock.c_str(), O_WRONLY | O_CREAT | O_CLOEXEC, 0644);
+    if (fd >= 0) close(fd);
+    struct stat st;
+    if (!touch(clock) || stat(clock.c_str(), &st) != 0) return false;
+    now = st.st_mtim.tv_sec;
+    return true;
+}
+
+// owner 为 worker 标识 (host:pid)：至少一次语义下两个 worker 可能同时完成同一作业，
+// 临时文件各自独立，rename 后留下的总是某一方完整的结果
+static bool writeAtomically(const std::string& path, const std::string& content, const std::string& owner) {
+    std::string tmpPath = parentDir(path) + "/." + path.substr(path.find_last_of('/') + 1) + "." + owner + ".tmp";
+    int fd = open(tmpPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) return false;
+    size_t off = 0;
+    bool ok = true;
+    while (ok && off < content.size()) {
+        ssize_t n = write(fd, content.data() + off, content.size() - off);
+        ok = n > 0;
+        if (ok) off += (size_t)n;
+    }
+    ok = ok && fdatasync(fd) == 0;
+    close(fd);
+    if (!ok || rename(tmpPath.c_str(), path.c_str()) != 0) {
+        unlink(tmpPath.c_str());
+        return false;
+    }
+    return true;
+}
+
+static std::string workerIdentity() {
+    char host[256] = { 0 };
+    gethostname(host, sizeof(host) - 1);
+    return std::string(host) + ":" + std::to_string(getpid());
+}
+
+void initSpool(const std::string& dir) {
+    for (const char* sub : { "incoming", "claimed", "done", "failed" }) makeDirs(dir + "/" + sub);
+}
+
+// 与 POST /process、/verify 相同的处理入口
+static void executeJob(const json& job, json& result) {
+    if (!job.is_object()) throw std::runtime_error("任务文件必须是 JSON 对象");
+    if (!job.contains("inputPath") || !job["inputPath"].is_string()) throw std::runtime_error("Required key 'inputPath' is missing.");
+    std::string input = job["inputPath"];
+    std::string algo = job.value("algorithm", "pipeline");
+    cv::Rect roi = job.contains("roi") ? parseRoi(job["roi"]) : cv::Rect();
+    if (algo == "verify") {
+        processVerify(input, "", result, roi);
+        return;
+    }
+    std::string wmText = job.value("watermarkData", "COPYRIGHT-CHECK");
+    ProcessOptions options;
+    options.signature = job.value("signature", "");
+    options.roi = roi;
+    if (job.contains("renditions")) {
+        processRenditions(input, job["renditions"], wmText, options, result);
+        return;
+    }
+    if (!job.contains("outputPath") || !job["outputPath"].is_string()) throw std::runtime_error("Required key 'outputPath' is missing.");
+    std::string output = job["outputPath"];
+    if (job.contains("stages")) processPipeline(input, output, job["stages"], options, result);
+    else if (algo == "watermark") processWatermark(input, output, wmText, result, options);
+    else if (algo == "forensics") processForensics(input, output, wmText, result, options);
+    else throw std::runtime_error("Unknown algorithm");
+}
+
+// =======================================================
+// Worker 池
+// =======================================================
+namespace {
+
+class SpoolRunner {
+public:
+    SpoolRunner(const SpoolOptions& options, const std::atomic<bool>& stop)
+        : opts_(options), stop_(stop), identity_(workerIdentity()), workersDone_(false), done_(0), failed_(0), reclaimed_(0) {}
+
+    SpoolSummary run() {
+        std::vector<std::thread> workers;
+        for (int i = 0; i < std::max(1, opts_.workers); ++i) workers.push_back(std::thread(&SpoolRunner::workerLoop, this));
+        std::thread heartbeat(&SpoolRunner::heartbeatLoop, this);
+        for (std::thread& t : workers) t.join();
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            workersDone_ = true;
+        }
+        heartbeat.join();
+        SpoolSummary s = { done_.load(), failed_.load(), reclaimed_.load() };
+        return s;
+    }
+
+private:
+    std::string path(const char* sub, const std::string& name) const { return opts_.dir + "/" + sub + "/" + name; }
+
+    bool claimNext(std::string& name) {
+        for (const std::string& candidate : listJobs(opts_.dir + "/incoming")) {
+            if (stop_) return false;
+            std::string src = path("incoming", candidate);
+            // 先刷新 mtime 作为租约起点 (rename 保留 mtime)，再原子领取
+            if (!touch(src)) continue;
+            if (rename(src.c_str(), path("claimed", candidate).c_str()) == 0) {
+                name = candidate;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void workerLoop() {
+        while (!stop_) {
+            std::string name;
+            if (!claimNext(name)) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(opts_.pollMs));
+                continue;
+            }
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                held_.insert(name);
+            }
+            execute(name);
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                held_.erase(name);
+            }
+        }
+    }
+
+    void execute(const std::string& name) {
+        std::string stem;
+        int attempt = 1;
+        parseJobName(name, stem, attempt);
+        std::string claimedPath = path("claimed", name);
+        auto start = std::chrono::steady_clock::now();
+
+        json job, record = { {"worker", identity_}, {"attempt", attempt} };
+        std::string error;
+        try {
+            std::vector<unsigned char> bytes;
+            if (!readFile(claimedPath, bytes)) throw std::runtime_error("无法读取任务文件 (租约可能已被回收)");
+            job = json::parse(bytes.begin(), bytes.end());
+            if (attempt > opts_.maxAttempts) {
+                throw std::runtime_error("租约过期 " + std::to_string(attempt - 1) + " 次，超过重试上限");
+            }
+            json result;
+            executeJob(job, result);
+            record["result"] = result;
+        }
+        catch (const std::exception& e) {
+            error = e.what();
+        }
+        record["job"] = job;
+        record["elapsedMs"] = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        if (!error.empty()) record["error"] = error;
+
+        const char* outcome = error.empty() ? "done" : "failed";
+        if (!writeAtomically(path(outcome, stem + ".json"), record.dump(), identity_)) {
+            // 结果写不进去时保留 claimed 文件，租约过期后由其他 worker 重试
+            std::cerr << "[SPOOL] 无法写入结果: " << path(outcome, stem + ".json") << std::endl;
+            return;
+        }
+        if (unlink(claimedPath.c_str()) != 0 && errno == ENOENT) {
+            std::cerr << "[SPOOL] " << name << " 的租约已被回收，任务可能被重复处理" << std::endl;
+        }
+        if (error.empty()) done_++;
+        else {
+            failed_++;
+            std::cerr << "[SPOOL] " << name << ": " << error << std::endl;
+        }
+    }
+
+    // 续租 + 回收过期租约
+    void heartbeatLoop() {
+        const int periodMs = std::max(1000, opts_.leaseSeconds * 1000 / 3);
+        while (true) {
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                if (workersDone_) return;
+                for (const std::string& name : held_) touch(path("claimed", name));
+            }
+            reclaimExpired();
+            for (int waited = 0; waited < periodMs; waited += 100) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(100));
+                std::lock_guard<std::mutex> lock(mutex_);
+                if (workersDone_) return;
+            }
+        }
+    }
+
+    void reclaimExpired() {
+        time_t now;
+        if (!spoolNow(opts_.dir, now)) return;
+        for (const std::string& name : listJobs(opts_.dir + "/claimed")) {
+            struct stat st;
+            std::string claimedPath = path("claimed", name);
+            if (stat(claimedPath.c_str(), &st) != 0 || now - st.st_mtim.tv_sec <= opts_.leaseSeconds) continue;
+            std::string stem;
+            int attempt;
+            parseJobName(name, stem, attempt);
+            if (rename(claimedPath.c_str(), path("incoming", jobName(stem, attempt + 1)).c_str()) == 0) {
+                reclaimed_++;
+                std::cerr << "[SPOOL] 回收过期租约: " << name << std::endl;
+            }
+        }
+    }
+
+    const SpoolOptions& opts_;
+    const std::atomic<bool>& stop_;
+    const std::string identity_;
+
+    std::mutex mutex_;
+    std::set<std::string> held_;
+    bool workersDone_;
+
+    std::atomic<size_t> done_;
+    std::atomic<size_t> failed_;
+    std::atomic<size_t> reclaimed_;
+};
+
+} // namespace
+
+SpoolSummary runSpoolWorkers(const SpoolOptions& options, const std::atomic<bool>& stop) {
+    initSpool(options.dir);
+    SpoolRunner runner(options, stop);
+    return runner.run();
+}
@@ -0,0 +1,47 @@
+#pragma once
+// =======================================================
+// 共享目录任务队列 (spool) worker
+// 不依赖任何网络服务：任务是目录中的文件，多个进程 / 共享同一文件系统的多台主机
+// 各自运行 worker 即可横向扩展。
+//
+//   <spool>/incoming/<id>.json   待处理。生产者先写 incoming/.<id>.tmp 再 rename 进来
+//   <spool>/claimed/<id>.json    已被某个 worker 领取；文件 mtime 即租约时间戳
+//   <spool>/done/<id>.json       {"job", "result", "worker", "attempt", "elapsedMs"}
+//   <spool>/failed/<id>.json     {"job", "error", "worker", "attempt"}
+//
+// 任务内容与 POST /process 的请求体相同 (algorithm / inputPath / outputPath /
+// watermarkData / stages / renditions)，另支持 {"algorithm": "verify", "inputPath": ...}。
+//
+// - 领取：先 touch 再 rename(incoming → claimed)，rename 是原子的，只有一个 worker 成功
+// - 续租：处理期间每 lease/3 秒 touch 一次 claimed 文件
+// - 回收：任一 worker 发现 claimed 文件超过租约未更新，就把它 rename 回 incoming，
+//   文件名带上重试次数 (<id>~<n>.json)；超过 maxAttempts 次记为失败
+// - 时间以 spool 目录所在文件系统的时钟为准 (touch .clock 后读取其 mtime)，
+//   各主机本地时钟不一致不会导致误回收
+// 语义为至少一次：租约过期的任务可能被处理两次，输出路径相同，结果可覆盖
+// =======================================================
+#include <atomic>
+#include <cstddef>
+#include <string>
+
+struct SpoolOptions {
+    std::string dir;
+    int workers;
+    int leaseSeconds;
+    int maxAttempts;
+    int pollMs;      // incoming 为空时的轮询间隔
+
+    SpoolOptions() : workers(1), leaseSeconds(60), maxAttempts(3), pollMs(500) {}
+};
+
+struct SpoolSummary {
+    size_t done;
+    size_t failed;
+    size_t reclaimed;  // 本进程回收的过期租约
+};
+
+// 创建 incoming / claimed / done / failed 子目录
+void initSpool(const std::string& dir);
+
+// 持续领取并处理任务，直到 stop 变为 true；处理中的任务会完成后再返回
+SpoolSummary runSpoolWorkers(const SpoolOptions& options, const std::atomic<bool>& stop);
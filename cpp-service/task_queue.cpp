@@ -0,0 +1,87 @@
+#include "task_queue.h"
+#include <algorithm>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+// 空闲 worker 的等待策略：先短暂忙等，再 yield，最后挂起。
+// 忙等只覆盖几微秒：更长的自旋在核数不多于 worker 数时会与 accept 线程抢 CPU
+static const int kSpinIterations = 100;
+static const int kYieldIterations = 16;
+
+static std::atomic<uint64_t> g_executed(0);
+static std::atomic<uint64_t> g_rejected(0);
+static std::atomic<uint64_t> g_parks(0);
+
+static inline void cpuRelax() {
+#if defined(__x86_64__) || defined(__i386__)
+    _mm_pause();
+#elif defined(__aarch64__)
+    asm volatile("yield");
+#endif
+}
+
+TaskQueueStats taskQueueTotals() {
+    TaskQueueStats s = { g_executed.load(), g_rejected.load(), g_parks.load() };
+    return s;
+}
+
+RingTaskQueue::RingTaskQueue(size_t threads, size_t capacity) : ring_(capacity), sleepers_(0), shutdown_(false) {
+    for (size_t i = 0; i < std::max<size_t>(1, threads); ++i) workers_.push_back(std::thread(&RingTaskQueue::workerLoop, this));
+}
+
+RingTaskQueue::~RingTaskQueue() {
+    shutdown();
+}
+
+bool RingTaskQueue::enqueue(std::function<void()> fn) {
+    if (shutdown_.load(std::memory_order_relaxed) || !ring_.tryPush(std::move(fn))) {
+        g_rejected++;
+        return false;
+    }
+    // 与 waitForWork 中的栅栏配对：要么这里看到 sleeper，要么 sleeper 复查时看到新任务
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (sleepers_.load(std::memory_order_relaxed) > 0) {
+        { std::lock_guard<std::mutex> lock(mutex_); }
+        wake_.notify_one();
+    }
+    return true;
+}
+
+void RingTaskQueue::shutdown() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (shutdown_.exchange(true)) return;
+    }
+    wake_.notify_all();
+    for (std::thread& t : workers_) t.join();
+}
+
+bool RingTaskQueue::waitForWork() {
+    for (int i = 0; i < kSpinIterations + kYieldIterations; ++i) {
+        if (!ring_.empty()) return true;
+        if (shutdown_.load(std::memory_order_relaxed)) return false;
+        if (i < kSpinIterations) cpuRelax();
+        else std::this_thread::yield();
+    }
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    sleepers_++;
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    g_parks++;
+    wake_.wait(lock, [this] { return !ring_.empty() || shutdown_.load(); });
+    sleepers_--;
+    return !ring_.empty();
+}
+
+void RingTaskQueue::workerLoop() {
+    std::function<void()> fn;
+    for (;;) {
+        while (ring_.tryPop(fn)) {
+            fn();
+            fn = nullptr;
+            g_executed++;
+        }
+        if (!waitForWork() && ring_.empty()) return;
+    }
+}
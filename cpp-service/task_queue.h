@@ -0,0 +1,51 @@
+#pragma once
+// =======================================================
+// HTTP 请求分发队列 (svr.new_task_queue)
+// 替代 httplib::ThreadPool 的 std::list + 单个 mutex / condition_variable：
+// 任务放入有界无锁 MPMC 环，空闲的 worker 先自旋、再让出 CPU、最后才挂起，
+// 生产者只有在确实有 worker 挂起时才去拿锁唤醒。
+// httplib 只有 accept 线程一个生产者，任务也不会在 worker 内部派生，
+// 因此不做每 worker 本地队列 / 窃取，所有 worker 共用一个环。
+// 环满时 enqueue 返回 false，httplib 直接拒绝该连接 (相当于背压)
+// =======================================================
+#include "lib/httplib.h"
+#include "mpmc_ring.h"
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+struct TaskQueueStats {
+    uint64_t executed;
+    uint64_t rejected;  // 环满被拒绝的任务
+    uint64_t parks;     // worker 自旋后仍无任务而挂起的次数
+};
+
+class RingTaskQueue : public httplib::TaskQueue {
+public:
+    RingTaskQueue(size_t threads, size_t capacity);
+    ~RingTaskQueue() override;
+
+    bool enqueue(std::function<void()> fn) override;
+    // 执行完已入队的任务后退出所有 worker
+    void shutdown() override;
+
+private:
+    void workerLoop();
+    // 等到有任务可取；关闭且队列已空时返回 false
+    bool waitForWork();
+
+    MpmcRing<std::function<void()> > ring_;
+    std::vector<std::thread> workers_;
+
+    std::mutex mutex_;
+    std::condition_variable wake_;
+    std::atomic<int> sleepers_;
+    std::atomic<bool> shutdown_;
+};
+
+// 进程内所有 RingTaskQueue 的累计值 (httplib 持有队列对象，指标通过这里读取)
+TaskQueueStats taskQueueTotals();
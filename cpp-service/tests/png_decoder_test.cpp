@@ -0,0 +1,145 @@
+// =======================================================
+// 快速 PNG 解码器离线比对：与 imdecode(IMREAD_COLOR) 逐字节比较
+//   1. 合成语料：随机噪声 / 渐变 (覆盖各种行滤波)，1 / 3 / 4 通道，各压缩级别，含 1 像素宽高
+//   2. 外部语料：参数中的目录 (递归) 里的所有 .png，快速解码器不支持的文件只计数
+// 每个文件比对完整解码与若干随机 ROI 的区域解码；另外验证带 eXIf 块的文件被拒绝
+// (imread 会按 EXIF 方向旋转，快速解码器必须交给 OpenCV)。
+// 构建：cmake -DSENTINEL_BUILD_TESTS=ON，ctest 或 ./png-decoder-test [语料目录 ...]
+// =======================================================
+#include "file_utils.h"
+#include "png_decoder.h"
+#include <cstdio>
+#include <cstring>
+#include <opencv2/opencv.hpp>
+#include <random>
+#include <string>
+#include <strings.h>
+#include <vector>
+#include <zlib.h>
+
+using namespace cv;
+
+struct Totals {
+    int files;
+    int unsupported;
+    int failures;
+};
+
+static bool sameRows(const Mat& a, const Mat& b) {
+    if (a.rows != b.rows || a.cols != b.cols || a.type() != b.type()) return false;
+    for (int y = 0; y < a.rows; ++y) {
+        if (memcmp(a.ptr(y), b.ptr(y), a.cols * a.elemSize()) != 0) return false;
+    }
+    return true;
+}
+
+static void check(const std::string& name, const std::vector<uchar>& bytes, std::mt19937& rng, Totals& totals) {
+    totals.files++;
+    PngHeader header;
+    bool supported = false;
+    if (!readPngHeader(bytes.data(), bytes.size(), header, supported) || !supported) {
+        totals.unsupported++;
+        return;
+    }
+    Mat reference = imdecode(bytes, IMREAD_COLOR);
+    Mat fast(header.height, header.width, CV_8UC3);
+    if (!decodePngBgr(bytes.data(), bytes.size(), fast.data, fast.step)) {
+        // 快速解码器拒绝的文件由 OpenCV 解码，结果自然一致
+        totals.unsupported++;
+        return;
+    }
+    if (!sameRows(fast, reference)) {
+        printf("FAIL %s: full decode differs from imdecode\n", name.c_str());
+        totals.failures++;
+        return;
+    }
+    for (int i = 0; i < 16; ++i) {
+        int x = std::uniform_int_distribution<int>(0, header.width - 1)(rng);
+        int y = std::uniform_int_distribution<int>(0, header.height - 1)(rng);
+        int w = std::uniform_int_distribution<int>(1, header.width - x)(rng);
+        int h = std::uniform_int_distribution<int>(1, header.height - y)(rng);
+        Mat region(h, w, CV_8UC3);
+        if (!decodePngBgrRegion(bytes.data(), bytes.size(), x, y, w, h, region.data, region.step) ||
+            !sameRows(region, reference(Rect(x, y, w, h)))) {
+            printf("FAIL %s: region (%d,%d %dx%d) differs from imdecode\n", name.c_str(), x, y, w, h);
+            totals.failures++;
+            return;
+        }
+    }
+}
+
+static Mat syntheticImage(int rows, int cols, int channels, bool noise, std::mt19937& rng) {
+    Mat img(rows, cols, CV_8UC(channels));
+    if (noise) {
+        randu(img, Scalar::all(0), Scalar::all(256));
+        return img;
+    }
+    // 平滑渐变：编码器会选用 Sub / Up / Avg / Paeth
+    int phase = std::uniform_int_distribution<int>(0, 255)(rng);
+    for (int y = 0; y < rows; ++y) {
+        uchar* row = img.ptr(y);
+        for (int x = 0; x < cols; ++x) {
+            for (int c = 0; c < channels; ++c) row[x * channels + c] = (uchar)(x * (c + 1) + y * 3 + phase);
+        }
+    }
+    return img;
+}
+
+// 在 IHDR 之后插入一个 eXIf 块 (Orientation = 6)
+static std::vector<uchar> withExif(const std::vector<uchar>& png) {
+    static const uchar kTiff[] = { 'M', 'M', 0, 42, 0, 0, 0, 8, 0, 1, 0x01, 0x12, 0, 3, 0, 0, 0, 1, 0, 6, 0, 0, 0, 0, 0, 0 };
+    std::vector<uchar> chunk = { 0, 0, 0, (uchar)sizeof(kTiff), 'e', 'X', 'I', 'f' };
+    chunk.insert(chunk.end(), kTiff, kTiff + sizeof(kTiff));
+    uint32_t crc = (uint32_t)crc32(0L, chunk.data() + 4, (uInt)(chunk.size() - 4));
+    for (int shift = 24; shift >= 0; shift -= 8) chunk.push_back((uchar)(crc >> shift));
+    std::vector<uchar> out(png.begin(), png.begin() + 33); // 签名 8 + IHDR 25
+    out.insert(out.end(), chunk.begin(), chunk.end());
+    out.insert(out.end(), png.begin() + 33, png.end());
+    return out;
+}
+
+int main(int argc, char** argv) {
+    std::mt19937 rng(20240601);
+    Totals totals = { 0, 0, 0 };
+
+    static const Size kSizes[] = { Size(1, 1), Size(1, 37), Size(53, 1), Size(7, 5), Size(64, 64), Size(333, 211), Size(1024, 97) };
+    for (const Size& size : kSizes) {
+        for (int channels : { 1, 3, 4 }) {
+            for (bool noise : { false, true }) {
+                for (int level : { 0, 1, 6, 9 }) {
+                    Mat img = syntheticImage(size.height, size.width, channels, noise, rng);
+                    std::vector<uchar> bytes;
+                    imencode(".png", img, bytes, { IMWRITE_PNG_COMPRESSION, level });
+                    char name[96];
+                    snprintf(name, sizeof(name), "synthetic %dx%d c%d %s z%d", size.width, size.height, channels, noise ? "noise" : "ramp", level);
+                    check(name, bytes, rng, totals);
+                }
+            }
+        }
+    }
+
+    // eXIf：快速解码器必须放弃
+    {
+        std::vector<uchar> bytes;
+        imencode(".png", syntheticImage(16, 24, 3, true, rng), bytes);
+        std::vector<uchar> exif = withExif(bytes);
+        std::vector<uchar> out(16 * 24 * 3);
+        if (decodePngBgr(exif.data(), exif.size(), out.data(), 24 * 3)) {
+            printf("FAIL eXIf: fast decoder accepted a PNG with EXIF orientation\n");
+            totals.failures++;
+        }
+    }
+
+    for (int i = 1; i < argc; ++i) {
+        std::vector<std::string> files;
+        listImageFiles(argv[i], files);
+        for (const std::string& path : files) {
+            if (path.size() < 4 || strcasecmp(path.c_str() + path.size() - 4, ".png") != 0) continue;
+            std::vector<uchar> bytes;
+            if (readFile(path, bytes)) check(path, bytes, rng, totals);
+        }
+    }
+
+    printf("%d files, %d unsupported (decoded by OpenCV), %d failures\n", totals.files, totals.unsupported, totals.failures);
+    return totals.failures == 0 ? 0 : 1;
+}
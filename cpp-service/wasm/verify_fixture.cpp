@@ -0,0 +1,101 @@
+// =======================================================
+// WASM 验证模块的对照数据 (原生构建)
+// 生成若干 RGBA 测试图写入目录，并在 stdout 输出原生代码对每张图的验证结果 (JSON 数组)。
+// 结果按服务端 /verify 的方式计算：先转成 BGR，在 Blue 通道 (下标 0) 上提取；
+// 同时在 RGBA 视图 (下标 2) 上再算一次，二者必须一致。
+// 由 verify_node_test.mjs 调用，用来比对 WASM 模块的输出
+// =======================================================
+#include "../watermark_codec.h"
+#include <cstdio>
+#include <random>
+#include <string>
+#include <vector>
+
+struct Fixture {
+    const char* name;
+    int width;
+    int height;
+    std::string payload;  // 空表示不嵌入
+};
+
+static void embed(std::vector<uint8_t>& rgba, const std::string& payload) {
+    size_t bits = payloadBitCount(payload);
+    for (size_t i = 0; i < bits && i * 4 < rgba.size(); ++i) {
+        uint8_t& blue = rgba[i * 4 + 2];
+        blue = (uint8_t)((blue & 0xFE) | payloadBit(payload, i));
+    }
+}
+
+static std::string escapeJson(const std::string& s) {
+    std::string out;
+    for (char c : s) {
+        if (c == '"' || c == '\\') out += '\\';
+        out += c;
+    }
+    return out;
+}
+
+static bool sameResult(const VerifyResult& a, const VerifyResult& b) {
+    return a.success == b.success && a.extractedText == b.extractedText && a.confidenceScore == b.confidenceScore &&
+        a.signature == b.signature;
+}
+
+int main(int argc, char** argv) {
+    if (argc != 2) {
+        fprintf(stderr, "用法: %s <输出目录>\n", argv[0]);
+        return 2;
+    }
+    const std::string dir = argv[1];
+    const Fixture fixtures[] = {
+        { "watermarked", 257, 64, MAGIC_HEADER + "SENTINEL-FIXTURE-2024" },
+        // 行宽不是 8 的倍数，载荷跨越多行；文本含需要 JSON 转义的字符
+        { "narrow", 7, 400, MAGIC_HEADER + "say \"hi\" \\ 2024" },
+        { "clean", 128, 32, "" },
+        // 头部标记不对
+        { "forged", 64, 64, "#XX#not-a-watermark" },
+        // 长度字节超出图像容量
+        { "tiny", 4, 4, "" },
+        // 签名载荷 (MAC 方案，签名为占位字节)：只能报告已签名、未验证
+        { "signed", 96, 64, SIGNED_HEADER + std::string("\x02\x07", 2) + "SENTINEL-SIGNED" + std::string(kMacBytes, '\x5a') },
+    };
+
+    std::mt19937 rng(20240501);
+    printf("[");
+    for (size_t f = 0; f < sizeof(fixtures) / sizeof(fixtures[0]); ++f) {
+        const Fixture& fx = fixtures[f];
+        std::vector<uint8_t> rgba((size_t)fx.width * fx.height * 4);
+        for (size_t i = 0; i < rgba.size(); ++i) rgba[i] = (i % 4 == 3) ? 255 : (uint8_t)rng();
+        if (!fx.payload.empty()) embed(rgba, fx.payload);
+        else if (std::string(fx.name) == "tiny") rgba[2] |= 1;  // 长度字节最高位为 1 (>= 128 字节)
+
+        std::vector<uint8_t> bgr((size_t)fx.width * fx.height * 3);
+        for (size_t p = 0; p < (size_t)fx.width * fx.height; ++p) {
+            bgr[p * 3] = rgba[p * 4 + 2];
+            bgr[p * 3 + 1] = rgba[p * 4 + 1];
+            bgr[p * 3 + 2] = rgba[p * 4];
+        }
+        LsbView bgrView = { bgr.data(), fx.height, fx.width, (size_t)fx.width * 3, 3, 0 };
+        LsbView rgbaView = { rgba.data(), fx.height, fx.width, (size_t)fx.width * 4, 4, 2 };
+        VerifyResult native = verifyLsbPayload(bgrView);
+        if (!sameResult(native, verifyLsbPayload(rgbaView))) {
+            fprintf(stderr, "%s: BGR 与 RGBA 视图的结果不一致\n", fx.name);
+            return 1;
+        }
+
+        std::string path = dir + "/" + fx.name + ".rgba";
+        FILE* out = fopen(path.c_str(), "wb");
+        if (!out || fwrite(rgba.data(), 1, rgba.size(), out) != rgba.size()) {
+            fprintf(stderr, "无法写入 %s\n", path.c_str());
+            if (out) fclose(out);
+            return 1;
+        }
+        fclose(out);
+
+        printf("%s{\"name\":\"%s\",\"path\":\"%s\",\"width\":%d,\"height\":%d,\"expected\":"
+            "{\"success\":%s,\"extractedText\":\"%s\",\"confidenceScore\":%.2f,\"signature\":\"%s\"}}",
+            f ? "," : "", fx.name, escapeJson(path).c_str(), fx.width, fx.height, native.success ? "true" : "false",
+            escapeJson(native.extractedText).c_str(), native.confidenceScore, native.signature.c_str());
+    }
+    printf("]\n");
+    return 0;
+}
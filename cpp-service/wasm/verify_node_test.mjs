@@ -0,0 +1,95 @@
+// =======================================================
+// WASM 验证模块的无头测试 (Node)
+// 用原生构建的 verify-fixture 生成测试图及其原生验证结果，
+// 再分别用标量版与 SIMD 版 WASM 模块验证同一批像素，结果必须与原生完全一致。
+//
+// 用法: node verify_node_test.mjs [--wasm <模块目录>] [--fixture-tool <verify-fixture 路径>]
+//   默认模块目录为 client/public/wasm，默认工具为 $SENTINEL_FIXTURE_TOOL 或 cpp-service/build/verify-fixture
+// 模块尚未构建时退出码为 77 (ctest 记为跳过)
+// =======================================================
+import { spawnSync } from 'node:child_process';
+import { existsSync, mkdtempSync, readFileSync, rmSync } from 'node:fs';
+import { tmpdir } from 'node:os';
+import path from 'node:path';
+import { fileURLToPath, pathToFileURL } from 'node:url';
+
+const here = path.dirname(fileURLToPath(import.meta.url));
+const SKIP = 77;
+const MODULES = [
+    { name: 'sentinel-verify', simd: 0 },
+    { name: 'sentinel-verify-simd', simd: 1 }
+];
+
+const argValue = (flag, fallback) => {
+    const i = process.argv.indexOf(flag);
+    return i >= 0 && i + 1 < process.argv.length ? process.argv[i + 1] : fallback;
+};
+
+const wasmDir = path.resolve(argValue('--wasm', path.join(here, '../../client/public/wasm')));
+const fixtureTool = path.resolve(argValue('--fixture-tool',
+    process.env.SENTINEL_FIXTURE_TOOL || path.join(here, '../build/verify-fixture')));
+
+const verifyWith = (mod, fixture) => {
+    const pixels = readFileSync(fixture.path);
+    const ptr = mod._malloc(pixels.length);
+    try {
+        mod.HEAPU8.set(pixels, ptr);
+        return JSON.parse(mod.UTF8ToString(mod._sentinel_verify_rgba(ptr, fixture.width, fixture.height)));
+    } finally {
+        mod._free(ptr);
+    }
+};
+
+const main = async () => {
+    const missing = MODULES.filter((m) => !existsSync(path.join(wasmDir, `${m.name}.mjs`)));
+    if (missing.length > 0) {
+        console.log(`SKIP: ${missing.map((m) => m.name).join(', ')} 未构建 (${wasmDir})`);
+        return SKIP;
+    }
+    if (!existsSync(fixtureTool)) {
+        console.error(`找不到原生对照工具: ${fixtureTool}`);
+        return 1;
+    }
+
+    const workDir = mkdtempSync(path.join(tmpdir(), 'sentinel-wasm-'));
+    let failures = 0;
+    try {
+        const run = spawnSync(fixtureTool, [workDir], { encoding: 'utf8' });
+        if (run.status !== 0) {
+            console.error(`verify-fixture 失败: ${run.stderr}`);
+            return 1;
+        }
+        const fixtures = JSON.parse(run.stdout);
+
+        for (const { name, simd } of MODULES) {
+            const { default: createSentinelVerifier } = await import(pathToFileURL(path.join(wasmDir, `${name}.mjs`)).href);
+            const mod = await createSentinelVerifier();
+            if (mod._sentinel_simd_enabled() !== simd) {
+                console.error(`FAIL ${name}: sentinel_simd_enabled() = ${mod._sentinel_simd_enabled()}`);
+                failures++;
+            }
+            for (const fixture of fixtures) {
+                const actual = verifyWith(mod, fixture);
+                const expected = fixture.expected;
+                const same = actual.success === expected.success &&
+                    actual.extractedText === expected.extractedText &&
+                    actual.confidenceScore === expected.confidenceScore &&
+                    (actual.signature || '') === expected.signature &&
+                    (!actual.signature || actual.signatureValid === false);
+                if (!same) {
+                    console.error(`FAIL ${name} ${fixture.name}: wasm ${JSON.stringify(actual)} != native ${JSON.stringify(expected)}`);
+                    failures++;
+                }
+            }
+            console.log(`${name}: ${fixtures.length} fixtures checked`);
+        }
+    } finally {
+        rmSync(workDir, { recursive: true, force: true });
+    }
+    return failures === 0 ? 0 : 1;
+};
+
+main().then((code) => process.exit(code), (err) => {
+    console.error(err);
+    process.exit(1);
+});
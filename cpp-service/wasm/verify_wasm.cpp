@@ -0,0 +1,48 @@
+// =======================================================
+// 浏览器端水印验证入口 (Emscripten)
+// 与服务端 /verify 共用 watermark_codec.cpp，输入为 Canvas 的 RGBA 像素
+// =======================================================
+#include "../watermark_codec.h"
+#include <emscripten/emscripten.h>
+#include <cstdio>
+#include <string>
+
+static std::string g_lastResult;
+
+static std::string escapeJson(const std::string& s) {
+    std::string out;
+    for (char c : s) {
+        if (c == '"' || c == '\\') out += '\\';
+        out += c;
+    }
+    return out;
+}
+
+extern "C" {
+
+// 返回与 /verify 响应同结构的 JSON 字符串，指针在下一次调用前有效。
+// 签名载荷只报告 "已签名、未在本地验证"
+EMSCRIPTEN_KEEPALIVE const char* sentinel_verify_rgba(const uint8_t* rgba, int width, int height) {
+    LsbView view = { rgba, height, width, (size_t)width * 4, 4, 2 };
+    VerifyResult result = verifyLsbPayload(view);
+
+    char score[32];
+    snprintf(score, sizeof(score), "%.2f", result.confidenceScore);
+    g_lastResult = std::string("{\"success\":") + (result.success ? "true" : "false") +
+        ",\"extractedText\":\"" + escapeJson(result.extractedText) +
+        "\",\"confidenceScore\":" + score;
+    // 签名载荷在浏览器端无法验证：带上方案，signatureValid 恒为 false，由服务端定论
+    if (!result.signature.empty()) g_lastResult += ",\"signature\":\"" + result.signature + "\",\"signatureValid\":false";
+    g_lastResult += "}";
+    return g_lastResult.c_str();
+}
+
+EMSCRIPTEN_KEEPALIVE int sentinel_simd_enabled() {
+#if defined(__wasm_simd128__)
+    return 1;
+#else
+    return 0;
+#endif
+}
+
+}
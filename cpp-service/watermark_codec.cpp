@@ -0,0 +1,192 @@
+#include "watermark_codec.h"
+
+#if defined(__wasm_simd128__)
+#include <wasm_simd128.h>
+#endif
+
+const std::string MAGIC_HEADER = "#IS#";
+const std::string SIGNED_HEADER = "#SG#";
+
+// =======================================================
+// LSB 隐写辅助函数
+// =======================================================
+
+std::string sanitizeString(const std::string& input) {
+    std::string result;
+    for (char c : input) {
+        if (c >= 32 && c <= 126) {
+            result += c;
+        }
+        else {
+            result += '?';
+        }
+    }
+    return result;
+}
+
+std::string textToBinary(const std::string& text) {
+    if (text.empty() || text.length() > 255) return "";
+
+    std::string binaryStr = "";
+    int len = text.length();
+
+    // 1. 编码长度（8位，高位在前）
+    for (int i = 7; i >= 0; --i) {
+        binaryStr += ((len >> i) & 1) ? '1' : '0';
+    }
+
+    // 2. 编码数据
+    for (char c : text) {
+        for (int i = 7; i >= 0; --i) {
+            binaryStr += ((c >> i) & 1) ? '1' : '0';
+        }
+    }
+    return binaryStr;
+}
+
+std::string binaryToText(const std::string& binaryStr, double& confidence) {
+    if (binaryStr.length() < 8) {
+        confidence = 0.0;
+        return "";
+    }
+
+    int len = 0;
+    for (int i = 0; i < 8; ++i) {
+        if (binaryStr[i] == '1') {
+            len |= (1 << (7 - i));
+        }
+    }
+
+    if (len == 0 || (8 + len * 8) > binaryStr.length()) {
+        confidence = 0.0;
+        return "";
+    }
+
+    std::string text = "";
+    for (int i = 0; i < len; ++i) {
+        int charValue = 0;
+        int start_index = 8 + i * 8;
+        for (int j = 0; j < 8; ++j) {
+            if (binaryStr[start_index + j] == '1') {
+                charValue |= (1 << (7 - j));
+            }
+        }
+        text += (char)charValue;
+    }
+
+    confidence = 0.99;
+    return text;
+}
+
+// =======================================================
+// LSB 字节提取内核
+// =======================================================
+
+// 通用路径：逐像素读取，可跨行
+static uint8_t extractByteScalar(const LsbView& v, size_t pixelIndex) {
+    uint8_t value = 0;
+    for (int k = 0; k < 8; ++k) {
+        size_t p = pixelIndex + k;
+        size_t row = p / v.cols;
+        size_t col = p % v.cols;
+        const uint8_t* px = v.data + row * v.step + col * v.channels;
+        value = (uint8_t)((value << 1) | (px[v.channel] & 0x01));
+    }
+    return value;
+}
+
+#if defined(__wasm_simd128__)
+// SIMD128 路径：一次载入 8 个 RGBA 像素 (32 字节)，把 8 个目标通道字节
+// 逆序收拢到低 8 个 lane，左移 7 位后用 bitmask 一次得到整字节
+static inline uint8_t extractByteRgbaSimd(const uint8_t* px, int channel) {
+    v128_t lo = wasm_v128_load(px);
+    v128_t hi = wasm_v128_load(px + 16);
+    v128_t gathered;
+    switch (channel) {
+    case 0: gathered = wasm_i8x16_shuffle(lo, hi, 28, 24, 20, 16, 12, 8, 4, 0, 0, 0, 0, 0, 0, 0, 0, 0); break;
+    case 1: gathered = wasm_i8x16_shuffle(lo, hi, 29, 25, 21, 17, 13, 9, 5, 1, 1, 1, 1, 1, 1, 1, 1, 1); break;
+    case 2: gathered = wasm_i8x16_shuffle(lo, hi, 30, 26, 22, 18, 14, 10, 6, 2, 2, 2, 2, 2, 2, 2, 2, 2); break;
+    default: gathered = wasm_i8x16_shuffle(lo, hi, 31, 27, 23, 19, 15, 11, 7, 3, 3, 3, 3, 3, 3, 3, 3, 3); break;
+    }
+    gathered = wasm_i8x16_shl(gathered, 7);
+    return (uint8_t)(wasm_i8x16_bitmask(gathered) & 0xFF);
+}
+#endif
+
+void extractLsbBytes(const LsbView& v, size_t firstByte, uint8_t* out, size_t nBytes) {
+    for (size_t i = 0; i < nBytes; ++i) {
+        size_t pixelIndex = (firstByte + i) * 8;
+#if defined(__wasm_simd128__)
+        size_t col = pixelIndex % v.cols;
+        if (v.channels == 4 && col + 8 <= (size_t)v.cols) {
+            const uint8_t* px = v.data + (pixelIndex / v.cols) * v.step + col * 4;
+            out[i] = extractByteRgbaSimd(px, v.channel);
+            continue;
+        }
+#endif
+        out[i] = extractByteScalar(v, pixelIndex);
+    }
+}
+
+bool extractLsbPayload(const LsbView& v, std::string& payload) {
+    const size_t maxPixels = (size_t)v.rows * v.cols;
+    if (maxPixels < 8) return false;
+
+    // 1. 提取长度
+    uint8_t lenByte = 0;
+    extractLsbBytes(v, 0, &lenByte, 1);
+    size_t len = lenByte;
+    if (len == 0 || (8 + len * 8) > maxPixels) return false;
+
+    // 2. 提取全部数据
+    uint8_t data[255];
+    extractLsbBytes(v, 1, data, len);
+    payload.assign(reinterpret_cast<const char*>(data), len);
+    return true;
+}
+
+bool parseSignedPayload(const std::string& payload, SignedPayloadFields& fields) {
+    if (payload.size() < kSignedPrefixBytes || payload.compare(0, SIGNED_HEADER.size(), SIGNED_HEADER) != 0) return false;
+    fields.scheme = (uint8_t)payload[4];
+    fields.keyId = (uint8_t)payload[5];
+    if (fields.scheme == kSignedSchemeEd25519) {
+        fields.name = "ed25519";
+        fields.tagBytes = kEd25519SignatureBytes;
+    }
+    else if (fields.scheme == kSignedSchemeMac) {
+        fields.name = "mac";
+        fields.tagBytes = kMacBytes;
+    }
+    else {
+        return false;
+    }
+    if (payload.size() < kSignedPrefixBytes + fields.tagBytes) return false;
+    fields.text = payload.substr(kSignedPrefixBytes, payload.size() - kSignedPrefixBytes - fields.tagBytes);
+    return true;
+}
+
+VerifyResult checkPayloadHeader(const std::string& payload) {
+    VerifyResult result = { false, "", 0.1, "", false };
+    SignedPayloadFields fields;
+    // 3. 校验 Magic Header
+    if (payload.find(MAGIC_HEADER) == 0) {
+        result.success = true;
+        result.extractedText = sanitizeString(payload.substr(MAGIC_HEADER.length()));
+        result.confidenceScore = 0.99;
+    }
+    else if (parseSignedPayload(payload, fields)) {
+        // 已签名、未在本地验证
+        result.extractedText = sanitizeString(fields.text);
+        result.signature = fields.name;
+    }
+    return result;
+}
+
+VerifyResult verifyLsbPayload(const LsbView& v) {
+    std::string rawText;
+    if (!extractLsbPayload(v, rawText)) {
+        VerifyResult none = { false, "", 0.0, "", false };
+        return none;
+    }
+    return checkPayloadHeader(rawText);
+}
@@ -0,0 +1,73 @@
+#pragma once
+// =======================================================
+// 水印载荷编解码 (不依赖 OpenCV，供服务端 / WASM 共用)
+// =======================================================
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+extern const std::string MAGIC_HEADER; // 水印头部标记
+extern const std::string SIGNED_HEADER; // 签名载荷头部标记，格式见 signed_payload.h
+
+// 签名载荷布局：头部 | 方案 (1 字节) | 密钥 ID (1 字节) | 文本 | 签名
+const uint8_t kSignedSchemeEd25519 = 1;
+const uint8_t kSignedSchemeMac = 2;
+const size_t kEd25519SignatureBytes = 64;
+const size_t kMacBytes = 16;
+const size_t kSignedPrefixBytes = 6;  // 头部 + 方案 + 密钥 ID
+
+std::string sanitizeString(const std::string& input);
+std::string textToBinary(const std::string& text);
+std::string binaryToText(const std::string& binaryStr, double& confidence);
+
+// 与 textToBinary 相同的比特序列，但按下标直接取值，不构造 '0'/'1' 字符串。
+// 载荷无效 (空或超过 255 字节) 时比特数为 0
+inline size_t payloadBitCount(const std::string& text) {
+    return (text.empty() || text.length() > 255) ? 0 : (text.length() + 1) * 8;
+}
+inline uint8_t payloadBit(const std::string& text, size_t index) {
+    uint8_t byte = index < 8 ? (uint8_t)text.length() : (uint8_t)text[index / 8 - 1];
+    return (byte >> (7 - index % 8)) & 1;
+}
+
+// 交错排列的 8 位像素缓冲区视图。channel 为承载水印的通道下标：
+// OpenCV BGR 为 0，浏览器 Canvas 的 RGBA 为 2。
+struct LsbView {
+    const uint8_t* data;
+    int rows;
+    int cols;
+    size_t step;   // 每行字节数
+    int channels;
+    int channel;
+};
+
+struct VerifyResult {
+    bool success;
+    std::string extractedText;
+    double confidenceScore;
+    std::string signature;  // 签名方案："" 为未签名载荷，"ed25519" / "mac" 见 signed_payload.h
+    bool signatureValid;
+};
+
+// 从 LSB 中按光栅顺序读取 nBytes 个字节 (每 8 个像素 1 字节，高位在前)
+void extractLsbBytes(const LsbView& view, size_t firstByte, uint8_t* out, size_t nBytes);
+
+// 读取长度字节及其后的原始载荷 (含头部标记)；长度为 0 或超出图像容量时返回 false
+bool extractLsbPayload(const LsbView& view, std::string& payload);
+
+struct SignedPayloadFields {
+    uint8_t scheme;
+    uint8_t keyId;
+    const char* name;  // "ed25519" / "mac"
+    size_t tagBytes;
+    std::string text;  // 未经 sanitizeString
+};
+// 只解析签名载荷的结构，不校验签名；非签名载荷、方案未知或长度不足时返回 false
+bool parseSignedPayload(const std::string& payload, SignedPayloadFields& fields);
+
+// 对 extractLsbPayload 的结果做 Header 校验。签名载荷在这里无法验证 (浏览器端没有密钥)：
+// 返回其中的文本与方案，success 与 signatureValid 均为 false，由服务端 verifySignedPayload 定论
+VerifyResult checkPayloadHeader(const std::string& payload);
+
+// 长度字节 + 数据 + Magic Header 校验，与服务端 /verify 对未签名载荷的判定完全一致
+VerifyResult verifyLsbPayload(const LsbView& view);
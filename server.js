@@ -48,6 +48,9 @@ cron.schedule('0 3 * * *', () => {
 
     let deletedCount = 0;
     oldFiles.forEach(file => {
+        if (file.uploadPath) {
+            axios.post(`${CPP_SERVICE_URL}/prefetch/cancel`, { inputPath: path.resolve(file.uploadPath) }).catch(() => {});
+        }
         if (file.uploadPath && fs.existsSync(file.uploadPath)) {
             try { fs.unlinkSync(file.uploadPath); } catch (e) { console.error(`Failed to delete source: ${e.message}`); }
         }
@@ -82,6 +85,28 @@ const upload = multer({
     limits: { fileSize: 50 * 1024 * 1024 }
 });
 
+// 上传完成后通知 C++ 服务预取 (探测、哈希、解码入缓存)，失败不影响上传结果
+const requestPrefetch = (filePath) => {
+    axios.post(`${CPP_SERVICE_URL}/prefetch`, { inputPath: path.resolve(filePath) }, { timeout: 2000 })
+        .catch(err => console.warn('Prefetch request failed:', err.message));
+};
+
+// C++ 服务按租户公平分配 CPU。租户只能由服务端确定 (目前没有登录会话，按客户端 IP 区分)；
+// 浏览器提供的 X-Tenant-Id 一律忽略，否则任何人都能冒充高权重租户或轮换标识逃避公平调度
+const tenantHeaders = (req) => ({ 'X-Tenant-Id': `ip-${String(req.ip || 'unknown').replace(/:/g, '_')}` });
+
+// C++ 服务热重启时，旧进程会关闭空闲的 keep-alive 连接；
+// 请求恰好落在被关闭的连接上时 (尚未收到任何响应) 重试一次
+const postToCore = async (endpoint, payload, options) => {
+    try {
+        return await axios.post(`${CPP_SERVICE_URL}${endpoint}`, payload, options);
+    } catch (err) {
+        if (err.response || (err.code !== 'ECONNRESET' && err.code !== 'ECONNREFUSED')) throw err;
+        await new Promise(resolve => setTimeout(resolve, 200));
+        return axios.post(`${CPP_SERVICE_URL}${endpoint}`, payload, options);
+    }
+};
+
 // --- API 接口 ---
 
 // 1. 原始文件上传
@@ -115,6 +140,7 @@ app.post('/api/upload', upload.single('image'), (req, res) => {
             new Date().toISOString()
         );
 
+        requestPrefetch(req.file.path);
         res.json({ success: true, fileId });
     } catch (err) {
         console.error('DB Error:', err);
@@ -124,20 +150,44 @@ app.post('/api/upload', upload.single('image'), (req, res) => {
 
 // 2. 核心处理
 app.post('/api/process', async (req, res) => {
-    const { fileId, algorithm, customWatermarkText } = req.body;
+    const { fileId, customWatermarkText, stages, signature } = req.body;
+    // 组合流水线请求可以只给 stages，algorithm 缺省为 pipeline
+    const algorithm = req.body.algorithm || (Array.isArray(stages) ? 'pipeline' : '');
 
     // --- 安全验证 START ---
-    if (customWatermarkText) {
-        // 包含: < > : " / \ | ? * 以及 ASCII 0-31 (控制字符)
-        const INVALID_FILENAME_CHARS = /[<>:"/\\|?*\x00-\x1F]/;
+    // 包含: < > : " / \ | ? * 以及 ASCII 0-31 (控制字符)
+    const INVALID_FILENAME_CHARS = /[<>:"/\\|?*\x00-\x1F]/;
+    const watermarkTextError = (text) => {
+        if (typeof text !== 'string') return '水印内容必须是字符串';
+        if (INVALID_FILENAME_CHARS.test(text)) {
+            return '水印内容包含非法字符，无法用于生成文件名 (禁止使用: < > : " / \\ | ? *)';
+        }
+        if (text.length > 50) return '水印内容过长 (最多50字符)';
+        return null;
+    };
 
-        if (INVALID_FILENAME_CHARS.test(customWatermarkText)) {
-            return res.status(400).json({
-                error: '水印内容包含非法字符，无法用于生成文件名 (禁止使用: < > : " / \\ | ? *)'
-            });
+    if (customWatermarkText) {
+        const error = watermarkTextError(customWatermarkText);
+        if (error) return res.status(400).json({ error });
+    }
+    // 流水线中 watermark 阶段的文本同样嵌入图片并记入处理结果，规则相同 (未给出时下文补为 watermarkData)
+    if (Array.isArray(stages)) {
+        for (const stage of stages) {
+            if (!stage || stage.type !== 'watermark' || !stage.text) continue;
+            const error = watermarkTextError(stage.text);
+            if (error) return res.status(400).json({ error: `watermark 阶段: ${error}` });
         }
-        if (customWatermarkText.length > 50) {
-            return res.status(400).json({ error: '水印内容过长 (最多50字符)' });
+    }
+    // 签名方案：不给出时嵌入未签名载荷
+    const SIGNATURE_SCHEMES = ['ed25519', 'mac'];
+    if (signature && !SIGNATURE_SCHEMES.includes(signature)) {
+        return res.status(400).json({ error: 'signature 只能是 "ed25519" 或 "mac"' });
+    }
+    if (Array.isArray(stages)) {
+        for (const stage of stages) {
+            if (stage && stage.type === 'watermark' && stage.signature && !SIGNATURE_SCHEMES.includes(stage.signature)) {
+                return res.status(400).json({ error: 'watermark 阶段: signature 只能是 "ed25519" 或 "mac"' });
+            }
         }
     }
     // --- 安全验证 END ---
@@ -151,7 +201,8 @@ app.post('/api/process', async (req, res) => {
 
     // 检查是否需要强制转 PNG (LSB算法 必须 PNG)
     const isLossyFormat = ['.jpg', '.jpeg', '.webp'].includes(outputExt.toLowerCase());
-    if (algorithm.startsWith('LSB') || isLossyFormat) {
+    const hasWatermarkStage = Array.isArray(stages) && stages.some(s => s && s.type === 'watermark');
+    if (algorithm.startsWith('LSB') || isLossyFormat || hasWatermarkStage) {
         outputExt = '.png';
     }
 
@@ -163,12 +214,19 @@ app.post('/api/process', async (req, res) => {
     try {
         console.log(`[Node] Calling C++ Service for ${algorithm}. Output: ${finalOutputPath}`);
 
-        const cppResponse = await axios.post(`${CPP_SERVICE_URL}/process`, {
+        const cppPayload = {
             inputPath: path.resolve(file.uploadPath),
             outputPath: finalOutputPath,
             algorithm: algorithm,
             watermarkData: watermarkData
-        });
+        };
+        if (signature) cppPayload.signature = signature;
+        if (Array.isArray(stages)) {
+            // 未指定文本的 watermark 阶段使用与单算法调用相同的水印内容
+            cppPayload.stages = stages.map(s => (s && s.type === 'watermark' && !s.text) ? { ...s, text: watermarkData } : s);
+        }
+
+        const cppResponse = await postToCore('/process', cppPayload, { headers: tenantHeaders(req) });
 
         if (cppResponse.data.success) {
             const { success, previewPath, ...evidenceData } = cppResponse.data;
@@ -204,15 +262,14 @@ app.get('/api/preview/:id', (req, res) => {
     const file = db.prepare('SELECT previewFilePath, outputPath FROM files WHERE id = ?').get(req.params.id);
     if (!file) return res.status(404).send('File not found');
 
-    let targetPath = file.previewFilePath;
-    if (!targetPath || !fs.existsSync(targetPath)) {
-        targetPath = file.outputPath;
-    }
-
+    // 只返回带横幅的预览图；预览缺失时绝不能退回全分辨率的输出文件 (那是付费下载的内容)
+    const targetPath = file.previewFilePath;
     if (targetPath && fs.existsSync(targetPath)) {
         res.sendFile(path.resolve(targetPath));
+    } else if (targetPath) {
+        res.status(404).send('Preview image not found');
     } else {
-        res.status(404).send('Preview image generation failed');
+        res.status(503).send('Preview image not available');
     }
 });
 
@@ -319,6 +376,7 @@ app.post('/api/upload_verify', upload.single('image'), (req, res) => {
             VALUES (?, ?, ?, ?, ?, ?, -1, ?)
         `).run(fileId, req.file.originalname, req.file.filename, req.file.path, req.file.size, req.file.mimetype, new Date().toISOString());
 
+        requestPrefetch(req.file.path);
         res.json({ success: true, fileId });
     } catch (err) {
         console.error('DB Error:', err);
@@ -338,16 +396,20 @@ app.post('/api/verify_watermark_free', async (req, res) => {
     }
 
     try {
-        const cppResponse = await axios.post(`${CPP_SERVICE_URL}/verify`, {
+        const cppResponse = await postToCore('/verify', {
             inputPath: path.resolve(targetPath)
-        });
+        }, { headers: tenantHeaders(req) });
 
+        // 签名载荷附带方案与校验结果 ("ed25519" / "mac")；未签名载荷不含这两个字段
+        const { signature, signatureValid } = cppResponse.data;
+        const signatureFields = signature ? { signature, signatureValid } : {};
         if (cppResponse.data.success) {
             res.json({
                 success: true,
                 found: true,
                 extractedText: cppResponse.data.extractedText,
-                confidenceScore: cppResponse.data.confidenceScore
+                confidenceScore: cppResponse.data.confidenceScore,
+                ...signatureFields
             });
         } else {
             res.json({
@@ -355,7 +417,8 @@ app.post('/api/verify_watermark_free', async (req, res) => {
                 found: false,
                 extractedText: null,
                 confidenceScore: 0,
-                message: "未检测到有效数字水印"
+                message: signature ? "水印签名无效" : "未检测到有效数字水印",
+                ...signatureFields
             });
         }
     } catch (err) {
@@ -364,7 +427,40 @@ app.post('/api/verify_watermark_free', async (req, res) => {
     }
 });
 
-// 9. 前端托管
+// 9. 批量验证：上传 tar / tar.gz / zip 归档，C++ 服务流式读取并逐条返回 NDJSON，不解包
+const archiveUpload = multer({
+    storage: multer.diskStorage({
+        destination: (req, file, cb) => cb(null, UPLOAD_DIR),
+        filename: (req, file, cb) => cb(null, `${uuidv4()}.archive`)
+    }),
+    limits: { fileSize: 2 * 1024 * 1024 * 1024 }
+});
+
+app.post('/api/verify_bulk', archiveUpload.single('archive'), async (req, res) => {
+    if (!req.file) return res.status(400).json({ error: '请选择归档文件' });
+    const archivePath = path.resolve(req.file.path);
+    const cleanup = () => fs.unlink(archivePath, () => {});
+
+    try {
+        const cppResponse = await axios.post(`${CPP_SERVICE_URL}/verify/bulk`, { inputPath: archivePath }, { responseType: 'stream', headers: tenantHeaders(req) });
+        res.setHeader('Content-Type', 'application/x-ndjson');
+        cppResponse.data.pipe(res);
+        cppResponse.data.on('close', cleanup);
+        // 客户端提前断开时中止上游请求，C++ 侧随之停止读取归档
+        res.on('close', () => cppResponse.data.destroy());
+    } catch (err) {
+        cleanup();
+        // C++ 侧批量验证配额已满：原样转告客户端稍后重试
+        if (err.response?.status === 503) {
+            res.setHeader('Retry-After', err.response.headers['retry-after'] || '5');
+            return res.status(503).json({ error: '批量验证繁忙，请稍后重试' });
+        }
+        console.error('Bulk Verification Error:', err.message);
+        res.status(500).json({ error: 'System error: ' + err.message });
+    }
+});
+
+// 10. 前端托管
 app.use(express.static(CLIENT_DIST_DIR));
 app.get('*', (req, res) => {
     const indexHtml = path.join(CLIENT_DIST_DIR, 'index.html');